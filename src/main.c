@@ -8,9 +8,42 @@
 #include <string.h>
 #include <unistd.h>
 #include "wasi/wasi_shim.h"
+#include "wasi/wasi_vfs.h"
 #include "php/php_engine.h"
+#include "php/php_aot.h"
+#include "php/php_opcache.h"
+#include "php/php_output.h"
 #include "extensions/extension_manager.h"
 
+#if defined(PHP_SNAPSHOT) && defined(__wasi__)
+#include <wasi/libc.h>
+#include <wasi/libc-environ.h>
+#define SNAPSHOT_EXPORT __attribute__((export_name("wizer.initialize")))
+#else
+#define SNAPSHOT_EXPORT
+#endif
+
+#ifdef PHP_AOT
+// Functions of the packed application, generated with -C
+extern const php_aot_entry_t php_aot_entries[];
+#endif
+
+#ifdef PHP_BYTECODE
+// Compiled scripts of the packed application, from the C generated with -B
+extern const php_opcache_image_t php_opcache_images[];
+#endif
+
+#ifdef PHP_VFS
+// Files of the packed application, linked from php2wasm-pack output
+extern const uint8_t wasi_vfs_image[];
+extern const size_t wasi_vfs_image_size;
+
+static const uint8_t* vfs_reader(const char* path, size_t* size) {
+    const uint8_t* data = NULL;
+    return wasi_vfs_map(path, &data, size) == WASI_ESUCCESS ? data : NULL;
+}
+#endif
+
 static void print_usage(const char* program_name) {
     printf("Usage: %s [options] <file> [args...]\n", program_name);
     printf("\n");
@@ -25,11 +58,65 @@ static void print_usage(const char* program_name) {
     printf("  -s             Output HTML syntax highlighted source\n");
     printf("  -w             Strip whitespace and comments\n");
     printf("  -z             Load Zend extension\n");
+    printf("  -C out.c       Compile the functions of the files to C\n");
+    printf("  -B out         Compile the files to bytecode images in out, and C\n");
+    printf("                 linking them in out.c\n");
     printf("\n");
     printf("Examples:\n");
     printf("  %s script.php\n", program_name);
     printf("  %s -r 'echo \"Hello World\";'\n", program_name);
     printf("  %s -d display_errors=1 script.php\n", program_name);
+    printf("  %s -C aot.c index.php lib.php\n", program_name);
+    printf("  %s -B bytecode.img index.php lib.php\n", program_name);
+}
+
+// Lower the functions of the given scripts to C, for a build with PHP_AOT
+static int compile_aot(const char* output, int count, char** files) {
+    php_op_array_t** scripts = calloc(count > 0 ? (size_t)count : 1, sizeof(php_op_array_t*));
+    if (!scripts) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    int status = 0;
+    int compiled = 0;
+    for (int i = 0; i < count; i++) {
+        scripts[compiled] = php_opcache_compile_file(files[i]);
+        if (!scripts[compiled]) {
+            fprintf(stderr, "Failed to compile %s\n", files[i]);
+            status = 1;
+            break;
+        }
+        compiled++;
+    }
+
+    if (status == 0) {
+        FILE* out = fopen(output, "w");
+        int written = out ? php_aot_emit(scripts, (size_t)compiled, out) : -1;
+        if (out && fclose(out) != 0) {
+            written = -1;
+        }
+        if (written < 0) {
+            fprintf(stderr, "Failed to write %s\n", output);
+            status = 1;
+        }
+    }
+
+    for (int i = 0; i < compiled; i++) {
+        php_opcache_release(scripts[i]);
+    }
+    free(scripts);
+    return status;
+}
+
+// Compile the given scripts to images, for a build with PHP_BYTECODE of
+// the C written next to them
+static int compile_images(const char* output, int count, char** files) {
+    if (php_opcache_emit_images((const char* const*)files, (size_t)count, output) < 0) {
+        fprintf(stderr, "Failed to write %s\n", output);
+        return 1;
+    }
+    return 0;
 }
 
 static void print_version(void) {
@@ -39,6 +126,86 @@ static void print_version(void) {
     printf("Zend Engine v%s, with php2wasm v1.0.0\n", ZEND_VERSION);
 }
 
+// Apply a "key=value" php.ini directive; only the opcache and output
+// directives are supported so far
+static void set_ini(char* directive) {
+    char* separator = strchr(directive, '=');
+    if (!separator) return;
+    *separator = '\0';
+    if (!php_opcache_set_ini(directive, separator + 1) && !php_output_set_ini(directive, separator + 1)) {
+        fprintf(stderr, "Unsupported php.ini directive: %s\n", directive);
+    }
+}
+
+// Engine, builtins and extensions, before any script runs
+static bool runtime_init(void) {
+    if (!php_engine_init()) {
+        fprintf(stderr, "Failed to initialize PHP engine\n");
+        return false;
+    }
+    if (!extension_manager_init()) {
+        fprintf(stderr, "Failed to initialize extensions\n");
+        return false;
+    }
+#ifdef PHP_AOT
+    php_aot_register(php_aot_entries);
+#endif
+#ifdef PHP_BYTECODE
+    php_opcache_add_images(php_opcache_images);
+#endif
+#ifdef PHP_VFS
+    if (!wasi_vfs_mount(wasi_vfs_image, wasi_vfs_image_size)) {
+        fprintf(stderr, "Failed to mount the packed files\n");
+        return false;
+    }
+    php_opcache_set_reader(vfs_reader);
+#endif
+    return true;
+}
+
+#ifdef PHP_SNAPSHOT
+// Set when the module starts from a snapshot taken after initialize()
+static bool preinitialized = false;
+
+// Run once at pack time by Wizer, which saves linear memory afterwards as
+// the module's starting state. PHP2WASM_INI holds directives separated by
+// ';' and PHP2WASM_PRELOAD scripts separated by ':', compiled into the
+// opcache under the paths the module will see them by.
+SNAPSHOT_EXPORT
+void php2wasm_initialize(void) {
+    if (!wasi_init() || !runtime_init()) {
+        abort();
+    }
+
+    char* ini = getenv("PHP2WASM_INI");
+    ini = ini ? strdup(ini) : NULL;
+    for (char* directive = ini ? strtok(ini, ";") : NULL; directive; directive = strtok(NULL, ";")) {
+        set_ini(directive);
+    }
+    free(ini);
+
+    char* preload = getenv("PHP2WASM_PRELOAD");
+    preload = preload ? strdup(preload) : NULL;
+    for (char* path = preload ? strtok(preload, ":") : NULL; path; path = strtok(NULL, ":")) {
+        php_op_array_t* script = php_opcache_compile_file(path);
+        if (!script) {
+            fprintf(stderr, "Failed to preload %s\n", path);
+            abort();
+        }
+        php_opcache_release(script);
+    }
+    free(preload);
+
+#ifdef __wasi__
+    // The environment and preopened directories are those of the instance
+    // that runs, not of the one taking the snapshot
+    __wasilibc_deinitialize_environ();
+    __wasilibc_reset_preopens();
+#endif
+    preinitialized = true;
+}
+#endif
+
 int main(int argc, char* argv[]) {
     // Initialize WASI
     if (!wasi_init()) {
@@ -46,17 +213,15 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Initialize PHP engine
-    if (!php_engine_init()) {
-        fprintf(stderr, "Failed to initialize PHP engine\n");
+#ifdef PHP_SNAPSHOT
+    if (!preinitialized && !runtime_init()) {
         return 1;
     }
-
-    // Initialize extensions
-    if (!extension_manager_init()) {
-        fprintf(stderr, "Failed to initialize extensions\n");
+#else
+    if (!runtime_init()) {
         return 1;
     }
+#endif
 
     // Parse command line arguments
     int opt;
@@ -65,8 +230,10 @@ int main(int argc, char* argv[]) {
     int syntax_check = 0;
     int html_syntax = 0;
     int strip_whitespace = 0;
+    char* aot_output = NULL;
+    char* image_output = NULL;
 
-    while ((opt = getopt(argc, argv, "hvdef:lrs:wz:")) != -1) {
+    while ((opt = getopt(argc, argv, "hvd:ef:lrs:wz:C:B:")) != -1) {
         switch (opt) {
             case 'h':
                 print_usage(argv[0]);
@@ -75,7 +242,7 @@ int main(int argc, char* argv[]) {
                 print_version();
                 return 0;
             case 'd':
-                // TODO: Handle php.ini directives
+                set_ini(optarg);
                 break;
             case 'e':
             case 'r':
@@ -108,6 +275,12 @@ int main(int argc, char* argv[]) {
             case 'z':
                 // TODO: Handle Zend extensions
                 break;
+            case 'C':
+                aot_output = optarg;
+                break;
+            case 'B':
+                image_output = optarg;
+                break;
             default:
                 print_usage(argv[0]);
                 return 1;
@@ -115,7 +288,14 @@ int main(int argc, char* argv[]) {
     }
 
     // Determine what to execute
-    if (eval_code) {
+    if (aot_output || image_output) {
+        int status = aot_output ? compile_aot(aot_output, argc - optind, argv + optind)
+                                : compile_images(image_output, argc - optind, argv + optind);
+        extension_manager_cleanup();
+        php_engine_cleanup();
+        wasi_cleanup();
+        return status;
+    } else if (eval_code) {
         // Execute code from command line
         if (!php_engine_execute_string(eval_code)) {
             fprintf(stderr, "Failed to execute code\n");
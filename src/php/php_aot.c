@@ -0,0 +1,738 @@
+/**
+ * PHP Ahead-of-Time Compiler Implementation
+ * Lowers compiled functions to C that runs against the executor
+ */
+
+#include "php_aot.h"
+#include "php_array.h"
+#include "php_string.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define AOT_UNREACHED UINT32_MAX
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+static const php_aot_entry_t** tables = NULL;
+static size_t table_count = 0;
+
+void php_aot_register(const php_aot_entry_t* entries) {
+    const php_aot_entry_t** grown = realloc(tables, (table_count + 1) * sizeof(*tables));
+    if (!grown) return;
+    tables = grown;
+    tables[table_count++] = entries;
+}
+
+void php_aot_bind(php_op_array_t* op_array) {
+    if (table_count == 0 || !op_array->name) return;
+
+    uint64_t fingerprint = php_aot_fingerprint(op_array);
+    for (size_t t = 0; t < table_count; t++) {
+        for (const php_aot_entry_t* entry = tables[t]; entry->name; entry++) {
+            if (entry->fingerprint == fingerprint && strcasecmp(entry->name, op_array->name) == 0) {
+                op_array->native = entry->function;
+                return;
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Fingerprint
+// ---------------------------------------------------------------------------
+
+// FNV-1a, fed field by field so struct padding never counts
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_u64(uint64_t hash, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(value >> (i * 8));
+    }
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+static uint64_t hash_value(uint64_t hash, const php_value_t* value) {
+    hash = hash_u64(hash, value->type);
+    switch (value->type) {
+        case PHP_TYPE_BOOL:
+            return hash_u64(hash, value->value.bool_val);
+        case PHP_TYPE_INT:
+            return hash_u64(hash, (uint64_t)value->value.int_val);
+        case PHP_TYPE_FLOAT: {
+            uint64_t bits;
+            memcpy(&bits, &value->value.float_val, sizeof(bits));
+            return hash_u64(hash, bits);
+        }
+        case PHP_TYPE_STRING:
+            hash = hash_u64(hash, value->value.str->len);
+            return hash_bytes(hash, value->value.str->val, value->value.str->len);
+        case PHP_TYPE_ARRAY: {
+            const php_array_t* array = value->value.arr;
+            hash = hash_u64(hash, php_array_count(array));
+            uint32_t position = 0;
+            php_array_key_t key;
+            const php_value_t* element;
+            while ((element = php_array_next(array, &position, &key))) {
+                if (key.str) {
+                    hash = hash_u64(hash, key.str->len);
+                    hash = hash_bytes(hash, key.str->val, key.str->len);
+                } else {
+                    hash = hash_u64(hash, UINT64_MAX);
+                    hash = hash_u64(hash, (uint64_t)key.index);
+                }
+                hash = hash_value(hash, element);
+            }
+            return hash;
+        }
+        default:
+            return hash;
+    }
+}
+
+uint64_t php_aot_fingerprint(const php_op_array_t* op_array) {
+    uint64_t hash = 14695981039346656037ULL;
+    if (op_array->name) {
+        hash = hash_bytes(hash, op_array->name, strlen(op_array->name));
+    }
+    hash = hash_u64(hash, op_array->num_cvs);
+    hash = hash_u64(hash, op_array->num_params);
+    hash = hash_u64(hash, op_array->required_params);
+    hash = hash_u64(hash, op_array->by_ref | (uint64_t)op_array->variadic << 32);
+    for (uint32_t i = 0; i < op_array->num_cvs; i++) {
+        hash = hash_u64(hash, op_array->cv_names[i]);
+    }
+    for (uint32_t i = 0; i < op_array->op_count; i++) {
+        const php_op_t* op = &op_array->ops[i];
+        hash = hash_u64(hash, op->opcode | (uint64_t)op->ext << 8 | (uint64_t)op->lineno << 32);
+        hash = hash_u64(hash, op->op1 | (uint64_t)op->op2 << 32);
+    }
+    hash = hash_u64(hash, op_array->literal_count);
+    for (uint32_t i = 0; i < op_array->literal_count; i++) {
+        hash = hash_value(hash, &op_array->literals[i]);
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Stack layout
+// ---------------------------------------------------------------------------
+
+// Operands live in a C array, s[], whose depth at each op must be the same
+// on every path to it. Functions using ops the generated code cannot run,
+// such as "global" and $$name, stay interpreted.
+typedef struct {
+    const php_op_array_t* op_array;
+    uint32_t* depth;                    // Stack depth before each op, AOT_UNREACHED when none
+    bool* target;                       // Ops that are jumped to
+    uint32_t* work;
+    uint32_t work_count;
+    uint32_t max_depth;
+} layout_t;
+
+static bool is_variable_op(uint8_t opcode) {
+    switch (opcode) {
+        case PHP_OP_FETCH_VAR: case PHP_OP_FETCH_VAR_QUIET: case PHP_OP_ASSIGN_VAR: case PHP_OP_ASSIGN_OP_VAR:
+        case PHP_OP_UNSET_VAR: case PHP_OP_ISSET_VAR: case PHP_OP_PRE_INC_VAR: case PHP_OP_PRE_DEC_VAR:
+        case PHP_OP_POST_INC_VAR: case PHP_OP_POST_DEC_VAR: case PHP_OP_ASSIGN_DIM: case PHP_OP_INC_DEC_DIM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Values a straight-line op pops and pushes; false for ops that are not lowered
+static bool stack_effect(const php_op_t* op, uint32_t* pops, uint32_t* pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (op->opcode) {
+        case PHP_OP_NOP: case PHP_OP_UNSET_VAR: case PHP_OP_INC_NUMBER: case PHP_OP_DEC_NUMBER:
+        case PHP_OP_ECHO_CONST: case PHP_OP_RECV: case PHP_OP_RECV_INIT:
+            return true;
+        case PHP_OP_PUSH_CONST: case PHP_OP_FETCH_VAR: case PHP_OP_FETCH_VAR_QUIET: case PHP_OP_ISSET_VAR:
+        case PHP_OP_PRE_INC_VAR: case PHP_OP_PRE_DEC_VAR: case PHP_OP_POST_INC_VAR: case PHP_OP_POST_DEC_VAR:
+        case PHP_OP_INIT_ARRAY: case PHP_OP_PUSH_APPEND_KEY:
+            *pushes = 1;
+            return true;
+        case PHP_OP_POP: case PHP_OP_ECHO:
+            *pops = 1;
+            return true;
+        case PHP_OP_DUP:
+            *pops = 1;
+            *pushes = 2;
+            return true;
+        case PHP_OP_ASSIGN_VAR: case PHP_OP_ASSIGN_OP_VAR:
+        case PHP_OP_BOOL_NOT: case PHP_OP_BOOL: case PHP_OP_NEG: case PHP_OP_PLUS: case PHP_OP_BW_NOT:
+        case PHP_OP_CAST:
+            *pops = 1;
+            *pushes = 1;
+            return true;
+        case PHP_OP_ADD_ARRAY_ELEMENT:
+            *pops = op->ext ? 2 : 1;
+            return true;
+        case PHP_OP_FETCH_DIM: case PHP_OP_FETCH_DIM_QUIET:
+            *pops = 2;
+            *pushes = 1;
+            return true;
+        case PHP_OP_ASSIGN_DIM:
+            *pops = PHP_DIM_DEPTH(op->op2) + 1;
+            *pushes = 1;
+            return true;
+        case PHP_OP_INC_DEC_DIM:
+            *pops = PHP_DIM_DEPTH(op->op2);
+            *pushes = 1;
+            return true;
+        case PHP_OP_CONCAT_N:
+            *pops = op->op1;
+            *pushes = 1;
+            return true;
+        case PHP_OP_FE_FREE:
+            *pops = 2;
+            return true;
+        case PHP_OP_CALL:
+            *pops = op->op2;
+            *pushes = 1;
+            return true;
+        default:
+            if ((op->opcode >= PHP_OP_ADD && op->opcode <= PHP_OP_BOOL_XOR) ||
+                (op->opcode >= PHP_OP_ADD_NUMBER && op->opcode <= PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER)) {
+                *pops = 2;
+                *pushes = 1;
+                return true;
+            }
+            return false;
+    }
+}
+
+static bool layout_reach(layout_t* l, uint32_t index, uint32_t depth) {
+    if (index >= l->op_array->op_count) return false;
+    if (l->depth[index] == AOT_UNREACHED) {
+        l->depth[index] = depth;
+        l->work[l->work_count++] = index;
+        if (depth > l->max_depth) l->max_depth = depth;
+        return true;
+    }
+    return l->depth[index] == depth;
+}
+
+static bool layout_jump(layout_t* l, uint32_t target, uint32_t depth) {
+    if (target >= l->op_array->op_count) return false;
+    l->target[target] = true;
+    return layout_reach(l, target, depth);
+}
+
+// Depth of every reachable op, or false when the function is not lowered
+static bool layout_analyze(layout_t* l) {
+    const php_op_array_t* op_array = l->op_array;
+    if (!layout_reach(l, 0, 0)) return false;
+
+    while (l->work_count > 0) {
+        uint32_t i = l->work[--l->work_count];
+        const php_op_t* op = &op_array->ops[i];
+        uint32_t d = l->depth[i];
+        if (is_variable_op(op->opcode) && (op->ext & PHP_VAR_DYNAMIC)) return false;
+
+        bool ok;
+        switch (op->opcode) {
+            case PHP_OP_JMP:
+                ok = layout_jump(l, op->op1, d);
+                break;
+            case PHP_OP_JMPZ:
+            case PHP_OP_JMPNZ:
+                ok = d >= 1 && layout_jump(l, op->op1, d - 1) && layout_reach(l, i + 1, d - 1);
+                break;
+            case PHP_OP_JMPZ_EX:
+            case PHP_OP_JMPNZ_EX:
+            case PHP_OP_JMP_SET:
+            case PHP_OP_JMP_NOT_NULL:
+                ok = d >= 1 && layout_jump(l, op->op1, d) && layout_reach(l, i + 1, d - 1);
+                break;
+            case PHP_OP_FE_RESET:
+                ok = d >= 1 && layout_jump(l, op->op1, d - 1) && layout_reach(l, i + 1, d + 1);
+                break;
+            case PHP_OP_FE_FETCH:
+                ok = d >= 2 && layout_jump(l, op->op1, d) && layout_reach(l, i + 1, d + (op->ext ? 1 : 0));
+                break;
+            case PHP_OP_RETURN:
+                ok = d >= 1;
+                break;
+            default: {
+                uint32_t pops, pushes;
+                // Elements are added to the array below their operands
+                uint32_t below = op->opcode == PHP_OP_ADD_ARRAY_ELEMENT ? 1 : 0;
+                ok = stack_effect(op, &pops, &pushes) && d >= pops + below &&
+                     layout_reach(l, i + 1, d - pops + pushes);
+                break;
+            }
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Code generation
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} text_t;
+
+static void text_printf(text_t* text, const char* fmt, ...) {
+    if (text->failed) return;
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(text->data ? text->data + text->length : NULL,
+                           text->data ? text->capacity - text->length : 0, fmt, args);
+    va_end(args);
+    if (length < 0) {
+        text->failed = true;
+        return;
+    }
+    if (text->length + (size_t)length + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity * 2 : 4096;
+        while (capacity < text->length + (size_t)length + 1) {
+            capacity *= 2;
+        }
+        char* data = realloc(text->data, capacity);
+        if (!data) {
+            text->failed = true;
+            return;
+        }
+        text->data = data;
+        text->capacity = capacity;
+        va_start(args, fmt);
+        vsnprintf(text->data + text->length, text->capacity - text->length, fmt, args);
+        va_end(args);
+    }
+    text->length += (size_t)length;
+}
+
+// A C string literal of a function name
+static void text_c_string(text_t* text, const char* str) {
+    text_printf(text, "\"");
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        if (*p < 0x20 || *p >= 0x7f || *p == '"' || *p == '\\' || *p == '?') {
+            text_printf(text, "\\%03o", *p);
+        } else {
+            text_printf(text, "%c", *p);
+        }
+    }
+    text_printf(text, "\"");
+}
+
+typedef struct {
+    text_t* text;
+    const php_op_array_t* op_array;
+    bool* unwind;                       // Unwind labels used, by live operand count
+} emitter_t;
+
+// Leave the function when a runtime helper fails, releasing the live
+// operands below it
+static void emit_check(emitter_t* e, const char* fmt, uint32_t live, ...) {
+    va_list args;
+    va_start(args, live);
+    char call[256];
+    vsnprintf(call, sizeof(call), fmt, args);
+    va_end(args);
+    text_printf(e->text, "    if (!%s) goto U%u;\n", call, live);
+    e->unwind[live] = true;
+}
+
+// Literals emit_literal writes as C constants rather than copying from
+// the frame's op array
+static bool literal_is_inline(const php_value_t* value) {
+    return value->type == PHP_TYPE_NULL || value->type == PHP_TYPE_BOOL || value->type == PHP_TYPE_INT ||
+           (value->type == PHP_TYPE_FLOAT && isfinite(value->value.float_val));
+}
+
+static void emit_literal(emitter_t* e, uint32_t slot, uint32_t literal) {
+    const php_value_t* value = &e->op_array->literals[literal];
+    switch (value->type) {
+        case PHP_TYPE_NULL:
+            text_printf(e->text, "    php_value_set_null(&s[%u]);\n", slot);
+            return;
+        case PHP_TYPE_BOOL:
+            text_printf(e->text, "    php_value_set_bool(&s[%u], %s);\n", slot, value->value.bool_val ? "true" : "false");
+            return;
+        case PHP_TYPE_INT:
+            if (value->value.int_val == INT64_MIN) {
+                text_printf(e->text, "    php_value_set_int(&s[%u], INT64_MIN);\n", slot);
+            } else {
+                text_printf(e->text, "    php_value_set_int(&s[%u], INT64_C(%" PRId64 "));\n", slot, value->value.int_val);
+            }
+            return;
+        case PHP_TYPE_FLOAT:
+            if (isfinite(value->value.float_val)) {
+                text_printf(e->text, "    php_value_set_float(&s[%u], %a);\n", slot, value->value.float_val);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    text_printf(e->text, "    php_value_copy(&s[%u], &f->op_array->literals[%u]);\n", slot, literal);
+}
+
+// Ops that can report a diagnostic or call out set the ip it names
+static bool needs_ip(uint8_t opcode) {
+    switch (opcode) {
+        case PHP_OP_NOP: case PHP_OP_PUSH_CONST: case PHP_OP_POP: case PHP_OP_DUP: case PHP_OP_FETCH_VAR_QUIET:
+        case PHP_OP_ASSIGN_VAR: case PHP_OP_ISSET_VAR: case PHP_OP_PUSH_APPEND_KEY: case PHP_OP_JMP:
+        case PHP_OP_JMPZ: case PHP_OP_JMPNZ: case PHP_OP_JMPZ_EX: case PHP_OP_JMPNZ_EX: case PHP_OP_JMP_SET:
+        case PHP_OP_JMP_NOT_NULL: case PHP_OP_FE_FETCH: case PHP_OP_FE_FREE: case PHP_OP_ECHO_CONST:
+        case PHP_OP_RETURN:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Ops whose lowering names the frame, other than through needs_ip
+static bool uses_frame(const php_op_array_t* op_array, const php_op_t* op) {
+    switch (op->opcode) {
+        case PHP_OP_PUSH_CONST:
+            return !literal_is_inline(&op_array->literals[op->op1]);
+        case PHP_OP_FETCH_VAR_QUIET: case PHP_OP_ASSIGN_VAR: case PHP_OP_ISSET_VAR: case PHP_OP_FE_FETCH:
+        case PHP_OP_ECHO_CONST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void emit_op(emitter_t* e, uint32_t i, uint32_t d) {
+    const php_op_t* op = &e->op_array->ops[i];
+    text_t* text = e->text;
+    const char* name = php_opcode_name(op->opcode);
+
+    if (needs_ip(op->opcode)) {
+        text_printf(text, "    f->ip = %u;\n", i + 1);
+    }
+
+    switch (op->opcode) {
+        case PHP_OP_NOP:
+            break;
+        case PHP_OP_PUSH_CONST:
+            emit_literal(e, d, op->op1);
+            break;
+        case PHP_OP_POP:
+            text_printf(text, "    php_value_release(&s[%u]);\n", d - 1);
+            break;
+        case PHP_OP_DUP:
+            text_printf(text, "    php_value_copy(&s[%u], &s[%u]);\n", d, d - 1);
+            break;
+        case PHP_OP_FETCH_VAR:
+        case PHP_OP_FETCH_VAR_QUIET:
+            text_printf(text, "    php_aot_fetch_var(f, %u, %s, &s[%u]);\n", op->op1,
+                        op->opcode == PHP_OP_FETCH_VAR_QUIET ? "true" : "false", d);
+            break;
+        case PHP_OP_ASSIGN_VAR:
+            text_printf(text, "    php_variable_assign(&f->cvs[%u], &s[%u]);\n", op->op1, d - 1);
+            break;
+        case PHP_OP_ASSIGN_OP_VAR:
+            emit_check(e, "php_aot_assign_op(f, %u, PHP_OP_%s, &s[%u])", d - 1, op->op1,
+                       php_opcode_name((uint8_t)op->op2), d - 1);
+            break;
+        case PHP_OP_UNSET_VAR:
+            text_printf(text, "    php_aot_unset(f, %u);\n", op->op1);
+            break;
+        case PHP_OP_ISSET_VAR:
+            text_printf(text, "    php_aot_isset(f, %u, &s[%u]);\n", op->op1, d);
+            break;
+        case PHP_OP_PRE_INC_VAR:
+        case PHP_OP_PRE_DEC_VAR:
+        case PHP_OP_POST_INC_VAR:
+        case PHP_OP_POST_DEC_VAR:
+            text_printf(text, "    php_aot_inc_dec(f, %u, PHP_OP_%s, &s[%u]);\n", op->op1, name, d);
+            break;
+        case PHP_OP_INC_NUMBER:
+        case PHP_OP_DEC_NUMBER:
+            text_printf(text, "    php_aot_counter(f, %u, %s);\n", op->op1,
+                        op->opcode == PHP_OP_INC_NUMBER ? "true" : "false");
+            break;
+        case PHP_OP_INIT_ARRAY:
+            emit_check(e, "php_aot_init_array(%u, &s[%u])", d, op->op1, d);
+            break;
+        case PHP_OP_ADD_ARRAY_ELEMENT:
+            if (op->ext) {
+                emit_check(e, "php_aot_add_element(&s[%u], &s[%u], &s[%u])", d - 2, d - 3, d - 2, d - 1);
+            } else {
+                emit_check(e, "php_aot_add_element(&s[%u], NULL, &s[%u])", d - 1, d - 2, d - 1);
+            }
+            break;
+        case PHP_OP_FETCH_DIM:
+        case PHP_OP_FETCH_DIM_QUIET:
+            emit_check(e, "php_aot_fetch_dim(%s, &s[%u], &s[%u])", d - 2,
+                       op->opcode == PHP_OP_FETCH_DIM_QUIET ? "true" : "false", d - 2, d - 1);
+            break;
+        case PHP_OP_PUSH_APPEND_KEY:
+            text_printf(text, "    s[%u].type = PHP_TYPE_UNDEF;\n", d);
+            break;
+        case PHP_OP_ASSIGN_DIM: {
+            uint32_t keys = d - 1 - PHP_DIM_DEPTH(op->op2);
+            emit_check(e, "php_aot_assign_dim(f, %u, %uu, &s[%u])", keys, op->op1, op->op2, keys);
+            break;
+        }
+        case PHP_OP_INC_DEC_DIM: {
+            uint32_t keys = d - PHP_DIM_DEPTH(op->op2);
+            emit_check(e, "php_aot_inc_dec_dim(f, %u, %uu, &s[%u])", keys, op->op1, op->op2, keys);
+            break;
+        }
+        case PHP_OP_ADD:
+        case PHP_OP_SUB:
+        case PHP_OP_MUL:
+            emit_check(e, "php_aot_arithmetic(PHP_OP_%s, &s[%u], &s[%u])", d - 2, name, d - 2, d - 1);
+            break;
+        case PHP_OP_ADD_NUMBER:
+        case PHP_OP_SUB_NUMBER:
+        case PHP_OP_MUL_NUMBER:
+            emit_check(e, "php_aot_arithmetic(PHP_OP_%s, &s[%u], &s[%u])", d - 2,
+                       php_opcode_name((uint8_t)(op->opcode - PHP_OP_ADD_NUMBER + PHP_OP_ADD)), d - 2, d - 1);
+            break;
+        case PHP_OP_IS_EQUAL:
+        case PHP_OP_IS_NOT_EQUAL:
+        case PHP_OP_IS_IDENTICAL:
+        case PHP_OP_IS_NOT_IDENTICAL:
+        case PHP_OP_IS_SMALLER:
+        case PHP_OP_IS_SMALLER_OR_EQUAL:
+            text_printf(text, "    php_aot_compare(PHP_OP_%s, %u, &s[%u], &s[%u]);\n", name, op->ext, d - 2, d - 1);
+            break;
+        case PHP_OP_IS_SMALLER_NUMBER:
+        case PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER:
+            text_printf(text, "    php_aot_compare(PHP_OP_%s, %u, &s[%u], &s[%u]);\n",
+                        op->opcode == PHP_OP_IS_SMALLER_NUMBER ? "IS_SMALLER" : "IS_SMALLER_OR_EQUAL", op->ext,
+                        d - 2, d - 1);
+            break;
+        case PHP_OP_CONCAT:
+        case PHP_OP_SPACESHIP:
+        case PHP_OP_BOOL_XOR:
+            // These never fail
+            text_printf(text, "    php_aot_binary(PHP_OP_%s, %u, &s[%u], &s[%u]);\n", name, op->ext, d - 2, d - 1);
+            break;
+        case PHP_OP_CONCAT_N:
+            emit_check(e, "php_aot_concat(%u, &s[%u])", d - op->op1, op->op1, d - op->op1);
+            break;
+        case PHP_OP_BOOL_NOT:
+        case PHP_OP_BOOL:
+            text_printf(text, "    php_aot_unary(PHP_OP_%s, 0, &s[%u]);\n", name, d - 1);
+            break;
+        case PHP_OP_NEG:
+        case PHP_OP_PLUS:
+        case PHP_OP_BW_NOT:
+        case PHP_OP_CAST:
+            emit_check(e, "php_aot_unary(PHP_OP_%s, %u, &s[%u])", d - 1, name, op->ext, d - 1);
+            break;
+        case PHP_OP_JMP:
+            text_printf(text, "    goto L%u;\n", op->op1);
+            break;
+        case PHP_OP_JMPZ:
+        case PHP_OP_JMPNZ:
+            text_printf(text, "    if (%sphp_aot_test(&s[%u])) goto L%u;\n", op->opcode == PHP_OP_JMPZ ? "!" : "",
+                        d - 1, op->op1);
+            break;
+        case PHP_OP_JMPZ_EX:
+        case PHP_OP_JMPNZ_EX: {
+            bool jump_on = op->opcode == PHP_OP_JMPNZ_EX;
+            text_printf(text, "    if (%sphp_aot_test(&s[%u])) {\n", jump_on ? "" : "!", d - 1);
+            text_printf(text, "        php_value_set_bool(&s[%u], %s);\n", d - 1, jump_on ? "true" : "false");
+            text_printf(text, "        goto L%u;\n    }\n", op->op1);
+            break;
+        }
+        case PHP_OP_JMP_SET:
+            text_printf(text, "    if (php_aot_truth(&s[%u])) goto L%u;\n", d - 1, op->op1);
+            text_printf(text, "    php_value_release(&s[%u]);\n", d - 1);
+            break;
+        case PHP_OP_JMP_NOT_NULL:
+            text_printf(text, "    if (s[%u].type != PHP_TYPE_NULL) goto L%u;\n", d - 1, op->op1);
+            break;
+        case PHP_OP_FE_RESET:
+            text_printf(text, "    if (!php_aot_fe_reset(&s[%u], &s[%u])) goto L%u;\n", d - 1, d, op->op1);
+            break;
+        case PHP_OP_FE_FETCH:
+            if (op->ext) {
+                text_printf(text, "    if (!php_aot_fe_fetch(f, %u, &s[%u], &s[%u])) goto L%u;\n", op->op2, d - 2, d,
+                            op->op1);
+            } else {
+                text_printf(text, "    if (!php_aot_fe_fetch(f, %u, &s[%u], NULL)) goto L%u;\n", op->op2, d - 2,
+                            op->op1);
+            }
+            break;
+        case PHP_OP_FE_FREE:
+            text_printf(text, "    php_value_release(&s[%u]);\n", d - 2);
+            break;
+        case PHP_OP_ECHO:
+            text_printf(text, "    php_aot_echo(&s[%u]);\n", d - 1);
+            break;
+        case PHP_OP_ECHO_CONST:
+            text_printf(text, "    php_aot_echo_const(f, %u);\n", op->op1);
+            break;
+        case PHP_OP_CALL:
+            emit_check(e, "php_aot_call(f, %u, %u, &s[%u])", d - op->op2, op->op1, op->op2, d - op->op2);
+            break;
+        case PHP_OP_RECV:
+            emit_check(e, "php_aot_recv(f, %u, PHP_AOT_NO_DEFAULT)", d, op->op1);
+            break;
+        case PHP_OP_RECV_INIT:
+            emit_check(e, "php_aot_recv(f, %u, %u)", d, op->op1, op->op2);
+            break;
+        case PHP_OP_RETURN:
+            // A return inside foreach leaves the array below the value
+            for (uint32_t k = 0; k + 1 < d; k++) {
+                text_printf(text, "    php_value_release(&s[%u]);\n", k);
+            }
+            text_printf(text, "    *result = s[%u];\n    return true;\n", d - 1);
+            break;
+        default:
+            // Every other binary op can fail on its operands
+            emit_check(e, "php_aot_binary(PHP_OP_%s, %u, &s[%u], &s[%u])", d - 2, name, op->ext, d - 2, d - 1);
+            break;
+    }
+}
+
+// Lower one function to a C function named aot_<index>; false when it
+// stays interpreted
+static bool emit_function(text_t* text, const php_op_array_t* op_array, int index) {
+    uint32_t count = op_array->op_count;
+    if (count == 0) return false;
+
+    layout_t l = {op_array, malloc(count * sizeof(uint32_t)), calloc(count, sizeof(bool)),
+                  malloc(count * sizeof(uint32_t)), 0, 0};
+    bool ok = l.depth && l.target && l.work;
+    if (ok) {
+        for (uint32_t i = 0; i < count; i++) {
+            l.depth[i] = AOT_UNREACHED;
+        }
+        ok = layout_analyze(&l);
+    }
+    bool* unwind = ok ? calloc(l.max_depth + 1, sizeof(bool)) : NULL;
+    if (!unwind) {
+        free(l.depth);
+        free(l.target);
+        free(l.work);
+        return false;
+    }
+
+    emitter_t e = {text, op_array, unwind};
+    text_printf(text, "\n// %s()\n", op_array->name);
+    text_printf(text, "static bool aot_%d(php_aot_frame_t* f, php_value_t* result) {\n", index);
+    text_printf(text, "    php_value_t s[%u];\n", l.max_depth);
+    bool frame_used = false;
+    for (uint32_t i = 0; i < count && !frame_used; i++) {
+        const php_op_t* op = &op_array->ops[i];
+        frame_used = l.depth[i] != AOT_UNREACHED && (needs_ip(op->opcode) || uses_frame(op_array, op));
+    }
+    if (!frame_used) {
+        text_printf(text, "    (void)f;\n");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (l.depth[i] == AOT_UNREACHED) continue;
+        if (l.target[i]) {
+            text_printf(text, "L%u:;\n", i);
+        }
+        emit_op(&e, i, l.depth[i]);
+    }
+
+    // Failed helpers fall through the releases of what lies below them
+    uint32_t top = l.max_depth + 1;
+    while (top > 0 && !unwind[top - 1]) {
+        top--;
+    }
+    if (top > 0) {
+        for (uint32_t k = top - 1; k > 0; k--) {
+            if (unwind[k]) text_printf(text, "U%u:\n", k);
+            text_printf(text, "    php_value_release(&s[%u]);\n", k - 1);
+        }
+        if (unwind[0]) text_printf(text, "U0:\n");
+        text_printf(text, "    return false;\n");
+    }
+    text_printf(text, "}\n");
+
+    free(l.depth);
+    free(l.target);
+    free(l.work);
+    free(unwind);
+    return true;
+}
+
+// Functions written so far; aot_<k> is the body of written[k]
+typedef struct {
+    text_t* text;
+    const php_op_array_t** written;
+    uint64_t* fingerprints;
+    int written_count;
+} aot_output_t;
+
+// Functions declared inside a function follow the one declaring them
+static void emit_functions(aot_output_t* o, const php_op_array_t* op_array) {
+    for (uint32_t i = 0; i < op_array->function_count && !o->text->failed; i++) {
+        const php_op_array_t* func = op_array->functions[i];
+        uint64_t fingerprint = php_aot_fingerprint(func);
+
+        // The same function in several scripts needs one body
+        bool seen = false;
+        for (int k = 0; k < o->written_count && !seen; k++) {
+            seen = o->fingerprints[k] == fingerprint && strcasecmp(o->written[k]->name, func->name) == 0;
+        }
+        if (!seen) {
+            const php_op_array_t** grown_written =
+                realloc(o->written, (o->written_count + 1) * sizeof(*o->written));
+            if (grown_written) o->written = grown_written;
+            uint64_t* grown_fingerprints =
+                realloc(o->fingerprints, (o->written_count + 1) * sizeof(*o->fingerprints));
+            if (grown_fingerprints) o->fingerprints = grown_fingerprints;
+            if (!grown_written || !grown_fingerprints) {
+                o->text->failed = true;
+                return;
+            }
+
+            if (emit_function(o->text, func, o->written_count)) {
+                o->written[o->written_count] = func;
+                o->fingerprints[o->written_count] = fingerprint;
+                o->written_count++;
+            }
+        }
+        emit_functions(o, func);
+    }
+}
+
+int php_aot_emit(php_op_array_t* const* scripts, size_t count, FILE* out) {
+    text_t text = {NULL, 0, 0, false};
+    text_printf(&text, "// Generated by php2wasm from compiled PHP functions; do not edit\n\n");
+    text_printf(&text, "#include \"php_aot.h\"\n");
+
+    aot_output_t o = {&text, NULL, NULL, 0};
+    for (size_t s = 0; s < count; s++) {
+        emit_functions(&o, scripts[s]);
+    }
+
+    text_printf(&text, "\nconst php_aot_entry_t php_aot_entries[] = {\n");
+    for (int k = 0; k < o.written_count; k++) {
+        text_printf(&text, "    {");
+        text_c_string(&text, o.written[k]->name);
+        text_printf(&text, ", 0x%016" PRIx64 "ull, aot_%d},\n", o.fingerprints[k], k);
+    }
+    text_printf(&text, "    {NULL, 0, NULL}\n};\n");
+
+    bool ok = !text.failed && fwrite(text.data, 1, text.length, out) == text.length;
+    free(text.data);
+    free(o.written);
+    free(o.fingerprints);
+    return ok ? o.written_count : -1;
+}
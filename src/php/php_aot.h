@@ -0,0 +1,181 @@
+/**
+ * PHP Ahead-of-Time Compiler Header
+ * Lowers compiled functions to C that runs against the executor
+ */
+
+#ifndef PHP_AOT_H
+#define PHP_AOT_H
+
+#include "php_compiler.h"
+#include "php_variables.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A compiled function while it runs: the variables of its frame, its op
+// array for literals and calls, and the op it is at for diagnostics
+typedef struct php_aot_frame {
+    php_variable_t* cvs;
+    const php_op_array_t* op_array;
+    uint32_t ip;                        // Index of the current op + 1, as in the interpreter
+} php_aot_frame_t;
+
+// Body of a function compiled ahead of time. False when a fatal error or
+// exit() stopped it; its temporaries are released either way and the
+// executor pops its frame.
+typedef bool (*php_aot_function_t)(php_aot_frame_t* frame, php_value_t* result);
+
+// Compiled functions of an application, ended by a NULL name. The
+// fingerprint ties each to the op array it was lowered from, so a script
+// changed since then runs interpreted.
+typedef struct {
+    const char* name;
+    uint64_t fingerprint;
+    php_aot_function_t function;
+} php_aot_entry_t;
+
+// Make compiled functions available to the scripts compiled or loaded after
+void php_aot_register(const php_aot_entry_t* entries);
+
+// Attach the compiled body of a function op array, when there is one
+void php_aot_bind(php_op_array_t* op_array);
+
+// Hash of the ops and literals of an op array
+uint64_t php_aot_fingerprint(const php_op_array_t* op_array);
+
+// Write C for the functions of the scripts that can be lowered, followed by
+// the php_aot_entries table listing them; the others stay interpreted.
+// Returns the number of functions written, or -1 on a write error.
+int php_aot_emit(php_op_array_t* const* scripts, size_t count, FILE* out);
+
+// ---------------------------------------------------------------------------
+// Runtime for generated code, in php_executor.c
+// ---------------------------------------------------------------------------
+//
+// Operands are consumed and a result replaces the first of them. Those
+// returning bool give false after a fatal error.
+
+#define PHP_AOT_NO_DEFAULT UINT32_MAX
+
+bool php_aot_recv(php_aot_frame_t* frame, uint32_t index, uint32_t default_literal);
+void php_aot_undefined(php_aot_frame_t* frame, uint32_t cv, php_value_t* result);
+bool php_aot_assign_op(php_aot_frame_t* frame, uint32_t cv, uint8_t opcode, php_value_t* value);
+void php_aot_inc_dec(php_aot_frame_t* frame, uint32_t cv, uint8_t opcode, php_value_t* result);
+void php_aot_unset(php_aot_frame_t* frame, uint32_t cv);
+
+bool php_aot_binary(uint8_t opcode, uint8_t ext, php_value_t* a, php_value_t* b);
+bool php_aot_unary(uint8_t opcode, uint8_t ext, php_value_t* a);
+bool php_aot_concat(uint32_t count, php_value_t* parts);
+
+bool php_aot_init_array(uint32_t size, php_value_t* result);
+bool php_aot_add_element(php_value_t* array, php_value_t* key, php_value_t* value);
+bool php_aot_fetch_dim(bool quiet, php_value_t* container, php_value_t* key);
+
+// Element writes of op2 (PHP_DIM_OP2) on slot cv, with the keys followed by
+// any value from keys[0]
+bool php_aot_assign_dim(php_aot_frame_t* frame, uint32_t cv, uint32_t op2, php_value_t* keys);
+bool php_aot_inc_dec_dim(php_aot_frame_t* frame, uint32_t cv, uint32_t op2, php_value_t* keys);
+
+// foreach over value, or false to skip the loop; then the value and its
+// position (two slots) give each element, and a key when key is set,
+// until fe_fetch returns false
+bool php_aot_fe_reset(php_value_t* value, php_value_t* position);
+bool php_aot_fe_fetch(php_aot_frame_t* frame, uint32_t cv, php_value_t* iterator, php_value_t* key);
+
+void php_aot_echo(php_value_t* value);
+void php_aot_echo_const(php_aot_frame_t* frame, uint32_t literal);
+
+// Call the function named by a literal with argc values from args
+bool php_aot_call(php_aot_frame_t* frame, uint32_t name_literal, uint32_t argc, php_value_t* args);
+
+// ---------------------------------------------------------------------------
+// Inline fast paths, falling back to the runtime
+// ---------------------------------------------------------------------------
+
+static inline bool php_aot_truth(const php_value_t* value) {
+    return value->type == PHP_TYPE_BOOL ? value->value.bool_val : php_value_is_true(value);
+}
+
+// Truth of a condition, which is consumed
+static inline bool php_aot_test(php_value_t* value) {
+    bool truth = php_aot_truth(value);
+    php_value_release(value);
+    return truth;
+}
+
+static inline void php_aot_fetch_var(php_aot_frame_t* frame, uint32_t cv, bool quiet, php_value_t* result) {
+    const php_variable_t* var = php_variable_deref(&frame->cvs[cv]);
+    if (var->value.type != PHP_TYPE_UNDEF) {
+        php_value_copy(result, &var->value);
+    } else if (quiet) {
+        php_value_set_null(result);
+    } else {
+        php_aot_undefined(frame, cv, result);
+    }
+}
+
+static inline void php_aot_isset(php_aot_frame_t* frame, uint32_t cv, php_value_t* result) {
+    php_type_t type = php_variable_deref(&frame->cvs[cv])->value.type;
+    php_value_set_bool(result, type != PHP_TYPE_UNDEF && type != PHP_TYPE_NULL);
+}
+
+// +, - and * of two integers that do not overflow, or of two floats
+static inline bool php_aot_arithmetic(uint8_t opcode, php_value_t* a, php_value_t* b) {
+    if (a->type == PHP_TYPE_INT && b->type == PHP_TYPE_INT) {
+        int64_t x = a->value.int_val;
+        int64_t y = b->value.int_val;
+        int64_t value;
+        bool overflow = opcode == PHP_OP_ADD   ? __builtin_add_overflow(x, y, &value)
+                        : opcode == PHP_OP_SUB ? __builtin_sub_overflow(x, y, &value)
+                                               : __builtin_mul_overflow(x, y, &value);
+        if (!overflow) {
+            a->value.int_val = value;
+            return true;
+        }
+    } else if (a->type == PHP_TYPE_FLOAT && b->type == PHP_TYPE_FLOAT) {
+        double x = a->value.float_val;
+        double y = b->value.float_val;
+        a->value.float_val = opcode == PHP_OP_ADD ? x + y : opcode == PHP_OP_SUB ? x - y : x * y;
+        return true;
+    }
+    return php_aot_binary(opcode, 0, a, b);
+}
+
+// Comparisons of two integers
+static inline void php_aot_compare(uint8_t opcode, uint8_t ext, php_value_t* a, php_value_t* b) {
+    if (a->type == PHP_TYPE_INT && b->type == PHP_TYPE_INT) {
+        int64_t x = ext ? b->value.int_val : a->value.int_val;
+        int64_t y = ext ? a->value.int_val : b->value.int_val;
+        bool result;
+        switch (opcode) {
+            case PHP_OP_IS_SMALLER: result = x < y; break;
+            case PHP_OP_IS_SMALLER_OR_EQUAL: result = x <= y; break;
+            case PHP_OP_IS_NOT_EQUAL:
+            case PHP_OP_IS_NOT_IDENTICAL: result = x != y; break;
+            default: result = x == y; break;
+        }
+        php_value_set_bool(a, result);
+        return;
+    }
+    php_aot_binary(opcode, ext, a, b);
+}
+
+// "$i++;" and "$i--;" on a variable inferred to be a number
+static inline void php_aot_counter(php_aot_frame_t* frame, uint32_t cv, bool increment) {
+    php_value_t* value = &php_variable_deref(&frame->cvs[cv])->value;
+    if (value->type == PHP_TYPE_INT && value->value.int_val != (increment ? INT64_MAX : INT64_MIN)) {
+        value->value.int_val += increment ? 1 : -1;
+    } else if (value->type == PHP_TYPE_FLOAT) {
+        value->value.float_val += increment ? 1.0 : -1.0;
+    } else {
+        php_aot_inc_dec(frame, cv, increment ? PHP_OP_PRE_INC_VAR : PHP_OP_PRE_DEC_VAR, NULL);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_AOT_H
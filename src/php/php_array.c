@@ -0,0 +1,528 @@
+/**
+ * PHP Array Implementation
+ * Ordered hash tables with a packed vector layout for list-like arrays
+ */
+
+#include "php_array.h"
+#include "php_hash.h"
+#include "php_memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARRAY_MIN_CAPACITY 8
+
+#define INDEX_EMPTY UINT32_MAX
+#define INDEX_DELETED (UINT32_MAX - 1)
+
+static php_array_t empty_array = {
+    {1, PHP_GC_IMMORTAL}, PHP_ARRAY_PACKED, 0, 0, 0, 0, {NULL}, NULL
+};
+
+php_array_t* php_array_empty(void) {
+    return &empty_array;
+}
+
+static inline void* storage_alloc(uint32_t flags, size_t size) {
+    return (flags & PHP_ARRAY_PERSISTENT) ? malloc(size) : php_memory_alloc(size);
+}
+
+static inline void* storage_realloc(uint32_t flags, void* ptr, size_t size) {
+    return (flags & PHP_ARRAY_PERSISTENT) ? realloc(ptr, size) : php_memory_realloc(ptr, size);
+}
+
+static inline void storage_free(uint32_t flags, void* ptr) {
+    if (flags & PHP_ARRAY_PERSISTENT) {
+        free(ptr);
+    } else {
+        php_memory_free(ptr);
+    }
+}
+
+static php_array_t* array_new(uint32_t capacity, uint32_t flags) {
+    php_array_t* array = storage_alloc(flags, sizeof(php_array_t));
+    if (!array) return NULL;
+
+    array->gc.refcount = 1;
+    array->gc.flags = 0;
+    array->flags = PHP_ARRAY_PACKED | flags;
+    array->count = 0;
+    array->used = 0;
+    array->capacity = 0;
+    array->next_index = INT64_MIN;
+    array->data.packed = NULL;
+    array->index = NULL;
+
+    // Storage is allocated on the first insert unless a size is known
+    if (capacity > 0) {
+        uint32_t rounded = ARRAY_MIN_CAPACITY;
+        while (rounded < capacity && rounded < (UINT32_MAX >> 2)) rounded <<= 1;
+        array->data.packed = storage_alloc(flags, rounded * sizeof(php_value_t));
+        if (!array->data.packed) {
+            storage_free(flags, array);
+            return NULL;
+        }
+        array->capacity = rounded;
+    }
+    return array;
+}
+
+php_array_t* php_array_new(uint32_t capacity) {
+    return array_new(capacity, 0);
+}
+
+php_array_t* php_array_new_persistent(uint32_t capacity) {
+    return array_new(capacity, PHP_ARRAY_PERSISTENT);
+}
+
+static inline bool is_packed(const php_array_t* array) {
+    return array->flags & PHP_ARRAY_PACKED;
+}
+
+static inline uint32_t index_slots(const php_array_t* array) {
+    return array->capacity * 2;
+}
+
+// Buckets and their index share one allocation, the index after the buckets
+static php_array_bucket_t* hash_storage_alloc(uint32_t flags, uint32_t capacity, uint32_t** index) {
+    size_t bucket_bytes = (size_t)capacity * sizeof(php_array_bucket_t);
+    php_array_bucket_t* buckets = storage_alloc(flags, bucket_bytes + (size_t)capacity * 2 * sizeof(uint32_t));
+    if (!buckets) return NULL;
+    *index = (uint32_t*)((char*)buckets + bucket_bytes);
+    memset(*index, 0xff, (size_t)capacity * 2 * sizeof(uint32_t));
+    return buckets;
+}
+
+static inline uint32_t bucket_slot(const php_array_t* array, uint64_t h) {
+    // Integer keys are often sequential; fold the high bits into the mask
+    return (uint32_t)(h ^ (h >> 29)) & (index_slots(array) - 1);
+}
+
+static void index_insert(php_array_t* array, uint64_t h, uint32_t position) {
+    uint32_t mask = index_slots(array) - 1;
+    uint32_t slot = bucket_slot(array, h);
+    while (array->index[slot] != INDEX_EMPTY && array->index[slot] != INDEX_DELETED) {
+        slot = (slot + 1) & mask;
+    }
+    array->index[slot] = position;
+}
+
+static void array_destroy(php_array_t* array) {
+    if (is_packed(array)) {
+        for (uint32_t i = 0; i < array->used; i++) {
+            php_value_release(&array->data.packed[i]);
+        }
+    } else {
+        for (uint32_t i = 0; i < array->used; i++) {
+            php_array_bucket_t* bucket = &array->data.buckets[i];
+            if (bucket->value.type != PHP_TYPE_UNDEF) {
+                php_value_release(&bucket->value);
+                if (bucket->key) php_string_release(bucket->key);
+            }
+        }
+    }
+    storage_free(array->flags, array->data.packed);
+    storage_free(array->flags, array);
+}
+
+void php_array_free(php_array_t* array) {
+    if (!array || (array->gc.flags & PHP_GC_IMMORTAL)) return;
+    array_destroy(array);
+}
+
+// Applies to the array and the persistent arrays nested in it, which only
+// a sealed parent holds; php_array_empty() is never among them
+static void seal_walk(php_array_t* array, bool seal) {
+    uint32_t position = 0;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, NULL)) != NULL) {
+        if (element->type == PHP_TYPE_ARRAY && (element->value.arr->flags & PHP_ARRAY_PERSISTENT)) {
+            seal_walk(element->value.arr, seal);
+        }
+    }
+    if (seal) {
+        array->gc.flags |= PHP_GC_IMMORTAL;
+    } else {
+        array->gc.flags &= ~PHP_GC_IMMORTAL;
+        array->gc.refcount = 1;
+    }
+}
+
+void php_array_seal(php_array_t* array) {
+    if (array->flags & PHP_ARRAY_PERSISTENT) {
+        seal_walk(array, true);
+    }
+}
+
+void php_array_free_sealed(php_array_t* array) {
+    if (array->flags & PHP_ARRAY_PERSISTENT) {
+        seal_walk(array, false);
+        array_destroy(array);
+    }
+}
+
+php_array_t* php_array_dup(const php_array_t* array) {
+    php_array_t* copy = php_array_new(0);
+    if (!copy || array->used == 0) {
+        if (copy) copy->next_index = array->next_index;
+        return copy;
+    }
+
+    copy->flags = array->flags & ~PHP_ARRAY_PERSISTENT;
+    copy->count = array->count;
+    copy->used = array->used;
+    copy->capacity = array->capacity;
+    copy->next_index = array->next_index;
+
+    if (is_packed(array)) {
+        copy->data.packed = php_memory_alloc(array->capacity * sizeof(php_value_t));
+        if (!copy->data.packed) {
+            php_memory_free(copy);
+            return NULL;
+        }
+        memcpy(copy->data.packed, array->data.packed, array->used * sizeof(php_value_t));
+        for (uint32_t i = 0; i < array->used; i++) {
+            php_value_addref(&copy->data.packed[i]);
+        }
+        return copy;
+    }
+
+    copy->data.buckets = hash_storage_alloc(copy->flags, array->capacity, &copy->index);
+    if (!copy->data.buckets) {
+        php_memory_free(copy);
+        return NULL;
+    }
+    memcpy(copy->data.buckets, array->data.buckets, array->used * sizeof(php_array_bucket_t));
+    memcpy(copy->index, array->index, index_slots(array) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < array->used; i++) {
+        php_array_bucket_t* bucket = &copy->data.buckets[i];
+        if (bucket->value.type != PHP_TYPE_UNDEF) {
+            php_value_addref(&bucket->value);
+            if (bucket->key) php_string_addref(bucket->key);
+        }
+    }
+    return copy;
+}
+
+// ---------------------------------------------------------------------------
+// Layout changes
+// ---------------------------------------------------------------------------
+
+static bool packed_grow(php_array_t* array) {
+    uint32_t capacity = array->capacity ? array->capacity * 2 : ARRAY_MIN_CAPACITY;
+    if (capacity <= array->capacity) return false;
+    php_value_t* packed = storage_realloc(array->flags, array->data.packed, capacity * sizeof(php_value_t));
+    if (!packed) return false;
+    array->data.packed = packed;
+    array->capacity = capacity;
+    return true;
+}
+
+// Rebuild hashed storage at the given capacity, dropping holes
+static bool hash_resize(php_array_t* array, uint32_t capacity) {
+    uint32_t* index;
+    php_array_bucket_t* buckets = hash_storage_alloc(array->flags, capacity, &index);
+    if (!buckets) return false;
+
+    php_array_bucket_t* old = array->data.buckets;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < array->used; i++) {
+        if (old[i].value.type != PHP_TYPE_UNDEF) {
+            buckets[used++] = old[i];
+        }
+    }
+    storage_free(array->flags, old);
+
+    array->data.buckets = buckets;
+    array->index = index;
+    array->capacity = capacity;
+    array->used = used;
+    for (uint32_t i = 0; i < used; i++) {
+        index_insert(array, buckets[i].h, i);
+    }
+    return true;
+}
+
+// Make room for one more bucket: reclaim holes if there are enough of
+// them, otherwise double
+static bool hash_reserve(php_array_t* array) {
+    if (array->used < array->capacity) return true;
+    if (array->count < array->used - array->used / 4) {
+        return hash_resize(array, array->capacity);
+    }
+    uint32_t capacity = array->capacity * 2;
+    return capacity > array->capacity && hash_resize(array, capacity);
+}
+
+static bool packed_to_hash(php_array_t* array) {
+    uint32_t capacity = array->capacity ? array->capacity : ARRAY_MIN_CAPACITY;
+    if (array->used == capacity) capacity *= 2;
+
+    uint32_t* index;
+    php_array_bucket_t* buckets = hash_storage_alloc(array->flags, capacity, &index);
+    if (!buckets) return false;
+
+    php_value_t* packed = array->data.packed;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < array->used; i++) {
+        if (packed[i].type != PHP_TYPE_UNDEF) {
+            buckets[used].value = packed[i];
+            buckets[used].key = NULL;
+            buckets[used].h = i;
+            used++;
+        }
+    }
+    storage_free(array->flags, packed);
+
+    array->flags &= ~PHP_ARRAY_PACKED;
+    array->data.buckets = buckets;
+    array->index = index;
+    array->capacity = capacity;
+    array->used = used;
+    for (uint32_t i = 0; i < used; i++) {
+        index_insert(array, buckets[i].h, i);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Keys
+// ---------------------------------------------------------------------------
+
+bool php_array_numeric_key(const char* str, size_t length, int64_t* index) {
+    // Canonical decimal integers only: no sign but '-', no leading zeros
+    // and no "-0", so the key round-trips through its string form
+    if (length == 0 || length > 20) return false;
+
+    size_t i = 0;
+    bool negative = str[0] == '-';
+    if (negative) {
+        if (length == 1) return false;
+        i = 1;
+    }
+    if (str[i] == '0' && (length - i > 1 || negative)) return false;
+
+    uint64_t magnitude = 0;
+    for (; i < length; i++) {
+        if (str[i] < '0' || str[i] > '9') return false;
+        uint64_t digit = (uint64_t)(str[i] - '0');
+        if (magnitude > (UINT64_MAX - digit) / 10) return false;
+        magnitude = magnitude * 10 + digit;
+    }
+    if (magnitude > (uint64_t)INT64_MAX + (negative ? 1 : 0)) return false;
+
+    *index = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return true;
+}
+
+bool php_array_key_from_value(const php_value_t* value, php_array_key_t* key) {
+    key->str = NULL;
+    switch (value->type) {
+        case PHP_TYPE_INT:
+            key->index = value->value.int_val;
+            return true;
+        case PHP_TYPE_STRING:
+            if (!php_array_numeric_key(value->value.str->val, value->value.str->len, &key->index)) {
+                key->str = value->value.str;
+            }
+            return true;
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            key->str = php_string_empty();
+            return true;
+        case PHP_TYPE_BOOL:
+            key->index = value->value.bool_val;
+            return true;
+        case PHP_TYPE_FLOAT:
+            key->index = php_dval_to_lval(value->value.float_val);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Lookup
+// ---------------------------------------------------------------------------
+
+static php_array_bucket_t* hash_find(const php_array_t* array, const char* str, size_t length,
+                                     uint64_t h, uint32_t* slot_out) {
+    uint32_t mask = index_slots(array) - 1;
+    uint32_t slot = bucket_slot(array, h);
+    uint32_t position;
+    while ((position = array->index[slot]) != INDEX_EMPTY) {
+        if (position != INDEX_DELETED) {
+            php_array_bucket_t* bucket = &array->data.buckets[position];
+            if (bucket->h == h && (str ? bucket->key && bucket->key->len == length &&
+                                         (bucket->key->val == str || memcmp(bucket->key->val, str, length) == 0)
+                                       : !bucket->key)) {
+                if (slot_out) *slot_out = slot;
+                return bucket;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+php_value_t* php_array_find_index(const php_array_t* array, int64_t index) {
+    if (is_packed(array)) {
+        if (index < 0 || (uint64_t)index >= array->used) return NULL;
+        php_value_t* value = &array->data.packed[index];
+        return value->type != PHP_TYPE_UNDEF ? value : NULL;
+    }
+    php_array_bucket_t* bucket = hash_find(array, NULL, 0, (uint64_t)index, NULL);
+    return bucket ? &bucket->value : NULL;
+}
+
+php_value_t* php_array_find_str(const php_array_t* array, const char* str, size_t length) {
+    if (is_packed(array)) return NULL;
+    php_array_bucket_t* bucket = hash_find(array, str, length, php_hash_bytes(str, length), NULL);
+    return bucket ? &bucket->value : NULL;
+}
+
+php_value_t* php_array_find(const php_array_t* array, const php_array_key_t* key) {
+    if (!key->str) {
+        return php_array_find_index(array, key->index);
+    }
+    if (is_packed(array)) return NULL;
+    php_array_bucket_t* bucket = hash_find(array, key->str->val, key->str->len, php_string_hash(key->str), NULL);
+    return bucket ? &bucket->value : NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Update
+// ---------------------------------------------------------------------------
+
+// As of PHP 8.3 the next key follows the largest integer key even when
+// that is negative: [-5 => 'a'] appends at -4
+static inline void note_index(php_array_t* array, int64_t index) {
+    if (index >= array->next_index) {
+        array->next_index = index == INT64_MAX ? INT64_MAX : index + 1;
+    }
+}
+
+// Add a bucket for a key known to be missing; the value is left undefined
+static php_value_t* hash_add(php_array_t* array, php_string_t* key, uint64_t h) {
+    if (!hash_reserve(array)) return NULL;
+
+    uint32_t position = array->used++;
+    php_array_bucket_t* bucket = &array->data.buckets[position];
+    bucket->key = key ? php_string_addref(key) : NULL;
+    bucket->h = h;
+    bucket->value.type = PHP_TYPE_UNDEF;
+    index_insert(array, h, position);
+    array->count++;
+    return &bucket->value;
+}
+
+static php_value_t* add_index(php_array_t* array, int64_t index) {
+    if (is_packed(array)) {
+        // Appending in key order keeps the vector; anything else needs buckets
+        if (index >= 0 && (uint64_t)index == array->used) {
+            if (array->used == array->capacity && !packed_grow(array)) return NULL;
+            php_value_t* slot = &array->data.packed[array->used++];
+            slot->type = PHP_TYPE_UNDEF;
+            array->count++;
+            note_index(array, index);
+            return slot;
+        }
+        if (!packed_to_hash(array)) return NULL;
+    }
+    note_index(array, index);
+    return hash_add(array, NULL, (uint64_t)index);
+}
+
+php_value_t* php_array_lookup(php_array_t* array, const php_array_key_t* key) {
+    php_value_t* value = php_array_find(array, key);
+    if (value) return value;
+
+    if (key->str) {
+        if (is_packed(array) && !packed_to_hash(array)) return NULL;
+        value = hash_add(array, key->str, php_string_hash(key->str));
+    } else {
+        value = add_index(array, key->index);
+    }
+    if (value) php_value_set_null(value);
+    return value;
+}
+
+php_value_t* php_array_append(php_array_t* array) {
+    if (array->next_index == INT64_MAX && php_array_find_index(array, INT64_MAX)) {
+        return NULL;
+    }
+    return add_index(array, array->next_index == INT64_MIN ? 0 : array->next_index);
+}
+
+bool php_array_update(php_array_t* array, const php_array_key_t* key, php_value_t* value) {
+    php_value_t* slot = php_array_lookup(array, key);
+    if (!slot) {
+        php_value_release(value);
+        return false;
+    }
+    php_value_t old = *slot;
+    *slot = *value;
+    php_value_release(&old);
+    return true;
+}
+
+bool php_array_delete(php_array_t* array, const php_array_key_t* key) {
+    if (is_packed(array)) {
+        php_value_t* value = key->str ? NULL : php_array_find_index(array, key->index);
+        if (!value) return false;
+
+        php_value_t old = *value;
+        value->type = PHP_TYPE_UNDEF;
+        array->count--;
+        php_value_release(&old);
+        return true;
+    }
+
+    uint32_t slot;
+    php_array_bucket_t* bucket = key->str
+        ? hash_find(array, key->str->val, key->str->len, php_string_hash(key->str), &slot)
+        : hash_find(array, NULL, 0, (uint64_t)key->index, &slot);
+    if (!bucket) return false;
+
+    php_value_t old = bucket->value;
+    php_string_t* old_key = bucket->key;
+    bucket->value.type = PHP_TYPE_UNDEF;
+    bucket->key = NULL;
+    array->index[slot] = INDEX_DELETED;
+    array->count--;
+    php_value_release(&old);
+    if (old_key) php_string_release(old_key);
+    return true;
+}
+
+bool php_array_pop(php_array_t* array, php_value_t* value) {
+    php_array_key_t key = {NULL, 0};
+    php_value_t* last = NULL;
+    for (uint32_t position = array->used; position > 0 && !last; position--) {
+        if (is_packed(array)) {
+            if (array->data.packed[position - 1].type != PHP_TYPE_UNDEF) {
+                last = &array->data.packed[position - 1];
+                key.index = position - 1;
+            }
+        } else if (array->data.buckets[position - 1].value.type != PHP_TYPE_UNDEF) {
+            last = &array->data.buckets[position - 1].value;
+            key.str = array->data.buckets[position - 1].key;
+            key.index = (int64_t)array->data.buckets[position - 1].h;
+        }
+    }
+    if (!last) return false;
+
+    // The value moves out and a null is left behind to be deleted
+    bool integer_key = key.str == NULL;
+    *value = *last;
+    php_value_set_null(last);
+    php_array_delete(array, &key);
+
+    // Like array_pop(), hand the popped integer key out again
+    if (integer_key && array->next_index != INT64_MIN && key.index == array->next_index - 1) {
+        array->next_index = key.index;
+        while (is_packed(array) && array->used > 0 && array->data.packed[array->used - 1].type == PHP_TYPE_UNDEF) {
+            array->used--;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,126 @@
+/**
+ * PHP Array Header
+ * Ordered hash tables with a packed vector layout for list-like arrays
+ */
+
+#ifndef PHP_ARRAY_H
+#define PHP_ARRAY_H
+
+#include "php_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PHP_ARRAY_PACKED (1u << 0)      // Keys are exactly 0..used-1, values stored densely
+#define PHP_ARRAY_PERSISTENT (1u << 1)  // Allocated with malloc instead of in the request heap
+
+// Element of a hashed array. Deleted elements stay behind as UNDEF holes
+// until the next resize, so iteration order is the bucket order.
+typedef struct {
+    php_value_t value;
+    php_string_t* key;                  // NULL for integer keys
+    uint64_t h;                         // Integer key, or the hash of key
+} php_array_bucket_t;
+
+// Arrays start out packed: a plain vector of values whose positions are
+// their keys, which is what lists, argv and most template data are. Any
+// other key turns the array into buckets in insertion order, plus an
+// open-addressing index of bucket numbers with twice as many slots.
+struct php_array {
+    php_refcounted_t gc;
+    uint32_t flags;
+    uint32_t count;                     // Live elements
+    uint32_t used;                      // Positions handed out, holes included
+    uint32_t capacity;                  // Positions allocated, 0 or a power of two
+    int64_t next_index;                 // Key of the next append; INT64_MIN (0) until an integer key
+    union {
+        php_value_t* packed;
+        php_array_bucket_t* buckets;
+    } data;
+    uint32_t* index;                    // 2 * capacity slots, NULL while packed
+};
+
+// Array key after PHP's key conversions; str is borrowed
+typedef struct {
+    php_string_t* str;                  // NULL for integer keys
+    int64_t index;
+} php_array_key_t;
+
+// Lifecycle. dup is shallow: payloads of the elements are shared.
+php_array_t* php_array_new(uint32_t capacity);
+php_array_t* php_array_dup(const php_array_t* array);
+void php_array_free(php_array_t* array);
+php_array_t* php_array_empty(void);
+
+// Array literals of compiled scripts outlive requests. They are built as
+// persistent arrays, then sealed: made immortal along with the persistent
+// arrays inside them, so requests share them without counting. Their op
+// array frees them with free_sealed.
+php_array_t* php_array_new_persistent(uint32_t capacity);
+void php_array_seal(php_array_t* array);
+void php_array_free_sealed(php_array_t* array);
+
+// Keys: integers, and strings holding canonical decimal integers, become
+// integer keys; null is "", booleans and floats are truncated to integers.
+// Returns false for arrays, objects and resources.
+bool php_array_key_from_value(const php_value_t* value, php_array_key_t* key);
+bool php_array_numeric_key(const char* str, size_t length, int64_t* index);
+
+// Lookup and update. lookup adds a null element when the key is missing;
+// append returns an undefined slot for the caller to fill, or NULL when
+// the next integer key is taken. Returned pointers are valid until the
+// array is next modified.
+php_value_t* php_array_find(const php_array_t* array, const php_array_key_t* key);
+php_value_t* php_array_find_index(const php_array_t* array, int64_t index);
+php_value_t* php_array_find_str(const php_array_t* array, const char* str, size_t length);
+php_value_t* php_array_lookup(php_array_t* array, const php_array_key_t* key);
+php_value_t* php_array_append(php_array_t* array);
+bool php_array_delete(php_array_t* array, const php_array_key_t* key);
+
+// Remove the last element, moving its value into *value
+bool php_array_pop(php_array_t* array, php_value_t* value);
+
+// Update taking over the value's reference, replacing any previous value
+bool php_array_update(php_array_t* array, const php_array_key_t* key, php_value_t* value);
+
+static inline uint32_t php_array_count(const php_array_t* array) {
+    return array->count;
+}
+
+// Iteration in order: returns the next live element at or after *position
+// and advances past it, or NULL at the end. key may be NULL.
+static inline php_value_t* php_array_next(const php_array_t* array, uint32_t* position, php_array_key_t* key) {
+    if (array->flags & PHP_ARRAY_PACKED) {
+        for (uint32_t i = *position; i < array->used; i++) {
+            if (array->data.packed[i].type != PHP_TYPE_UNDEF) {
+                *position = i + 1;
+                if (key) {
+                    key->str = NULL;
+                    key->index = i;
+                }
+                return &array->data.packed[i];
+            }
+        }
+    } else {
+        for (uint32_t i = *position; i < array->used; i++) {
+            php_array_bucket_t* bucket = &array->data.buckets[i];
+            if (bucket->value.type != PHP_TYPE_UNDEF) {
+                *position = i + 1;
+                if (key) {
+                    key->str = bucket->key;
+                    key->index = (int64_t)bucket->h;
+                }
+                return &bucket->value;
+            }
+        }
+    }
+    *position = array->used;
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_ARRAY_H
@@ -0,0 +1,1560 @@
+/**
+ * PHP Compiler Implementation
+ * Lowers the parser's AST into opcode arrays for the executor
+ */
+
+#include "php_compiler.h"
+#include "php_aot.h"
+#include "php_array.h"
+#include "php_format.h"
+#include "php_optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+// Pending jumps of an enclosing loop, patched once the targets are known
+typedef struct {
+    uint32_t* breaks;
+    size_t break_count;
+    size_t break_capacity;
+    uint32_t* continues;
+    size_t continue_count;
+    size_t continue_capacity;
+    bool is_foreach;            // Keeps an iterator on the stack until left
+} loop_context_t;
+
+// Text assembled at compile time
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;                // An append could not grow the buffer
+} text_buffer_t;
+
+// Open-addressing index over string literals to deduplicate names
+typedef struct {
+    uint32_t* slots;            // literal index + 1, 0 = empty
+    size_t capacity;
+    size_t count;
+} literal_index_t;
+
+// Compiler state for one op array
+typedef struct {
+    php_op_array_t* op_array;
+    php_op_array_t* script;
+    loop_context_t* loops;
+    size_t loop_depth;
+    size_t loop_capacity;
+    literal_index_t string_literals;
+    uint32_t* literal_cvs;      // Compiled variable + 1 for each name literal, 0 = none
+    size_t literal_cvs_capacity;
+    uint32_t cv_capacity;
+    text_buffer_t echo;         // Static output not emitted yet, see append_echo
+    int echo_line;
+    int line;
+    bool has_error;
+    const php_ast_node_t* const* declarations;  // Every function declared in the file
+    size_t declaration_count;
+} compiler_t;
+
+// Compile-time constants
+typedef struct {
+    const char* name;
+    php_type_t type;
+    int64_t int_val;
+    double float_val;
+    const char* string_val;
+} compile_constant_t;
+
+static const compile_constant_t compile_constants[] = {
+    {"PHP_EOL", PHP_TYPE_STRING, 0, 0, "\n"},
+    {"PHP_VERSION", PHP_TYPE_STRING, 0, 0, PHP_VERSION},
+    {"PHP_OS", PHP_TYPE_STRING, 0, 0, "WASI"},
+    {"PHP_OS_FAMILY", PHP_TYPE_STRING, 0, 0, "Unknown"},
+    {"PHP_INT_MAX", PHP_TYPE_INT, INT64_MAX, 0, NULL},
+    {"PHP_INT_MIN", PHP_TYPE_INT, INT64_MIN, 0, NULL},
+    {"PHP_INT_SIZE", PHP_TYPE_INT, 8, 0, NULL},
+    {"PHP_FLOAT_EPSILON", PHP_TYPE_FLOAT, 0, 2.220446049250313e-16, NULL},
+    {"PHP_FLOAT_MAX", PHP_TYPE_FLOAT, 0, 1.7976931348623157e308, NULL},
+    {"PHP_FLOAT_MIN", PHP_TYPE_FLOAT, 0, 2.2250738585072014e-308, NULL},
+    {"M_PI", PHP_TYPE_FLOAT, 0, 3.14159265358979323846, NULL},
+    {"M_E", PHP_TYPE_FLOAT, 0, 2.7182818284590452354, NULL},
+    {"NAN", PHP_TYPE_FLOAT, 0, NAN, NULL},
+    {"INF", PHP_TYPE_FLOAT, 0, INFINITY, NULL},
+    {"E_ERROR", PHP_TYPE_INT, 1, 0, NULL},
+    {"E_WARNING", PHP_TYPE_INT, 2, 0, NULL},
+    {"E_NOTICE", PHP_TYPE_INT, 8, 0, NULL},
+    {"E_ALL", PHP_TYPE_INT, 32767, 0, NULL},
+    {NULL, PHP_TYPE_NULL, 0, 0, NULL}
+};
+
+static void compile_statement(compiler_t* c, const php_ast_node_t* node);
+static void compile_expression(compiler_t* c, const php_ast_node_t* node);
+
+// ---------------------------------------------------------------------------
+// Op array construction
+// ---------------------------------------------------------------------------
+
+static php_op_array_t* op_array_create(const char* name, const char* filename) {
+    php_op_array_t* op_array = calloc(1, sizeof(php_op_array_t));
+    if (!op_array) return NULL;
+    op_array->name = name ? strdup(name) : NULL;
+    op_array->filename = strdup(filename ? filename : "Standard input code");
+    return op_array;
+}
+
+void php_op_array_destroy(php_op_array_t* op_array) {
+    if (!op_array) return;
+
+    for (uint32_t i = 0; i < op_array->literal_count; i++) {
+        if (op_array->literals[i].type == PHP_TYPE_ARRAY) {
+            php_array_free_sealed(op_array->literals[i].value.arr);
+        } else {
+            php_value_release(&op_array->literals[i]);
+        }
+    }
+    for (uint32_t i = 0; i < op_array->function_count; i++) {
+        php_op_array_destroy(op_array->functions[i]);
+    }
+    free(op_array->literals);
+    free(op_array->call_targets);
+    free(op_array->functions);
+    free(op_array->cv_names);
+    free(op_array->ops);
+    free(op_array->name);
+    free(op_array->filename);
+    free(op_array);
+}
+
+static void compile_error(compiler_t* c, const char* fmt, const char* arg) {
+    char message[256];
+    char detail[192];
+    snprintf(detail, sizeof(detail), fmt, arg);
+    snprintf(message, sizeof(message), "PHP Fatal error: %s in %s on line %d\n",
+             detail, c->op_array->filename, c->line);
+    php_engine_error(message);
+    c->has_error = true;
+}
+
+static uint32_t add_string_literal(compiler_t* c, const char* str, size_t length);
+
+static uint32_t push_op(compiler_t* c, uint8_t opcode, uint32_t op1, uint32_t op2) {
+    php_op_array_t* op_array = c->op_array;
+    if (op_array->op_count >= op_array->op_capacity) {
+        op_array->op_capacity = op_array->op_capacity ? op_array->op_capacity * 2 : 64;
+        op_array->ops = realloc(op_array->ops, op_array->op_capacity * sizeof(php_op_t));
+    }
+
+    php_op_t* op = &op_array->ops[op_array->op_count];
+    op->opcode = opcode;
+    op->ext = 0;
+    op->op1 = op1;
+    op->op2 = op2;
+    op->lineno = (uint32_t)c->line;
+    return op_array->op_count++;
+}
+
+static void text_append(text_buffer_t* text, const char* str, size_t length) {
+    if (length == 0) return;
+    if (text->length + length > text->capacity) {
+        size_t capacity = text->capacity * 2 > text->length + length ? text->capacity * 2 : text->length + length;
+        char* data = realloc(text->data, capacity);
+        if (!data) {
+            text->failed = true;
+            return;
+        }
+        text->data = data;
+        text->capacity = capacity;
+    }
+    memcpy(text->data + text->length, str, length);
+    text->length += length;
+}
+
+// Inline HTML and constant echoes collect into one piece of static output,
+// emitted as a single ECHO_CONST of an interned string before the next op
+// or jump target, so neighbouring segments are joined at compile time
+static void append_echo(compiler_t* c, const char* str, size_t length) {
+    if (c->echo.length == 0) {
+        c->echo_line = c->line;
+    }
+    text_append(&c->echo, str, length);
+    if (c->echo.failed) {
+        compile_error(c, "Out of memory%s", "");
+    }
+}
+
+static void flush_echo(compiler_t* c) {
+    if (c->echo.length == 0) return;
+    size_t length = c->echo.length;
+    c->echo.length = 0;
+    uint32_t op = push_op(c, PHP_OP_ECHO_CONST, add_string_literal(c, c->echo.data, length), 0);
+    c->op_array->ops[op].lineno = (uint32_t)c->echo_line;
+}
+
+static uint32_t emit(compiler_t* c, uint8_t opcode, uint32_t op1, uint32_t op2) {
+    flush_echo(c);
+    return push_op(c, opcode, op1, op2);
+}
+
+static uint32_t current_offset(compiler_t* c) {
+    flush_echo(c);
+    return c->op_array->op_count;
+}
+
+static void patch_jump(compiler_t* c, uint32_t op_index, uint32_t target) {
+    c->op_array->ops[op_index].op1 = target;
+}
+
+// Literals are stored inline; the boxed value is consumed. They outlive
+// the request, so strings are interned and arrays sealed.
+static uint32_t add_literal(compiler_t* c, php_value_t* value) {
+    php_op_array_t* op_array = c->op_array;
+    if (op_array->literal_count >= op_array->literal_capacity) {
+        op_array->literal_capacity = op_array->literal_capacity ? op_array->literal_capacity * 2 : 16;
+        op_array->literals = realloc(op_array->literals, op_array->literal_capacity * sizeof(php_value_t));
+    }
+    php_value_t* literal = &op_array->literals[op_array->literal_count];
+    php_value_unbox(literal, value);
+    if (literal->type == PHP_TYPE_ARRAY) {
+        php_array_seal(literal->value.arr);
+    }
+    return op_array->literal_count++;
+}
+
+static void literal_index_insert(literal_index_t* index, const php_op_array_t* op_array, uint32_t literal) {
+    size_t mask = index->capacity - 1;
+    size_t slot = (size_t)op_array->literals[literal].value.str->hash & mask;
+    while (index->slots[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    index->slots[slot] = literal + 1;
+    index->count++;
+}
+
+// String literals are interned, so equal literals share one immortal string
+// and are deduplicated by address; variable and function names repeat a lot
+static uint32_t add_string_literal(compiler_t* c, const char* str, size_t length) {
+    literal_index_t* index = &c->string_literals;
+    php_op_array_t* op_array = c->op_array;
+    php_string_t* interned = php_string_intern(str, length);
+
+    if (index->capacity) {
+        size_t mask = index->capacity - 1;
+        size_t slot = (size_t)interned->hash & mask;
+        while (index->slots[slot]) {
+            if (op_array->literals[index->slots[slot] - 1].value.str == interned) {
+                return index->slots[slot] - 1;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    uint32_t literal = add_literal(c, php_value_create_str(interned));
+
+    // Keep the load factor under one half
+    if ((index->count + 1) * 2 > index->capacity) {
+        uint32_t* old_slots = index->slots;
+        size_t old_capacity = index->capacity;
+        index->capacity = old_capacity ? old_capacity * 2 : 32;
+        index->slots = calloc(index->capacity, sizeof(uint32_t));
+        index->count = 0;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i]) {
+                literal_index_insert(index, op_array, old_slots[i] - 1);
+            }
+        }
+        free(old_slots);
+    }
+    literal_index_insert(index, op_array, literal);
+    return literal;
+}
+
+static void emit_push_literal(compiler_t* c, php_value_t* value) {
+    emit(c, PHP_OP_PUSH_CONST, add_literal(c, value), 0);
+}
+
+// ---------------------------------------------------------------------------
+// Constant expressions
+// ---------------------------------------------------------------------------
+
+static const compile_constant_t* find_compile_constant(const char* name) {
+    for (int i = 0; compile_constants[i].name; i++) {
+        if (strcmp(compile_constants[i].name, name) == 0) {
+            return &compile_constants[i];
+        }
+    }
+    return NULL;
+}
+
+static php_value_t* create_interned(const char* str, size_t length) {
+    php_string_t* interned = php_string_intern(str, length);
+    return interned ? php_value_create_str(interned) : NULL;
+}
+
+static php_value_t* constant_to_value(const compile_constant_t* constant) {
+    switch (constant->type) {
+        case PHP_TYPE_INT: return php_value_create_int(constant->int_val);
+        case PHP_TYPE_FLOAT: return php_value_create_float(constant->float_val);
+        case PHP_TYPE_STRING: return create_interned(constant->string_val, strlen(constant->string_val));
+        default: return php_value_create_null();
+    }
+}
+
+
+// Add a boxed value to a constant array under a constant key, or append it
+static bool add_constant_element(php_array_t* array, const php_ast_node_t* key_node, php_value_t* box) {
+    php_value_t value;
+    php_value_unbox(&value, box);
+
+    php_value_t* slot = NULL;
+    if (!key_node) {
+        slot = php_array_append(array);
+    } else {
+        php_value_t* key = php_evaluate_constant(key_node);
+        php_array_key_t array_key;
+        if (key && php_array_key_from_value(key, &array_key)) {
+            // Literal keys are interned, so every copy of the array shares them
+            if (array_key.str) {
+                array_key.str = php_string_intern(array_key.str->val, array_key.str->len);
+            }
+            // A repeated key keeps its position and takes the later value
+            slot = php_array_lookup(array, &array_key);
+            if (slot) php_value_release(slot);
+        }
+        php_value_destroy(key);
+    }
+
+    if (!slot) {
+        php_value_release(&value);
+        return false;
+    }
+    *slot = value;
+    return true;
+}
+
+// Evaluate a literal-only expression, used for parameter defaults and to
+// build constant array literals once at compile time
+php_value_t* php_evaluate_constant(const php_ast_node_t* node) {
+    switch (node->kind) {
+        case PHP_AST_NULL_LITERAL:
+            return php_value_create_null();
+        case PHP_AST_BOOL_LITERAL:
+            return php_value_create_bool(node->int_val != 0);
+        case PHP_AST_INT_LITERAL:
+            return php_value_create_int(node->int_val);
+        case PHP_AST_FLOAT_LITERAL:
+            return php_value_create_float(node->float_val);
+        case PHP_AST_STRING_LITERAL:
+            return create_interned(node->str, node->str_len);
+        case PHP_AST_CONSTANT: {
+            const compile_constant_t* constant = find_compile_constant(node->str);
+            return constant ? constant_to_value(constant) : NULL;
+        }
+        case PHP_AST_UNARY:
+            if (node->op == PHP_UNOP_NEG || node->op == PHP_UNOP_PLUS) {
+                php_value_t* operand = php_evaluate_constant(node->children[0]);
+                if (!operand) return NULL;
+                php_value_t* result = NULL;
+                if (operand->type == PHP_TYPE_INT && node->op == PHP_UNOP_NEG && operand->value.int_val != INT64_MIN) {
+                    result = php_value_create_int(-operand->value.int_val);
+                } else if (operand->type == PHP_TYPE_INT) {
+                    result = node->op == PHP_UNOP_NEG ? php_value_create_float(-(double)operand->value.int_val)
+                                                      : php_value_create_int(operand->value.int_val);
+                } else if (operand->type == PHP_TYPE_FLOAT) {
+                    result = php_value_create_float(node->op == PHP_UNOP_NEG ? -operand->value.float_val
+                                                                             : operand->value.float_val);
+                }
+                php_value_destroy(operand);
+                return result;
+            }
+            return NULL;
+        case PHP_AST_ARRAY: {
+            php_array_t* array = php_array_new_persistent((uint32_t)node->child_count);
+            if (!array) return NULL;
+            for (size_t i = 0; i < node->child_count; i++) {
+                const php_ast_node_t* elem = node->children[i];
+                php_value_t* value = php_evaluate_constant(elem->children[1]);
+                if (!value || !add_constant_element(array, elem->children[0], value)) {
+                    php_array_free(array);
+                    return NULL;
+                }
+            }
+            return php_value_create_array(array);
+        }
+        default:
+            return NULL;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+uint8_t php_binary_opcode(int op) {
+    switch (op) {
+        case PHP_BINOP_ADD: return PHP_OP_ADD;
+        case PHP_BINOP_SUB: return PHP_OP_SUB;
+        case PHP_BINOP_MUL: return PHP_OP_MUL;
+        case PHP_BINOP_DIV: return PHP_OP_DIV;
+        case PHP_BINOP_MOD: return PHP_OP_MOD;
+        case PHP_BINOP_POW: return PHP_OP_POW;
+        case PHP_BINOP_CONCAT: return PHP_OP_CONCAT;
+        case PHP_BINOP_SL: return PHP_OP_SL;
+        case PHP_BINOP_SR: return PHP_OP_SR;
+        case PHP_BINOP_BW_AND: return PHP_OP_BW_AND;
+        case PHP_BINOP_BW_OR: return PHP_OP_BW_OR;
+        case PHP_BINOP_BW_XOR: return PHP_OP_BW_XOR;
+        case PHP_BINOP_EQUAL: return PHP_OP_IS_EQUAL;
+        case PHP_BINOP_NOT_EQUAL: return PHP_OP_IS_NOT_EQUAL;
+        case PHP_BINOP_IDENTICAL: return PHP_OP_IS_IDENTICAL;
+        case PHP_BINOP_NOT_IDENTICAL: return PHP_OP_IS_NOT_IDENTICAL;
+        case PHP_BINOP_SMALLER: return PHP_OP_IS_SMALLER;
+        case PHP_BINOP_SMALLER_OR_EQUAL: return PHP_OP_IS_SMALLER_OR_EQUAL;
+        case PHP_BINOP_SPACESHIP: return PHP_OP_SPACESHIP;
+        case PHP_BINOP_BOOL_XOR: return PHP_OP_BOOL_XOR;
+        default: return PHP_OP_NOP;
+    }
+}
+
+// Slot of a named variable; names map to slots through their deduplicated literal
+static uint32_t lookup_cv(compiler_t* c, const char* name, size_t length) {
+    php_op_array_t* op_array = c->op_array;
+    uint32_t literal = add_string_literal(c, name, length);
+
+    if (literal >= c->literal_cvs_capacity) {
+        size_t capacity = c->literal_cvs_capacity ? c->literal_cvs_capacity : 32;
+        while (capacity <= literal) capacity *= 2;
+        c->literal_cvs = realloc(c->literal_cvs, capacity * sizeof(uint32_t));
+        memset(c->literal_cvs + c->literal_cvs_capacity, 0, (capacity - c->literal_cvs_capacity) * sizeof(uint32_t));
+        c->literal_cvs_capacity = capacity;
+    }
+    if (c->literal_cvs[literal]) {
+        return c->literal_cvs[literal] - 1;
+    }
+
+    if (op_array->num_cvs >= c->cv_capacity) {
+        c->cv_capacity = c->cv_capacity ? c->cv_capacity * 2 : 16;
+        op_array->cv_names = realloc(op_array->cv_names, c->cv_capacity * sizeof(uint32_t));
+    }
+    op_array->cv_names[op_array->num_cvs] = literal;
+    c->literal_cvs[literal] = ++op_array->num_cvs;
+    return op_array->num_cvs - 1;
+}
+
+static bool is_dynamic_var(const php_ast_node_t* var) {
+    return var->str == NULL;
+}
+
+// Push the name of a $$name variable; named variables need nothing
+static void compile_var_name(compiler_t* c, const php_ast_node_t* var) {
+    if (is_dynamic_var(var)) {
+        compile_expression(c, var->children[0]);
+        c->line = var->line;
+    }
+}
+
+// Emit a variable op after compile_var_name() and any value operand
+static uint32_t emit_var(compiler_t* c, uint8_t opcode, const php_ast_node_t* var) {
+    if (is_dynamic_var(var)) {
+        uint32_t op = emit(c, opcode, 0, 0);
+        c->op_array->ops[op].ext = PHP_VAR_DYNAMIC;
+        return op;
+    }
+    return emit(c, opcode, lookup_cv(c, var->str, var->str_len), 0);
+}
+
+// Push a variable's or element's value, quietly when used by isset/empty/??
+static void compile_fetch(compiler_t* c, const php_ast_node_t* node, bool quiet) {
+    if (node->kind == PHP_AST_VAR) {
+        compile_var_name(c, node);
+        emit_var(c, quiet ? PHP_OP_FETCH_VAR_QUIET : PHP_OP_FETCH_VAR, node);
+    } else if (node->kind == PHP_AST_DIM) {
+        if (!node->children[1]) {
+            compile_error(c, "Cannot use [] for reading%s", "");
+            return;
+        }
+        compile_fetch(c, node->children[0], quiet);
+        compile_expression(c, node->children[1]);
+        c->line = node->line;
+        emit(c, quiet ? PHP_OP_FETCH_DIM_QUIET : PHP_OP_FETCH_DIM, 0, 0);
+    } else {
+        compile_expression(c, node);
+    }
+}
+
+// The variable an element write starts from: $a of $a[1][2]
+static const php_ast_node_t* dim_base(const php_ast_node_t* node) {
+    while (node->kind == PHP_AST_DIM) {
+        node = node->children[0];
+    }
+    return node;
+}
+
+static bool is_writable(const php_ast_node_t* node) {
+    return dim_base(node)->kind == PHP_AST_VAR;
+}
+
+// Push the name of a $$name base and the key of every dimension,
+// outermost first; returns the number of dimensions
+static uint32_t compile_dim_keys(compiler_t* c, const php_ast_node_t* node) {
+    if (node->kind != PHP_AST_DIM) {
+        compile_var_name(c, node);
+        return 0;
+    }
+
+    uint32_t depth = compile_dim_keys(c, node->children[0]);
+    if (node->children[1]) {
+        compile_expression(c, node->children[1]);
+    } else {
+        emit(c, PHP_OP_PUSH_APPEND_KEY, 0, 0);
+    }
+    if (depth + 1 > PHP_DIM_DEPTH(UINT32_MAX)) {
+        compile_error(c, "Too many array dimensions%s", "");
+    }
+    return depth + 1;
+}
+
+// Emit an element op after compile_dim_keys() and any value operand
+static void emit_dim(compiler_t* c, uint8_t opcode, const php_ast_node_t* node, uint32_t depth, uint32_t extra) {
+    c->line = node->line;
+    uint32_t op = emit_var(c, opcode, dim_base(node));
+    c->op_array->ops[op].op2 = PHP_DIM_OP2(depth, extra);
+}
+
+static void compile_inc_dec(compiler_t* c, const php_ast_node_t* target, uint8_t opcode) {
+    if (target->kind == PHP_AST_DIM) {
+        uint32_t depth = compile_dim_keys(c, target);
+        emit_dim(c, PHP_OP_INC_DEC_DIM, target, depth, opcode);
+        return;
+    }
+    compile_var_name(c, target);
+    emit_var(c, opcode, target);
+}
+
+// Compile the right operand of a binary node and the operator, its left
+// operand being on the stack already
+static void compile_binary_right(compiler_t* c, const php_ast_node_t* node) {
+    const php_ast_node_t* right = node->children[1];
+
+    switch (node->op) {
+        case PHP_BINOP_BOOL_AND:
+        case PHP_BINOP_BOOL_OR: {
+            uint32_t jump = emit(c, node->op == PHP_BINOP_BOOL_AND ? PHP_OP_JMPZ_EX : PHP_OP_JMPNZ_EX, 0, 0);
+            compile_expression(c, right);
+            emit(c, PHP_OP_BOOL, 0, 0);
+            patch_jump(c, jump, current_offset(c));
+            return;
+        }
+        case PHP_BINOP_GREATER:
+        case PHP_BINOP_GREATER_OR_EQUAL:
+            // a > b is evaluated as b < a, keeping operand evaluation order
+            compile_expression(c, right);
+            emit(c, node->op == PHP_BINOP_GREATER ? PHP_OP_IS_SMALLER : PHP_OP_IS_SMALLER_OR_EQUAL, 0, 0);
+            c->op_array->ops[c->op_array->op_count - 1].ext = 1;
+            return;
+        default:
+            compile_expression(c, right);
+            emit(c, php_binary_opcode(node->op), 0, 0);
+            return;
+    }
+}
+
+// Binary nodes whose left operand is compiled as a plain expression; "."
+// chains go to compile_concat_chain instead
+static bool is_left_chained(const php_ast_node_t* node) {
+    return node->kind == PHP_AST_BINARY && node->op != PHP_BINOP_COALESCE && node->op != PHP_BINOP_CONCAT;
+}
+
+// a + b - c parses as (a + b) - c. The left spine is walked in a loop and
+// compiled from the innermost node out, so a long chain does not recurse.
+static void compile_binary(compiler_t* c, const php_ast_node_t* node) {
+    if (node->op == PHP_BINOP_COALESCE) {
+        compile_fetch(c, node->children[0], true);
+        uint32_t jump = emit(c, PHP_OP_JMP_NOT_NULL, 0, 0);
+        compile_expression(c, node->children[1]);
+        patch_jump(c, jump, current_offset(c));
+        return;
+    }
+
+    size_t count = 1;
+    for (const php_ast_node_t* left = node->children[0]; is_left_chained(left); left = left->children[0]) {
+        count++;
+    }
+    const php_ast_node_t** spine = malloc(count * sizeof(php_ast_node_t*));
+    if (!spine) {
+        compile_error(c, "Out of memory%s", "");
+        return;
+    }
+    const php_ast_node_t* operand = node;
+    for (size_t i = count; i > 0; i--) {
+        spine[i - 1] = operand;
+        operand = operand->children[0];
+    }
+    compile_expression(c, operand);
+    for (size_t i = 0; i < count && !c->has_error; i++) {
+        compile_binary_right(c, spine[i]);
+    }
+    free(spine);
+}
+
+static void compile_assign(compiler_t* c, const php_ast_node_t* node) {
+    const php_ast_node_t* target = node->children[0];
+    if (target->kind == PHP_AST_DIM) {
+        uint32_t depth = compile_dim_keys(c, target);
+        compile_expression(c, node->children[1]);
+        emit_dim(c, PHP_OP_ASSIGN_DIM, target, depth, PHP_OP_NOP);
+        return;
+    }
+    compile_var_name(c, target);
+    compile_expression(c, node->children[1]);
+    emit_var(c, PHP_OP_ASSIGN_VAR, target);
+}
+
+static void compile_assign_op(compiler_t* c, const php_ast_node_t* node) {
+    const php_ast_node_t* var = node->children[0];
+
+    if (var->kind == PHP_AST_DIM) {
+        // Keys are evaluated again for the assignment of "??="
+        uint32_t jump = UINT32_MAX;
+        if (node->op == PHP_BINOP_COALESCE) {
+            compile_fetch(c, var, true);
+            jump = emit(c, PHP_OP_JMP_NOT_NULL, 0, 0);
+        }
+        uint32_t depth = compile_dim_keys(c, var);
+        compile_expression(c, node->children[1]);
+        emit_dim(c, PHP_OP_ASSIGN_DIM, var, depth, jump == UINT32_MAX ? php_binary_opcode(node->op) : PHP_OP_NOP);
+        if (jump != UINT32_MAX) {
+            patch_jump(c, jump, current_offset(c));
+        }
+        return;
+    }
+
+    if (node->op == PHP_BINOP_COALESCE) {
+        // The name of $$name is evaluated again for the assignment
+        compile_fetch(c, var, true);
+        uint32_t jump = emit(c, PHP_OP_JMP_NOT_NULL, 0, 0);
+        compile_var_name(c, var);
+        compile_expression(c, node->children[1]);
+        emit_var(c, PHP_OP_ASSIGN_VAR, var);
+        patch_jump(c, jump, current_offset(c));
+        return;
+    }
+
+    // Applied to the variable itself, so "$s .= $t" can grow $s in place
+    compile_var_name(c, var);
+    compile_expression(c, node->children[1]);
+    uint32_t op = emit_var(c, PHP_OP_ASSIGN_OP_VAR, var);
+    c->op_array->ops[op].op2 = php_binary_opcode(node->op);
+}
+
+// Builtins taking arguments by reference get pointers to the variables or
+// elements passed. Element references are fetched after all arguments are
+// evaluated, as those could still add to the array and move its elements.
+// Declarations are looked up by name for calls compiled before them; one
+// declared twice conditionally takes the same arguments by reference
+static const php_ast_node_t* find_declaration(const compiler_t* c, const char* name) {
+    for (size_t i = 0; i < c->declaration_count; i++) {
+        if (strcasecmp(c->declarations[i]->str, name) == 0) {
+            return c->declarations[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t declared_by_ref(const php_ast_node_t* decl) {
+    const php_ast_node_t* params = decl->children[0];
+    uint32_t by_ref = 0;
+    for (size_t i = 0; i < params->child_count && i < 32; i++) {
+        if (params->children[i]->op & PHP_PARAM_BY_REF) by_ref |= 1u << i;
+    }
+    return by_ref;
+}
+
+// A user function takes variables by reference, and the results of calls
+// with a notice when the call runs; anything else is an error
+static bool check_reference_argument(compiler_t* c, const php_ast_node_t* decl, size_t index,
+                                     const php_ast_node_t* arg) {
+    if (arg->kind == PHP_AST_VAR || arg->kind == PHP_AST_CALL) return true;
+
+    char detail[160];
+    if (arg->kind == PHP_AST_DIM) {
+        snprintf(detail, sizeof(detail), "%s(): Unsupported array element for argument #%zu passed by reference",
+                 decl->str, index + 1);
+    } else {
+        snprintf(detail, sizeof(detail), "%s(): Argument #%zu ($%s) could not be passed by reference",
+                 decl->str, index + 1, decl->children[0]->children[index]->str);
+    }
+    compile_error(c, "%s", detail);
+    return false;
+}
+
+static void compile_call(compiler_t* c, const php_ast_node_t* node) {
+    const php_function_t* builtin = php_engine_find_function(node->str);
+    const php_ast_node_t* decl = builtin ? NULL : find_declaration(c, node->str);
+    uint32_t by_ref = builtin ? builtin->by_ref : decl ? declared_by_ref(decl) : 0;
+    uint32_t* dim_depths = builtin && by_ref ? calloc(node->child_count ? node->child_count : 1, sizeof(uint32_t)) : NULL;
+
+    for (size_t i = 0; i < node->child_count && !c->has_error; i++) {
+        const php_ast_node_t* arg = node->children[i];
+        bool ref = i < 32 && (by_ref & (1u << i));
+        if (ref && decl && !check_reference_argument(c, decl, i, arg)) break;
+        ref = ref && is_writable(arg);
+        if (ref && arg->kind == PHP_AST_VAR) {
+            compile_var_name(c, arg);
+            emit_var(c, PHP_OP_FETCH_VAR_REF, arg);
+        } else if (ref && dim_depths && !is_dynamic_var(dim_base(arg))) {
+            dim_depths[i] = compile_dim_keys(c, arg);
+        } else {
+            compile_expression(c, arg);
+        }
+    }
+
+    for (size_t i = 0; dim_depths && i < node->child_count; i++) {
+        if (!dim_depths[i]) continue;
+        uint32_t above = 0;
+        for (size_t j = i + 1; j < node->child_count; j++) {
+            above += dim_depths[j] ? dim_depths[j] : 1;
+        }
+        emit_dim(c, PHP_OP_FETCH_DIM_REF, node->children[i], dim_depths[i], above);
+    }
+    free(dim_depths);
+
+    c->line = node->line;
+    emit(c, PHP_OP_CALL, add_string_literal(c, node->str, node->str_len), (uint32_t)node->child_count);
+}
+
+// Append the string form of an expression known at compile time, formatted
+// as the executor would convert it
+static bool append_constant_text(text_buffer_t* text, const php_ast_node_t* node) {
+    if (node->kind == PHP_AST_ARRAY) return false;
+    php_value_t* value = php_evaluate_constant(node);
+    if (!value) return false;
+
+    bool folded = true;
+    char buffer[PHP_FORMAT_FLOAT_SIZE];
+    switch (value->type) {
+        case PHP_TYPE_STRING:
+            text_append(text, value->value.str->val, value->value.str->len);
+            break;
+        case PHP_TYPE_INT:
+            text_append(text, buffer, php_format_int(value->value.int_val, buffer));
+            break;
+        case PHP_TYPE_FLOAT:
+            text_append(text, buffer, php_format_float(value->value.float_val, PHP_FORMAT_PRECISION, buffer));
+            break;
+        case PHP_TYPE_BOOL:
+            text_append(text, "1", value->value.bool_val ? 1 : 0);
+            break;
+        case PHP_TYPE_NULL:
+            break;
+        default:
+            folded = false;
+            break;
+    }
+    php_value_destroy(value);
+    return folded;
+}
+
+static bool is_concat(const php_ast_node_t* node) {
+    return node->kind == PHP_AST_BINARY && node->op == PHP_BINOP_CONCAT;
+}
+
+// Join the parts of an interpolated string or of a chain a . b . c. Runs of
+// constant parts fold into one literal, and three or more pushed parts are
+// joined by CONCAT_N into a result allocated once, rather than copying the
+// growing prefix at every ".". Parts are converted to strings when the join
+// runs, after all of them are evaluated.
+static void compile_concat(compiler_t* c, const php_ast_node_t* const* parts, size_t count) {
+    text_buffer_t constant = {NULL, 0, 0, false};
+    uint32_t pushed = 0;
+    for (size_t i = 0; i < count && !c->has_error; i++) {
+        if (append_constant_text(&constant, parts[i])) continue;
+        if (constant.length > 0) {
+            emit(c, PHP_OP_PUSH_CONST, add_string_literal(c, constant.data, constant.length), 0);
+            constant.length = 0;
+            pushed++;
+        }
+        compile_expression(c, parts[i]);
+        pushed++;
+    }
+    if (constant.failed) {
+        compile_error(c, "Out of memory%s", "");
+    }
+
+    if (constant.length > 0 || pushed == 0) {
+        emit(c, PHP_OP_PUSH_CONST, add_string_literal(c, constant.data ? constant.data : "", constant.length), 0);
+        pushed++;
+    } else if (pushed == 1) {
+        // A lone part that is not a literal still has to become a string
+        emit(c, PHP_OP_CAST, 0, 0);
+        c->op_array->ops[c->op_array->op_count - 1].ext = PHP_TYPE_STRING;
+    }
+    free(constant.data);
+
+    if (pushed == 2) {
+        emit(c, PHP_OP_CONCAT, 0, 0);
+    } else if (pushed > 2) {
+        emit(c, PHP_OP_CONCAT_N, pushed, 0);
+    }
+}
+
+// a . b . c parses as (a . b) . c; the parts are the right operands down
+// the left spine, then the leftmost operand
+static void compile_concat_chain(compiler_t* c, const php_ast_node_t* node) {
+    size_t count = 2;
+    for (const php_ast_node_t* left = node->children[0]; is_concat(left); left = left->children[0]) {
+        count++;
+    }
+    const php_ast_node_t** parts = malloc(count * sizeof(php_ast_node_t*));
+    size_t i = count;
+    for (; is_concat(node); node = node->children[0]) {
+        parts[--i] = node->children[1];
+    }
+    parts[0] = node;
+    compile_concat(c, parts, count);
+    free(parts);
+}
+
+static void compile_expression(compiler_t* c, const php_ast_node_t* node) {
+    if (c->has_error) return;
+    c->line = node->line;
+
+    switch (node->kind) {
+        case PHP_AST_NULL_LITERAL:
+        case PHP_AST_BOOL_LITERAL:
+        case PHP_AST_INT_LITERAL:
+        case PHP_AST_FLOAT_LITERAL:
+            emit_push_literal(c, php_evaluate_constant(node));
+            break;
+
+        case PHP_AST_STRING_LITERAL:
+            emit(c, PHP_OP_PUSH_CONST, add_string_literal(c, node->str, node->str_len), 0);
+            break;
+
+        case PHP_AST_CONSTANT: {
+            const compile_constant_t* constant = find_compile_constant(node->str);
+            if (constant) {
+                emit_push_literal(c, constant_to_value(constant));
+            } else {
+                emit(c, PHP_OP_FETCH_CONSTANT, add_string_literal(c, node->str, node->str_len), 0);
+            }
+            break;
+        }
+
+        case PHP_AST_VAR:
+            compile_fetch(c, node, false);
+            break;
+
+        case PHP_AST_BINARY:
+            if (node->op == PHP_BINOP_CONCAT) {
+                compile_concat_chain(c, node);
+            } else {
+                compile_binary(c, node);
+            }
+            break;
+
+        case PHP_AST_UNARY: {
+            compile_expression(c, node->children[0]);
+            switch (node->op) {
+                case PHP_UNOP_NOT: emit(c, PHP_OP_BOOL_NOT, 0, 0); break;
+                case PHP_UNOP_NEG: emit(c, PHP_OP_NEG, 0, 0); break;
+                case PHP_UNOP_PLUS: emit(c, PHP_OP_PLUS, 0, 0); break;
+                case PHP_UNOP_BW_NOT: emit(c, PHP_OP_BW_NOT, 0, 0); break;
+                default: break;  // "@" only affects diagnostics
+            }
+            break;
+        }
+
+        case PHP_AST_DIM:
+            compile_fetch(c, node, false);
+            break;
+
+        case PHP_AST_ARRAY: {
+            php_value_t* constant = php_evaluate_constant(node);
+            if (constant) {
+                emit_push_literal(c, constant);
+                break;
+            }
+            emit(c, PHP_OP_INIT_ARRAY, (uint32_t)node->child_count, 0);
+            for (size_t i = 0; i < node->child_count; i++) {
+                const php_ast_node_t* elem = node->children[i];
+                if (elem->children[0]) {
+                    compile_expression(c, elem->children[0]);
+                }
+                compile_expression(c, elem->children[1]);
+                c->line = elem->line;
+                uint32_t op = emit(c, PHP_OP_ADD_ARRAY_ELEMENT, 0, 0);
+                c->op_array->ops[op].ext = elem->children[0] != NULL;
+            }
+            break;
+        }
+
+        case PHP_AST_ASSIGN:
+            compile_assign(c, node);
+            break;
+
+        case PHP_AST_ASSIGN_OP:
+            compile_assign_op(c, node);
+            break;
+
+        case PHP_AST_PRE_INC:
+            compile_inc_dec(c, node->children[0], PHP_OP_PRE_INC_VAR);
+            break;
+        case PHP_AST_PRE_DEC:
+            compile_inc_dec(c, node->children[0], PHP_OP_PRE_DEC_VAR);
+            break;
+        case PHP_AST_POST_INC:
+            compile_inc_dec(c, node->children[0], PHP_OP_POST_INC_VAR);
+            break;
+        case PHP_AST_POST_DEC:
+            compile_inc_dec(c, node->children[0], PHP_OP_POST_DEC_VAR);
+            break;
+
+        case PHP_AST_CALL:
+            compile_call(c, node);
+            break;
+
+        case PHP_AST_TERNARY: {
+            const php_ast_node_t* cond = node->children[0];
+            const php_ast_node_t* then_expr = node->children[1];
+            const php_ast_node_t* else_expr = node->children[2];
+
+            compile_expression(c, cond);
+            if (!then_expr) {
+                uint32_t jump = emit(c, PHP_OP_JMP_SET, 0, 0);
+                compile_expression(c, else_expr);
+                patch_jump(c, jump, current_offset(c));
+                break;
+            }
+
+            uint32_t jump_else = emit(c, PHP_OP_JMPZ, 0, 0);
+            compile_expression(c, then_expr);
+            uint32_t jump_end = emit(c, PHP_OP_JMP, 0, 0);
+            patch_jump(c, jump_else, current_offset(c));
+            compile_expression(c, else_expr);
+            patch_jump(c, jump_end, current_offset(c));
+            break;
+        }
+
+        case PHP_AST_INTERP:
+            compile_concat(c, (const php_ast_node_t* const*)node->children, node->child_count);
+            break;
+
+        case PHP_AST_CAST:
+            compile_expression(c, node->children[0]);
+            emit(c, PHP_OP_CAST, 0, 0);
+            c->op_array->ops[c->op_array->op_count - 1].ext = (uint8_t)node->op;
+            break;
+
+        case PHP_AST_ISSET: {
+            // isset(a, b) is isset(a) && isset(b)
+            uint32_t* jumps = calloc(node->child_count, sizeof(uint32_t));
+            for (size_t i = 0; i < node->child_count; i++) {
+                const php_ast_node_t* arg = node->children[i];
+                if (arg->kind == PHP_AST_VAR) {
+                    compile_var_name(c, arg);
+                    emit_var(c, PHP_OP_ISSET_VAR, arg);
+                } else if (arg->kind == PHP_AST_DIM) {
+                    // A missing element or anything on the way reads as null
+                    compile_fetch(c, arg, true);
+                    emit_push_literal(c, php_value_create_null());
+                    emit(c, PHP_OP_IS_NOT_IDENTICAL, 0, 0);
+                } else {
+                    compile_error(c, "Cannot use isset() on the result of an expression%s", "");
+                    break;
+                }
+                if (i + 1 < node->child_count) {
+                    jumps[i] = emit(c, PHP_OP_JMPZ_EX, 0, 0);
+                }
+            }
+            for (size_t i = 0; i + 1 < node->child_count; i++) {
+                patch_jump(c, jumps[i], current_offset(c));
+            }
+            free(jumps);
+            break;
+        }
+
+        case PHP_AST_EMPTY:
+            compile_fetch(c, node->children[0], true);
+            emit(c, PHP_OP_BOOL_NOT, 0, 0);
+            break;
+
+        case PHP_AST_PRINT:
+            compile_expression(c, node->children[0]);
+            emit(c, PHP_OP_ECHO, 0, 0);
+            emit_push_literal(c, php_value_create_int(1));
+            break;
+
+        case PHP_AST_EXIT:
+            if (node->child_count > 0) {
+                compile_expression(c, node->children[0]);
+            } else {
+                emit_push_literal(c, php_value_create_null());
+            }
+            emit(c, PHP_OP_EXIT, 0, 0);
+            // EXIT never falls through, but expressions must leave a value
+            emit_push_literal(c, php_value_create_null());
+            break;
+
+        default:
+            compile_error(c, "Unsupported expression%s", "");
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
+static void jump_list_add(uint32_t** list, size_t* count, size_t* capacity, uint32_t op_index) {
+    if (*count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4;
+        *list = realloc(*list, *capacity * sizeof(uint32_t));
+    }
+    (*list)[(*count)++] = op_index;
+}
+
+static void loop_begin(compiler_t* c) {
+    if (c->loop_depth >= c->loop_capacity) {
+        c->loop_capacity = c->loop_capacity ? c->loop_capacity * 2 : 4;
+        c->loops = realloc(c->loops, c->loop_capacity * sizeof(loop_context_t));
+    }
+    memset(&c->loops[c->loop_depth++], 0, sizeof(loop_context_t));
+}
+
+static void loop_end(compiler_t* c, uint32_t continue_target, uint32_t break_target) {
+    loop_context_t* loop = &c->loops[--c->loop_depth];
+    for (size_t i = 0; i < loop->continue_count; i++) {
+        patch_jump(c, loop->continues[i], continue_target);
+    }
+    for (size_t i = 0; i < loop->break_count; i++) {
+        patch_jump(c, loop->breaks[i], break_target);
+    }
+    free(loop->continues);
+    free(loop->breaks);
+}
+
+static void compile_break_continue(compiler_t* c, const php_ast_node_t* node) {
+    bool is_break = node->kind == PHP_AST_BREAK;
+    if ((size_t)node->int_val > c->loop_depth) {
+        if (c->loop_depth == 0) {
+            compile_error(c, "'%s' not in the 'loop' or 'switch' context", is_break ? "break" : "continue");
+        } else {
+            char levels[32];
+            snprintf(levels, sizeof(levels), "%lld", (long long)node->int_val);
+            compile_error(c, "Cannot 'break' %s levels", levels);
+        }
+        return;
+    }
+
+    // Iterators of the foreach loops left behind are freed on the way out;
+    // the target loop frees its own at its break target
+    for (size_t i = c->loop_depth; i > c->loop_depth - node->int_val + 1; i--) {
+        if (c->loops[i - 1].is_foreach) {
+            emit(c, PHP_OP_FE_FREE, 0, 0);
+        }
+    }
+
+    loop_context_t* loop = &c->loops[c->loop_depth - node->int_val];
+    uint32_t jump = emit(c, PHP_OP_JMP, 0, 0);
+    if (is_break) {
+        jump_list_add(&loop->breaks, &loop->break_count, &loop->break_capacity, jump);
+    } else {
+        jump_list_add(&loop->continues, &loop->continue_count, &loop->continue_capacity, jump);
+    }
+}
+
+// foreach ($array as $key => $value): the array and a position live on
+// the stack, FE_FETCH assigns the value and pushes the key for ASSIGN_VAR
+static void compile_foreach(compiler_t* c, const php_ast_node_t* node) {
+    const php_ast_node_t* key = node->children[1];
+    const php_ast_node_t* value = node->children[2];
+
+    if (node->op) {
+        compile_error(c, "foreach by reference is not supported%s", "");
+        return;
+    }
+    if (value->kind != PHP_AST_VAR || is_dynamic_var(value) ||
+        (key && (key->kind != PHP_AST_VAR || is_dynamic_var(key)))) {
+        compile_error(c, "foreach only supports plain variables as targets%s", "");
+        return;
+    }
+
+    compile_expression(c, node->children[0]);
+    c->line = node->line;
+    uint32_t reset = emit(c, PHP_OP_FE_RESET, 0, 0);
+    uint32_t fetch = emit(c, PHP_OP_FE_FETCH, 0, lookup_cv(c, value->str, value->str_len));
+    if (key) {
+        c->op_array->ops[fetch].ext = 1;
+        emit_var(c, PHP_OP_ASSIGN_VAR, key);
+        emit(c, PHP_OP_POP, 0, 0);
+    }
+
+    loop_begin(c);
+    c->loops[c->loop_depth - 1].is_foreach = true;
+    compile_statement(c, node->children[3]);
+    emit(c, PHP_OP_JMP, fetch, 0);
+    uint32_t free_op = emit(c, PHP_OP_FE_FREE, 0, 0);
+    patch_jump(c, fetch, free_op);
+    patch_jump(c, reset, current_offset(c));
+    loop_end(c, fetch, free_op);
+}
+
+static void compile_statement_list(compiler_t* c, const php_ast_node_t* list) {
+    for (size_t i = 0; i < list->child_count && !c->has_error; i++) {
+        compile_statement(c, list->children[i]);
+    }
+}
+
+static void compile_function(compiler_t* c, const php_ast_node_t* node, bool hoisted);
+
+// Echo arguments whose output is known at compile time join the static output
+static bool append_constant_echo(compiler_t* c, const php_ast_node_t* node) {
+    if (c->echo.length == 0) {
+        c->echo_line = c->line;
+    }
+    bool appended = append_constant_text(&c->echo, node);
+    if (c->echo.failed) {
+        compile_error(c, "Out of memory%s", "");
+    }
+    return appended;
+}
+
+static void compile_statement(compiler_t* c, const php_ast_node_t* node) {
+    if (!node || c->has_error) return;
+    c->line = node->line;
+
+    switch (node->kind) {
+        case PHP_AST_STMT_LIST:
+            compile_statement_list(c, node);
+            break;
+
+        case PHP_AST_INLINE_HTML:
+            append_echo(c, node->str, node->str_len);
+            break;
+
+        case PHP_AST_ECHO:
+            for (size_t i = 0; i < node->child_count; i++) {
+                if (!append_constant_echo(c, node->children[i])) {
+                    compile_expression(c, node->children[i]);
+                    emit(c, PHP_OP_ECHO, 0, 0);
+                }
+            }
+            break;
+
+        case PHP_AST_EXPR_STMT:
+            compile_expression(c, node->children[0]);
+            emit(c, PHP_OP_POP, 0, 0);
+            break;
+
+        case PHP_AST_IF: {
+            // Jumps from the end of each taken branch are chained through
+            // their targets (index + 1, 0 ends) until the end is known
+            size_t last = node->child_count - 1;
+            uint32_t jumps_end = 0;
+            for (size_t i = 0; i < last && !c->has_error; i += 2) {
+                compile_expression(c, node->children[i]);
+                uint32_t jump_next = emit(c, PHP_OP_JMPZ, 0, 0);
+                compile_statement(c, node->children[i + 1]);
+                if (i + 2 < last || node->children[last]) {
+                    jumps_end = emit(c, PHP_OP_JMP, jumps_end, 0) + 1;
+                }
+                patch_jump(c, jump_next, current_offset(c));
+            }
+            compile_statement(c, node->children[last]);
+            while (jumps_end) {
+                uint32_t jump = jumps_end - 1;
+                jumps_end = c->op_array->ops[jump].op1;
+                patch_jump(c, jump, current_offset(c));
+            }
+            break;
+        }
+
+        case PHP_AST_WHILE: {
+            uint32_t start = current_offset(c);
+            compile_expression(c, node->children[0]);
+            uint32_t jump_end = emit(c, PHP_OP_JMPZ, 0, 0);
+            loop_begin(c);
+            compile_statement(c, node->children[1]);
+            emit(c, PHP_OP_JMP, start, 0);
+            patch_jump(c, jump_end, current_offset(c));
+            loop_end(c, start, current_offset(c));
+            break;
+        }
+
+        case PHP_AST_DO_WHILE: {
+            uint32_t start = current_offset(c);
+            loop_begin(c);
+            compile_statement(c, node->children[0]);
+            uint32_t cond = current_offset(c);
+            compile_expression(c, node->children[1]);
+            emit(c, PHP_OP_JMPNZ, start, 0);
+            loop_end(c, cond, current_offset(c));
+            break;
+        }
+
+        case PHP_AST_FOR: {
+            const php_ast_node_t* init = node->children[0];
+            const php_ast_node_t* cond = node->children[1];
+            const php_ast_node_t* step = node->children[2];
+
+            for (size_t i = 0; i < init->child_count; i++) {
+                compile_expression(c, init->children[i]);
+                emit(c, PHP_OP_POP, 0, 0);
+            }
+
+            uint32_t start = current_offset(c);
+            uint32_t jump_end = UINT32_MAX;
+            if (cond->child_count > 0) {
+                // Only the last condition expression decides
+                for (size_t i = 0; i < cond->child_count; i++) {
+                    compile_expression(c, cond->children[i]);
+                    if (i + 1 < cond->child_count) {
+                        emit(c, PHP_OP_POP, 0, 0);
+                    }
+                }
+                jump_end = emit(c, PHP_OP_JMPZ, 0, 0);
+            }
+
+            loop_begin(c);
+            compile_statement(c, node->children[3]);
+            uint32_t step_start = current_offset(c);
+            for (size_t i = 0; i < step->child_count; i++) {
+                compile_expression(c, step->children[i]);
+                emit(c, PHP_OP_POP, 0, 0);
+            }
+            emit(c, PHP_OP_JMP, start, 0);
+            if (jump_end != UINT32_MAX) {
+                patch_jump(c, jump_end, current_offset(c));
+            }
+            loop_end(c, step_start, current_offset(c));
+            break;
+        }
+
+        case PHP_AST_FOREACH:
+            compile_foreach(c, node);
+            break;
+
+        case PHP_AST_BREAK:
+        case PHP_AST_CONTINUE:
+            compile_break_continue(c, node);
+            break;
+
+        case PHP_AST_FUNC_DECL:
+            compile_function(c, node, false);
+            break;
+
+        case PHP_AST_RETURN:
+            if (node->child_count > 0) {
+                compile_expression(c, node->children[0]);
+            } else {
+                emit_push_literal(c, php_value_create_null());
+            }
+            emit(c, PHP_OP_RETURN, 0, 0);
+            break;
+
+        case PHP_AST_GLOBAL:
+            for (size_t i = 0; i < node->child_count; i++) {
+                emit_var(c, PHP_OP_BIND_GLOBAL, node->children[i]);
+            }
+            break;
+
+        case PHP_AST_UNSET:
+            for (size_t i = 0; i < node->child_count; i++) {
+                const php_ast_node_t* target = node->children[i];
+                if (target->kind == PHP_AST_DIM) {
+                    for (const php_ast_node_t* dim = target; dim->kind == PHP_AST_DIM; dim = dim->children[0]) {
+                        if (!dim->children[1]) {
+                            compile_error(c, "Cannot use [] for unsetting%s", "");
+                            return;
+                        }
+                    }
+                    uint32_t depth = compile_dim_keys(c, target);
+                    emit_dim(c, PHP_OP_UNSET_DIM, target, depth, 0);
+                    continue;
+                }
+                compile_var_name(c, target);
+                emit_var(c, PHP_OP_UNSET_VAR, target);
+            }
+            break;
+
+        default:
+            compile_error(c, "Unsupported statement%s", "");
+            break;
+    }
+}
+
+static bool compiler_init(compiler_t* c, php_op_array_t* op_array, php_op_array_t* script) {
+    memset(c, 0, sizeof(compiler_t));
+    c->op_array = op_array;
+    c->script = script;
+    return op_array != NULL;
+}
+
+static void compiler_cleanup(compiler_t* c) {
+    free(c->loops);
+    free(c->string_literals.slots);
+    free(c->literal_cvs);
+    free(c->echo.data);
+}
+
+// Functions declared when the script starts; conditional ones may never be
+static const php_op_array_t* find_script_function(const php_op_array_t* script, const char* name) {
+    for (uint32_t i = 0; i < script->function_count; i++) {
+        if (!script->functions[i]->conditional && strcasecmp(script->functions[i]->name, name) == 0) {
+            return script->functions[i];
+        }
+    }
+    return NULL;
+}
+
+// Functions are compiled into their own op array. Those at the top level of
+// the script are hoisted and declared when it starts; any other is declared
+// by DECLARE_FUNCTION when the code around it reaches it, as in PHP.
+static void compile_function(compiler_t* c, const php_ast_node_t* node, bool hoisted) {
+    const php_ast_node_t* params = node->children[0];
+    const php_ast_node_t* body = node->children[1];
+
+    if (hoisted && find_script_function(c->script, node->str)) {
+        compile_error(c, "Cannot redeclare %s()", node->str);
+        return;
+    }
+
+    compiler_t fc;
+    if (!compiler_init(&fc, op_array_create(node->str, c->script->filename), c->script)) {
+        c->has_error = true;
+        return;
+    }
+    fc.line = node->line;
+    fc.declarations = c->declarations;
+    fc.declaration_count = c->declaration_count;
+
+    php_op_array_t* func = fc.op_array;
+    func->num_params = (uint32_t)params->child_count;
+    func->required_params = 0;
+
+    for (size_t i = 0; i < params->child_count && !fc.has_error; i++) {
+        const php_ast_node_t* param = params->children[i];
+        const php_ast_node_t* def = param->children[0];
+        fc.line = param->line;
+
+        // Parameters take the first slots, in order
+        if (lookup_cv(&fc, param->str, param->str_len) != i) {
+            compile_error(&fc, "Redefinition of parameter $%s", param->str);
+            break;
+        }
+
+        if (param->op & PHP_PARAM_VARIADIC) {
+            if (i + 1 < params->child_count) {
+                compile_error(&fc, "Only the last parameter can be variadic%s", "");
+            } else if (def) {
+                compile_error(&fc, "Variadic parameter $%s cannot have a default value", param->str);
+            } else if (param->op & PHP_PARAM_BY_REF) {
+                compile_error(&fc, "Unsupported variadic parameter $%s taken by reference", param->str);
+            }
+            func->variadic = true;
+            emit(&fc, PHP_OP_RECV_VARIADIC, (uint32_t)i, 0);
+            continue;
+        }
+        if (param->op & PHP_PARAM_BY_REF) {
+            if (i >= 32) {
+                compile_error(&fc, "Unsupported parameter $%s taken by reference after the 32nd", param->str);
+                break;
+            }
+            func->by_ref |= 1u << i;
+        }
+
+        if (def) {
+            php_value_t* value = php_evaluate_constant(def);
+            if (!value) {
+                compile_error(&fc, "Unsupported default value for parameter $%s", param->str);
+                break;
+            }
+            emit(&fc, PHP_OP_RECV_INIT, (uint32_t)i, add_literal(&fc, value));
+        } else {
+            emit(&fc, PHP_OP_RECV, (uint32_t)i, 0);
+            func->required_params = (uint32_t)i + 1;
+        }
+    }
+
+    compile_statement_list(&fc, body);
+    emit_push_literal(&fc, php_value_create_null());
+    emit(&fc, PHP_OP_RETURN, 0, 0);
+
+    bool failed = fc.has_error;
+    compiler_cleanup(&fc);
+    if (failed) {
+        php_op_array_destroy(func);
+        c->has_error = true;
+        return;
+    }
+
+    php_op_array_t* owner = c->op_array;
+    if (owner->function_count >= owner->function_capacity) {
+        owner->function_capacity = owner->function_capacity ? owner->function_capacity * 2 : 8;
+        owner->functions = realloc(owner->functions, owner->function_capacity * sizeof(php_op_array_t*));
+    }
+    func->conditional = !hoisted;
+    if (!hoisted) {
+        emit(c, PHP_OP_DECLARE_FUNCTION, owner->function_count, 0);
+    }
+    owner->functions[owner->function_count++] = func;
+}
+
+static bool resolve_calls(php_op_array_t* op_array, const php_op_array_t* script) {
+    free(op_array->call_targets);
+    op_array->call_targets = calloc(op_array->literal_count ? op_array->literal_count : 1,
+                                    sizeof(php_call_target_t));
+    if (!op_array->call_targets) return false;
+
+    // Functions the script declares win, as the executor refuses to let
+    // them shadow builtins; anything unresolved is looked up at run time
+    for (uint32_t i = 0; i < op_array->op_count; i++) {
+        const php_op_t* op = &op_array->ops[i];
+        if (op->opcode != PHP_OP_CALL) continue;
+
+        php_call_target_t* target = &op_array->call_targets[op->op1];
+        if (target->user || target->builtin) continue;
+
+        const char* name = op_array->literals[op->op1].value.str->val;
+        target->user = find_script_function(script, name);
+        if (!target->user) {
+            target->builtin = php_engine_find_function(name);
+        }
+    }
+    return true;
+}
+
+static bool resolve_functions(const php_op_array_t* op_array, const php_op_array_t* script) {
+    for (uint32_t i = 0; i < op_array->function_count; i++) {
+        php_op_array_t* func = op_array->functions[i];
+        if (!resolve_calls(func, script) || !resolve_functions(func, script)) return false;
+        php_aot_bind(func);
+    }
+    return true;
+}
+
+bool php_op_array_resolve_calls(php_op_array_t* script) {
+    return resolve_calls(script, script) && resolve_functions(script, script);
+}
+
+static void optimize_functions(const php_op_array_t* op_array) {
+    for (uint32_t i = 0; i < op_array->function_count; i++) {
+        php_optimize_op_array(op_array->functions[i]);
+        optimize_functions(op_array->functions[i]);
+    }
+}
+
+// Every function declared in the file, so that calls compiled before a
+// declaration know which arguments it takes by reference
+typedef struct {
+    const php_ast_node_t** items;
+    size_t count;
+    size_t capacity;
+} declaration_list_t;
+
+static void collect_declarations(declaration_list_t* list, const php_ast_node_t* node) {
+    // The first child is followed in a loop, as in php_ast_destroy
+    for (; node; node = node->child_count ? node->children[0] : NULL) {
+        if (node->kind == PHP_AST_FUNC_DECL) {
+            if (list->count >= list->capacity) {
+                list->capacity = list->capacity ? list->capacity * 2 : 16;
+                list->items = realloc(list->items, list->capacity * sizeof(php_ast_node_t*));
+            }
+            list->items[list->count++] = node;
+        }
+        for (size_t i = 1; i < node->child_count; i++) {
+            collect_declarations(list, node->children[i]);
+        }
+    }
+}
+
+// Conditional declarations of one name must agree on what they take by
+// reference, as calls are compiled for one of them
+static void check_declarations(compiler_t* c) {
+    for (size_t i = 0; i < c->declaration_count && !c->has_error; i++) {
+        const php_ast_node_t* decl = c->declarations[i];
+        const php_ast_node_t* first = find_declaration(c, decl->str);
+        if (declared_by_ref(first) != declared_by_ref(decl)) {
+            c->line = decl->line;
+            compile_error(c, "Declarations of %s() differ in the parameters they take by reference", decl->str);
+        }
+    }
+}
+
+php_op_array_t* php_compile_ast(const php_ast_node_t* ast, const char* filename) {
+    if (!ast) return NULL;
+
+    compiler_t c;
+    php_op_array_t* script = op_array_create(NULL, filename);
+    if (!compiler_init(&c, script, script)) {
+        return NULL;
+    }
+
+    declaration_list_t declarations = {NULL, 0, 0};
+    collect_declarations(&declarations, ast);
+    c.declarations = declarations.items;
+    c.declaration_count = declarations.count;
+    check_declarations(&c);
+
+    for (size_t i = 0; i < ast->child_count && !c.has_error; i++) {
+        const php_ast_node_t* statement = ast->children[i];
+        if (statement && statement->kind == PHP_AST_FUNC_DECL) {
+            c.line = statement->line;
+            compile_function(&c, statement, true);
+        } else {
+            compile_statement(&c, statement);
+        }
+    }
+    emit_push_literal(&c, php_value_create_null());
+    emit(&c, PHP_OP_RETURN, 0, 0);
+
+    bool failed = c.has_error;
+    compiler_cleanup(&c);
+    free(declarations.items);
+    if (failed) {
+        php_op_array_destroy(script);
+        return NULL;
+    }
+
+    php_optimize_op_array(script);
+    optimize_functions(script);
+    if (!php_op_array_resolve_calls(script)) {
+        php_op_array_destroy(script);
+        return NULL;
+    }
+    return script;
+}
+
+php_op_array_t* php_compile_string(const char* code, const char* filename) {
+    php_ast_node_t* ast = php_parse(code);
+    if (!ast) {
+        return NULL;
+    }
+    php_optimize_ast(ast);
+    php_op_array_t* op_array = php_compile_ast(ast, filename);
+    php_ast_destroy(ast);
+    return op_array;
+}
+
+const char* php_opcode_name(uint8_t opcode) {
+    static const char* const names[PHP_OP_COUNT] = {
+        "NOP", "PUSH_CONST", "POP", "DUP",
+        "FETCH_VAR", "FETCH_VAR_QUIET", "ASSIGN_VAR", "ASSIGN_OP_VAR", "UNSET_VAR", "ISSET_VAR", "BIND_GLOBAL",
+        "PRE_INC_VAR", "PRE_DEC_VAR", "POST_INC_VAR", "POST_DEC_VAR", "FETCH_CONSTANT",
+        "INIT_ARRAY", "ADD_ARRAY_ELEMENT", "FETCH_DIM", "FETCH_DIM_QUIET", "PUSH_APPEND_KEY",
+        "ASSIGN_DIM", "INC_DEC_DIM", "UNSET_DIM", "FETCH_VAR_REF", "FETCH_DIM_REF",
+        "ADD", "SUB", "MUL", "DIV", "MOD", "POW", "CONCAT", "SL", "SR",
+        "BW_AND", "BW_OR", "BW_XOR", "IS_EQUAL", "IS_NOT_EQUAL", "IS_IDENTICAL",
+        "IS_NOT_IDENTICAL", "IS_SMALLER", "IS_SMALLER_OR_EQUAL", "SPACESHIP", "BOOL_XOR", "CONCAT_N",
+        "BOOL_NOT", "BOOL", "NEG", "PLUS", "BW_NOT", "CAST",
+        "JMP", "JMPZ", "JMPNZ", "JMPZ_EX", "JMPNZ_EX", "JMP_SET", "JMP_NOT_NULL",
+        "FE_RESET", "FE_FETCH", "FE_FREE",
+        "ECHO", "ECHO_CONST", "CALL", "RECV", "RECV_INIT", "RECV_VARIADIC", "RETURN", "EXIT", "DECLARE_FUNCTION",
+        "ADD_NUMBER", "SUB_NUMBER", "MUL_NUMBER", "IS_SMALLER_NUMBER", "IS_SMALLER_OR_EQUAL_NUMBER",
+        "INC_NUMBER", "DEC_NUMBER"
+    };
+    return opcode < PHP_OP_COUNT ? names[opcode] : "UNKNOWN";
+}
@@ -0,0 +1,218 @@
+/**
+ * PHP Compiler Header
+ * Opcode definitions and AST to bytecode compilation
+ */
+
+#ifndef PHP_COMPILER_H
+#define PHP_COMPILER_H
+
+#include "php_engine.h"
+#include "php_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opcodes for the stack VM. Operands are literal indices, jump targets
+// or counts depending on the opcode; see php_executor.c for semantics.
+typedef enum {
+    PHP_OP_NOP,
+
+    // Operand stack
+    PHP_OP_PUSH_CONST,          // op1 = literal
+    PHP_OP_POP,
+    PHP_OP_DUP,
+
+    // Variables (op1 = compiled variable slot, or the name is popped
+    // from the stack when ext is PHP_VAR_DYNAMIC)
+    PHP_OP_FETCH_VAR,
+    PHP_OP_FETCH_VAR_QUIET,     // No notice for undefined variables (isset, ??)
+    PHP_OP_ASSIGN_VAR,          // Pops value, stores it, pushes it back
+    PHP_OP_ASSIGN_OP_VAR,       // Pops value, applies binary op op2 in place, pushes the result
+    PHP_OP_UNSET_VAR,
+    PHP_OP_ISSET_VAR,
+    PHP_OP_BIND_GLOBAL,
+    PHP_OP_PRE_INC_VAR,
+    PHP_OP_PRE_DEC_VAR,
+    PHP_OP_POST_INC_VAR,
+    PHP_OP_POST_DEC_VAR,
+    PHP_OP_FETCH_CONSTANT,      // op1 = name literal, not a variable op
+
+    // Arrays
+    PHP_OP_INIT_ARRAY,          // op1 = size hint, pushes an empty array
+    PHP_OP_ADD_ARRAY_ELEMENT,   // Pops value and, when ext is set, key; adds to the array below
+    PHP_OP_FETCH_DIM,           // Pops key and container, pushes the element
+    PHP_OP_FETCH_DIM_QUIET,     // No notice for missing keys (isset, ??)
+    PHP_OP_PUSH_APPEND_KEY,     // Key placeholder of a "[]" dimension
+
+    // Element writes are variable ops on the base variable. The key of each
+    // dimension, outermost first, is on the stack above any $$name and below
+    // any value; op2 packs the dimension count with an opcode, PHP_DIM_OP2.
+    PHP_OP_ASSIGN_DIM,          // Pops value, stores it, pushes it back; opcode = binary op of "op="
+    PHP_OP_INC_DEC_DIM,         // opcode = the matching PRE/POST_INC/DEC_VAR
+    PHP_OP_UNSET_DIM,
+
+    // By-reference arguments of builtins, pushed as pointers to the variable
+    // or element. The keys of FETCH_DIM_REF are followed by the extra count
+    // of arguments pushed after them; the element is only fetched once those
+    // are evaluated, so nothing can move it before the call.
+    PHP_OP_FETCH_VAR_REF,
+    PHP_OP_FETCH_DIM_REF,
+
+    // Binary operators, pop two and push the result
+    PHP_OP_ADD,
+    PHP_OP_SUB,
+    PHP_OP_MUL,
+    PHP_OP_DIV,
+    PHP_OP_MOD,
+    PHP_OP_POW,
+    PHP_OP_CONCAT,
+    PHP_OP_SL,
+    PHP_OP_SR,
+    PHP_OP_BW_AND,
+    PHP_OP_BW_OR,
+    PHP_OP_BW_XOR,
+    PHP_OP_IS_EQUAL,
+    PHP_OP_IS_NOT_EQUAL,
+    PHP_OP_IS_IDENTICAL,
+    PHP_OP_IS_NOT_IDENTICAL,
+    PHP_OP_IS_SMALLER,
+    PHP_OP_IS_SMALLER_OR_EQUAL,
+    PHP_OP_SPACESHIP,
+    PHP_OP_BOOL_XOR,
+    PHP_OP_CONCAT_N,            // op1 = part count; pops the parts and pushes them joined
+
+    // Unary operators
+    PHP_OP_BOOL_NOT,
+    PHP_OP_BOOL,
+    PHP_OP_NEG,
+    PHP_OP_PLUS,
+    PHP_OP_BW_NOT,
+    PHP_OP_CAST,                // ext = php_type_t
+
+    // Control flow (op1 = target)
+    PHP_OP_JMP,
+    PHP_OP_JMPZ,                // Pops condition
+    PHP_OP_JMPNZ,
+    PHP_OP_JMPZ_EX,             // Keeps false and jumps, or pops and falls through
+    PHP_OP_JMPNZ_EX,            // Keeps true and jumps, or pops and falls through
+    PHP_OP_JMP_SET,             // "?:" keeps a truthy value and jumps
+    PHP_OP_JMP_NOT_NULL,        // "??" keeps a non-null value and jumps
+
+    // foreach keeps the array and an integer position on the stack
+    PHP_OP_FE_RESET,            // Pushes a position above the array; pops non-arrays and jumps to op1
+    PHP_OP_FE_FETCH,            // op1 = exit target, op2 = value variable; ext pushes the key too
+    PHP_OP_FE_FREE,
+
+    // Output
+    PHP_OP_ECHO,
+    PHP_OP_ECHO_CONST,          // op1 = string literal, written without touching the stack
+
+    // Functions
+    PHP_OP_CALL,                // op1 = name literal, op2 = argument count
+    PHP_OP_RECV,                // op1 = parameter index
+    PHP_OP_RECV_INIT,           // op1 = parameter index, op2 = default literal
+    PHP_OP_RECV_VARIADIC,       // op1 = parameter index; collects it and the arguments after it into an array
+    PHP_OP_RETURN,              // Pops the return value
+    PHP_OP_EXIT,                // Pops the status or message
+    PHP_OP_DECLARE_FUNCTION,    // op1 = index in the functions of the op array
+
+    // Set by the optimizer where operands were inferred to be numbers; each
+    // checks the types it gets and falls back to the generic op
+    PHP_OP_ADD_NUMBER,
+    PHP_OP_SUB_NUMBER,
+    PHP_OP_MUL_NUMBER,
+    PHP_OP_IS_SMALLER_NUMBER,   // ext as for IS_SMALLER
+    PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER,
+    PHP_OP_INC_NUMBER,          // op1 = variable slot; "$i++;" with the result unused
+    PHP_OP_DEC_NUMBER,
+
+    PHP_OP_COUNT
+} php_opcode_t;
+
+// ext flag of variable opcodes: $$name, the name is on the stack
+#define PHP_VAR_DYNAMIC 1
+
+// op2 of element writes
+#define PHP_DIM_OP2(depth, extra) ((uint32_t)(depth) | ((uint32_t)(extra) << 16))
+#define PHP_DIM_DEPTH(op2) ((op2) & 0xffff)
+#define PHP_DIM_EXTRA(op2) ((op2) >> 16)
+
+// A single instruction
+typedef struct {
+    uint32_t op1;
+    uint32_t op2;
+    uint32_t lineno;
+    uint8_t opcode;
+    uint8_t ext;
+} php_op_t;
+
+struct php_op_array;
+struct php_aot_frame;
+
+// Callee of a CALL op, resolved once when the script is compiled or loaded
+// so calls do not look functions up by name
+typedef struct {
+    const php_function_t* builtin;
+    const struct php_op_array* user;
+} php_call_target_t;
+
+// A compiled function or script body
+typedef struct php_op_array {
+    char* name;                         // NULL for the main script
+    char* filename;
+
+    php_op_t* ops;
+    uint32_t op_count;
+    uint32_t op_capacity;
+
+    php_value_t* literals;
+    uint32_t literal_count;
+    uint32_t literal_capacity;
+
+    php_call_target_t* call_targets;    // Indexed by the name literal of each CALL
+
+    uint32_t* cv_names;                 // Literal index of each compiled variable's name
+    uint32_t num_cvs;
+    uint32_t num_params;                // Parameters are the first compiled variables
+    uint32_t required_params;
+    uint32_t by_ref;                    // Bit n set: parameter n is taken by reference
+    bool variadic;                      // The last parameter collects the remaining arguments
+
+    // Body compiled ahead of time (php_aot.h), run instead of the ops
+    bool (*native)(struct php_aot_frame* frame, php_value_t* result);
+
+    // Functions declared in this body. Those at the top level of a script
+    // are declared when it starts; the others are conditional and declared
+    // by a DECLARE_FUNCTION op when it runs.
+    struct php_op_array** functions;
+    uint32_t function_count;
+    uint32_t function_capacity;
+    bool conditional;
+} php_op_array_t;
+
+// Compilation
+php_op_array_t* php_compile_ast(const php_ast_node_t* ast, const char* filename);
+php_op_array_t* php_compile_string(const char* code, const char* filename);
+void php_op_array_destroy(php_op_array_t* op_array);
+
+// Bind CALL ops to user functions of the script and registered builtins,
+// and functions to their bodies compiled ahead of time
+bool php_op_array_resolve_calls(php_op_array_t* script);
+
+// Value of a literal-only expression: literals, known constants and arrays
+// of them, or NULL. The caller frees it with php_value_destroy.
+php_value_t* php_evaluate_constant(const php_ast_node_t* node);
+
+// Opcode of a binary operator, PHP_OP_NOP for those compiled as jumps or
+// with swapped operands
+uint8_t php_binary_opcode(int op);
+
+// Debugging
+const char* php_opcode_name(uint8_t opcode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_COMPILER_H
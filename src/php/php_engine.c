@@ -4,48 +4,69 @@
  */
 
 #include "php_engine.h"
+#include "php_array.h"
+#include "php_compiler.h"
+#include "php_executor.h"
+#include "php_format.h"
+#include "php_opcache.h"
+#include "php_hash.h"
+#include "php_memory.h"
+#include "php_output.h"
+#include "php_variables.h"
 #include "wasi/wasi_shim.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
+#include <math.h>
+#include <time.h>
 
 // Global engine state
 static php_engine_state_t engine_state = PHP_ENGINE_UNINITIALIZED;
-static php_value_t** global_variables = NULL;
-static php_function_t* registered_functions = NULL;
-static size_t global_vars_count = 0;
-static size_t global_vars_capacity = 0;
+static php_function_t** registered_functions = NULL;  // Stable handles, owned
+static php_hash_t function_table = {0};                 // Folded name -> handle
 static size_t functions_count = 0;
 static size_t functions_capacity = 0;
 
 // Forward declarations
 static void register_builtin_functions(void);
-static php_value_t* parse_php_expression(const char* code, size_t* consumed);
+static bool execute_source(const char* code, const char* filename);
+static bool execute_op_array(const php_op_array_t* op_array);
 
 bool php_engine_init(void) {
     if (engine_state != PHP_ENGINE_UNINITIALIZED) {
         return true;
     }
 
-    // Initialize global variables storage
-    global_vars_capacity = 64;
-    global_variables = calloc(global_vars_capacity, sizeof(php_value_t*));
-    if (!global_variables) {
+    // Initialize the request heap and global variables storage
+    if (!php_memory_init() || !php_variables_init()) {
         return false;
     }
 
     // Initialize functions storage
     functions_capacity = 32;
-    registered_functions = calloc(functions_capacity, sizeof(php_function_t));
-    if (!registered_functions) {
-        free(global_variables);
+    registered_functions = calloc(functions_capacity, sizeof(php_function_t*));
+    if (!registered_functions || !php_hash_init(&function_table, functions_capacity * 2, true)) {
+        free(registered_functions);
+        php_variables_cleanup();
         return false;
     }
 
     // Register built-in functions
     register_builtin_functions();
 
+    if (!php_executor_init() || !php_opcache_init()) {
+        php_executor_cleanup();
+        for (size_t i = 0; i < functions_count; i++) {
+            free(registered_functions[i]);
+        }
+        free(registered_functions);
+        php_hash_destroy(&function_table);
+        php_variables_cleanup();
+        return false;
+    }
+
     engine_state = PHP_ENGINE_INITIALIZED;
     return true;
 }
@@ -55,30 +76,25 @@ void php_engine_cleanup(void) {
         return;
     }
 
+    php_executor_cleanup();
+    php_opcache_cleanup();
+
     // Clean up global variables
-    if (global_variables) {
-        for (size_t i = 0; i < global_vars_count; i++) {
-            if (global_variables[i]) {
-                php_value_destroy(global_variables[i]);
-            }
-        }
-        free(global_variables);
-        global_variables = NULL;
-    }
+    php_variables_cleanup();
 
-    // Clean up functions
+    // Clean up functions; their names belong to the intern pool
     if (registered_functions) {
         for (size_t i = 0; i < functions_count; i++) {
-            if (registered_functions[i].name) {
-                free(registered_functions[i].name);
-            }
+            free(registered_functions[i]);
         }
         free(registered_functions);
         registered_functions = NULL;
     }
+    php_hash_destroy(&function_table);
+    php_output_cleanup();
+    php_intern_cleanup();
+    php_memory_cleanup();
 
-    global_vars_count = 0;
-    global_vars_capacity = 0;
     functions_count = 0;
     functions_capacity = 0;
     engine_state = PHP_ENGINE_UNINITIALIZED;
@@ -93,117 +109,47 @@ bool php_engine_execute_file(const char* filename) {
         return false;
     }
 
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        php_engine_error("Failed to open file");
-        return false;
-    }
-
-    // Read file content
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char* content = malloc(file_size + 1);
-    if (!content) {
-        fclose(file);
+    // Scripts are compiled once and reused while they stay unchanged
+    php_op_array_t* op_array = php_opcache_compile_file(filename);
+    if (!op_array) {
         return false;
     }
 
-    fread(content, 1, file_size, file);
-    content[file_size] = '\0';
-    fclose(file);
-
-    // Execute content
-    bool result = php_engine_execute_string(content);
-    free(content);
+    bool result = execute_op_array(op_array);
+    php_opcache_release(op_array);
     return result;
 }
 
 bool php_engine_execute_string(const char* code) {
-    if (engine_state != PHP_ENGINE_INITIALIZED) {
+    return execute_source(code, "Command line code");
+}
+
+// Compile source to an op array and run it on the executor
+static bool execute_source(const char* code, const char* filename) {
+    if (engine_state != PHP_ENGINE_INITIALIZED || !code) {
         return false;
     }
 
-    engine_state = PHP_ENGINE_RUNNING;
-
-    // Simple PHP parser - this is a very basic implementation
-    const char* pos = code;
-    while (*pos) {
-        // Skip whitespace
-        while (*pos && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')) {
-            pos++;
-        }
-
-        if (!*pos) break;
-
-        // Handle PHP tags
-        if (strncmp(pos, "<?php", 5) == 0) {
-            pos += 5;
-            continue;
-        }
-        if (strncmp(pos, "<?", 2) == 0) {
-            pos += 2;
-            continue;
-        }
-        if (strncmp(pos, "?>", 2) == 0) {
-            pos += 2;
-            continue;
-        }
-
-        // Handle echo statements
-        if (strncmp(pos, "echo", 4) == 0) {
-            pos += 4;
-            while (*pos && (*pos == ' ' || *pos == '\t')) pos++;
-            
-            if (*pos == '"' || *pos == '\'') {
-                char quote = *pos++;
-                const char* start = pos;
-                while (*pos && *pos != quote) pos++;
-                if (*pos == quote) {
-                    size_t len = pos - start;
-                    char* str = malloc(len + 1);
-                    memcpy(str, start, len);
-                    str[len] = '\0';
-                    php_engine_output(str);
-                    free(str);
-                    pos++;
-                }
-            }
-            continue;
-        }
-
-        // Handle print statements
-        if (strncmp(pos, "print", 5) == 0) {
-            pos += 5;
-            while (*pos && (*pos == ' ' || *pos == '\t')) pos++;
-            
-            if (*pos == '"' || *pos == '\'') {
-                char quote = *pos++;
-                const char* start = pos;
-                while (*pos && *pos != quote) pos++;
-                if (*pos == quote) {
-                    size_t len = pos - start;
-                    char* str = malloc(len + 1);
-                    memcpy(str, start, len);
-                    str[len] = '\0';
-                    php_engine_output(str);
-                    free(str);
-                    pos++;
-                }
-            }
-            continue;
-        }
-
-        // Skip unknown statements
-        while (*pos && *pos != ';' && *pos != '\n') {
-            pos++;
-        }
-        if (*pos == ';') pos++;
+    php_op_array_t* op_array = php_compile_string(code, filename);
+    if (!op_array) {
+        return false;
     }
 
+    bool result = execute_op_array(op_array);
+    php_op_array_destroy(op_array);
+    return result;
+}
+
+// Each execution is one request: whatever it left in the request heap,
+// globals included, goes at once when it ends
+static bool execute_op_array(const php_op_array_t* op_array) {
+    engine_state = PHP_ENGINE_RUNNING;
+    bool result = php_executor_execute(op_array);
+    php_output_end_all();
+    php_variables_reset();
+    php_memory_reset();
     engine_state = PHP_ENGINE_INITIALIZED;
-    return true;
+    return result;
 }
 
 bool php_engine_syntax_check(const char* filename) {
@@ -248,126 +194,568 @@ bool php_engine_syntax_check(const char* filename) {
 }
 
 // Memory management
+_Static_assert(sizeof(php_value_t) == 16, "php_value_t must stay 16 bytes");
+
+// Immortal boxes
+static php_value_t immortal_null = {.type = PHP_TYPE_NULL};
+static php_value_t immortal_false = {.value.bool_val = false, .type = PHP_TYPE_BOOL};
+static php_value_t immortal_true = {.value.bool_val = true, .type = PHP_TYPE_BOOL};
+static php_value_t immortal_small_ints[PHP_SMALL_INT_MAX - PHP_SMALL_INT_MIN + 1];
+
+static php_value_t immortal_empty_string;
+
+static bool is_immortal(const php_value_t* value) {
+    return value == &immortal_null || value == &immortal_false || value == &immortal_true ||
+           value == &immortal_empty_string ||
+           (value >= immortal_small_ints &&
+            value < immortal_small_ints + (PHP_SMALL_INT_MAX - PHP_SMALL_INT_MIN + 1));
+}
+
+static php_value_t* box_alloc(void) {
+    return malloc(sizeof(php_value_t));
+}
+
 php_value_t* php_value_create_null(void) {
-    php_value_t* value = malloc(sizeof(php_value_t));
-    if (!value) return NULL;
-    
-    value->type = PHP_TYPE_NULL;
-    value->refcount = 1;
-    return value;
+    return &immortal_null;
 }
 
 php_value_t* php_value_create_bool(bool val) {
-    php_value_t* value = malloc(sizeof(php_value_t));
-    if (!value) return NULL;
-    
-    value->type = PHP_TYPE_BOOL;
-    value->value.bool_val = val;
-    value->refcount = 1;
-    return value;
+    return val ? &immortal_true : &immortal_false;
 }
 
 php_value_t* php_value_create_int(int64_t val) {
-    php_value_t* value = malloc(sizeof(php_value_t));
+    if (val >= PHP_SMALL_INT_MIN && val <= PHP_SMALL_INT_MAX) {
+        // Filled in on first use
+        php_value_t* value = &immortal_small_ints[val - PHP_SMALL_INT_MIN];
+        if (value->type == PHP_TYPE_UNDEF) {
+            php_value_set_int(value, val);
+        }
+        return value;
+    }
+
+    php_value_t* value = box_alloc();
     if (!value) return NULL;
-    
-    value->type = PHP_TYPE_INT;
-    value->value.int_val = val;
-    value->refcount = 1;
+    php_value_set_int(value, val);
     return value;
 }
 
 php_value_t* php_value_create_float(double val) {
-    php_value_t* value = malloc(sizeof(php_value_t));
+    php_value_t* value = box_alloc();
     if (!value) return NULL;
-    
-    value->type = PHP_TYPE_FLOAT;
-    value->value.float_val = val;
-    value->refcount = 1;
+    php_value_set_float(value, val);
     return value;
 }
 
 php_value_t* php_value_create_string(const char* val) {
     if (!val) return php_value_create_null();
-    
-    php_value_t* value = malloc(sizeof(php_value_t));
-    if (!value) return NULL;
-    
-    value->type = PHP_TYPE_STRING;
-    value->value.string_val = strdup(val);
-    value->refcount = 1;
-    return value;
+    return php_value_create_string_len(val, strlen(val));
 }
 
 php_value_t* php_value_create_string_len(const char* val, size_t length) {
     if (!val) return php_value_create_null();
-    
-    php_value_t* value = malloc(sizeof(php_value_t));
-    if (!value) return NULL;
-    
-    value->type = PHP_TYPE_STRING;
-    value->value.string_val = malloc(length + 1);
-    memcpy(value->value.string_val, val, length);
-    value->value.string_val[length] = '\0';
-    value->refcount = 1;
+    php_string_t* str = php_string_init(val, length);
+    return str ? php_value_create_str(str) : NULL;
+}
+
+php_value_t* php_value_create_str(php_string_t* str) {
+    if (str->len == 0) {
+        php_string_release(str);
+        if (immortal_empty_string.type == PHP_TYPE_UNDEF) {
+            php_value_set_str(&immortal_empty_string, php_string_empty());
+        }
+        return &immortal_empty_string;
+    }
+
+    php_value_t* value = box_alloc();
+    if (!value) {
+        php_string_release(str);
+        return NULL;
+    }
+    php_value_set_str(value, str);
+    return value;
+}
+
+php_value_t* php_value_create_array(php_array_t* array) {
+    php_value_t* value = box_alloc();
+    if (!value) {
+        php_array_free(array);
+        return NULL;
+    }
+    php_value_set_array(value, array);
     return value;
 }
 
 void php_value_destroy(php_value_t* value) {
-    if (!value) return;
-    
-    if (--value->refcount == 0) {
-        if (value->type == PHP_TYPE_STRING && value->value.string_val) {
-            free(value->value.string_val);
+    if (!value || is_immortal(value)) return;
+
+    php_value_release(value);
+    free(value);
+}
+
+php_value_t* php_value_box(const php_value_t* value) {
+    switch (value->type) {
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            return &immortal_null;
+        case PHP_TYPE_BOOL:
+            return php_value_create_bool(value->value.bool_val);
+        case PHP_TYPE_INT:
+            return php_value_create_int(value->value.int_val);
+        default: {
+            php_value_t* box = box_alloc();
+            if (!box) {
+                php_value_release((php_value_t*)value);
+                return NULL;
+            }
+            *box = *value;
+            return box;
         }
-        free(value);
     }
 }
 
-void php_value_ref(php_value_t* value) {
-    if (value) {
-        value->refcount++;
+void php_value_unbox(php_value_t* dest, php_value_t* box) {
+    if (!box) {
+        php_value_set_null(dest);
+        return;
+    }
+
+    *dest = *box;
+    if (is_immortal(box)) {
+        php_value_addref(dest);
+    } else {
+        free(box);
+    }
+}
+
+void php_value_set_string_len(php_value_t* value, const char* str, size_t length) {
+    php_string_t* copy = php_string_init(str, length);
+    if (copy) {
+        php_value_set_str(value, copy);
+    } else {
+        php_value_set_null(value);
     }
 }
 
-void php_value_unref(php_value_t* value) {
-    php_value_destroy(value);
+bool php_value_separate(php_value_t* value) {
+    if (value->type != PHP_TYPE_ARRAY) return true;
+
+    php_array_t* array = value->value.arr;
+    if (array->gc.refcount == 1 && !(array->gc.flags & PHP_GC_IMMORTAL)) return true;
+
+    // Nested arrays stay shared with the original until they are written
+    php_array_t* copy = php_array_dup(array);
+    if (!copy) return false;
+    php_value_release(value);
+    value->value.arr = copy;
+    return true;
+}
+
+// Value conversion
+static bool is_numeric_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
 }
 
-// Variable management
-bool php_engine_set_variable(const char* name, php_value_t* value) {
-    if (!name || !value) return false;
-    
-    // Find existing variable
-    for (size_t i = 0; i < global_vars_count; i++) {
-        if (global_variables[i] && strcmp(global_variables[i]->value.string_val, name) == 0) {
-            php_value_destroy(global_variables[i]);
-            global_variables[i] = value;
+// Parse a numeric prefix the way PHP's numeric strings work. Returns the
+// number type, or PHP_TYPE_NULL without a numeric prefix. *consumed covers
+// leading and trailing whitespace, so it equals length for numeric strings.
+php_type_t php_parse_numeric(const char* str, size_t length, int64_t* lval, double* dval, size_t* consumed) {
+    size_t i = 0;
+    while (i < length && is_numeric_whitespace(str[i])) i++;
+
+    size_t start = i;
+    if (i < length && (str[i] == '+' || str[i] == '-')) i++;
+
+    size_t int_digits = 0;
+    while (i < length && str[i] >= '0' && str[i] <= '9') {
+        i++;
+        int_digits++;
+    }
+
+    bool is_float = false;
+    size_t frac_digits = 0;
+    if (i < length && str[i] == '.') {
+        size_t j = i + 1;
+        while (j < length && str[j] >= '0' && str[j] <= '9') {
+            j++;
+            frac_digits++;
+        }
+        if (int_digits > 0 || frac_digits > 0) {
+            i = j;
+            is_float = true;
+        }
+    }
+
+    if (int_digits == 0 && frac_digits == 0) {
+        *consumed = 0;
+        return PHP_TYPE_NULL;
+    }
+
+    if (i < length && (str[i] == 'e' || str[i] == 'E')) {
+        size_t j = i + 1;
+        if (j < length && (str[j] == '+' || str[j] == '-')) j++;
+        if (j < length && str[j] >= '0' && str[j] <= '9') {
+            while (j < length && str[j] >= '0' && str[j] <= '9') j++;
+            i = j;
+            is_float = true;
+        }
+    }
+
+    size_t end = i;
+    while (i < length && is_numeric_whitespace(str[i])) i++;
+    *consumed = i;
+
+    if (!is_float) {
+        bool negative = str[start] == '-';
+        uint64_t magnitude = 0;
+        bool overflow = false;
+        for (size_t k = start + (str[start] == '+' || str[start] == '-'); k < end; k++) {
+            if (magnitude > (UINT64_MAX - 9) / 10) {
+                overflow = true;
+                break;
+            }
+            magnitude = magnitude * 10 + (uint64_t)(str[k] - '0');
+        }
+        if (!overflow && magnitude <= (uint64_t)INT64_MAX + (negative ? 1 : 0)) {
+            *lval = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+            return PHP_TYPE_INT;
+        }
+    }
+
+    // strtod needs a terminated copy and must not see hex or inf/nan forms
+    char buffer[64];
+    size_t number_len = end - start;
+    char* text = number_len < sizeof(buffer) ? buffer : malloc(number_len + 1);
+    memcpy(text, str + start, number_len);
+    text[number_len] = '\0';
+    *dval = strtod(text, NULL);
+    if (text != buffer) {
+        free(text);
+    }
+    return PHP_TYPE_FLOAT;
+}
+
+int64_t php_dval_to_lval(double value) {
+    if (!isfinite(value)) {
+        return 0;
+    }
+    if (value >= -9223372036854775808.0 && value < 9223372036854775808.0) {
+        return (int64_t)value;
+    }
+    // Out of range values wrap modulo 2^64
+    double two_pow_64 = 18446744073709551616.0;
+    double wrapped = fmod(value, two_pow_64);
+    if (wrapped < 0) {
+        wrapped += two_pow_64;
+    }
+    return (int64_t)(uint64_t)wrapped;
+}
+
+bool php_value_is_true(const php_value_t* value) {
+    if (!value) return false;
+
+    switch (value->type) {
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            return false;
+        case PHP_TYPE_BOOL:
+            return value->value.bool_val;
+        case PHP_TYPE_INT:
+            return value->value.int_val != 0;
+        case PHP_TYPE_FLOAT:
+            return value->value.float_val != 0.0;
+        case PHP_TYPE_STRING: {
+            const php_string_t* str = value->value.str;
+            return !(str->len == 0 || (str->len == 1 && str->val[0] == '0'));
+        }
+        case PHP_TYPE_ARRAY:
+            return php_array_count(value->value.arr) > 0;
+        default:
             return true;
+    }
+}
+
+int64_t php_value_to_int(const php_value_t* value) {
+    if (!value) return 0;
+
+    switch (value->type) {
+        case PHP_TYPE_BOOL:
+            return value->value.bool_val;
+        case PHP_TYPE_INT:
+            return value->value.int_val;
+        case PHP_TYPE_FLOAT:
+            return php_dval_to_lval(value->value.float_val);
+        case PHP_TYPE_STRING: {
+            int64_t lval;
+            double dval;
+            size_t consumed;
+            const php_string_t* str = value->value.str;
+            php_type_t type = php_parse_numeric(str->val, str->len, &lval, &dval, &consumed);
+            if (type == PHP_TYPE_INT) return lval;
+            if (type == PHP_TYPE_FLOAT) return php_dval_to_lval(dval);
+            return 0;
         }
+        case PHP_TYPE_ARRAY:
+            return php_array_count(value->value.arr) > 0;
+        default:
+            return 0;
     }
-    
-    // Add new variable
-    if (global_vars_count >= global_vars_capacity) {
-        global_vars_capacity *= 2;
-        global_variables = realloc(global_variables, global_vars_capacity * sizeof(php_value_t*));
-        if (!global_variables) return false;
+}
+
+double php_value_to_float(const php_value_t* value) {
+    if (!value) return 0.0;
+
+    switch (value->type) {
+        case PHP_TYPE_BOOL:
+            return value->value.bool_val ? 1.0 : 0.0;
+        case PHP_TYPE_INT:
+            return (double)value->value.int_val;
+        case PHP_TYPE_FLOAT:
+            return value->value.float_val;
+        case PHP_TYPE_STRING: {
+            int64_t lval;
+            double dval;
+            size_t consumed;
+            const php_string_t* str = value->value.str;
+            php_type_t type = php_parse_numeric(str->val, str->len, &lval, &dval, &consumed);
+            if (type == PHP_TYPE_INT) return (double)lval;
+            if (type == PHP_TYPE_FLOAT) return dval;
+            return 0.0;
+        }
+        case PHP_TYPE_ARRAY:
+            return php_array_count(value->value.arr) > 0 ? 1.0 : 0.0;
+        default:
+            return 0.0;
     }
-    
-    global_variables[global_vars_count++] = value;
+}
+
+php_string_t* php_value_to_str(const php_value_t* value) {
+    char buffer[PHP_FORMAT_FLOAT_SIZE];
+    size_t len;
+
+    switch (value ? value->type : PHP_TYPE_NULL) {
+        case PHP_TYPE_STRING:
+            return php_string_addref(value->value.str);
+        case PHP_TYPE_BOOL:
+            return value->value.bool_val ? php_string_intern("1", 1) : php_string_empty();
+        case PHP_TYPE_INT:
+            len = php_format_int(value->value.int_val, buffer);
+            break;
+        case PHP_TYPE_FLOAT:
+            len = php_format_float(value->value.float_val, PHP_FORMAT_PRECISION, buffer);
+            break;
+        case PHP_TYPE_ARRAY:
+            return php_string_intern("Array", 5);
+        case PHP_TYPE_OBJECT:
+        case PHP_TYPE_RESOURCE:
+            return php_string_intern("Object", 6);
+        default:
+            return php_string_empty();
+    }
+    return php_string_init(buffer, len);
+}
+
+const char* php_value_type_name(const php_value_t* value) {
+    switch (value ? value->type : PHP_TYPE_NULL) {
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL: return "null";
+        case PHP_TYPE_BOOL: return "bool";
+        case PHP_TYPE_INT: return "int";
+        case PHP_TYPE_FLOAT: return "float";
+        case PHP_TYPE_STRING: return "string";
+        case PHP_TYPE_ARRAY: return "array";
+        case PHP_TYPE_OBJECT: return "object";
+        default: return "resource";
+    }
+}
+
+// Value comparison
+static int compare_doubles(double a, double b) {
+    if (a < b) return -1;
+    if (a > b) return 1;
+    if (a == b) return 0;
+    return 1;  // Unordered (NAN) compares as "not equal and not smaller"
+}
+
+static int compare_strings(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int result = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (result == 0) {
+        return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+    }
+    return result < 0 ? -1 : 1;
+}
+
+// Numeric strings compare as numbers; everything else as strings (PHP 8 rules)
+static int compare_number_string(const php_value_t* number, const php_value_t* string) {
+    int64_t lval;
+    double dval;
+    size_t consumed;
+    const char* str = string->value.str->val;
+    size_t length = string->value.str->len;
+    php_type_t type = php_parse_numeric(str, length, &lval, &dval, &consumed);
+
+    if (type != PHP_TYPE_NULL && consumed == length) {
+        if (number->type == PHP_TYPE_INT && type == PHP_TYPE_INT) {
+            return number->value.int_val < lval ? -1 : (number->value.int_val > lval ? 1 : 0);
+        }
+        double left = number->type == PHP_TYPE_INT ? (double)number->value.int_val : number->value.float_val;
+        return compare_doubles(left, type == PHP_TYPE_INT ? (double)lval : dval);
+    }
+
+    php_string_t* number_str = php_value_to_str(number);
+    int result = compare_strings(number_str->val, number_str->len, str, length);
+    php_string_release(number_str);
+    return result;
+}
+
+// Arrays with fewer elements are smaller; otherwise they compare element
+// by element, and a key missing from b makes them uncomparable
+static int compare_arrays(const php_array_t* a, const php_array_t* b) {
+    if (a == b) return 0;
+    if (a->count != b->count) {
+        return a->count < b->count ? -1 : 1;
+    }
+
+    uint32_t position = 0;
+    php_array_key_t key;
+    php_value_t* element;
+    while ((element = php_array_next(a, &position, &key)) != NULL) {
+        php_value_t* other = php_array_find(b, &key);
+        if (!other) return 1;
+        int result = php_value_compare(element, other);
+        if (result != 0) return result;
+    }
+    return 0;
+}
+
+int php_value_compare(const php_value_t* a, const php_value_t* b) {
+    php_type_t ta = a->type;
+    php_type_t tb = b->type;
+
+    if (ta == PHP_TYPE_INT && tb == PHP_TYPE_INT) {
+        return a->value.int_val < b->value.int_val ? -1 : (a->value.int_val > b->value.int_val ? 1 : 0);
+    }
+    if ((ta == PHP_TYPE_INT || ta == PHP_TYPE_FLOAT) && (tb == PHP_TYPE_INT || tb == PHP_TYPE_FLOAT)) {
+        return compare_doubles(php_value_to_float(a), php_value_to_float(b));
+    }
+    if (ta == PHP_TYPE_STRING && tb == PHP_TYPE_STRING) {
+        const char* sa = a->value.str->val;
+        const char* sb = b->value.str->val;
+        size_t la = a->value.str->len;
+        size_t lb = b->value.str->len;
+        int64_t l1, l2;
+        double d1, d2;
+        size_t c1, c2;
+        php_type_t n1 = php_parse_numeric(sa, la, &l1, &d1, &c1);
+        php_type_t n2 = php_parse_numeric(sb, lb, &l2, &d2, &c2);
+        if (n1 != PHP_TYPE_NULL && n2 != PHP_TYPE_NULL && c1 == la && c2 == lb) {
+            if (n1 == PHP_TYPE_INT && n2 == PHP_TYPE_INT) {
+                return l1 < l2 ? -1 : (l1 > l2 ? 1 : 0);
+            }
+            return compare_doubles(n1 == PHP_TYPE_INT ? (double)l1 : d1, n2 == PHP_TYPE_INT ? (double)l2 : d2);
+        }
+        return compare_strings(sa, la, sb, lb);
+    }
+    if (ta == PHP_TYPE_NULL && tb == PHP_TYPE_STRING) {
+        return b->value.str->len == 0 ? 0 : -1;
+    }
+    if (ta == PHP_TYPE_STRING && tb == PHP_TYPE_NULL) {
+        return a->value.str->len == 0 ? 0 : 1;
+    }
+    if (ta == PHP_TYPE_BOOL || tb == PHP_TYPE_BOOL || ta == PHP_TYPE_NULL || tb == PHP_TYPE_NULL) {
+        bool ba = php_value_is_true(a);
+        bool bb = php_value_is_true(b);
+        return ba == bb ? 0 : (ba ? 1 : -1);
+    }
+    if ((ta == PHP_TYPE_INT || ta == PHP_TYPE_FLOAT) && tb == PHP_TYPE_STRING) {
+        return compare_number_string(a, b);
+    }
+    if (ta == PHP_TYPE_STRING && (tb == PHP_TYPE_INT || tb == PHP_TYPE_FLOAT)) {
+        return -compare_number_string(b, a);
+    }
+
+    if (ta == PHP_TYPE_ARRAY && tb == PHP_TYPE_ARRAY) {
+        return compare_arrays(a->value.arr, b->value.arr);
+    }
+
+    // Arrays and objects are uncomparable with scalars and always greater
+    return ta == tb ? 0 : (ta > tb ? 1 : -1);
+}
+
+// Same key/value pairs in the same order, with identical values
+static bool identical_arrays(const php_array_t* a, const php_array_t* b) {
+    if (a == b) return true;
+    if (a->count != b->count) return false;
+
+    uint32_t position_a = 0;
+    uint32_t position_b = 0;
+    php_array_key_t key_a;
+    php_array_key_t key_b;
+    php_value_t* element_a;
+    while ((element_a = php_array_next(a, &position_a, &key_a)) != NULL) {
+        php_value_t* element_b = php_array_next(b, &position_b, &key_b);
+        if (!element_b) return false;
+        if (key_a.str ? !key_b.str || !php_string_equals(key_a.str, key_b.str)
+                      : key_b.str || key_a.index != key_b.index) {
+            return false;
+        }
+        if (!php_value_identical(element_a, element_b)) return false;
+    }
+    return true;
+}
+
+bool php_value_identical(const php_value_t* a, const php_value_t* b) {
+    if (a->type != b->type) {
+        return false;
+    }
+
+    switch (a->type) {
+        case PHP_TYPE_NULL:
+            return true;
+        case PHP_TYPE_BOOL:
+            return a->value.bool_val == b->value.bool_val;
+        case PHP_TYPE_INT:
+            return a->value.int_val == b->value.int_val;
+        case PHP_TYPE_FLOAT:
+            return a->value.float_val == b->value.float_val;
+        case PHP_TYPE_STRING:
+            return php_string_equals(a->value.str, b->value.str);
+        case PHP_TYPE_ARRAY:
+            return identical_arrays(a->value.arr, b->value.arr);
+        default:
+            return a->value.object_val == b->value.object_val;
+    }
+}
+
+// Variable management; the engine API always works on the global scope
+bool php_engine_set_variable(const char* name, php_value_t* value) {
+    if (!name || !value) return false;
+
+    php_variable_t* var = php_symbol_table_add(php_variables_globals(), name, strlen(name));
+    if (!var) {
+        php_value_destroy(value);
+        return false;
+    }
+
+    php_value_release(&var->value);
+    php_value_unbox(&var->value, value);
     return true;
 }
 
 php_value_t* php_engine_get_variable(const char* name) {
     if (!name) return NULL;
-    
-    for (size_t i = 0; i < global_vars_count; i++) {
-        if (global_variables[i] && strcmp(global_variables[i]->value.string_val, name) == 0) {
-            return global_variables[i];
-        }
-    }
-    
-    return NULL;
+
+    php_variable_t* var = php_symbol_table_find(php_variables_globals(), name, strlen(name));
+    return var && var->value.type != PHP_TYPE_UNDEF ? &var->value : NULL;
+}
+
+bool php_engine_unset_variable(const char* name) {
+    if (!name) return false;
+
+    php_variable_t* var = php_symbol_table_find(php_variables_globals(), name, strlen(name));
+    if (!var || var->value.type == PHP_TYPE_UNDEF) return false;
+
+    php_variable_unset_slot(var);
+    return true;
 }
 
 // Output functions
@@ -377,33 +765,68 @@ void php_engine_output(const char* str) {
 }
 
 void php_engine_output_len(const char* str, size_t length) {
-    if (!str) return;
-    
-    wasi_ciovec_t iov = {(uint8_t*)str, length};
-    size_t nwritten;
-    wasi_fd_write(WASI_STDOUT_FD, &iov, 1, &nwritten);
+    php_output_write(str, length);
 }
 
+// Numbers are formatted in place at the end of the output when it has room
 void php_engine_output_int(int64_t value) {
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
-    php_engine_output(buffer);
+    char* out = php_output_reserve(PHP_FORMAT_INT_SIZE);
+    if (out) {
+        php_output_commit(php_format_int(value, out));
+        return;
+    }
+    char buffer[PHP_FORMAT_INT_SIZE];
+    php_output_write(buffer, php_format_int(value, buffer));
 }
 
 void php_engine_output_float(double value) {
-    char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%.6g", value);
-    php_engine_output(buffer);
+    char* out = php_output_reserve(PHP_FORMAT_FLOAT_SIZE);
+    if (out) {
+        php_output_commit(php_format_float(value, PHP_FORMAT_PRECISION, out));
+        return;
+    }
+    char buffer[PHP_FORMAT_FLOAT_SIZE];
+    php_output_write(buffer, php_format_float(value, PHP_FORMAT_PRECISION, buffer));
 }
 
 void php_engine_output_bool(bool value) {
     php_engine_output(value ? "1" : "");
 }
 
+void php_engine_output_value(const php_value_t* value) {
+    if (!value) return;
+
+    switch (value->type) {
+        case PHP_TYPE_STRING:
+            php_engine_output_len(value->value.str->val, value->value.str->len);
+            break;
+        case PHP_TYPE_INT:
+            php_engine_output_int(value->value.int_val);
+            break;
+        case PHP_TYPE_FLOAT:
+            php_engine_output_float(value->value.float_val);
+            break;
+        case PHP_TYPE_BOOL:
+            php_engine_output_bool(value->value.bool_val);
+            break;
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            break;
+        default: {
+            php_string_t* str = php_value_to_str(value);
+            php_engine_output_len(str->val, str->len);
+            php_string_release(str);
+            break;
+        }
+    }
+}
+
 // Error handling
 void php_engine_error(const char* message) {
     if (!message) return;
-    
+
+    // Send pending output first so the two streams stay in order
+    php_output_flush();
     wasi_ciovec_t iov = {(uint8_t*)message, strlen(message)};
     size_t nwritten;
     wasi_fd_write(WASI_STDERR_FD, &iov, 1, &nwritten);
@@ -420,25 +843,7 @@ void php_engine_notice(const char* message) {
 // Built-in function implementations
 php_value_t* php_function_echo(int argc, php_value_t** argv) {
     for (int i = 0; i < argc; i++) {
-        if (argv[i]) {
-            switch (argv[i]->type) {
-                case PHP_TYPE_STRING:
-                    php_engine_output(argv[i]->value.string_val);
-                    break;
-                case PHP_TYPE_INT:
-                    php_engine_output_int(argv[i]->value.int_val);
-                    break;
-                case PHP_TYPE_FLOAT:
-                    php_engine_output_float(argv[i]->value.float_val);
-                    break;
-                case PHP_TYPE_BOOL:
-                    php_engine_output_bool(argv[i]->value.bool_val);
-                    break;
-                default:
-                    php_engine_output("NULL");
-                    break;
-            }
-        }
+        php_engine_output_value(argv[i]);
     }
     return php_value_create_null();
 }
@@ -455,55 +860,1086 @@ php_value_t* php_function_strlen(int argc, php_value_t** argv) {
         return php_value_create_int(0);
     }
     
-    return php_value_create_int(strlen(argv[0]->value.string_val));
+    return php_value_create_int((int64_t)argv[0]->value.str->len);
 }
 
-// Register built-in functions
-static void register_builtin_functions(void) {
-    php_function_t functions[] = {
-        {"echo", php_function_echo, 1, -1},
-        {"print", php_function_print, 1, 1},
-        {"strlen", php_function_strlen, 1, 1},
-        {NULL, NULL, 0, 0}
-    };
-    
-    for (int i = 0; functions[i].name; i++) {
-        php_engine_register_function(&functions[i]);
+// ASCII-only, like PHP 8 whatever the locale. Scalars convert to strings.
+static php_value_t* change_case(const char* func, const php_value_t* value, bool upper) {
+    if (value->type == PHP_TYPE_ARRAY) {
+        php_executor_warning("%s(): Argument #1 ($string) must be of type string, array given", func);
+        return php_value_create_null();
     }
-}
+    php_string_t* str = php_value_to_str(value);
+    if (!str) return php_value_create_null();
 
-bool php_engine_register_function(const php_function_t* func) {
-    if (!func || !func->name || !func->callback) {
-        return false;
+    size_t i = 0;
+    while (i < str->len && !(upper ? (str->val[i] >= 'a' && str->val[i] <= 'z')
+                                   : (str->val[i] >= 'A' && str->val[i] <= 'Z'))) {
+        i++;
     }
-    
-    if (functions_count >= functions_capacity) {
-        functions_capacity *= 2;
-        registered_functions = realloc(registered_functions, functions_capacity * sizeof(php_function_t));
-        if (!registered_functions) return false;
+    if (i == str->len) {
+        return php_value_create_str(str);
     }
-    
-    registered_functions[functions_count].name = strdup(func->name);
-    registered_functions[functions_count].callback = func->callback;
-    registered_functions[functions_count].min_args = func->min_args;
-    registered_functions[functions_count].max_args = func->max_args;
-    functions_count++;
-    
-    return true;
-}
 
-php_value_t* php_engine_call_function(const char* name, int argc, php_value_t** argv) {
-    if (!name) return NULL;
-    
-    for (size_t i = 0; i < functions_count; i++) {
-        if (strcmp(registered_functions[i].name, name) == 0) {
-            if (argc < registered_functions[i].min_args || 
-                (registered_functions[i].max_args > 0 && argc > registered_functions[i].max_args)) {
-                return NULL;
+    php_string_t* result = php_string_init(str->val, str->len);
+    php_string_release(str);
+    if (!result) return php_value_create_null();
+    for (; i < result->len; i++) {
+        char c = result->val[i];
+        if (upper && c >= 'a' && c <= 'z') {
+            result->val[i] = (char)(c - ('a' - 'A'));
+        } else if (!upper && c >= 'A' && c <= 'Z') {
+            result->val[i] = (char)(c + ('a' - 'A'));
+        }
+    }
+    return php_value_create_str(result);
+}
+
+php_value_t* php_function_strtolower(int argc, php_value_t** argv) {
+    (void)argc;
+    return change_case("strtolower", argv[0], false);
+}
+
+php_value_t* php_function_strtoupper(int argc, php_value_t** argv) {
+    (void)argc;
+    return change_case("strtoupper", argv[0], true);
+}
+
+// PHP throws a TypeError for an array; builtins cannot, so they warn and
+// bail out. Other scalars convert. Returns a reference for the caller.
+static php_string_t* expect_string(const char* func, int position, const char* param, const php_value_t* value) {
+    if (value->type == PHP_TYPE_ARRAY) {
+        php_executor_warning("%s(): Argument #%d ($%s) must be of type string, array given", func, position, param);
+        return NULL;
+    }
+    return php_value_to_str(value);
+}
+
+php_value_t* php_function_phpversion(int argc, php_value_t** argv) {
+    (void)argv;
+    // Extensions have no versions of their own
+    return argc > 0 ? php_value_create_bool(false) : php_value_create_string(PHP_VERSION);
+}
+
+// Characters to strip, with "a..z" ranges as in PHP
+static void trim_mask(const php_string_t* chars, bool mask[256]) {
+    memset(mask, 0, 256 * sizeof(bool));
+    for (size_t i = 0; i < chars->len; i++) {
+        unsigned char c = (unsigned char)chars->val[i];
+        if (i + 3 < chars->len && chars->val[i + 1] == '.' && chars->val[i + 2] == '.' &&
+            (unsigned char)chars->val[i + 3] >= c) {
+            for (unsigned k = c; k <= (unsigned char)chars->val[i + 3]; k++) {
+                mask[k] = true;
+            }
+            i += 3;
+        } else {
+            mask[c] = true;
+        }
+    }
+}
+
+php_value_t* php_function_trim(int argc, php_value_t** argv) {
+    php_string_t* str = expect_string("trim", 1, "string", argv[0]);
+    if (!str) return php_value_create_null();
+
+    bool mask[256];
+    if (argc > 1) {
+        php_string_t* chars = expect_string("trim", 2, "characters", argv[1]);
+        if (!chars) {
+            php_string_release(str);
+            return php_value_create_null();
+        }
+        trim_mask(chars, mask);
+        php_string_release(chars);
+    } else {
+        memset(mask, 0, sizeof(mask));
+        mask[' '] = mask['\n'] = mask['\r'] = mask['\t'] = mask['\v'] = mask['\0'] = true;
+    }
+
+    size_t start = 0;
+    size_t end = str->len;
+    while (start < end && mask[(unsigned char)str->val[start]]) start++;
+    while (end > start && mask[(unsigned char)str->val[end - 1]]) end--;
+    if (start == 0 && end == str->len) {
+        return php_value_create_str(str);
+    }
+
+    php_string_t* result = php_string_init(str->val + start, end - start);
+    php_string_release(str);
+    return result ? php_value_create_str(result) : NULL;
+}
+
+php_value_t* php_function_strpos(int argc, php_value_t** argv) {
+    php_string_t* haystack = expect_string("strpos", 1, "haystack", argv[0]);
+    php_string_t* needle = haystack ? expect_string("strpos", 2, "needle", argv[1]) : NULL;
+    if (!needle) {
+        if (haystack) php_string_release(haystack);
+        return php_value_create_null();
+    }
+
+    // A negative offset counts from the end
+    int64_t offset = argc > 2 ? php_value_to_int(argv[2]) : 0;
+    if (offset < 0) {
+        offset += (int64_t)haystack->len;
+    }
+
+    php_value_t* result;
+    if (offset < 0 || offset > (int64_t)haystack->len) {
+        php_executor_warning("strpos(): Argument #3 ($offset) must be contained in argument #1 ($haystack)");
+        result = php_value_create_bool(false);
+    } else {
+        result = NULL;
+        for (size_t i = (size_t)offset; i + needle->len <= haystack->len; i++) {
+            if (memcmp(haystack->val + i, needle->val, needle->len) == 0) {
+                result = php_value_create_int((int64_t)i);
+                break;
+            }
+        }
+        if (!result) {
+            result = php_value_create_bool(false);
+        }
+    }
+    php_string_release(haystack);
+    php_string_release(needle);
+    return result;
+}
+
+php_value_t* php_function_substr(int argc, php_value_t** argv) {
+    php_string_t* str = expect_string("substr", 1, "string", argv[0]);
+    if (!str) return php_value_create_null();
+
+    // Negative offsets and lengths count from the end; out of range
+    // offsets give an empty string
+    int64_t length = (int64_t)str->len;
+    int64_t start = php_value_to_int(argv[1]);
+    if (start < 0) {
+        start = start + length < 0 ? 0 : start + length;
+    } else if (start > length) {
+        start = length;
+    }
+    int64_t count = length - start;
+    if (argc > 2 && argv[2]->type != PHP_TYPE_NULL) {
+        int64_t requested = php_value_to_int(argv[2]);
+        if (requested < 0) {
+            count = count + requested < 0 ? 0 : count + requested;
+        } else if (requested < count) {
+            count = requested;
+        }
+    }
+    if (start == 0 && count == length) {
+        return php_value_create_str(str);
+    }
+
+    php_string_t* result = php_string_init(str->val + start, (size_t)count);
+    php_string_release(str);
+    return result ? php_value_create_str(result) : NULL;
+}
+
+php_value_t* php_function_is_string(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_STRING);
+}
+
+php_value_t* php_function_is_int(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_INT);
+}
+
+php_value_t* php_function_is_float(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_FLOAT);
+}
+
+php_value_t* php_function_is_bool(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_BOOL);
+}
+
+php_value_t* php_function_is_null(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_NULL);
+}
+
+// Numbers, and strings PHP would read as one whole number, allowing
+// surrounding whitespace
+php_value_t* php_function_is_numeric(int argc, php_value_t** argv) {
+    (void)argc;
+    const php_value_t* value = argv[0];
+    if (value->type == PHP_TYPE_INT || value->type == PHP_TYPE_FLOAT) {
+        return php_value_create_bool(true);
+    }
+    if (value->type != PHP_TYPE_STRING) {
+        return php_value_create_bool(false);
+    }
+    int64_t lval;
+    double dval;
+    size_t consumed;
+    php_type_t type = php_parse_numeric(value->value.str->val, value->value.str->len, &lval, &dval, &consumed);
+    return php_value_create_bool(type != PHP_TYPE_NULL && consumed == value->value.str->len);
+}
+
+// The historical names, unlike the ones in error messages
+php_value_t* php_function_gettype(int argc, php_value_t** argv) {
+    (void)argc;
+    const char* name;
+    switch (argv[0]->type) {
+        case PHP_TYPE_NULL: name = "NULL"; break;
+        case PHP_TYPE_BOOL: name = "boolean"; break;
+        case PHP_TYPE_INT: name = "integer"; break;
+        case PHP_TYPE_FLOAT: name = "double"; break;
+        case PHP_TYPE_STRING: name = "string"; break;
+        case PHP_TYPE_ARRAY: name = "array"; break;
+        case PHP_TYPE_OBJECT: name = "object"; break;
+        default: name = "resource"; break;
+    }
+    return php_value_create_string(name);
+}
+
+// var_dump() output for one value, nested values indented two more spaces
+static void dump_value(const php_value_t* value, int indent) {
+    char buffer[96];
+    for (int i = 0; i < indent; i++) {
+        php_engine_output_len(" ", 1);
+    }
+
+    switch (value->type) {
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            php_engine_output("NULL\n");
+            break;
+        case PHP_TYPE_BOOL:
+            php_engine_output(value->value.bool_val ? "bool(true)\n" : "bool(false)\n");
+            break;
+        case PHP_TYPE_INT:
+            php_engine_output("int(");
+            php_engine_output_int(value->value.int_val);
+            php_engine_output(")\n");
+            break;
+        case PHP_TYPE_FLOAT: {
+            size_t length = php_format_float(value->value.float_val, 0, buffer);
+            php_engine_output("float(");
+            php_engine_output_len(buffer, length);
+            php_engine_output(")\n");
+            break;
+        }
+        case PHP_TYPE_STRING:
+            snprintf(buffer, sizeof(buffer), "string(%zu) \"", value->value.str->len);
+            php_engine_output(buffer);
+            php_engine_output_len(value->value.str->val, value->value.str->len);
+            php_engine_output("\"\n");
+            break;
+        case PHP_TYPE_ARRAY: {
+            const php_array_t* array = value->value.arr;
+            snprintf(buffer, sizeof(buffer), "array(%u) {\n", php_array_count(array));
+            php_engine_output(buffer);
+
+            uint32_t position = 0;
+            php_array_key_t key;
+            php_value_t* element;
+            while ((element = php_array_next(array, &position, &key)) != NULL) {
+                for (int i = 0; i < indent + 2; i++) {
+                    php_engine_output_len(" ", 1);
+                }
+                if (key.str) {
+                    php_engine_output("[\"");
+                    php_engine_output_len(key.str->val, key.str->len);
+                    php_engine_output("\"]=>\n");
+                } else {
+                    php_engine_output("[");
+                    php_engine_output_int(key.index);
+                    php_engine_output("]=>\n");
+                }
+                dump_value(element, indent + 2);
+            }
+
+            for (int i = 0; i < indent; i++) {
+                php_engine_output_len(" ", 1);
+            }
+            php_engine_output("}\n");
+            break;
+        }
+        default:
+            php_engine_output(value->type == PHP_TYPE_OBJECT ? "object\n" : "resource\n");
+            break;
+    }
+}
+
+php_value_t* php_function_var_dump(int argc, php_value_t** argv) {
+    for (int i = 0; i < argc; i++) {
+        dump_value(argv[i], 0);
+    }
+    return php_value_create_null();
+}
+
+// ---------------------------------------------------------------------------
+// Array functions
+// ---------------------------------------------------------------------------
+
+// PHP throws a TypeError here; builtins cannot, so they warn and bail out
+static bool expect_array(const char* func, int position, const char* param, const php_value_t* value) {
+    if (value->type == PHP_TYPE_ARRAY) {
+        return true;
+    }
+    php_executor_warning("%s(): Argument #%d ($%s) must be of type array, %s given",
+                         func, position, param, php_value_type_name(value));
+    return false;
+}
+
+static uint32_t count_recursive(const php_array_t* array) {
+    uint32_t count = php_array_count(array);
+    uint32_t position = 0;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, NULL)) != NULL) {
+        if (element->type == PHP_TYPE_ARRAY) {
+            count += count_recursive(element->value.arr);
+        }
+    }
+    return count;
+}
+
+php_value_t* php_function_count(int argc, php_value_t** argv) {
+    if (argv[0]->type != PHP_TYPE_ARRAY) {
+        php_executor_warning("count(): Argument #1 ($value) must be of type Countable|array, %s given",
+                             php_value_type_name(argv[0]));
+        return php_value_create_int(0);
+    }
+
+    bool recursive = argc > 1 && php_value_to_int(argv[1]) == 1;
+    const php_array_t* array = argv[0]->value.arr;
+    return php_value_create_int(recursive ? count_recursive(array) : php_array_count(array));
+}
+
+php_value_t* php_function_is_array(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_bool(argv[0]->type == PHP_TYPE_ARRAY);
+}
+
+php_value_t* php_function_array_push(int argc, php_value_t** argv) {
+    if (!expect_array("array_push", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    // In place unless the array is shared with another variable
+    if (!php_value_separate(argv[0])) return NULL;
+    php_array_t* array = argv[0]->value.arr;
+    for (int i = 1; i < argc; i++) {
+        php_value_t* slot = php_array_append(array);
+        if (!slot) {
+            php_executor_warning("Cannot add element to the array as the next element is already occupied");
+            return php_value_create_bool(false);
+        }
+        php_value_copy(slot, argv[i]);
+    }
+    return php_value_create_int(php_array_count(array));
+}
+
+php_value_t* php_function_array_pop(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("array_pop", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    if (!php_value_separate(argv[0])) return NULL;
+    php_value_t value;
+    if (!php_array_pop(argv[0]->value.arr, &value)) {
+        return php_value_create_null();
+    }
+    return php_value_box(&value);
+}
+
+php_value_t* php_function_array_keys(int argc, php_value_t** argv) {
+    if (!expect_array("array_keys", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    // With a filter value only the keys of matching elements are returned
+    const php_value_t* filter = argc > 1 ? argv[1] : NULL;
+    bool strict = argc > 2 && php_value_is_true(argv[2]);
+    const php_array_t* array = argv[0]->value.arr;
+    php_array_t* keys = php_array_new(filter ? 0 : php_array_count(array));
+    if (!keys) return NULL;
+
+    uint32_t position = 0;
+    php_array_key_t key;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, &key)) != NULL) {
+        if (filter && !(strict ? php_value_identical(element, filter) : php_value_compare(element, filter) == 0)) {
+            continue;
+        }
+        php_value_t* slot = php_array_append(keys);
+        if (!slot) break;
+        if (key.str) {
+            php_value_set_str(slot, php_string_addref(key.str));
+        } else {
+            php_value_set_int(slot, key.index);
+        }
+    }
+    return php_value_create_array(keys);
+}
+
+php_value_t* php_function_array_values(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("array_values", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    // A list without holes is its own result
+    const php_array_t* array = argv[0]->value.arr;
+    if ((array->flags & PHP_ARRAY_PACKED) && array->count == array->used) {
+        php_value_t same;
+        php_value_copy(&same, argv[0]);
+        return php_value_box(&same);
+    }
+
+    php_array_t* values = php_array_new(php_array_count(array));
+    if (!values) return NULL;
+
+    uint32_t position = 0;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, NULL)) != NULL) {
+        php_value_t* slot = php_array_append(values);
+        if (!slot) break;
+        php_value_copy(slot, element);
+    }
+    return php_value_create_array(values);
+}
+
+// Integer keys are renumbered, later string keys overwrite earlier ones
+php_value_t* php_function_array_merge(int argc, php_value_t** argv) {
+    for (int i = 0; i < argc; i++) {
+        if (!expect_array("array_merge", i + 1, "arrays", argv[i])) {
+            return php_value_create_null();
+        }
+    }
+
+    uint32_t capacity = 0;
+    for (int i = 0; i < argc; i++) {
+        capacity += php_array_count(argv[i]->value.arr);
+    }
+    php_array_t* merged = php_array_new(capacity);
+    if (!merged) return NULL;
+
+    for (int i = 0; i < argc; i++) {
+        uint32_t position = 0;
+        php_array_key_t key;
+        php_value_t* element;
+        while ((element = php_array_next(argv[i]->value.arr, &position, &key)) != NULL) {
+            php_value_t* slot = key.str ? php_array_lookup(merged, &key) : php_array_append(merged);
+            if (!slot) continue;
+            php_value_release(slot);
+            php_value_copy(slot, element);
+        }
+    }
+    return php_value_create_array(merged);
+}
+
+php_value_t* php_function_in_array(int argc, php_value_t** argv) {
+    if (!expect_array("in_array", 2, "haystack", argv[1])) {
+        return php_value_create_null();
+    }
+
+    bool strict = argc > 2 && php_value_is_true(argv[2]);
+    uint32_t position = 0;
+    php_value_t* element;
+    while ((element = php_array_next(argv[1]->value.arr, &position, NULL)) != NULL) {
+        if (strict ? php_value_identical(element, argv[0]) : php_value_compare(element, argv[0]) == 0) {
+            return php_value_create_bool(true);
+        }
+    }
+    return php_value_create_bool(false);
+}
+
+php_value_t* php_function_array_key_exists(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("array_key_exists", 2, "array", argv[1])) {
+        return php_value_create_null();
+    }
+
+    php_array_key_t key;
+    if (!php_array_key_from_value(argv[0], &key)) {
+        php_executor_warning("array_key_exists(): Argument #1 ($key) must be a valid array offset type");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(php_array_find(argv[1]->value.arr, &key) != NULL);
+}
+
+// Elements converted to strings and joined by the separator. The
+// separator may be left out; PHP 8 no longer takes it after the array.
+php_value_t* php_function_implode(int argc, php_value_t** argv) {
+    const php_value_t* pieces = argv[argc > 1 ? 1 : 0];
+    if (!expect_array("implode", argc > 1 ? 2 : 1, argc > 1 ? "array" : "separator", pieces)) {
+        return php_value_create_null();
+    }
+    php_string_t* separator = argc > 1 ? expect_string("implode", 1, "separator", argv[0]) : php_string_empty();
+    if (!separator) return php_value_create_null();
+
+    const php_array_t* array = pieces->value.arr;
+    uint32_t count = php_array_count(array);
+    php_string_t** parts = malloc((count ? count : 1) * sizeof(php_string_t*));
+    if (!parts) {
+        php_string_release(separator);
+        return NULL;
+    }
+
+    uint32_t position = 0;
+    uint32_t n = 0;
+    size_t length = 0;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, NULL)) != NULL) {
+        php_string_t* part = php_value_to_str(element);
+        if (!part) continue;
+        length += part->len + (n > 0 ? separator->len : 0);
+        parts[n++] = part;
+    }
+
+    php_string_t* result = php_string_alloc(length);
+    char* out = result ? result->val : NULL;
+    for (uint32_t i = 0; i < n; i++) {
+        if (out) {
+            if (i > 0) {
+                memcpy(out, separator->val, separator->len);
+                out += separator->len;
             }
-            return registered_functions[i].callback(argc, argv);
+            memcpy(out, parts[i]->val, parts[i]->len);
+            out += parts[i]->len;
+        }
+        php_string_release(parts[i]);
+    }
+    free(parts);
+    php_string_release(separator);
+    return result ? php_value_create_str(result) : NULL;
+}
+
+// The number a value counts as in arithmetic: numeric strings and their
+// numeric prefixes, then booleans and null as integers
+static void to_number(const php_value_t* value, php_value_t* number) {
+    if (value->type == PHP_TYPE_FLOAT) {
+        php_value_set_float(number, value->value.float_val);
+        return;
+    }
+    if (value->type == PHP_TYPE_STRING) {
+        int64_t lval = 0;
+        double dval;
+        size_t consumed;
+        if (php_parse_numeric(value->value.str->val, value->value.str->len, &lval, &dval, &consumed) ==
+            PHP_TYPE_FLOAT) {
+            php_value_set_float(number, dval);
+            return;
+        }
+        php_value_set_int(number, lval);
+        return;
+    }
+    php_value_set_int(number, php_value_to_int(value));
+}
+
+// Integers overflow into floats, as with +
+php_value_t* php_function_array_sum(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("array_sum", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    php_value_t sum;
+    php_value_set_int(&sum, 0);
+    uint32_t position = 0;
+    php_value_t* element;
+    while ((element = php_array_next(argv[0]->value.arr, &position, NULL)) != NULL) {
+        if (element->type == PHP_TYPE_ARRAY) {
+            php_executor_warning("array_sum(): Addition is not supported on type array");
+            continue;
+        }
+        php_value_t number;
+        to_number(element, &number);
+        int64_t total;
+        if (sum.type == PHP_TYPE_INT && number.type == PHP_TYPE_INT &&
+            !__builtin_add_overflow(sum.value.int_val, number.value.int_val, &total)) {
+            php_value_set_int(&sum, total);
+        } else {
+            double left = sum.type == PHP_TYPE_INT ? (double)sum.value.int_val : sum.value.float_val;
+            double right = number.type == PHP_TYPE_INT ? (double)number.value.int_val : number.value.float_val;
+            php_value_set_float(&sum, left + right);
+        }
+    }
+    return php_value_box(&sum);
+}
+
+// The largest (or smallest) of the arguments, or of the one array given;
+// the first of equal ones wins
+static php_value_t* extreme(const char* func, int argc, php_value_t** argv, int sign) {
+    const php_value_t* best = NULL;
+    if (argc == 1) {
+        if (!expect_array(func, 1, "value", argv[0])) {
+            return php_value_create_bool(false);
+        }
+        uint32_t position = 0;
+        php_value_t* element;
+        while ((element = php_array_next(argv[0]->value.arr, &position, NULL)) != NULL) {
+            if (!best || php_value_compare(element, best) * sign > 0) {
+                best = element;
+            }
+        }
+        if (!best) {
+            php_executor_warning("%s(): Argument #1 ($value) must contain at least one element", func);
+            return php_value_create_bool(false);
+        }
+    } else {
+        for (int i = 0; i < argc; i++) {
+            if (!best || php_value_compare(argv[i], best) * sign > 0) {
+                best = argv[i];
+            }
+        }
+    }
+    return php_value_box(best);
+}
+
+php_value_t* php_function_max(int argc, php_value_t** argv) {
+    return extreme("max", argc, argv, 1);
+}
+
+php_value_t* php_function_min(int argc, php_value_t** argv) {
+    return extreme("min", argc, argv, -1);
+}
+
+// Stable merge sort of element pointers, as PHP 8's sort is stable
+static void sort_values(php_value_t** values, php_value_t** scratch, uint32_t count) {
+    if (count < 2) return;
+    uint32_t half = count / 2;
+    sort_values(values, scratch, half);
+    sort_values(values + half, scratch, count - half);
+
+    uint32_t left = 0;
+    uint32_t right = half;
+    uint32_t out = 0;
+    while (left < half && right < count) {
+        scratch[out++] = php_value_compare(values[right], values[left]) < 0 ? values[right++] : values[left++];
+    }
+    while (left < half) scratch[out++] = values[left++];
+    while (right < count) scratch[out++] = values[right++];
+    memcpy(values, scratch, count * sizeof(php_value_t*));
+}
+
+// Values in ascending order, renumbered from 0
+php_value_t* php_function_sort(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("sort", 1, "array", argv[0])) {
+        return php_value_create_bool(false);
+    }
+
+    const php_array_t* array = argv[0]->value.arr;
+    uint32_t count = php_array_count(array);
+    php_value_t** values = malloc(2 * (size_t)(count ? count : 1) * sizeof(php_value_t*));
+    php_array_t* sorted = values ? php_array_new(count) : NULL;
+    if (!sorted) {
+        free(values);
+        return NULL;
+    }
+
+    uint32_t position = 0;
+    uint32_t n = 0;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, NULL)) != NULL) {
+        values[n++] = element;
+    }
+    sort_values(values, values + count, n);
+    for (uint32_t i = 0; i < n; i++) {
+        php_value_t* slot = php_array_append(sorted);
+        if (!slot) break;
+        php_value_copy(slot, values[i]);
+    }
+    free(values);
+
+    php_value_release(argv[0]);
+    php_value_set_array(argv[0], sorted);
+    return php_value_create_bool(true);
+}
+
+// The first element of each distinct string value, keys kept
+php_value_t* php_function_array_unique(int argc, php_value_t** argv) {
+    (void)argc;
+    if (!expect_array("array_unique", 1, "array", argv[0])) {
+        return php_value_create_null();
+    }
+
+    const php_array_t* array = argv[0]->value.arr;
+    php_array_t* seen = php_array_new(php_array_count(array));
+    php_array_t* unique = seen ? php_array_new(php_array_count(array)) : NULL;
+    if (!unique) {
+        if (seen) php_array_free(seen);
+        return NULL;
+    }
+
+    uint32_t position = 0;
+    php_array_key_t key;
+    php_value_t* element;
+    while ((element = php_array_next(array, &position, &key)) != NULL) {
+        php_string_t* str = php_value_to_str(element);
+        if (!str) continue;
+        php_value_t text;
+        php_value_set_str(&text, str);
+        php_array_key_t text_key;
+        bool duplicate = php_array_key_from_value(&text, &text_key) && php_array_find(seen, &text_key);
+        if (!duplicate) {
+            php_value_t* mark = php_array_lookup(seen, &text_key);
+            php_value_t* slot = mark ? php_array_lookup(unique, &key) : NULL;
+            if (slot) {
+                php_value_release(slot);
+                php_value_copy(slot, element);
+            }
+        }
+        php_value_release(&text);
+    }
+    php_array_free(seen);
+    return php_value_create_array(unique);
+}
+
+// ---------------------------------------------------------------------------
+// Math functions
+// ---------------------------------------------------------------------------
+
+php_value_t* php_function_abs(int argc, php_value_t** argv) {
+    (void)argc;
+    php_value_t number;
+    to_number(argv[0], &number);
+    if (number.type == PHP_TYPE_FLOAT) {
+        return php_value_create_float(fabs(number.value.float_val));
+    }
+    // The one integer without a positive counterpart becomes a float
+    if (number.value.int_val == INT64_MIN) {
+        return php_value_create_float(-(double)INT64_MIN);
+    }
+    return php_value_create_int(number.value.int_val < 0 ? -number.value.int_val : number.value.int_val);
+}
+
+php_value_t* php_function_sqrt(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_float(sqrt(php_value_to_float(argv[0])));
+}
+
+// Integer powers stay integers until they overflow, as with **
+php_value_t* php_function_pow(int argc, php_value_t** argv) {
+    (void)argc;
+    php_value_t base;
+    php_value_t exponent;
+    to_number(argv[0], &base);
+    to_number(argv[1], &exponent);
+
+    if (base.type == PHP_TYPE_INT && exponent.type == PHP_TYPE_INT && exponent.value.int_val >= 0) {
+        int64_t factor = base.value.int_val;
+        int64_t remaining = exponent.value.int_val;
+        int64_t value = 1;
+        bool overflow = false;
+        while (remaining > 0 && !overflow) {
+            if (remaining & 1) overflow |= __builtin_mul_overflow(value, factor, &value);
+            remaining >>= 1;
+            if (remaining > 0) overflow |= __builtin_mul_overflow(factor, factor, &factor);
+        }
+        if (!overflow) {
+            return php_value_create_int(value);
         }
     }
+    double x = base.type == PHP_TYPE_INT ? (double)base.value.int_val : base.value.float_val;
+    double y = exponent.type == PHP_TYPE_INT ? (double)exponent.value.int_val : exponent.value.float_val;
+    return php_value_create_float(pow(x, y));
+}
+
+// Half away from zero at the given number of decimal places. The scaled
+// value is first rounded to the 15 significant digits a double carries,
+// so round(1.005, 2) is 1.01 as written rather than as stored.
+static double round_places(double value, int64_t places) {
+    if (!isfinite(value) || value == 0.0) return value;
+    if (places > 308) places = 308;
+    if (places < -308) places = -308;
+
+    double factor = pow(10.0, (double)(places < 0 ? -places : places));
+    double scaled = places >= 0 ? value * factor : value / factor;
+    if (!isfinite(scaled)) return value;
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.14e", scaled);
+    scaled = round(strtod(buffer, NULL));
+
+    double result = places >= 0 ? scaled / factor : scaled * factor;
+    return isfinite(result) ? result : value;
+}
+
+php_value_t* php_function_round(int argc, php_value_t** argv) {
+    php_value_t number;
+    to_number(argv[0], &number);
+    double value = number.type == PHP_TYPE_INT ? (double)number.value.int_val : number.value.float_val;
+    int64_t places = argc > 1 ? php_value_to_int(argv[1]) : 0;
+    return php_value_create_float(round_places(value, places));
+}
+
+php_value_t* php_function_ceil(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_float(ceil(php_value_to_float(argv[0])));
+}
+
+php_value_t* php_function_floor(int argc, php_value_t** argv) {
+    (void)argc;
+    return php_value_create_float(floor(php_value_to_float(argv[0])));
+}
+
+// ---------------------------------------------------------------------------
+// Date and time
+// ---------------------------------------------------------------------------
+
+php_value_t* php_function_time(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    return php_value_create_int((int64_t)time(NULL));
+}
+
+static bool is_leap_year(int64_t year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// ISO 8601 weeks: 53 in years starting on a Thursday, or leap years
+// starting on a Wednesday
+static int iso_weeks_in_year(int64_t year) {
+    int64_t p = (year + year / 4 - year / 100 + year / 400) % 7;
+    int64_t q = ((year - 1) + (year - 1) / 4 - (year - 1) / 100 + (year - 1) / 400) % 7;
+    return p == 4 || q == 3 ? 53 : 52;
+}
+
+static void iso_week(const struct tm* tm, int64_t* week_year, int* week) {
+    int64_t year = (int64_t)tm->tm_year + 1900;
+    int weekday = tm->tm_wday == 0 ? 7 : tm->tm_wday;
+    int w = (tm->tm_yday + 1 - weekday + 10) / 7;
+    if (w < 1) {
+        year--;
+        w = iso_weeks_in_year(year);
+    } else if (w > iso_weeks_in_year(year)) {
+        year++;
+        w = 1;
+    }
+    *week_year = year;
+    *week = w;
+}
+
+// Appends one format character's expansion; times are in UTC, PHP's
+// default timezone
+static int format_date_char(char c, const struct tm* tm, int64_t timestamp, char* out, size_t size) {
+    static const char* const days[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+    static const char* const months[] = {"January", "February", "March", "April", "May", "June", "July",
+                                         "August", "September", "October", "November", "December"};
+    static const int month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int64_t year = (int64_t)tm->tm_year + 1900;
+    int hour12 = tm->tm_hour % 12 == 0 ? 12 : tm->tm_hour % 12;
+    int64_t week_year;
+    int week;
+
+    switch (c) {
+        case 'd': return snprintf(out, size, "%02d", tm->tm_mday);
+        case 'D': return snprintf(out, size, "%.3s", days[tm->tm_wday]);
+        case 'j': return snprintf(out, size, "%d", tm->tm_mday);
+        case 'l': return snprintf(out, size, "%s", days[tm->tm_wday]);
+        case 'N': return snprintf(out, size, "%d", tm->tm_wday == 0 ? 7 : tm->tm_wday);
+        case 'S': {
+            int day = tm->tm_mday;
+            const char* suffix = day % 10 == 1 && day != 11 ? "st" : day % 10 == 2 && day != 12 ? "nd"
+                               : day % 10 == 3 && day != 13 ? "rd" : "th";
+            return snprintf(out, size, "%s", suffix);
+        }
+        case 'w': return snprintf(out, size, "%d", tm->tm_wday);
+        case 'z': return snprintf(out, size, "%d", tm->tm_yday);
+        case 'W':
+            iso_week(tm, &week_year, &week);
+            return snprintf(out, size, "%02d", week);
+        case 'o':
+            iso_week(tm, &week_year, &week);
+            return snprintf(out, size, "%lld", (long long)week_year);
+        case 'F': return snprintf(out, size, "%s", months[tm->tm_mon]);
+        case 'M': return snprintf(out, size, "%.3s", months[tm->tm_mon]);
+        case 'm': return snprintf(out, size, "%02d", tm->tm_mon + 1);
+        case 'n': return snprintf(out, size, "%d", tm->tm_mon + 1);
+        case 't': return snprintf(out, size, "%d", month_days[tm->tm_mon] + (tm->tm_mon == 1 && is_leap_year(year)));
+        case 'L': return snprintf(out, size, "%d", is_leap_year(year));
+        case 'Y': return snprintf(out, size, "%lld", (long long)year);
+        case 'y': return snprintf(out, size, "%02d", (int)(year % 100));
+        case 'a': return snprintf(out, size, "%s", tm->tm_hour < 12 ? "am" : "pm");
+        case 'A': return snprintf(out, size, "%s", tm->tm_hour < 12 ? "AM" : "PM");
+        case 'g': return snprintf(out, size, "%d", hour12);
+        case 'G': return snprintf(out, size, "%d", tm->tm_hour);
+        case 'h': return snprintf(out, size, "%02d", hour12);
+        case 'H': return snprintf(out, size, "%02d", tm->tm_hour);
+        case 'i': return snprintf(out, size, "%02d", tm->tm_min);
+        case 's': return snprintf(out, size, "%02d", tm->tm_sec);
+        case 'u': return snprintf(out, size, "000000");
+        case 'v': return snprintf(out, size, "000");
+        case 'e': case 'T': return snprintf(out, size, "UTC");
+        case 'I': case 'Z': return snprintf(out, size, "0");
+        case 'O': return snprintf(out, size, "+0000");
+        case 'P': return snprintf(out, size, "+00:00");
+        case 'p': return snprintf(out, size, "Z");
+        case 'U': return snprintf(out, size, "%lld", (long long)timestamp);
+        case 'c':
+            return snprintf(out, size, "%04lld-%02d-%02dT%02d:%02d:%02d+00:00", (long long)year, tm->tm_mon + 1,
+                            tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec);
+        case 'r':
+            return snprintf(out, size, "%.3s, %02d %.3s %04lld %02d:%02d:%02d +0000", days[tm->tm_wday], tm->tm_mday,
+                            months[tm->tm_mon], (long long)year, tm->tm_hour, tm->tm_min, tm->tm_sec);
+        default: return snprintf(out, size, "%c", c);
+    }
+}
+
+php_value_t* php_function_date(int argc, php_value_t** argv) {
+    php_string_t* format = expect_string("date", 1, "format", argv[0]);
+    if (!format) return php_value_create_null();
+
+    int64_t timestamp = argc > 1 && argv[1]->type != PHP_TYPE_NULL ? php_value_to_int(argv[1]) : (int64_t)time(NULL);
+    time_t seconds = (time_t)timestamp;
+    struct tm tm;
+    if (!gmtime_r(&seconds, &tm)) {
+        php_string_release(format);
+        return php_value_create_bool(false);
+    }
+
+    // No format character expands to more than 40 bytes
+    char* text = malloc(format->len * 40 + 1);
+    if (!text) {
+        php_string_release(format);
+        return NULL;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < format->len; i++) {
+        char c = format->val[i];
+        if (c == '\\' && i + 1 < format->len) {
+            text[length++] = format->val[++i];
+            continue;
+        }
+        int written = format_date_char(c, &tm, timestamp, text + length, 41);
+        if (written > 0) length += (size_t)written;
+    }
+    php_string_release(format);
+
+    php_string_t* result = php_string_init(text, length);
+    free(text);
+    return result ? php_value_create_str(result) : NULL;
+}
+
+// Register built-in functions
+static void register_builtin_functions(void) {
+    php_function_t functions[] = {
+        {"echo", php_function_echo, 1, -1, 0},
+        {"print", php_function_print, 1, 1, 0},
+        {"strlen", php_function_strlen, 1, 1, 0},
+        {"var_dump", php_function_var_dump, 1, -1, 0},
+        {"count", php_function_count, 1, 2, 0},
+        {"sizeof", php_function_count, 1, 2, 0},
+        {"is_array", php_function_is_array, 1, 1, 0},
+        {"is_string", php_function_is_string, 1, 1, 0},
+        {"is_int", php_function_is_int, 1, 1, 0},
+        {"is_float", php_function_is_float, 1, 1, 0},
+        {"is_bool", php_function_is_bool, 1, 1, 0},
+        {"is_null", php_function_is_null, 1, 1, 0},
+        {"gettype", php_function_gettype, 1, 1, 0},
+        {"strtolower", php_function_strtolower, 1, 1, 0},
+        {"strtoupper", php_function_strtoupper, 1, 1, 0},
+        {"array_push", php_function_array_push, 1, -1, 1u << 0},
+        {"array_pop", php_function_array_pop, 1, 1, 1u << 0},
+        {"array_keys", php_function_array_keys, 1, 3, 0},
+        {"array_values", php_function_array_values, 1, 1, 0},
+        {"array_merge", php_function_array_merge, 0, -1, 0},
+        {"in_array", php_function_in_array, 2, 3, 0},
+        {"array_key_exists", php_function_array_key_exists, 2, 2, 0},
+        {"array_sum", php_function_array_sum, 1, 1, 0},
+        {"array_unique", php_function_array_unique, 1, 2, 0},
+        {"sort", php_function_sort, 1, 2, 1u << 0},
+        {"max", php_function_max, 1, -1, 0},
+        {"min", php_function_min, 1, -1, 0},
+        {"phpversion", php_function_phpversion, 0, 1, 0},
+        {"trim", php_function_trim, 1, 2, 0},
+        {"strpos", php_function_strpos, 2, 3, 0},
+        {"substr", php_function_substr, 2, 3, 0},
+        {"implode", php_function_implode, 1, 2, 0},
+        {"is_numeric", php_function_is_numeric, 1, 1, 0},
+        {"abs", php_function_abs, 1, 1, 0},
+        {"sqrt", php_function_sqrt, 1, 1, 0},
+        {"pow", php_function_pow, 2, 2, 0},
+        {"round", php_function_round, 1, 2, 0},
+        {"ceil", php_function_ceil, 1, 1, 0},
+        {"floor", php_function_floor, 1, 1, 0},
+        {"time", php_function_time, 0, 0, 0},
+        {"date", php_function_date, 1, 2, 0},
+        {"ob_start", php_function_ob_start, 0, 3, 0},
+        {"ob_get_contents", php_function_ob_get_contents, 0, 0, 0},
+        {"ob_get_clean", php_function_ob_get_clean, 0, 0, 0},
+        {"ob_get_flush", php_function_ob_get_flush, 0, 0, 0},
+        {"ob_get_length", php_function_ob_get_length, 0, 0, 0},
+        {"ob_get_level", php_function_ob_get_level, 0, 0, 0},
+        {"ob_clean", php_function_ob_clean, 0, 0, 0},
+        {"ob_flush", php_function_ob_flush, 0, 0, 0},
+        {"ob_end_clean", php_function_ob_end_clean, 0, 0, 0},
+        {"ob_end_flush", php_function_ob_end_flush, 0, 0, 0},
+        {"flush", php_function_flush, 0, 0, 0},
+        {NULL, NULL, 0, 0, 0}
+    };
     
-    return NULL;
+    for (int i = 0; functions[i].name; i++) {
+        php_engine_register_function(&functions[i]);
+    }
+}
+
+bool php_engine_register_function(const php_function_t* func) {
+    if (!func || !func->name || !func->callback) {
+        return false;
+    }
+
+    // Names are case-insensitive, so the table is keyed by the folded spelling
+    const char* name = php_intern_lower(func->name, strlen(func->name));
+    if (!name) return false;
+
+    size_t name_len = strlen(name);
+    uint64_t hash = php_hash_bytes(name, name_len);
+    php_function_t* existing = php_hash_find(&function_table, name, name_len, hash);
+    if (existing) {
+        // Update in place so handles resolved earlier stay valid
+        existing->callback = func->callback;
+        existing->min_args = func->min_args;
+        existing->max_args = func->max_args;
+        existing->by_ref = func->by_ref;
+        return true;
+    }
+
+    if (functions_count >= functions_capacity) {
+        size_t new_capacity = functions_capacity * 2;
+        php_function_t** functions = realloc(registered_functions, new_capacity * sizeof(php_function_t*));
+        if (!functions) return false;
+        registered_functions = functions;
+        functions_capacity = new_capacity;
+    }
+
+    php_function_t* handle = malloc(sizeof(php_function_t));
+    if (!handle) return false;
+    handle->name = (char*)name;
+    handle->callback = func->callback;
+    handle->min_args = func->min_args;
+    handle->max_args = func->max_args;
+    handle->by_ref = func->by_ref;
+
+    if (!php_hash_insert(&function_table, name, name_len, hash, handle)) {
+        free(handle);
+        return false;
+    }
+    registered_functions[functions_count++] = handle;
+    return true;
+}
+
+const php_function_t* php_engine_find_function(const char* name) {
+    if (!name) return NULL;
+
+    // The table folds case, so no lowercase copy of the name is needed
+    size_t name_len = strlen(name);
+    return php_hash_find(&function_table, name, name_len, php_hash_bytes_lower(name, name_len));
+}
+
+php_value_t* php_engine_call_function(const char* name, int argc, php_value_t** argv) {
+    const php_function_t* func = php_engine_find_function(name);
+    if (!func) return NULL;
+
+    if (argc < func->min_args || (func->max_args > 0 && argc > func->max_args)) {
+        return NULL;
+    }
+    return func->callback(argc, argv);
 }
@@ -7,7 +7,13 @@
 #define PHP_ENGINE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "php_string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // PHP version constants
 #define PHP_VERSION "8.3.0"
@@ -21,8 +27,10 @@ typedef enum {
     PHP_ENGINE_ERROR
 } php_engine_state_t;
 
-// PHP value types
+// PHP value types. UNDEF marks an empty variable or stack slot and is never
+// visible to scripts; it is zero so calloc'd slots start out undefined.
 typedef enum {
+    PHP_TYPE_UNDEF,
     PHP_TYPE_NULL,
     PHP_TYPE_BOOL,
     PHP_TYPE_INT,
@@ -30,24 +38,33 @@ typedef enum {
     PHP_TYPE_STRING,
     PHP_TYPE_ARRAY,
     PHP_TYPE_OBJECT,
-    PHP_TYPE_RESOURCE
+    PHP_TYPE_RESOURCE,
+    PHP_TYPE_INDIRECT                   // VM stack only: points at a variable or element
 } php_type_t;
 
-// PHP value structure
-typedef struct {
-    php_type_t type;
+typedef struct php_array php_array_t;
+
+// PHP value structure: 16 bytes, scalars stored inline. Payloads such as
+// strings and arrays are shared between copies and carry their own refcount.
+typedef struct php_value {
     union {
         bool bool_val;
         int64_t int_val;
         double float_val;
-        char* string_val;
-        void* array_val;
+        php_string_t* str;
+        php_array_t* arr;
         void* object_val;
         void* resource_val;
+        struct php_value* indirect;
     } value;
-    uint32_t refcount;
+    php_type_t type;
+    uint32_t reserved;
 } php_value_t;
 
+// Integers in this range have immortal boxes
+#define PHP_SMALL_INT_MIN (-128)
+#define PHP_SMALL_INT_MAX 1023
+
 // PHP function callback
 typedef php_value_t* (*php_function_callback_t)(int argc, php_value_t** argv);
 
@@ -57,6 +74,7 @@ typedef struct {
     php_function_callback_t callback;
     int min_args;
     int max_args;
+    uint32_t by_ref;                    // Bit n set: argument n is passed by reference
 } php_function_t;
 
 // Engine initialization and cleanup
@@ -69,17 +87,100 @@ bool php_engine_execute_file(const char* filename);
 bool php_engine_execute_string(const char* code);
 bool php_engine_syntax_check(const char* filename);
 
-// Memory management
+// Boxed values, used where values cross the builtin function API.
+// null, booleans, small integers and "" come back as immortal singletons,
+// so creating them does not allocate and destroying them does nothing.
 php_value_t* php_value_create_null(void);
 php_value_t* php_value_create_bool(bool value);
 php_value_t* php_value_create_int(int64_t value);
 php_value_t* php_value_create_float(double value);
 php_value_t* php_value_create_string(const char* value);
 php_value_t* php_value_create_string_len(const char* value, size_t length);
-
+php_value_t* php_value_create_str(php_string_t* str);
+php_value_t* php_value_create_array(php_array_t* array);
 void php_value_destroy(php_value_t* value);
-void php_value_ref(php_value_t* value);
-void php_value_unref(php_value_t* value);
+
+// Move an inline value into a box and back; both transfer the reference
+php_value_t* php_value_box(const php_value_t* value);
+void php_value_unbox(php_value_t* dest, php_value_t* box);
+
+// Inline values, as stored in variables, literals and VM slots. set_str
+// takes over the caller's reference to str.
+void php_value_set_string_len(php_value_t* value, const char* str, size_t length);
+
+static inline void php_value_set_str(php_value_t* value, php_string_t* str) {
+    value->type = PHP_TYPE_STRING;
+    value->value.str = str;
+}
+
+static inline void php_value_set_array(php_value_t* value, php_array_t* array) {
+    value->type = PHP_TYPE_ARRAY;
+    value->value.arr = array;
+}
+
+static inline void php_value_set_null(php_value_t* value) {
+    value->type = PHP_TYPE_NULL;
+}
+
+static inline void php_value_set_bool(php_value_t* value, bool b) {
+    value->type = PHP_TYPE_BOOL;
+    value->value.bool_val = b;
+}
+
+static inline void php_value_set_int(php_value_t* value, int64_t i) {
+    value->type = PHP_TYPE_INT;
+    value->value.int_val = i;
+}
+
+static inline void php_value_set_float(php_value_t* value, double d) {
+    value->type = PHP_TYPE_FLOAT;
+    value->value.float_val = d;
+}
+
+void php_array_free(php_array_t* array);
+
+static inline void php_value_addref(const php_value_t* value) {
+    if (value->type == PHP_TYPE_STRING) {
+        php_string_addref(value->value.str);
+    } else if (value->type == PHP_TYPE_ARRAY) {
+        php_refcounted_t* gc = (php_refcounted_t*)value->value.arr;
+        if (!(gc->flags & PHP_GC_IMMORTAL)) gc->refcount++;
+    }
+}
+
+// Drop the value's reference to its payload; the slot is left as garbage
+static inline void php_value_release(php_value_t* value) {
+    if (value->type == PHP_TYPE_STRING) {
+        php_string_release(value->value.str);
+    } else if (value->type == PHP_TYPE_ARRAY) {
+        php_refcounted_t* gc = (php_refcounted_t*)value->value.arr;
+        if (!(gc->flags & PHP_GC_IMMORTAL) && --gc->refcount == 0) {
+            php_array_free(value->value.arr);
+        }
+    }
+}
+
+static inline void php_value_copy(php_value_t* dest, const php_value_t* src) {
+    *dest = *src;
+    php_value_addref(dest);
+}
+
+// Copies of arrays share them until written: writers call separate first,
+// which gives an array with other holders a private copy of its top level.
+// An array held only once is changed in place.
+bool php_value_separate(php_value_t* value);
+
+// Value conversion and comparison. to_str returns a new reference; string
+// values hand back their own payload instead of a copy.
+bool php_value_is_true(const php_value_t* value);
+int64_t php_value_to_int(const php_value_t* value);
+double php_value_to_float(const php_value_t* value);
+php_string_t* php_value_to_str(const php_value_t* value);
+int php_value_compare(const php_value_t* a, const php_value_t* b);
+bool php_value_identical(const php_value_t* a, const php_value_t* b);
+const char* php_value_type_name(const php_value_t* value);
+int64_t php_dval_to_lval(double value);
+php_type_t php_parse_numeric(const char* str, size_t length, int64_t* lval, double* dval, size_t* consumed);
 
 // Variable management
 bool php_engine_set_variable(const char* name, php_value_t* value);
@@ -89,6 +190,7 @@ bool php_engine_unset_variable(const char* name);
 // Function management
 bool php_engine_register_function(const php_function_t* func);
 php_value_t* php_engine_call_function(const char* name, int argc, php_value_t** argv);
+const php_function_t* php_engine_find_function(const char* name);
 
 // Output functions
 void php_engine_output(const char* str);
@@ -96,6 +198,7 @@ void php_engine_output_len(const char* str, size_t length);
 void php_engine_output_int(int64_t value);
 void php_engine_output_float(double value);
 void php_engine_output_bool(bool value);
+void php_engine_output_value(const php_value_t* value);
 
 // Error handling
 void php_engine_error(const char* message);
@@ -120,16 +223,32 @@ php_value_t* php_function_array_values(int argc, php_value_t** argv);
 php_value_t* php_function_array_merge(int argc, php_value_t** argv);
 php_value_t* php_function_in_array(int argc, php_value_t** argv);
 php_value_t* php_function_array_key_exists(int argc, php_value_t** argv);
+php_value_t* php_function_array_sum(int argc, php_value_t** argv);
+php_value_t* php_function_array_unique(int argc, php_value_t** argv);
+php_value_t* php_function_sort(int argc, php_value_t** argv);
+php_value_t* php_function_max(int argc, php_value_t** argv);
+php_value_t* php_function_min(int argc, php_value_t** argv);
+php_value_t* php_function_implode(int argc, php_value_t** argv);
 php_value_t* php_function_is_array(int argc, php_value_t** argv);
 php_value_t* php_function_is_string(int argc, php_value_t** argv);
 php_value_t* php_function_is_int(int argc, php_value_t** argv);
 php_value_t* php_function_is_float(int argc, php_value_t** argv);
 php_value_t* php_function_is_bool(int argc, php_value_t** argv);
 php_value_t* php_function_is_null(int argc, php_value_t** argv);
+php_value_t* php_function_is_numeric(int argc, php_value_t** argv);
 php_value_t* php_function_gettype(int argc, php_value_t** argv);
 php_value_t* php_function_isset(int argc, php_value_t** argv);
 php_value_t* php_function_unset(int argc, php_value_t** argv);
 php_value_t* php_function_empty(int argc, php_value_t** argv);
+php_value_t* php_function_phpversion(int argc, php_value_t** argv);
+php_value_t* php_function_abs(int argc, php_value_t** argv);
+php_value_t* php_function_sqrt(int argc, php_value_t** argv);
+php_value_t* php_function_pow(int argc, php_value_t** argv);
+php_value_t* php_function_round(int argc, php_value_t** argv);
+php_value_t* php_function_ceil(int argc, php_value_t** argv);
+php_value_t* php_function_floor(int argc, php_value_t** argv);
+php_value_t* php_function_time(int argc, php_value_t** argv);
+php_value_t* php_function_date(int argc, php_value_t** argv);
 php_value_t* php_function_exit(int argc, php_value_t** argv);
 php_value_t* php_function_die(int argc, php_value_t** argv);
 
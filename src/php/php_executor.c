@@ -0,0 +1,2401 @@
+/**
+ * PHP Executor Implementation
+ * Stack-based virtual machine with its own call frame stack
+ */
+
+#include "php_executor.h"
+#include "php_aot.h"
+#include "php_array.h"
+#include "php_hash.h"
+#include "php_output.h"
+#include "php_variables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+// Deepest user function nesting before giving up
+#define VM_MAX_FRAMES 65536
+
+// Bodies compiled ahead of time nest on the C stack, which is small under
+// WebAssembly; calls deeper than this run the interpreted ops instead
+#define VM_MAX_NATIVE_DEPTH 128
+
+// Compiled variable slots are carved from pages that never move, so
+// symbol tables and "global" aliases can point at them
+#define VM_SLOT_PAGE_SIZE 4096
+
+typedef struct vm_slot_page {
+    struct vm_slot_page* next;
+    size_t capacity;
+    size_t top;
+    php_variable_t slots[];
+} vm_slot_page_t;
+
+// Call frame
+typedef struct {
+    const php_op_array_t* op_array;
+    uint32_t ip;
+    size_t stack_base;          // Operand stack height when the frame was entered
+    uint32_t argc;              // Arguments live at stack[stack_base .. stack_base + argc)
+    php_variable_t* cvs;        // One slot per compiled variable
+    vm_slot_page_t* saved_page; // Slot allocator position to restore on return
+    size_t saved_top;
+    php_symbol_table_t* symbols; // The globals, or built on demand for $$name
+    bool owns_symbols;
+    php_aot_frame_t* native;    // State of a body compiled ahead of time, which keeps its own ip
+} vm_frame_t;
+
+// Executor state; the operand stack holds values inline
+static php_value_t* vm_stack = NULL;
+static size_t vm_stack_top = 0;
+static size_t vm_stack_capacity = 0;
+
+static vm_frame_t* vm_frames = NULL;
+static size_t vm_frame_count = 0;
+static size_t vm_frame_capacity = 0;
+
+static vm_slot_page_t* vm_slot_pages = NULL;
+static vm_slot_page_t* vm_slot_page = NULL;
+
+// Declared user functions, in declaration order and by folded name
+static const php_op_array_t** user_functions = NULL;
+static size_t user_functions_count = 0;
+static size_t user_functions_capacity = 0;
+static php_hash_t user_function_table = {0};
+
+static bool vm_failed = false;
+static bool vm_folding = false;         // Inside php_executor_fold_*: diagnostics are not reported
+static bool vm_fold_failed = false;     // Something would have been reported while folding
+static int vm_exit_status = 0;
+static uint32_t vm_native_depth = 0;
+
+static vm_slot_page_t* slot_page_create(size_t capacity) {
+    vm_slot_page_t* page = malloc(sizeof(vm_slot_page_t) + capacity * sizeof(php_variable_t));
+    if (page) {
+        page->next = NULL;
+        page->capacity = capacity;
+        page->top = 0;
+    }
+    return page;
+}
+
+static void slot_pages_free(vm_slot_page_t* page) {
+    while (page) {
+        vm_slot_page_t* next = page->next;
+        free(page);
+        page = next;
+    }
+}
+
+bool php_executor_init(void) {
+    vm_stack_capacity = 1024;
+    vm_stack = calloc(vm_stack_capacity, sizeof(php_value_t));
+    if (!vm_stack) {
+        return false;
+    }
+
+    vm_frame_capacity = 64;
+    vm_frames = calloc(vm_frame_capacity, sizeof(vm_frame_t));
+    vm_slot_pages = slot_page_create(VM_SLOT_PAGE_SIZE);
+    if (!vm_frames || !vm_slot_pages || !php_hash_init(&user_function_table, 32, true)) {
+        free(vm_frames);
+        free(vm_slot_pages);
+        free(vm_stack);
+        vm_frames = NULL;
+        vm_slot_pages = NULL;
+        vm_stack = NULL;
+        return false;
+    }
+
+    vm_slot_page = vm_slot_pages;
+    vm_stack_top = 0;
+    vm_frame_count = 0;
+    vm_exit_status = 0;
+    return true;
+}
+
+void php_executor_cleanup(void) {
+    free(vm_stack);
+    vm_stack = NULL;
+    vm_stack_top = 0;
+    vm_stack_capacity = 0;
+
+    free(vm_frames);
+    vm_frames = NULL;
+    vm_frame_count = 0;
+    vm_frame_capacity = 0;
+
+    slot_pages_free(vm_slot_pages);
+    vm_slot_pages = NULL;
+    vm_slot_page = NULL;
+
+    free(user_functions);
+    user_functions = NULL;
+    user_functions_count = 0;
+    user_functions_capacity = 0;
+    php_hash_destroy(&user_function_table);
+}
+
+int php_executor_get_exit_status(void) {
+    return vm_exit_status;
+}
+
+// ---------------------------------------------------------------------------
+// Diagnostics
+// ---------------------------------------------------------------------------
+
+static void vm_report(const char* level, const char* fmt, va_list args) {
+    if (vm_folding) {
+        vm_fold_failed = true;
+        return;
+    }
+
+    char detail[512];
+    char message[768];
+    vsnprintf(detail, sizeof(detail), fmt, args);
+
+    const char* filename = "Unknown";
+    uint32_t line = 0;
+    if (vm_frame_count > 0) {
+        const vm_frame_t* frame = &vm_frames[vm_frame_count - 1];
+        filename = frame->op_array->filename;
+        uint32_t ip = frame->native ? frame->native->ip : frame->ip;
+        if (ip > 0) {
+            line = frame->op_array->ops[ip - 1].lineno;
+        }
+    }
+
+    snprintf(message, sizeof(message), "PHP %s:  %s in %s on line %u\n", level, detail, filename, line);
+    php_engine_error(message);
+}
+
+static void vm_warning(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vm_report("Warning", fmt, args);
+    va_end(args);
+}
+
+void php_executor_warning(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vm_report("Warning", fmt, args);
+    va_end(args);
+}
+
+void php_executor_notice(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vm_report("Notice", fmt, args);
+    va_end(args);
+}
+
+static void vm_fatal(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vm_report("Fatal error", fmt, args);
+    va_end(args);
+    if (!vm_folding) vm_failed = true;
+}
+
+// ---------------------------------------------------------------------------
+// Operand stack
+// ---------------------------------------------------------------------------
+
+// Push moves the value and its reference onto the stack. value may point
+// into the stack itself, so it is read before the stack can grow.
+static inline void vm_push(const php_value_t* value) {
+    php_value_t moved = *value;
+    if (vm_stack_top >= vm_stack_capacity) {
+        vm_stack_capacity *= 2;
+        vm_stack = realloc(vm_stack, vm_stack_capacity * sizeof(php_value_t));
+    }
+    vm_stack[vm_stack_top++] = moved;
+}
+
+static inline void vm_push_copy(const php_value_t* value) {
+    php_value_addref(value);
+    vm_push(value);
+}
+
+static inline void vm_push_null(void) {
+    php_value_t value;
+    php_value_set_null(&value);
+    vm_push(&value);
+}
+
+static inline void vm_push_bool(bool b) {
+    php_value_t value;
+    php_value_set_bool(&value, b);
+    vm_push(&value);
+}
+
+// The popped value stays readable until the next push; the caller owns it
+static inline php_value_t* vm_pop(void) {
+    return &vm_stack[--vm_stack_top];
+}
+
+static inline php_value_t* vm_peek(void) {
+    return &vm_stack[vm_stack_top - 1];
+}
+
+// Release operand stack entries down to the given height
+static void vm_stack_release(size_t height) {
+    while (vm_stack_top > height) {
+        php_value_release(&vm_stack[--vm_stack_top]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Variables
+// ---------------------------------------------------------------------------
+
+static php_variable_t* slots_alloc(vm_frame_t* frame, uint32_t count) {
+    frame->saved_page = vm_slot_page;
+    frame->saved_top = vm_slot_page->top;
+    if (count == 0) {
+        return NULL;
+    }
+
+    vm_slot_page_t* page = vm_slot_page;
+    if (page->top + count > page->capacity) {
+        // Pages past the current one are free; reuse the next if it fits
+        vm_slot_page_t* next = page->next;
+        if (next && next->capacity < count) {
+            slot_pages_free(next);
+            next = NULL;
+        }
+        if (!next) {
+            next = slot_page_create(count > VM_SLOT_PAGE_SIZE ? count : VM_SLOT_PAGE_SIZE);
+            if (!next) return NULL;
+        }
+        page->next = next;
+        next->top = 0;
+        page = next;
+        vm_slot_page = page;
+    }
+
+    php_variable_t* slots = page->slots + page->top;
+    page->top += count;
+    memset(slots, 0, count * sizeof(php_variable_t));
+    return slots;
+}
+
+static void slots_release(vm_frame_t* frame) {
+    for (uint32_t i = 0; i < frame->op_array->num_cvs; i++) {
+        if (!frame->cvs[i].alias) {
+            php_value_release(&frame->cvs[i].value);
+        }
+    }
+    vm_slot_page = frame->saved_page;
+    vm_slot_page->top = frame->saved_top;
+}
+
+static inline const php_string_t* literal_str(const vm_frame_t* frame, uint32_t literal) {
+    return frame->op_array->literals[literal].value.str;
+}
+
+static inline const php_string_t* cv_name(const vm_frame_t* frame, uint32_t cv) {
+    return literal_str(frame, frame->op_array->cv_names[cv]);
+}
+
+// Symbol table of a frame; function frames only get one when a variable is
+// accessed by name, and it starts out with their compiled variables
+static php_symbol_table_t* frame_symbols(vm_frame_t* frame) {
+    if (frame->symbols) {
+        return frame->symbols;
+    }
+
+    php_symbol_table_t* symbols = malloc(sizeof(php_symbol_table_t));
+    if (!symbols || !php_symbol_table_init(symbols, frame->op_array->num_cvs * 2)) {
+        free(symbols);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < frame->op_array->num_cvs; i++) {
+        const php_string_t* name = cv_name(frame, i);
+        php_symbol_table_bind(symbols, name->val, name->len, &frame->cvs[i]);
+    }
+
+    frame->symbols = symbols;
+    frame->owns_symbols = true;
+    return symbols;
+}
+
+static bool frame_is_global(const vm_frame_t* frame) {
+    return frame->symbols == php_variables_globals();
+}
+
+// Variable of a variable op; $$name pops the name off the operand stack
+static php_variable_t* vm_variable(vm_frame_t* frame, const php_op_t* op, bool create, php_string_t** dynamic_name) {
+    if (!(op->ext & PHP_VAR_DYNAMIC)) {
+        return &frame->cvs[op->op1];
+    }
+
+    php_value_t* name_value = vm_pop();
+    php_string_t* name = php_value_to_str(name_value);
+    php_value_release(name_value);
+
+    php_symbol_table_t* symbols = frame_symbols(frame);
+    php_variable_t* var = NULL;
+    if (name && symbols) {
+        var = create ? php_symbol_table_add(symbols, name->val, name->len)
+                     : php_symbol_table_find(symbols, name->val, name->len);
+    }
+
+    if (dynamic_name) {
+        *dynamic_name = name;
+    } else if (name) {
+        php_string_release(name);
+    }
+    return var;
+}
+
+// Name of the variable an op refers to, for diagnostics
+static const char* vm_variable_name(const vm_frame_t* frame, const php_op_t* op, const php_string_t* dynamic_name) {
+    if (dynamic_name) return dynamic_name->val;
+    return (op->ext & PHP_VAR_DYNAMIC) ? "" : cv_name(frame, op->op1)->val;
+}
+
+// Unset in the global scope clears the global; in functions it drops the
+// local binding, which for "global $x" leaves the global alone
+static void vm_unset(vm_frame_t* frame, php_variable_t* var) {
+    php_variable_unset_slot(frame_is_global(frame) ? php_variable_deref(var) : var);
+}
+
+php_symbol_table_t* php_executor_active_symbols(void) {
+    if (vm_frame_count == 0) {
+        return php_variables_globals();
+    }
+    return frame_symbols(&vm_frames[vm_frame_count - 1]);
+}
+
+// ---------------------------------------------------------------------------
+// Arithmetic
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    php_type_t type;            // PHP_TYPE_INT or PHP_TYPE_FLOAT
+    int64_t lval;
+    double dval;
+} vm_number_t;
+
+static const char* operator_symbol(uint8_t opcode) {
+    switch (opcode) {
+        case PHP_OP_ADD: return "+";
+        case PHP_OP_SUB: return "-";
+        case PHP_OP_MUL: return "*";
+        case PHP_OP_DIV: return "/";
+        case PHP_OP_MOD: return "%";
+        case PHP_OP_POW: return "**";
+        case PHP_OP_SL: return "<<";
+        case PHP_OP_SR: return ">>";
+        case PHP_OP_BW_AND: return "&";
+        case PHP_OP_BW_OR: return "|";
+        case PHP_OP_BW_XOR: return "^";
+        default: return "?";
+    }
+}
+
+// Convert an operand to a number the way arithmetic operators do
+static bool vm_to_number(const php_value_t* value, const php_value_t* other, uint8_t opcode,
+                         bool left, vm_number_t* out) {
+    switch (value->type) {
+        case PHP_TYPE_NULL:
+            out->type = PHP_TYPE_INT;
+            out->lval = 0;
+            return true;
+        case PHP_TYPE_BOOL:
+            out->type = PHP_TYPE_INT;
+            out->lval = value->value.bool_val;
+            return true;
+        case PHP_TYPE_INT:
+            out->type = PHP_TYPE_INT;
+            out->lval = value->value.int_val;
+            return true;
+        case PHP_TYPE_FLOAT:
+            out->type = PHP_TYPE_FLOAT;
+            out->dval = value->value.float_val;
+            return true;
+        case PHP_TYPE_STRING: {
+            size_t length = value->value.str->len;
+            size_t consumed;
+            php_type_t type = php_parse_numeric(value->value.str->val, length, &out->lval, &out->dval, &consumed);
+            if (type == PHP_TYPE_NULL) {
+                const char* lhs = php_value_type_name(left ? value : other);
+                const char* rhs = php_value_type_name(left ? other : value);
+                vm_fatal("Uncaught TypeError: Unsupported operand types: %s %s %s", lhs, operator_symbol(opcode), rhs);
+                return false;
+            }
+            if (consumed != length) {
+                vm_warning("A non-numeric value encountered");
+            }
+            out->type = type;
+            return true;
+        }
+        default: {
+            const char* lhs = php_value_type_name(left ? value : other);
+            const char* rhs = php_value_type_name(left ? other : value);
+            vm_fatal("Uncaught TypeError: Unsupported operand types: %s %s %s", lhs, operator_symbol(opcode), rhs);
+            return false;
+        }
+    }
+}
+
+static inline double number_as_float(const vm_number_t* n) {
+    return n->type == PHP_TYPE_INT ? (double)n->lval : n->dval;
+}
+
+static bool vm_array_union(const php_array_t* a, const php_array_t* b, php_value_t* result);
+
+// ADD, SUB and MUL of two numbers without conversions; false for any other
+// operands, which take vm_arithmetic
+static inline bool vm_number_arithmetic(uint8_t opcode, const php_value_t* a, const php_value_t* b,
+                                        php_value_t* result) {
+    if (a->type == PHP_TYPE_INT && b->type == PHP_TYPE_INT) {
+        int64_t x = a->value.int_val;
+        int64_t y = b->value.int_val;
+        int64_t value;
+        bool overflow;
+        switch (opcode) {
+            case PHP_OP_ADD: overflow = __builtin_add_overflow(x, y, &value); break;
+            case PHP_OP_SUB: overflow = __builtin_sub_overflow(x, y, &value); break;
+            default: overflow = __builtin_mul_overflow(x, y, &value); break;
+        }
+        if (!overflow) {
+            php_value_set_int(result, value);
+            return true;
+        }
+    } else if ((a->type != PHP_TYPE_INT && a->type != PHP_TYPE_FLOAT) ||
+               (b->type != PHP_TYPE_INT && b->type != PHP_TYPE_FLOAT)) {
+        return false;
+    }
+    double x = a->type == PHP_TYPE_INT ? (double)a->value.int_val : a->value.float_val;
+    double y = b->type == PHP_TYPE_INT ? (double)b->value.int_val : b->value.float_val;
+    switch (opcode) {
+        case PHP_OP_ADD: php_value_set_float(result, x + y); break;
+        case PHP_OP_SUB: php_value_set_float(result, x - y); break;
+        default: php_value_set_float(result, x * y); break;
+    }
+    return true;
+}
+
+static bool vm_arithmetic(uint8_t opcode, const php_value_t* a, const php_value_t* b, php_value_t* result) {
+    if (opcode == PHP_OP_ADD && a->type == PHP_TYPE_ARRAY && b->type == PHP_TYPE_ARRAY) {
+        return vm_array_union(a->value.arr, b->value.arr, result);
+    }
+
+    vm_number_t x, y;
+    if (!vm_to_number(a, b, opcode, true, &x) || !vm_to_number(b, a, opcode, false, &y)) {
+        return false;
+    }
+
+    if (x.type == PHP_TYPE_INT && y.type == PHP_TYPE_INT) {
+        int64_t value;
+        switch (opcode) {
+            case PHP_OP_ADD:
+                if (!__builtin_add_overflow(x.lval, y.lval, &value)) php_value_set_int(result, value);
+                else php_value_set_float(result, (double)x.lval + (double)y.lval);
+                return true;
+            case PHP_OP_SUB:
+                if (!__builtin_sub_overflow(x.lval, y.lval, &value)) php_value_set_int(result, value);
+                else php_value_set_float(result, (double)x.lval - (double)y.lval);
+                return true;
+            case PHP_OP_MUL:
+                if (!__builtin_mul_overflow(x.lval, y.lval, &value)) php_value_set_int(result, value);
+                else php_value_set_float(result, (double)x.lval * (double)y.lval);
+                return true;
+            case PHP_OP_DIV:
+                if (y.lval == 0) {
+                    vm_fatal("Uncaught DivisionByZeroError: Division by zero");
+                    return false;
+                }
+                if (x.lval % y.lval == 0 && !(x.lval == INT64_MIN && y.lval == -1)) {
+                    php_value_set_int(result, x.lval / y.lval);
+                } else {
+                    php_value_set_float(result, (double)x.lval / (double)y.lval);
+                }
+                return true;
+            case PHP_OP_POW:
+                if (y.lval >= 0) {
+                    int64_t base = x.lval;
+                    int64_t exponent = y.lval;
+                    value = 1;
+                    bool overflow = false;
+                    while (exponent > 0 && !overflow) {
+                        if (exponent & 1) overflow |= __builtin_mul_overflow(value, base, &value);
+                        exponent >>= 1;
+                        if (exponent > 0) overflow |= __builtin_mul_overflow(base, base, &base);
+                    }
+                    if (!overflow) {
+                        php_value_set_int(result, value);
+                        return true;
+                    }
+                }
+                php_value_set_float(result, pow((double)x.lval, (double)y.lval));
+                return true;
+            default:
+                break;
+        }
+    }
+
+    double dx = number_as_float(&x);
+    double dy = number_as_float(&y);
+    switch (opcode) {
+        case PHP_OP_ADD: php_value_set_float(result, dx + dy); break;
+        case PHP_OP_SUB: php_value_set_float(result, dx - dy); break;
+        case PHP_OP_MUL: php_value_set_float(result, dx * dy); break;
+        case PHP_OP_DIV:
+            if (dy == 0.0) {
+                vm_fatal("Uncaught DivisionByZeroError: Division by zero");
+                return false;
+            }
+            php_value_set_float(result, dx / dy);
+            break;
+        case PHP_OP_POW: php_value_set_float(result, pow(dx, dy)); break;
+        default: php_value_set_null(result); break;
+    }
+    return true;
+}
+
+// Integer-only operators: %, <<, >>, &, |, ^
+static bool vm_integer_op(uint8_t opcode, const php_value_t* a, const php_value_t* b, php_value_t* result) {
+    vm_number_t x, y;
+    if (!vm_to_number(a, b, opcode, true, &x) || !vm_to_number(b, a, opcode, false, &y)) {
+        return false;
+    }
+
+    int64_t l = x.type == PHP_TYPE_INT ? x.lval : php_dval_to_lval(x.dval);
+    int64_t r = y.type == PHP_TYPE_INT ? y.lval : php_dval_to_lval(y.dval);
+
+    switch (opcode) {
+        case PHP_OP_MOD:
+            if (r == 0) {
+                vm_fatal("Uncaught DivisionByZeroError: Modulo by zero");
+                return false;
+            }
+            php_value_set_int(result, r == -1 ? 0 : l % r);
+            return true;
+        case PHP_OP_SL:
+        case PHP_OP_SR:
+            if (r < 0) {
+                vm_fatal("Uncaught ArithmeticError: Bit shift by negative number");
+                return false;
+            }
+            if (opcode == PHP_OP_SL) {
+                php_value_set_int(result, r >= 64 ? 0 : (int64_t)((uint64_t)l << r));
+            } else {
+                php_value_set_int(result, r >= 64 ? (l < 0 ? -1 : 0) : l >> r);
+            }
+            return true;
+        case PHP_OP_BW_AND: php_value_set_int(result, l & r); return true;
+        case PHP_OP_BW_OR: php_value_set_int(result, l | r); return true;
+        case PHP_OP_BW_XOR: php_value_set_int(result, l ^ r); return true;
+        default: php_value_set_null(result); return true;
+    }
+}
+
+// String conversion of an operand; arrays convert with a warning
+static php_string_t* vm_to_str(const php_value_t* value) {
+    if (value->type == PHP_TYPE_ARRAY) {
+        vm_warning("Array to string conversion");
+    }
+    return php_value_to_str(value);
+}
+
+static void vm_concat(const php_value_t* a, const php_value_t* b, php_value_t* result) {
+    php_string_t* left = vm_to_str(a);
+    php_string_t* right = vm_to_str(b);
+    php_string_t* joined = left && right ? php_string_concat(left, right) : NULL;
+    if (joined) {
+        php_value_set_str(result, joined);
+    } else {
+        php_value_set_null(result);
+    }
+    if (left) php_string_release(left);
+    if (right) php_string_release(right);
+}
+
+// The parts become strings in place, then are copied once into a result
+// sized from all of them; NULL when out of memory
+static php_string_t* vm_join(php_value_t* parts, uint32_t count) {
+    size_t length = 0;
+    bool ok = true;
+    for (uint32_t i = 0; i < count; i++) {
+        if (parts[i].type != PHP_TYPE_STRING) {
+            php_string_t* str = vm_to_str(&parts[i]);
+            php_value_release(&parts[i]);
+            if (!str) {
+                php_value_set_null(&parts[i]);
+                ok = false;
+                continue;
+            }
+            php_value_set_str(&parts[i], str);
+        }
+        length += parts[i].value.str->len;
+    }
+    php_string_t* joined = ok ? php_string_alloc(length) : NULL;
+    if (!joined) {
+        vm_fatal("Out of memory");
+        return NULL;
+    }
+    char* dest = joined->val;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(dest, parts[i].value.str->val, parts[i].value.str->len);
+        dest += parts[i].value.str->len;
+    }
+    return joined;
+}
+
+static bool vm_binary_op(uint8_t opcode, const php_value_t* a, const php_value_t* b, php_value_t* result) {
+    switch (opcode) {
+        case PHP_OP_CONCAT:
+            vm_concat(a, b, result);
+            return true;
+        case PHP_OP_MOD:
+        case PHP_OP_SL:
+        case PHP_OP_SR:
+        case PHP_OP_BW_AND:
+        case PHP_OP_BW_OR:
+        case PHP_OP_BW_XOR:
+            return vm_integer_op(opcode, a, b, result);
+        default:
+            return vm_arithmetic(opcode, a, b, result);
+    }
+}
+
+// "op=" on the value in slot. A string only slot holds is appended to in
+// place by ".=", so building a string up in a loop is not quadratic.
+static bool vm_assign_op(uint8_t opcode, php_value_t* slot, const php_value_t* value) {
+    if (opcode == PHP_OP_CONCAT && slot->type == PHP_TYPE_STRING && php_string_is_unique(slot->value.str)) {
+        php_string_t* tail = vm_to_str(value);
+        size_t length = slot->value.str->len;
+        php_string_t* str = tail ? php_string_extend(slot->value.str, length + tail->len) : NULL;
+        if (!str) {
+            if (tail) php_string_release(tail);
+            vm_fatal("Out of memory");
+            return false;
+        }
+        memcpy(str->val + length, tail->val, tail->len);
+        php_string_release(tail);
+        slot->value.str = str;
+        return true;
+    }
+
+    php_value_t result;
+    if (!vm_binary_op(opcode, slot, value, &result)) {
+        return false;
+    }
+    php_value_release(slot);
+    *slot = result;
+    return true;
+}
+
+// "a"++ is "b", "Az"++ is "Ba", "zz"++ is "aaa"
+static void string_increment(const php_string_t* string, php_value_t* result) {
+    const char* str = string->val;
+    size_t length = string->len;
+    if (length == 0) {
+        php_value_set_string_len(result, "1", 1);
+        return;
+    }
+
+    char* buffer = malloc(length + 2);
+    memcpy(buffer + 1, str, length + 1);
+    char* digits = buffer + 1;
+
+    size_t i = length;
+    char carry_first = 0;
+    while (i > 0) {
+        char c = digits[i - 1];
+        if (c >= 'a' && c < 'z') { digits[i - 1]++; break; }
+        if (c >= 'A' && c < 'Z') { digits[i - 1]++; break; }
+        if (c >= '0' && c < '9') { digits[i - 1]++; break; }
+        if (c == 'z') { digits[i - 1] = 'a'; carry_first = 'a'; }
+        else if (c == 'Z') { digits[i - 1] = 'A'; carry_first = 'A'; }
+        else if (c == '9') { digits[i - 1] = '0'; carry_first = '1'; }
+        else break;  // Non-alphanumeric stops the carry
+        i--;
+    }
+
+    if (i == 0) {
+        buffer[0] = carry_first;
+        php_value_set_string_len(result, buffer, length + 1);
+    } else {
+        php_value_set_string_len(result, digits, length);
+    }
+    free(buffer);
+}
+
+static void vm_increment(const php_value_t* value, bool increment, php_value_t* result) {
+    switch (value->type) {
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+            if (increment) php_value_set_int(result, 1);
+            else php_value_set_null(result);
+            return;
+        case PHP_TYPE_INT:
+            if (increment && value->value.int_val == INT64_MAX) {
+                php_value_set_float(result, (double)INT64_MAX + 1.0);
+            } else if (!increment && value->value.int_val == INT64_MIN) {
+                php_value_set_float(result, (double)INT64_MIN - 1.0);
+            } else {
+                php_value_set_int(result, value->value.int_val + (increment ? 1 : -1));
+            }
+            return;
+        case PHP_TYPE_FLOAT:
+            php_value_set_float(result, value->value.float_val + (increment ? 1.0 : -1.0));
+            return;
+        case PHP_TYPE_STRING: {
+            int64_t lval;
+            double dval;
+            size_t consumed;
+            const php_string_t* str = value->value.str;
+            php_type_t type = php_parse_numeric(str->val, str->len, &lval, &dval, &consumed);
+            if (type != PHP_TYPE_NULL && consumed == str->len) {
+                php_value_t number;
+                if (type == PHP_TYPE_INT) php_value_set_int(&number, lval);
+                else php_value_set_float(&number, dval);
+                vm_increment(&number, increment, result);
+            } else if (increment) {
+                string_increment(str, result);
+            } else {
+                php_value_copy(result, value);
+            }
+            return;
+        }
+        default:
+            php_value_copy(result, value);
+            return;
+    }
+}
+
+static bool vm_cast(const php_value_t* value, php_type_t type, php_value_t* result) {
+    switch (type) {
+        case PHP_TYPE_NULL:
+            php_value_set_null(result);
+            return true;
+        case PHP_TYPE_BOOL:
+            php_value_set_bool(result, php_value_is_true(value));
+            return true;
+        case PHP_TYPE_INT:
+            php_value_set_int(result, php_value_to_int(value));
+            return true;
+        case PHP_TYPE_FLOAT:
+            php_value_set_float(result, php_value_to_float(value));
+            return true;
+        case PHP_TYPE_STRING: {
+            php_string_t* str = vm_to_str(value);
+            if (str) {
+                php_value_set_str(result, str);
+            } else {
+                php_value_set_null(result);
+            }
+            return true;
+        }
+        case PHP_TYPE_ARRAY:
+            if (value->type == PHP_TYPE_ARRAY) {
+                php_value_copy(result, value);
+            } else if (value->type == PHP_TYPE_NULL) {
+                php_value_set_array(result, php_array_empty());
+            } else {
+                php_array_t* array = php_array_new(1);
+                php_value_t* element = array ? php_array_append(array) : NULL;
+                if (!element) {
+                    if (array) php_array_free(array);
+                    vm_fatal("Out of memory");
+                    return false;
+                }
+                php_value_copy(element, value);
+                php_value_set_array(result, array);
+            }
+            return true;
+        default:
+            vm_fatal("Uncaught Error: Cast to %s is not supported", "object");
+            return false;
+    }
+}
+
+// Comparison operators; a and b are already in the order the operator takes
+static void vm_compare(uint8_t opcode, const php_value_t* a, const php_value_t* b, php_value_t* result) {
+    switch (opcode) {
+        case PHP_OP_IS_EQUAL:
+            php_value_set_bool(result, php_value_compare(a, b) == 0);
+            break;
+        case PHP_OP_IS_NOT_EQUAL:
+            php_value_set_bool(result, php_value_compare(a, b) != 0);
+            break;
+        case PHP_OP_IS_IDENTICAL:
+            php_value_set_bool(result, php_value_identical(a, b));
+            break;
+        case PHP_OP_IS_NOT_IDENTICAL:
+            php_value_set_bool(result, !php_value_identical(a, b));
+            break;
+        case PHP_OP_IS_SMALLER:
+            php_value_set_bool(result, php_value_compare(a, b) < 0);
+            break;
+        case PHP_OP_IS_SMALLER_OR_EQUAL:
+            php_value_set_bool(result, php_value_compare(a, b) <= 0);
+            break;
+        default:
+            php_value_set_int(result, php_value_compare(a, b));
+            break;
+    }
+}
+
+static bool vm_bitwise_not(const php_value_t* value, php_value_t* result) {
+    if (value->type == PHP_TYPE_INT) {
+        php_value_set_int(result, ~value->value.int_val);
+    } else if (value->type == PHP_TYPE_FLOAT) {
+        php_value_set_int(result, ~php_value_to_int(value));
+    } else if (value->type == PHP_TYPE_STRING) {
+        const php_string_t* str = value->value.str;
+        php_string_t* bytes = php_string_alloc(str->len);
+        if (bytes) {
+            for (size_t i = 0; i < str->len; i++) {
+                bytes->val[i] = (char)~str->val[i];
+            }
+            php_value_set_str(result, bytes);
+        } else {
+            php_value_set_null(result);
+        }
+    } else {
+        vm_fatal("Uncaught TypeError: Cannot perform bitwise not on %s", php_value_type_name(value));
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Arrays
+// ---------------------------------------------------------------------------
+
+static void vm_deprecated(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vm_report("Deprecated", fmt, args);
+    va_end(args);
+}
+
+static bool vm_array_key(const php_value_t* value, php_array_key_t* key) {
+    if (php_array_key_from_value(value, key)) {
+        return true;
+    }
+    vm_fatal("Uncaught TypeError: Cannot access offset of type %s on array", php_value_type_name(value));
+    return false;
+}
+
+static void vm_undefined_key(const php_array_key_t* key) {
+    if (key->str) {
+        vm_warning("Undefined array key \"%s\"", key->str->val);
+    } else {
+        vm_warning("Undefined array key %lld", (long long)key->index);
+    }
+}
+
+// Array to write into through slot: shared arrays are separated first,
+// and null, undefined and false turn into new arrays
+static php_array_t* vm_write_container(php_value_t* slot) {
+    switch (slot->type) {
+        case PHP_TYPE_ARRAY:
+            if (!php_value_separate(slot)) {
+                vm_fatal("Out of memory");
+                return NULL;
+            }
+            return slot->value.arr;
+        case PHP_TYPE_BOOL:
+            if (slot->value.bool_val) break;
+            vm_deprecated("Automatic conversion of false to array is deprecated");
+            // Fall through
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL: {
+            php_array_t* array = php_array_new(0);
+            if (!array) {
+                vm_fatal("Out of memory");
+                return NULL;
+            }
+            php_value_set_array(slot, array);
+            return array;
+        }
+        case PHP_TYPE_STRING:
+            vm_fatal("Uncaught Error: Cannot use string offset as an array");
+            return NULL;
+        default:
+            break;
+    }
+    vm_fatal("Uncaught Error: Cannot use a scalar value as an array");
+    return NULL;
+}
+
+// Element for a write; an undefined key is "[]". Missing elements are
+// added as null, with a warning when the write reads them first.
+static php_value_t* vm_dim_slot(php_array_t* array, const php_value_t* key_value, bool warn_missing) {
+    php_value_t* slot;
+    if (key_value->type == PHP_TYPE_UNDEF) {
+        slot = php_array_append(array);
+        if (!slot) {
+            vm_fatal("Cannot add element to the array as the next element is already occupied");
+            return NULL;
+        }
+        php_value_set_null(slot);
+        return slot;
+    }
+
+    php_array_key_t key;
+    if (!vm_array_key(key_value, &key)) {
+        return NULL;
+    }
+    if (warn_missing && !php_array_find(array, &key)) {
+        vm_undefined_key(&key);
+    }
+    slot = php_array_lookup(array, &key);
+    if (!slot) {
+        vm_fatal("Out of memory");
+    }
+    return slot;
+}
+
+// Follow all but the last key down from root for a write, creating
+// arrays and elements on the way; returns the last container's slot
+static php_value_t* vm_dim_container(php_value_t* root, const php_value_t* keys, uint32_t depth) {
+    php_value_t* slot = root;
+    for (uint32_t i = 0; i + 1 < depth && slot; i++) {
+        php_array_t* array = vm_write_container(slot);
+        slot = array ? vm_dim_slot(array, &keys[i], false) : NULL;
+    }
+    return slot;
+}
+
+// Offset into a string, counted from the end when negative
+static bool vm_string_offset(const php_value_t* key, int64_t* offset) {
+    switch (key->type) {
+        case PHP_TYPE_INT:
+            *offset = key->value.int_val;
+            return true;
+        case PHP_TYPE_UNDEF:
+        case PHP_TYPE_NULL:
+        case PHP_TYPE_BOOL:
+        case PHP_TYPE_FLOAT:
+            *offset = php_value_to_int(key);
+            return true;
+        case PHP_TYPE_STRING:
+            if (php_array_numeric_key(key->value.str->val, key->value.str->len, offset)) {
+                return true;
+            }
+            vm_fatal("Uncaught TypeError: Cannot access offset of type %s on string", "string");
+            return false;
+        default:
+            vm_fatal("Uncaught TypeError: Cannot access offset of type %s on string", php_value_type_name(key));
+            return false;
+    }
+}
+
+// Element of an array literal; takes the key, when there is one, and the value
+static bool vm_add_element(php_array_t* array, php_value_t* key_value, php_value_t* value) {
+    php_value_t* slot;
+    if (key_value) {
+        php_array_key_t key;
+        bool ok = vm_array_key(key_value, &key);
+        slot = ok ? php_array_lookup(array, &key) : NULL;
+        if (ok && !slot) vm_fatal("Out of memory");
+        php_value_release(key_value);
+    } else {
+        slot = php_array_append(array);
+        if (!slot) vm_fatal("Cannot add element to the array as the next element is already occupied");
+    }
+    if (!slot) {
+        php_value_release(value);
+        return false;
+    }
+    php_value_release(slot);
+    *slot = *value;
+    return true;
+}
+
+static bool vm_fetch_dim(const php_value_t* container, const php_value_t* key_value, bool quiet, php_value_t* result) {
+    php_value_set_null(result);
+    switch (container->type) {
+        case PHP_TYPE_ARRAY: {
+            php_array_key_t key;
+            if (!php_array_key_from_value(key_value, &key)) {
+                if (quiet) return true;
+                return vm_array_key(key_value, &key);
+            }
+            const php_value_t* element = php_array_find(container->value.arr, &key);
+            if (element) {
+                php_value_copy(result, element);
+            } else if (!quiet) {
+                vm_undefined_key(&key);
+            }
+            return true;
+        }
+        case PHP_TYPE_STRING: {
+            const php_string_t* str = container->value.str;
+            int64_t offset;
+            if (!vm_string_offset(key_value, &offset)) return false;
+            if (offset < 0) offset += (int64_t)str->len;
+            if (offset < 0 || (uint64_t)offset >= str->len) {
+                if (!quiet) {
+                    vm_warning("Uninitialized string offset %lld", (long long)php_value_to_int(key_value));
+                    php_value_set_str(result, php_string_empty());
+                }
+                return true;
+            }
+            php_value_set_str(result, php_string_intern(&str->val[offset], 1));
+            return true;
+        }
+        case PHP_TYPE_UNDEF:
+            return true;
+        default:
+            if (!quiet) {
+                vm_warning("Trying to access array offset on %s", php_value_type_name(container));
+            }
+            return true;
+    }
+}
+
+// $str[offset] = value writes one byte, padding the string with spaces
+static bool vm_assign_string_offset(php_value_t* slot, const php_value_t* key, const php_value_t* value,
+                                    php_value_t* result) {
+    if (key->type == PHP_TYPE_UNDEF) {
+        vm_fatal("Uncaught Error: [] operator not supported for strings");
+        return false;
+    }
+    int64_t offset;
+    if (!vm_string_offset(key, &offset)) return false;
+
+    php_string_t* byte = php_value_to_str(value);
+    if (!byte || byte->len == 0) {
+        if (byte) php_string_release(byte);
+        vm_fatal("Uncaught Error: Cannot assign an empty string to a string offset");
+        return false;
+    }
+    if (byte->len > 1) {
+        vm_warning("Only the first byte will be assigned to the string offset");
+    }
+    char c = byte->val[0];
+    php_string_release(byte);
+
+    php_string_t* str = slot->value.str;
+    if (offset < 0) {
+        offset += (int64_t)str->len;
+        if (offset < 0) {
+            vm_warning("Illegal string offset %lld", (long long)(offset - (int64_t)str->len));
+            php_value_set_null(result);
+            return true;
+        }
+    }
+
+    // Writing past the end pads with spaces; a string nobody else holds is
+    // written in place, anything else is copied first
+    size_t length = str->len;
+    php_string_t* written = php_string_extend(str, (uint64_t)offset >= length ? (size_t)offset + 1 : length);
+    if (!written) {
+        vm_fatal("Out of memory");
+        return false;
+    }
+    if ((size_t)offset > length) {
+        memset(written->val + length, ' ', (size_t)offset - length);
+    }
+    written->val[offset] = c;
+    written->hash = 0;
+    php_value_set_str(slot, written);
+    php_value_set_str(result, php_string_intern(&c, 1));
+    return true;
+}
+
+// $a + $b: $a with the elements of $b whose keys it lacks
+// Store value at the element of var that the depth keys lead to, or apply
+// binary op opcode to the element with it; consumes value and the keys
+static bool vm_assign_dim(php_variable_t* var, php_value_t* keys, uint32_t depth, uint8_t opcode,
+                          php_value_t* value, php_value_t* result) {
+    const php_value_t* last = &keys[depth - 1];
+    php_value_t* container = var ? vm_dim_container(&php_variable_deref(var)->value, keys, depth) : NULL;
+    bool ok = container != NULL;
+
+    if (ok && container->type == PHP_TYPE_STRING) {
+        if (opcode != PHP_OP_NOP) {
+            vm_fatal("Uncaught Error: Cannot use assign-op operators with string offsets");
+            ok = false;
+        } else {
+            ok = vm_assign_string_offset(container, last, value, result);
+        }
+        php_value_release(value);
+    } else if (ok) {
+        php_array_t* array = vm_write_container(container);
+        php_value_t* slot = array ? vm_dim_slot(array, last, opcode != PHP_OP_NOP) : NULL;
+        ok = slot != NULL;
+        if (ok && opcode != PHP_OP_NOP) {
+            ok = vm_assign_op(opcode, slot, value);
+            php_value_release(value);
+            if (ok) {
+                php_value_copy(result, slot);
+            }
+        } else if (ok) {
+            php_value_release(slot);
+            php_value_copy(slot, value);
+            *result = *value;
+        } else {
+            php_value_release(value);
+        }
+    } else {
+        php_value_release(value);
+        if (!var) vm_fatal("Out of memory");
+    }
+
+    for (uint32_t i = 0; i < depth; i++) {
+        php_value_release(&keys[i]);
+    }
+    return ok;
+}
+
+// ++/-- (opcode is the matching PRE/POST_INC/DEC_VAR) on an element
+static bool vm_inc_dec_dim(php_variable_t* var, php_value_t* keys, uint32_t depth, uint8_t opcode,
+                           php_value_t* result) {
+    bool increment = opcode == PHP_OP_PRE_INC_VAR || opcode == PHP_OP_POST_INC_VAR;
+    bool post = opcode == PHP_OP_POST_INC_VAR || opcode == PHP_OP_POST_DEC_VAR;
+    php_value_t* container = var ? vm_dim_container(&php_variable_deref(var)->value, keys, depth) : NULL;
+    php_value_t* slot = NULL;
+    if (container && container->type == PHP_TYPE_STRING) {
+        vm_fatal("Uncaught Error: Cannot increment/decrement string offsets");
+    } else if (container) {
+        php_array_t* array = vm_write_container(container);
+        slot = array ? vm_dim_slot(array, &keys[depth - 1], true) : NULL;
+    } else if (!var) {
+        vm_fatal("Out of memory");
+    }
+
+    if (slot) {
+        php_value_t new_value;
+        vm_increment(slot, increment, &new_value);
+        php_value_copy(result, post ? slot : &new_value);
+        php_value_release(slot);
+        *slot = new_value;
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        php_value_release(&keys[i]);
+    }
+    return slot != NULL;
+}
+
+static bool vm_array_union(const php_array_t* a, const php_array_t* b, php_value_t* result) {
+    php_array_t* sum = php_array_dup(a);
+    if (!sum) {
+        vm_fatal("Out of memory");
+        return false;
+    }
+    uint32_t position = 0;
+    php_array_key_t key;
+    const php_value_t* element;
+    while ((element = php_array_next(b, &position, &key)) != NULL) {
+        if (php_array_find(sum, &key)) continue;
+        php_value_t* slot = php_array_lookup(sum, &key);
+        if (slot) {
+            php_value_copy(slot, element);
+        }
+    }
+    php_value_set_array(result, sum);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Functions
+// ---------------------------------------------------------------------------
+
+static const php_op_array_t* find_user_function(const char* name) {
+    return php_hash_find_str(&user_function_table, name);
+}
+
+static bool declare_function(const php_op_array_t* func) {
+    if (find_user_function(func->name) || php_engine_find_function(func->name)) {
+        vm_fatal("Cannot redeclare %s()", func->name);
+        return false;
+    }
+    if (user_functions_count >= user_functions_capacity) {
+        user_functions_capacity = user_functions_capacity ? user_functions_capacity * 2 : 16;
+        user_functions = realloc(user_functions, user_functions_capacity * sizeof(php_op_array_t*));
+    }
+    user_functions[user_functions_count++] = func;
+    php_hash_insert_str(&user_function_table, func->name, (void*)func);
+    return true;
+}
+
+// Conditional functions wait for their DECLARE_FUNCTION op
+static bool declare_functions(const php_op_array_t* script) {
+    for (uint32_t i = 0; i < script->function_count; i++) {
+        if (!script->functions[i]->conditional && !declare_function(script->functions[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Functions die with the script that declared them
+static void forget_functions(size_t base) {
+    while (user_functions_count > base) {
+        const php_op_array_t* func = user_functions[--user_functions_count];
+        size_t name_len = strlen(func->name);
+        php_hash_remove(&user_function_table, func->name, name_len, php_hash_bytes_lower(func->name, name_len));
+    }
+}
+
+static vm_frame_t* push_frame(const php_op_array_t* op_array, size_t stack_base, uint32_t argc) {
+    // Reported while the caller is still the current frame, at its line
+    for (uint32_t i = 0; op_array->by_ref && i < argc && i < 32; i++) {
+        if ((op_array->by_ref & (1u << i)) && vm_stack[stack_base + i].type != PHP_TYPE_INDIRECT) {
+            php_executor_notice("Only variables should be passed by reference");
+        }
+    }
+    if (vm_frame_count >= VM_MAX_FRAMES) {
+        vm_fatal("Maximum function nesting level of '%d' reached, aborting!", VM_MAX_FRAMES);
+        return NULL;
+    }
+    if (vm_frame_count >= vm_frame_capacity) {
+        vm_frame_capacity *= 2;
+        vm_frames = realloc(vm_frames, vm_frame_capacity * sizeof(vm_frame_t));
+    }
+
+    vm_frame_t* frame = &vm_frames[vm_frame_count];
+    memset(frame, 0, sizeof(vm_frame_t));
+    frame->op_array = op_array;
+    frame->stack_base = stack_base;
+    frame->argc = argc;
+    frame->cvs = slots_alloc(frame, op_array->num_cvs);
+    if (!frame->cvs && op_array->num_cvs > 0) {
+        vm_fatal("Out of memory for %u variables", op_array->num_cvs);
+        return NULL;
+    }
+    vm_frame_count++;
+    return frame;
+}
+
+// The main script's variables are the globals: each slot aliases its global
+static bool bind_globals(vm_frame_t* frame) {
+    php_symbol_table_t* globals = php_variables_globals();
+    frame->symbols = globals;
+
+    for (uint32_t i = 0; i < frame->op_array->num_cvs; i++) {
+        const php_string_t* name = cv_name(frame, i);
+        frame->cvs[i].alias = php_symbol_table_add(globals, name->val, name->len);
+        if (!frame->cvs[i].alias) return false;
+    }
+    return true;
+}
+
+static void pop_frame(void) {
+    vm_frame_t* frame = &vm_frames[--vm_frame_count];
+    if (frame->owns_symbols) {
+        php_symbol_table_destroy(frame->symbols);
+        free(frame->symbols);
+    }
+    slots_release(frame);
+    vm_stack_release(frame->stack_base);
+}
+
+// Move argument index off the operand stack into its slot, or the default.
+// Variables passed to a parameter taken by reference arrive as pointers to
+// their value from FETCH_VAR_REF, and the parameter aliases the variable,
+// which outlives the call.
+static bool vm_recv(vm_frame_t* frame, uint32_t index, const php_value_t* default_value) {
+    php_variable_t* var = &frame->cvs[index];
+    if (index < frame->argc) {
+        php_value_t* arg = &vm_stack[frame->stack_base + index];
+        bool by_ref = index < 32 && (frame->op_array->by_ref & (1u << index));
+        if (arg->type == PHP_TYPE_INDIRECT && by_ref) {
+            // The value is the first member of its variable
+            var->alias = (php_variable_t*)arg->value.indirect;
+        } else if (arg->type == PHP_TYPE_INDIRECT) {
+            php_value_copy(&var->value, arg->value.indirect);
+        } else {
+            var->value = *arg;
+        }
+        arg->type = PHP_TYPE_UNDEF;
+    } else if (default_value) {
+        php_variable_assign(var, default_value);
+    } else {
+        const php_op_array_t* func = frame->op_array;
+        vm_fatal("Uncaught ArgumentCountError: Too few arguments to function %s(), %u passed and %s %u expected",
+                 func->name, frame->argc, func->required_params == func->num_params ? "exactly" : "at least",
+                 func->required_params);
+        return false;
+    }
+    return true;
+}
+
+// Collect argument index and those after it into an array for "...$name"
+static bool vm_recv_variadic(vm_frame_t* frame, uint32_t index) {
+    php_array_t* array = php_array_new(frame->argc > index ? frame->argc - index : 0);
+    if (!array) {
+        vm_fatal("Out of memory");
+        return false;
+    }
+    for (uint32_t i = index; i < frame->argc; i++) {
+        php_value_t* arg = &vm_stack[frame->stack_base + i];
+        php_value_t* element = php_array_append(array);
+        if (arg->type == PHP_TYPE_INDIRECT) {
+            php_value_copy(element, arg->value.indirect);
+        } else {
+            *element = *arg;
+        }
+        arg->type = PHP_TYPE_UNDEF;
+    }
+    php_value_set_array(&frame->cvs[index].value, array);
+    return true;
+}
+
+static void vm_echo(php_value_t* value) {
+    if (value->type == PHP_TYPE_ARRAY) {
+        vm_warning("Array to string conversion");
+    }
+    php_engine_output_value(value);
+    php_value_release(value);
+}
+
+// Callee of the CALL naming literal name. Targets are bound at compile
+// time; anything else is looked up here, and only builtins are cached,
+// since user functions of other scripts go away when those scripts finish.
+static bool vm_call_target(const php_op_array_t* op_array, uint32_t name, const php_op_array_t** func,
+                           const php_function_t** builtin) {
+    php_call_target_t* target = &op_array->call_targets[name];
+    *func = target->user;
+    *builtin = target->builtin;
+    if (*func || *builtin) return true;
+
+    const char* str = op_array->literals[name].value.str->val;
+    *func = find_user_function(str);
+    if (*func) return true;
+    target->builtin = *builtin = php_engine_find_function(str);
+    if (!*builtin) {
+        vm_fatal("Uncaught Error: Call to undefined function %s()", str);
+        return false;
+    }
+    return true;
+}
+
+static inline bool vm_runs_native(const php_op_array_t* func) {
+    return func->native && vm_native_depth < VM_MAX_NATIVE_DEPTH;
+}
+
+// Run a body compiled ahead of time in a frame of its own over the argc
+// arguments on top of the stack, which it replaces with the result
+static bool vm_call_native(const php_op_array_t* func, uint32_t argc) {
+    vm_frame_t* frame = push_frame(func, vm_stack_top - argc, argc);
+    if (!frame) return false;
+    php_aot_frame_t native = {frame->cvs, func, 0};
+    frame->native = &native;
+    php_value_t result;
+    vm_native_depth++;
+    bool ok = func->native(&native, &result);
+    vm_native_depth--;
+    pop_frame();
+    if (ok) vm_push(&result);
+    return ok;
+}
+
+static bool call_builtin(const php_function_t* func, uint32_t argc) {
+    if ((int)argc < func->min_args || (func->max_args >= 0 && (int)argc > func->max_args)) {
+        bool too_few = (int)argc < func->min_args;
+        int expected = too_few ? func->min_args : func->max_args;
+        const char* qualifier = func->min_args == func->max_args ? "exactly" : (too_few ? "at least" : "at most");
+        vm_fatal("Uncaught ArgumentCountError: %s() expects %s %d argument%s, %u given",
+                 func->name, qualifier, expected, expected == 1 ? "" : "s", argc);
+        return false;
+    }
+
+    // Builtins see their arguments in place on the operand stack
+    size_t base = vm_stack_top - argc;
+    php_value_t* args[16];
+    php_value_t** argv = argc <= 16 ? args : malloc(argc * sizeof(php_value_t*));
+    if (!argv) {
+        vm_fatal("Out of memory");
+        return false;
+    }
+    for (uint32_t i = 0; i < argc; i++) {
+        php_value_t* arg = &vm_stack[base + i];
+        argv[i] = arg->type == PHP_TYPE_INDIRECT ? arg->value.indirect : arg;
+    }
+
+    php_value_t* result = func->callback((int)argc, argv);
+    if (argv != args) {
+        free(argv);
+    }
+    vm_stack_release(base);
+
+    php_value_t value;
+    php_value_unbox(&value, result);
+    vm_push(&value);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Constant folding
+// ---------------------------------------------------------------------------
+
+// The optimizer folds through the same code the handlers run. Anything that
+// would print a warning or fail is not folded, so it still happens, with its
+// message, when the script runs.
+static bool fold_end(bool ok, php_value_t* result) {
+    vm_folding = false;
+    if (ok && vm_fold_failed) {
+        php_value_release(result);
+        ok = false;
+    }
+    return ok;
+}
+
+bool php_executor_fold_op(uint8_t opcode, uint8_t ext, const php_value_t* a, const php_value_t* b,
+                          php_value_t* result) {
+    vm_folding = true;
+    vm_fold_failed = false;
+
+    bool ok = true;
+    switch (opcode) {
+        case PHP_OP_ADD: case PHP_OP_SUB: case PHP_OP_MUL: case PHP_OP_DIV: case PHP_OP_MOD:
+        case PHP_OP_POW: case PHP_OP_CONCAT: case PHP_OP_SL: case PHP_OP_SR:
+        case PHP_OP_BW_AND: case PHP_OP_BW_OR: case PHP_OP_BW_XOR:
+            ok = vm_binary_op(opcode, a, b, result);
+            break;
+        case PHP_OP_IS_EQUAL: case PHP_OP_IS_NOT_EQUAL: case PHP_OP_IS_IDENTICAL: case PHP_OP_IS_NOT_IDENTICAL:
+        case PHP_OP_IS_SMALLER: case PHP_OP_IS_SMALLER_OR_EQUAL: case PHP_OP_SPACESHIP:
+            vm_compare(opcode, ext ? b : a, ext ? a : b, result);
+            break;
+        case PHP_OP_BOOL_XOR:
+            php_value_set_bool(result, php_value_is_true(a) != php_value_is_true(b));
+            break;
+        case PHP_OP_BOOL_NOT:
+        case PHP_OP_BOOL:
+            php_value_set_bool(result, php_value_is_true(a) == (opcode == PHP_OP_BOOL));
+            break;
+        case PHP_OP_NEG:
+        case PHP_OP_PLUS: {
+            php_value_t factor;
+            php_value_set_int(&factor, opcode == PHP_OP_NEG ? -1 : 1);
+            ok = vm_arithmetic(PHP_OP_MUL, a, &factor, result);
+            break;
+        }
+        case PHP_OP_BW_NOT:
+            ok = vm_bitwise_not(a, result);
+            break;
+        case PHP_OP_CAST:
+            ok = vm_cast(a, (php_type_t)ext, result);
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    return fold_end(ok, result);
+}
+
+bool php_executor_fold_call(const php_function_t* func, int argc, php_value_t** argv, php_value_t* result) {
+    if (argc < func->min_args || (func->max_args >= 0 && argc > func->max_args) || func->by_ref) {
+        return false;
+    }
+    vm_folding = true;
+    vm_fold_failed = false;
+    php_value_unbox(result, func->callback(argc, argv));
+    return fold_end(true, result);
+}
+
+// ---------------------------------------------------------------------------
+// Interpreter loop
+// ---------------------------------------------------------------------------
+
+// Runs the innermost frame, and those it calls, until the frame above
+// base_frames returns; its return value is then left on the stack. False
+// when execution stops first, on a fatal error or at exit(), with the
+// frames above base_frames popped.
+static bool vm_run(size_t base_frames) {
+    vm_frame_t* frame = &vm_frames[vm_frame_count - 1];
+
+    for (;;) {
+        const php_op_t* op = &frame->op_array->ops[frame->ip++];
+
+        switch (op->opcode) {
+            case PHP_OP_NOP:
+                break;
+
+            case PHP_OP_PUSH_CONST:
+                vm_push_copy(&frame->op_array->literals[op->op1]);
+                break;
+
+            case PHP_OP_POP:
+                php_value_release(vm_pop());
+                break;
+
+            case PHP_OP_DUP:
+                vm_push_copy(vm_peek());
+                break;
+
+            case PHP_OP_FETCH_VAR:
+            case PHP_OP_FETCH_VAR_QUIET: {
+                php_string_t* name = NULL;
+                php_variable_t* var = vm_variable(frame, op, false, &name);
+                var = var ? php_variable_deref(var) : NULL;
+                if (var && var->value.type != PHP_TYPE_UNDEF) {
+                    vm_push_copy(&var->value);
+                } else {
+                    if (op->opcode == PHP_OP_FETCH_VAR) {
+                        vm_warning("Undefined variable $%s", vm_variable_name(frame, op, name));
+                    }
+                    vm_push_null();
+                }
+                if (name) php_string_release(name);
+                break;
+            }
+
+            case PHP_OP_ASSIGN_VAR: {
+                php_value_t value = *vm_pop();
+                php_variable_t* var = vm_variable(frame, op, true, NULL);
+                if (var) {
+                    php_variable_assign(var, &value);
+                }
+                vm_push(&value);
+                break;
+            }
+
+            case PHP_OP_ASSIGN_OP_VAR: {
+                php_value_t value = *vm_pop();
+                php_string_t* name = NULL;
+                php_variable_t* var = vm_variable(frame, op, true, &name);
+                if (!var) {
+                    if (name) php_string_release(name);
+                    php_value_release(&value);
+                    vm_fatal("Out of memory");
+                    goto fatal;
+                }
+                var = php_variable_deref(var);
+                if (var->value.type == PHP_TYPE_UNDEF) {
+                    vm_warning("Undefined variable $%s", vm_variable_name(frame, op, name));
+                    php_value_set_null(&var->value);
+                }
+                if (name) php_string_release(name);
+
+                bool ok = vm_assign_op((uint8_t)op->op2, &var->value, &value);
+                php_value_release(&value);
+                if (!ok) goto fatal;
+                vm_push_copy(&var->value);
+                break;
+            }
+
+            case PHP_OP_UNSET_VAR: {
+                php_variable_t* var = vm_variable(frame, op, false, NULL);
+                if (var) {
+                    vm_unset(frame, var);
+                }
+                break;
+            }
+
+            case PHP_OP_ISSET_VAR: {
+                php_variable_t* var = vm_variable(frame, op, false, NULL);
+                var = var ? php_variable_deref(var) : NULL;
+                vm_push_bool(var && var->value.type != PHP_TYPE_UNDEF && var->value.type != PHP_TYPE_NULL);
+                break;
+            }
+
+            case PHP_OP_BIND_GLOBAL: {
+                if (frame_is_global(frame)) {
+                    break;
+                }
+                const php_string_t* name = cv_name(frame, op->op1);
+                php_variable_t* global = php_symbol_table_add(php_variables_globals(), name->val, name->len);
+                // "global $x" creates $x as null when it does not exist yet
+                if (global && global->value.type == PHP_TYPE_UNDEF) {
+                    php_value_set_null(&global->value);
+                }
+                php_variable_t* var = &frame->cvs[op->op1];
+                if (!var->alias) {
+                    php_value_release(&var->value);
+                    var->value.type = PHP_TYPE_UNDEF;
+                }
+                var->alias = global;
+                break;
+            }
+
+            case PHP_OP_PRE_INC_VAR:
+            case PHP_OP_PRE_DEC_VAR:
+            case PHP_OP_POST_INC_VAR:
+            case PHP_OP_POST_DEC_VAR: {
+                php_string_t* name = NULL;
+                php_variable_t* var = vm_variable(frame, op, true, &name);
+                bool increment = op->opcode == PHP_OP_PRE_INC_VAR || op->opcode == PHP_OP_POST_INC_VAR;
+                bool post = op->opcode == PHP_OP_POST_INC_VAR || op->opcode == PHP_OP_POST_DEC_VAR;
+                if (!var) {
+                    if (name) php_string_release(name);
+                    vm_fatal("Out of memory");
+                    goto fatal;
+                }
+                var = php_variable_deref(var);
+                if (var->value.type == PHP_TYPE_UNDEF) {
+                    vm_warning("Undefined variable $%s", vm_variable_name(frame, op, name));
+                    php_value_set_null(&var->value);
+                }
+                if (name) php_string_release(name);
+
+                php_value_t new_value;
+                vm_increment(&var->value, increment, &new_value);
+                if (post) {
+                    vm_push_copy(&var->value);
+                }
+                php_value_release(&var->value);
+                var->value = new_value;
+                if (!post) {
+                    vm_push_copy(&var->value);
+                }
+                break;
+            }
+
+            case PHP_OP_INC_NUMBER:
+            case PHP_OP_DEC_NUMBER: {
+                // A counter inferred to be a number changes where it is
+                php_value_t* value = &php_variable_deref(&frame->cvs[op->op1])->value;
+                bool increment = op->opcode == PHP_OP_INC_NUMBER;
+                if (value->type == PHP_TYPE_INT && value->value.int_val != (increment ? INT64_MAX : INT64_MIN)) {
+                    value->value.int_val += increment ? 1 : -1;
+                } else if (value->type == PHP_TYPE_FLOAT) {
+                    value->value.float_val += increment ? 1.0 : -1.0;
+                } else {
+                    if (value->type == PHP_TYPE_UNDEF) {
+                        vm_warning("Undefined variable $%s", cv_name(frame, op->op1)->val);
+                        php_value_set_null(value);
+                    }
+                    php_value_t new_value;
+                    vm_increment(value, increment, &new_value);
+                    php_value_release(value);
+                    *value = new_value;
+                }
+                break;
+            }
+
+            case PHP_OP_FETCH_CONSTANT:
+                vm_fatal("Uncaught Error: Undefined constant \"%s\"", literal_str(frame, op->op1)->val);
+                goto fatal;
+
+            case PHP_OP_INIT_ARRAY: {
+                php_array_t* array = php_array_new(op->op1);
+                if (!array) {
+                    vm_fatal("Out of memory");
+                    goto fatal;
+                }
+                php_value_t value;
+                php_value_set_array(&value, array);
+                vm_push(&value);
+                break;
+            }
+
+            case PHP_OP_ADD_ARRAY_ELEMENT: {
+                php_value_t value = *vm_pop();
+                php_value_t* key_value = op->ext ? vm_pop() : NULL;
+                if (!vm_add_element(vm_peek()->value.arr, key_value, &value)) goto fatal;
+                break;
+            }
+
+            case PHP_OP_FETCH_DIM:
+            case PHP_OP_FETCH_DIM_QUIET: {
+                php_value_t* key = vm_pop();
+                php_value_t* container = vm_pop();
+                php_value_t result;
+                bool ok = vm_fetch_dim(container, key, op->opcode == PHP_OP_FETCH_DIM_QUIET, &result);
+                php_value_release(container);
+                php_value_release(key);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_PUSH_APPEND_KEY: {
+                php_value_t key;
+                key.type = PHP_TYPE_UNDEF;
+                vm_push(&key);
+                break;
+            }
+
+            case PHP_OP_ASSIGN_DIM: {
+                // The keys stay readable above the stack top until the
+                // result is pushed
+                uint32_t depth = PHP_DIM_DEPTH(op->op2);
+                php_value_t value = *vm_pop();
+                vm_stack_top -= depth;
+                php_value_t* keys = &vm_stack[vm_stack_top];
+                php_variable_t* var = vm_variable(frame, op, true, NULL);
+                php_value_t result;
+                if (!vm_assign_dim(var, keys, depth, (uint8_t)PHP_DIM_EXTRA(op->op2), &value, &result)) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_INC_DEC_DIM: {
+                uint32_t depth = PHP_DIM_DEPTH(op->op2);
+                vm_stack_top -= depth;
+                php_value_t* keys = &vm_stack[vm_stack_top];
+                php_variable_t* var = vm_variable(frame, op, true, NULL);
+                php_value_t result;
+                if (!vm_inc_dec_dim(var, keys, depth, (uint8_t)PHP_DIM_EXTRA(op->op2), &result)) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_UNSET_DIM: {
+                // Unlike writes, unset never creates what it walks through
+                uint32_t depth = PHP_DIM_DEPTH(op->op2);
+                vm_stack_top -= depth;
+                php_value_t* keys = &vm_stack[vm_stack_top];
+                php_variable_t* var = vm_variable(frame, op, false, NULL);
+                php_value_t* slot = var ? &php_variable_deref(var)->value : NULL;
+                bool ok = true;
+                for (uint32_t i = 0; i < depth && slot && ok; i++) {
+                    php_array_key_t key;
+                    if (slot->type == PHP_TYPE_ARRAY) {
+                        // Shared arrays are only separated when there is
+                        // something to remove from them
+                        ok = vm_array_key(&keys[i], &key);
+                        if (!ok || !php_array_find(slot->value.arr, &key)) {
+                            slot = NULL;
+                        } else if (!php_value_separate(slot)) {
+                            vm_fatal("Out of memory");
+                            ok = false;
+                        } else if (i + 1 == depth) {
+                            php_array_delete(slot->value.arr, &key);
+                        } else {
+                            slot = php_array_find(slot->value.arr, &key);
+                        }
+                    } else if (slot->type == PHP_TYPE_STRING) {
+                        vm_fatal("Uncaught Error: Cannot unset string offsets");
+                        ok = false;
+                    } else if (slot->type == PHP_TYPE_UNDEF || slot->type == PHP_TYPE_NULL ||
+                               (slot->type == PHP_TYPE_BOOL && !slot->value.bool_val)) {
+                        slot = NULL;
+                    } else {
+                        vm_fatal("Uncaught Error: Cannot unset offset in a non-array variable");
+                        ok = false;
+                    }
+                }
+                for (uint32_t i = 0; i < depth; i++) {
+                    php_value_release(&keys[i]);
+                }
+                if (!ok) goto fatal;
+                break;
+            }
+
+            case PHP_OP_FETCH_VAR_REF: {
+                php_variable_t* var = vm_variable(frame, op, true, NULL);
+                if (!var) {
+                    vm_fatal("Out of memory");
+                    goto fatal;
+                }
+                var = php_variable_deref(var);
+                if (var->value.type == PHP_TYPE_UNDEF) {
+                    php_value_set_null(&var->value);
+                }
+                php_value_t ref;
+                ref.type = PHP_TYPE_INDIRECT;
+                ref.value.indirect = &var->value;
+                vm_push(&ref);
+                break;
+            }
+
+            case PHP_OP_FETCH_DIM_REF: {
+                // Replaces the keys of an argument with a pointer to its
+                // element; the arguments above them move down
+                uint32_t depth = PHP_DIM_DEPTH(op->op2);
+                uint32_t above = PHP_DIM_EXTRA(op->op2);
+                size_t base = vm_stack_top - above - depth;
+                php_value_t* keys = &vm_stack[base];
+                php_value_t* container = vm_dim_container(&php_variable_deref(&frame->cvs[op->op1])->value, keys, depth);
+                php_value_t* slot = NULL;
+                if (container && container->type == PHP_TYPE_STRING) {
+                    vm_fatal("Uncaught Error: Cannot create references to/from string offsets");
+                } else if (container) {
+                    php_array_t* array = vm_write_container(container);
+                    slot = array ? vm_dim_slot(array, &keys[depth - 1], false) : NULL;
+                }
+                for (uint32_t i = 0; i < depth; i++) {
+                    php_value_release(&keys[i]);
+                }
+                if (!slot) {
+                    // Nothing left to release in the key slots
+                    memmove(&vm_stack[base], &vm_stack[base + depth], above * sizeof(php_value_t));
+                    vm_stack_top -= depth;
+                    goto fatal;
+                }
+                keys[0].type = PHP_TYPE_INDIRECT;
+                keys[0].value.indirect = slot;
+                memmove(&vm_stack[base + 1], &vm_stack[base + depth], above * sizeof(php_value_t));
+                vm_stack_top -= depth - 1;
+                break;
+            }
+
+            case PHP_OP_ADD:
+            case PHP_OP_SUB:
+            case PHP_OP_MUL:
+            case PHP_OP_DIV:
+            case PHP_OP_POW: {
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                php_value_t result;
+                bool ok = vm_arithmetic(op->opcode, left, right, &result);
+                php_value_release(left);
+                php_value_release(right);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_MOD:
+            case PHP_OP_SL:
+            case PHP_OP_SR:
+            case PHP_OP_BW_AND:
+            case PHP_OP_BW_OR:
+            case PHP_OP_BW_XOR: {
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                php_value_t result;
+                bool ok = vm_integer_op(op->opcode, left, right, &result);
+                php_value_release(left);
+                php_value_release(right);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_CONCAT: {
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                php_value_t result;
+                vm_concat(left, right, &result);
+                php_value_release(left);
+                php_value_release(right);
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_CONCAT_N: {
+                uint32_t count = op->op1;
+                php_string_t* joined = vm_join(&vm_stack[vm_stack_top - count], count);
+                if (!joined) goto fatal;
+                vm_stack_release(vm_stack_top - count);
+                php_value_t result;
+                php_value_set_str(&result, joined);
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_IS_EQUAL:
+            case PHP_OP_IS_NOT_EQUAL:
+            case PHP_OP_IS_IDENTICAL:
+            case PHP_OP_IS_NOT_IDENTICAL:
+            case PHP_OP_IS_SMALLER:
+            case PHP_OP_IS_SMALLER_OR_EQUAL:
+            case PHP_OP_SPACESHIP: {
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                php_value_t result;
+
+                // ext marks "a > b" compiled as "b < a" with operands left in source order
+                vm_compare(op->opcode, op->ext ? right : left, op->ext ? left : right, &result);
+                php_value_release(left);
+                php_value_release(right);
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_ADD_NUMBER:
+            case PHP_OP_SUB_NUMBER:
+            case PHP_OP_MUL_NUMBER: {
+                uint8_t opcode = (uint8_t)(op->opcode - PHP_OP_ADD_NUMBER + PHP_OP_ADD);
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                php_value_t result;
+                if (!vm_number_arithmetic(opcode, left, right, &result)) {
+                    bool ok = vm_arithmetic(opcode, left, right, &result);
+                    php_value_release(left);
+                    php_value_release(right);
+                    if (!ok) goto fatal;
+                }
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_IS_SMALLER_NUMBER:
+            case PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER: {
+                bool or_equal = op->opcode == PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER;
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                const php_value_t* a = op->ext ? right : left;
+                const php_value_t* b = op->ext ? left : right;
+                php_value_t result;
+                if (a->type == PHP_TYPE_INT && b->type == PHP_TYPE_INT) {
+                    php_value_set_bool(&result, or_equal ? a->value.int_val <= b->value.int_val
+                                                         : a->value.int_val < b->value.int_val);
+                } else {
+                    vm_compare(or_equal ? PHP_OP_IS_SMALLER_OR_EQUAL : PHP_OP_IS_SMALLER, a, b, &result);
+                    php_value_release(left);
+                    php_value_release(right);
+                }
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_BOOL_XOR: {
+                php_value_t* right = vm_pop();
+                php_value_t* left = vm_pop();
+                bool result = php_value_is_true(left) != php_value_is_true(right);
+                php_value_release(left);
+                php_value_release(right);
+                vm_push_bool(result);
+                break;
+            }
+
+            case PHP_OP_BOOL_NOT:
+            case PHP_OP_BOOL: {
+                php_value_t* value = vm_pop();
+                bool truth = php_value_is_true(value);
+                php_value_release(value);
+                vm_push_bool(op->opcode == PHP_OP_BOOL ? truth : !truth);
+                break;
+            }
+
+            case PHP_OP_NEG:
+            case PHP_OP_PLUS: {
+                // -x is x * -1 and +x is x * 1, as in the reference engine
+                php_value_t* value = vm_pop();
+                php_value_t factor;
+                php_value_t result;
+                php_value_set_int(&factor, op->opcode == PHP_OP_NEG ? -1 : 1);
+                bool ok = vm_arithmetic(PHP_OP_MUL, value, &factor, &result);
+                php_value_release(value);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_BW_NOT: {
+                php_value_t* value = vm_pop();
+                php_value_t result;
+                bool ok = vm_bitwise_not(value, &result);
+                php_value_release(value);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_CAST: {
+                php_value_t* value = vm_pop();
+                php_value_t result;
+                bool ok = vm_cast(value, (php_type_t)op->ext, &result);
+                php_value_release(value);
+                if (!ok) goto fatal;
+                vm_push(&result);
+                break;
+            }
+
+            case PHP_OP_JMP:
+                frame->ip = op->op1;
+                break;
+
+            case PHP_OP_JMPZ:
+            case PHP_OP_JMPNZ: {
+                php_value_t* value = vm_pop();
+                bool truth = php_value_is_true(value);
+                php_value_release(value);
+                if (truth == (op->opcode == PHP_OP_JMPNZ)) {
+                    frame->ip = op->op1;
+                }
+                break;
+            }
+
+            case PHP_OP_JMPZ_EX:
+            case PHP_OP_JMPNZ_EX: {
+                php_value_t* value = vm_pop();
+                bool truth = php_value_is_true(value);
+                php_value_release(value);
+                if (truth == (op->opcode == PHP_OP_JMPNZ_EX)) {
+                    vm_push_bool(truth);
+                    frame->ip = op->op1;
+                }
+                break;
+            }
+
+            case PHP_OP_JMP_SET:
+                if (php_value_is_true(vm_peek())) {
+                    frame->ip = op->op1;
+                } else {
+                    php_value_release(vm_pop());
+                }
+                break;
+
+            case PHP_OP_JMP_NOT_NULL:
+                if (vm_peek()->type != PHP_TYPE_NULL) {
+                    frame->ip = op->op1;
+                } else {
+                    php_value_release(vm_pop());
+                }
+                break;
+
+            case PHP_OP_FE_RESET: {
+                // Writes to the iterated variable separate it from the array
+                // held here, so iteration always sees the array as it was
+                php_value_t* value = vm_peek();
+                if (value->type != PHP_TYPE_ARRAY) {
+                    vm_warning("foreach() argument must be of type array|object, %s given", php_value_type_name(value));
+                    php_value_release(vm_pop());
+                    frame->ip = op->op1;
+                    break;
+                }
+                php_value_t position;
+                php_value_set_int(&position, 0);
+                vm_push(&position);
+                break;
+            }
+
+            case PHP_OP_FE_FETCH: {
+                php_value_t* position = vm_peek();
+                const php_array_t* array = vm_stack[vm_stack_top - 2].value.arr;
+                uint32_t next = (uint32_t)position->value.int_val;
+                php_array_key_t key;
+                const php_value_t* element = php_array_next(array, &next, &key);
+                if (!element) {
+                    frame->ip = op->op1;
+                    break;
+                }
+                position->value.int_val = next;
+                php_variable_assign(&frame->cvs[op->op2], element);
+                if (op->ext) {
+                    php_value_t key_value;
+                    if (key.str) {
+                        php_value_set_str(&key_value, php_string_addref(key.str));
+                    } else {
+                        php_value_set_int(&key_value, key.index);
+                    }
+                    vm_push(&key_value);
+                }
+                break;
+            }
+
+            case PHP_OP_FE_FREE:
+                php_value_release(vm_pop());
+                php_value_release(vm_pop());
+                break;
+
+            case PHP_OP_ECHO:
+                vm_echo(vm_pop());
+                break;
+
+            case PHP_OP_ECHO_CONST: {
+                const php_string_t* str = literal_str(frame, op->op1);
+                php_output_write_static(str->val, str->len);
+                break;
+            }
+
+            case PHP_OP_CALL: {
+                uint32_t argc = op->op2;
+                const php_op_array_t* func;
+                const php_function_t* builtin;
+                if (!vm_call_target(frame->op_array, op->op1, &func, &builtin)) goto fatal;
+
+                if (func && vm_runs_native(func)) {
+                    if (!vm_call_native(func, argc)) goto fatal;
+                    frame = &vm_frames[vm_frame_count - 1];
+                } else if (func) {
+                    frame = push_frame(func, vm_stack_top - argc, argc);
+                    if (!frame) goto fatal;
+                } else if (!call_builtin(builtin, argc)) {
+                    goto fatal;
+                }
+                break;
+            }
+
+            case PHP_OP_RECV:
+            case PHP_OP_RECV_INIT: {
+                const php_value_t* default_value =
+                    op->opcode == PHP_OP_RECV_INIT ? &frame->op_array->literals[op->op2] : NULL;
+                if (!vm_recv(frame, op->op1, default_value)) goto fatal;
+                break;
+            }
+
+            case PHP_OP_RECV_VARIADIC:
+                if (!vm_recv_variadic(frame, op->op1)) goto fatal;
+                break;
+
+            case PHP_OP_RETURN: {
+                php_value_t result = *vm_pop();
+                pop_frame();
+                vm_push(&result);
+                if (vm_frame_count == base_frames) {
+                    return true;
+                }
+                frame = &vm_frames[vm_frame_count - 1];
+                break;
+            }
+
+            case PHP_OP_EXIT: {
+                php_value_t* status = vm_pop();
+                if (status->type == PHP_TYPE_INT) {
+                    vm_exit_status = (int)status->value.int_val;
+                } else if (status->type != PHP_TYPE_NULL) {
+                    php_engine_output_value(status);
+                }
+                php_value_release(status);
+                while (vm_frame_count > base_frames) {
+                    pop_frame();
+                }
+                return false;
+            }
+
+            case PHP_OP_DECLARE_FUNCTION:
+                if (!declare_function(frame->op_array->functions[op->op1])) goto fatal;
+                break;
+
+            default:
+                vm_fatal("Invalid opcode %u", op->opcode);
+                goto fatal;
+        }
+    }
+
+fatal:
+    while (vm_frame_count > base_frames) {
+        pop_frame();
+    }
+    return false;
+}
+
+bool php_executor_execute(const php_op_array_t* op_array) {
+    if (!op_array) {
+        return false;
+    }
+
+    vm_failed = false;
+    size_t base_frames = vm_frame_count;
+    size_t base_stack = vm_stack_top;
+    size_t base_functions = user_functions_count;
+
+    vm_frame_t* frame = push_frame(op_array, vm_stack_top, 0);
+    bool ok = frame && bind_globals(frame) && declare_functions(op_array);
+    if (ok && vm_run(base_frames)) {
+        php_value_release(vm_pop());
+    }
+    while (vm_frame_count > base_frames) {
+        pop_frame();
+    }
+    vm_stack_release(base_stack);
+    forget_functions(base_functions);
+    return ok && !vm_failed;
+}
+
+// ---------------------------------------------------------------------------
+// Ahead-of-time compiled code
+// ---------------------------------------------------------------------------
+//
+// Generated bodies (php_aot.c) keep their operands in C locals and call
+// these for everything they do not do inline. They run in an executor
+// frame of their own, so diagnostics, builtins such as extract() and calls
+// back into interpreted functions see them like any other function.
+
+static inline vm_frame_t* aot_frame(void) {
+    return &vm_frames[vm_frame_count - 1];
+}
+
+bool php_aot_recv(php_aot_frame_t* frame, uint32_t index, uint32_t default_literal) {
+    const php_value_t* default_value =
+        default_literal == PHP_AOT_NO_DEFAULT ? NULL : &frame->op_array->literals[default_literal];
+    return vm_recv(aot_frame(), index, default_value);
+}
+
+void php_aot_undefined(php_aot_frame_t* frame, uint32_t cv, php_value_t* result) {
+    vm_warning("Undefined variable $%s", literal_str(aot_frame(), frame->op_array->cv_names[cv])->val);
+    php_value_set_null(result);
+}
+
+// The variable of slot cv, made defined with a warning when it was not
+static php_value_t* aot_defined(php_aot_frame_t* frame, uint32_t cv) {
+    php_variable_t* var = php_variable_deref(&frame->cvs[cv]);
+    if (var->value.type == PHP_TYPE_UNDEF) {
+        php_aot_undefined(frame, cv, &var->value);
+    }
+    return &var->value;
+}
+
+bool php_aot_assign_op(php_aot_frame_t* frame, uint32_t cv, uint8_t opcode, php_value_t* value) {
+    php_value_t* slot = aot_defined(frame, cv);
+    bool ok = vm_assign_op(opcode, slot, value);
+    php_value_release(value);
+    if (ok) php_value_copy(value, slot);
+    return ok;
+}
+
+void php_aot_inc_dec(php_aot_frame_t* frame, uint32_t cv, uint8_t opcode, php_value_t* result) {
+    php_value_t* slot = aot_defined(frame, cv);
+    bool increment = opcode == PHP_OP_PRE_INC_VAR || opcode == PHP_OP_POST_INC_VAR || opcode == PHP_OP_INC_NUMBER;
+    bool post = opcode == PHP_OP_POST_INC_VAR || opcode == PHP_OP_POST_DEC_VAR;
+    php_value_t new_value;
+    vm_increment(slot, increment, &new_value);
+    if (result && post) php_value_copy(result, slot);
+    php_value_release(slot);
+    *slot = new_value;
+    if (result && !post) php_value_copy(result, slot);
+}
+
+void php_aot_unset(php_aot_frame_t* frame, uint32_t cv) {
+    vm_unset(aot_frame(), &frame->cvs[cv]);
+}
+
+bool php_aot_binary(uint8_t opcode, uint8_t ext, php_value_t* a, php_value_t* b) {
+    php_value_t result;
+    bool ok = true;
+    switch (opcode) {
+        case PHP_OP_IS_EQUAL: case PHP_OP_IS_NOT_EQUAL: case PHP_OP_IS_IDENTICAL: case PHP_OP_IS_NOT_IDENTICAL:
+        case PHP_OP_IS_SMALLER: case PHP_OP_IS_SMALLER_OR_EQUAL: case PHP_OP_SPACESHIP:
+            vm_compare(opcode, ext ? b : a, ext ? a : b, &result);
+            break;
+        case PHP_OP_BOOL_XOR:
+            php_value_set_bool(&result, php_value_is_true(a) != php_value_is_true(b));
+            break;
+        default:
+            ok = vm_binary_op(opcode, a, b, &result);
+            break;
+    }
+    php_value_release(a);
+    php_value_release(b);
+    if (ok) *a = result;
+    return ok;
+}
+
+bool php_aot_unary(uint8_t opcode, uint8_t ext, php_value_t* a) {
+    php_value_t result;
+    bool ok = true;
+    switch (opcode) {
+        case PHP_OP_BOOL_NOT:
+        case PHP_OP_BOOL:
+            php_value_set_bool(&result, php_value_is_true(a) == (opcode == PHP_OP_BOOL));
+            break;
+        case PHP_OP_NEG:
+        case PHP_OP_PLUS: {
+            php_value_t factor;
+            php_value_set_int(&factor, opcode == PHP_OP_NEG ? -1 : 1);
+            ok = vm_arithmetic(PHP_OP_MUL, a, &factor, &result);
+            break;
+        }
+        case PHP_OP_BW_NOT:
+            ok = vm_bitwise_not(a, &result);
+            break;
+        default:
+            ok = vm_cast(a, (php_type_t)ext, &result);
+            break;
+    }
+    php_value_release(a);
+    if (ok) *a = result;
+    return ok;
+}
+
+bool php_aot_concat(uint32_t count, php_value_t* parts) {
+    php_string_t* joined = vm_join(parts, count);
+    for (uint32_t i = 0; i < count; i++) {
+        php_value_release(&parts[i]);
+    }
+    if (!joined) return false;
+    php_value_set_str(&parts[0], joined);
+    return true;
+}
+
+bool php_aot_init_array(uint32_t size, php_value_t* result) {
+    php_array_t* array = php_array_new(size);
+    if (!array) {
+        vm_fatal("Out of memory");
+        return false;
+    }
+    php_value_set_array(result, array);
+    return true;
+}
+
+bool php_aot_add_element(php_value_t* array, php_value_t* key, php_value_t* value) {
+    return vm_add_element(array->value.arr, key, value);
+}
+
+bool php_aot_fetch_dim(bool quiet, php_value_t* container, php_value_t* key) {
+    php_value_t result;
+    bool ok = vm_fetch_dim(container, key, quiet, &result);
+    php_value_release(container);
+    php_value_release(key);
+    if (ok) *container = result;
+    return ok;
+}
+
+bool php_aot_assign_dim(php_aot_frame_t* frame, uint32_t cv, uint32_t op2, php_value_t* keys) {
+    uint32_t depth = PHP_DIM_DEPTH(op2);
+    php_value_t result;
+    if (!vm_assign_dim(&frame->cvs[cv], keys, depth, (uint8_t)PHP_DIM_EXTRA(op2), &keys[depth], &result)) {
+        return false;
+    }
+    keys[0] = result;
+    return true;
+}
+
+bool php_aot_inc_dec_dim(php_aot_frame_t* frame, uint32_t cv, uint32_t op2, php_value_t* keys) {
+    php_value_t result;
+    if (!vm_inc_dec_dim(&frame->cvs[cv], keys, PHP_DIM_DEPTH(op2), (uint8_t)PHP_DIM_EXTRA(op2), &result)) {
+        return false;
+    }
+    keys[0] = result;
+    return true;
+}
+
+bool php_aot_fe_reset(php_value_t* value, php_value_t* position) {
+    if (value->type != PHP_TYPE_ARRAY) {
+        vm_warning("foreach() argument must be of type array|object, %s given", php_value_type_name(value));
+        php_value_release(value);
+        return false;
+    }
+    php_value_set_int(position, 0);
+    return true;
+}
+
+bool php_aot_fe_fetch(php_aot_frame_t* frame, uint32_t cv, php_value_t* iterator, php_value_t* key) {
+    uint32_t next = (uint32_t)iterator[1].value.int_val;
+    php_array_key_t element_key;
+    const php_value_t* element = php_array_next(iterator[0].value.arr, &next, &element_key);
+    if (!element) return false;
+    iterator[1].value.int_val = next;
+    php_variable_assign(&frame->cvs[cv], element);
+    if (key) {
+        if (element_key.str) {
+            php_value_set_str(key, php_string_addref(element_key.str));
+        } else {
+            php_value_set_int(key, element_key.index);
+        }
+    }
+    return true;
+}
+
+void php_aot_echo(php_value_t* value) {
+    vm_echo(value);
+}
+
+void php_aot_echo_const(php_aot_frame_t* frame, uint32_t literal) {
+    const php_string_t* str = frame->op_array->literals[literal].value.str;
+    php_output_write_static(str->val, str->len);
+}
+
+bool php_aot_call(php_aot_frame_t* frame, uint32_t name_literal, uint32_t argc, php_value_t* args) {
+    size_t base = vm_stack_top;
+    for (uint32_t i = 0; i < argc; i++) {
+        vm_push(&args[i]);
+    }
+
+    const php_op_array_t* func;
+    const php_function_t* builtin;
+    bool ok = vm_call_target(frame->op_array, name_literal, &func, &builtin);
+    if (ok && func && vm_runs_native(func)) {
+        ok = vm_call_native(func, argc);
+    } else if (ok && func) {
+        size_t base_frames = vm_frame_count;
+        ok = push_frame(func, base, argc) && vm_run(base_frames);
+    } else if (ok) {
+        ok = call_builtin(builtin, argc);
+    }
+    if (!ok) {
+        vm_stack_release(base);
+        return false;
+    }
+    args[0] = *vm_pop();
+    return true;
+}
@@ -0,0 +1,45 @@
+/**
+ * PHP Executor Header
+ * Stack-based virtual machine for compiled op arrays
+ */
+
+#ifndef PHP_EXECUTOR_H
+#define PHP_EXECUTOR_H
+
+#include "php_compiler.h"
+#include "php_variables.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Executor lifecycle
+bool php_executor_init(void);
+void php_executor_cleanup(void);
+
+// Run a compiled script; false on an uncaught fatal error
+bool php_executor_execute(const php_op_array_t* op_array);
+
+// Status requested by exit()/die(), 0 otherwise
+int php_executor_get_exit_status(void);
+
+// Variables of the innermost running function, or the globals when no
+// function is running; used by builtins such as extract()
+php_symbol_table_t* php_executor_active_symbols(void);
+
+// Warning and notice at the current script position, for builtins
+void php_executor_warning(const char* fmt, ...);
+void php_executor_notice(const char* fmt, ...);
+
+// Constant folding: apply an operator (ext as in php_op_t) or call a builtin
+// on constant operands the way the VM would. False, with nothing reported,
+// when the VM would report something; the work is then left for run time.
+bool php_executor_fold_op(uint8_t opcode, uint8_t ext, const php_value_t* a, const php_value_t* b,
+                          php_value_t* result);
+bool php_executor_fold_call(const php_function_t* func, int argc, php_value_t** argv, php_value_t* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_EXECUTOR_H
@@ -0,0 +1,433 @@
+/**
+ * PHP Number Formatting
+ * Digit-pair integer conversion and Grisu3 shortest float digits
+ */
+
+#include "php_format.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---------------------------------------------------------------------------
+// Integers
+// ---------------------------------------------------------------------------
+
+// "00" to "99", two digits per division
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Writes the digits of value backwards from end, returns the first one
+static char* format_digits(uint64_t value, char* end) {
+    char* p = end;
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    }
+    if (value >= 10) {
+        unsigned pair = (unsigned)value * 2;
+        *--p = digit_pairs[pair + 1];
+        *--p = digit_pairs[pair];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return p;
+}
+
+size_t php_format_int(int64_t value, char* buffer) {
+    char digits[PHP_FORMAT_INT_SIZE];
+    char* end = digits + sizeof(digits);
+    // Negated as unsigned so INT64_MIN has a magnitude
+    char* start = format_digits(value < 0 ? 0 - (uint64_t)value : (uint64_t)value, end);
+
+    size_t length = 0;
+    if (value < 0) {
+        buffer[length++] = '-';
+    }
+    memcpy(buffer + length, start, (size_t)(end - start));
+    length += (size_t)(end - start);
+    buffer[length] = '\0';
+    return length;
+}
+
+// ---------------------------------------------------------------------------
+// Shortest float digits
+// ---------------------------------------------------------------------------
+
+// f * 2^e with a 64-bit significand
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+// 10^decimal_exponent as a normalized diy_fp_t, rounded to nearest
+typedef struct {
+    uint64_t f;
+    int16_t e;
+    int16_t decimal_exponent;
+} cached_power_t;
+
+// Decimal exponents -348, -340, ..., 340
+static const cached_power_t cached_powers[] = {
+    {0xFA8FD5A0081C0288ull, -1220, -348},
+    {0xBAAEE17FA23EBF76ull, -1193, -340},
+    {0x8B16FB203055AC76ull, -1166, -332},
+    {0xCF42894A5DCE35EAull, -1140, -324},
+    {0x9A6BB0AA55653B2Dull, -1113, -316},
+    {0xE61ACF033D1A45DFull, -1087, -308},
+    {0xAB70FE17C79AC6CAull, -1060, -300},
+    {0xFF77B1FCBEBCDC4Full, -1034, -292},
+    {0xBE5691EF416BD60Cull, -1007, -284},
+    {0x8DD01FAD907FFC3Cull, -980, -276},
+    {0xD3515C2831559A83ull, -954, -268},
+    {0x9D71AC8FADA6C9B5ull, -927, -260},
+    {0xEA9C227723EE8BCBull, -901, -252},
+    {0xAECC49914078536Dull, -874, -244},
+    {0x823C12795DB6CE57ull, -847, -236},
+    {0xC21094364DFB5637ull, -821, -228},
+    {0x9096EA6F3848984Full, -794, -220},
+    {0xD77485CB25823AC7ull, -768, -212},
+    {0xA086CFCD97BF97F4ull, -741, -204},
+    {0xEF340A98172AACE5ull, -715, -196},
+    {0xB23867FB2A35B28Eull, -688, -188},
+    {0x84C8D4DFD2C63F3Bull, -661, -180},
+    {0xC5DD44271AD3CDBAull, -635, -172},
+    {0x936B9FCEBB25C996ull, -608, -164},
+    {0xDBAC6C247D62A584ull, -582, -156},
+    {0xA3AB66580D5FDAF6ull, -555, -148},
+    {0xF3E2F893DEC3F126ull, -529, -140},
+    {0xB5B5ADA8AAFF80B8ull, -502, -132},
+    {0x87625F056C7C4A8Bull, -475, -124},
+    {0xC9BCFF6034C13053ull, -449, -116},
+    {0x964E858C91BA2655ull, -422, -108},
+    {0xDFF9772470297EBDull, -396, -100},
+    {0xA6DFBD9FB8E5B88Full, -369, -92},
+    {0xF8A95FCF88747D94ull, -343, -84},
+    {0xB94470938FA89BCFull, -316, -76},
+    {0x8A08F0F8BF0F156Bull, -289, -68},
+    {0xCDB02555653131B6ull, -263, -60},
+    {0x993FE2C6D07B7FACull, -236, -52},
+    {0xE45C10C42A2B3B06ull, -210, -44},
+    {0xAA242499697392D3ull, -183, -36},
+    {0xFD87B5F28300CA0Eull, -157, -28},
+    {0xBCE5086492111AEBull, -130, -20},
+    {0x8CBCCC096F5088CCull, -103, -12},
+    {0xD1B71758E219652Cull, -77, -4},
+    {0x9C40000000000000ull, -50, 4},
+    {0xE8D4A51000000000ull, -24, 12},
+    {0xAD78EBC5AC620000ull, 3, 20},
+    {0x813F3978F8940984ull, 30, 28},
+    {0xC097CE7BC90715B3ull, 56, 36},
+    {0x8F7E32CE7BEA5C70ull, 83, 44},
+    {0xD5D238A4ABE98068ull, 109, 52},
+    {0x9F4F2726179A2245ull, 136, 60},
+    {0xED63A231D4C4FB27ull, 162, 68},
+    {0xB0DE65388CC8ADA8ull, 189, 76},
+    {0x83C7088E1AAB65DBull, 216, 84},
+    {0xC45D1DF942711D9Aull, 242, 92},
+    {0x924D692CA61BE758ull, 269, 100},
+    {0xDA01EE641A708DEAull, 295, 108},
+    {0xA26DA3999AEF774Aull, 322, 116},
+    {0xF209787BB47D6B85ull, 348, 124},
+    {0xB454E4A179DD1877ull, 375, 132},
+    {0x865B86925B9BC5C2ull, 402, 140},
+    {0xC83553C5C8965D3Dull, 428, 148},
+    {0x952AB45CFA97A0B3ull, 455, 156},
+    {0xDE469FBD99A05FE3ull, 481, 164},
+    {0xA59BC234DB398C25ull, 508, 172},
+    {0xF6C69A72A3989F5Cull, 534, 180},
+    {0xB7DCBF5354E9BECEull, 561, 188},
+    {0x88FCF317F22241E2ull, 588, 196},
+    {0xCC20CE9BD35C78A5ull, 614, 204},
+    {0x98165AF37B2153DFull, 641, 212},
+    {0xE2A0B5DC971F303Aull, 667, 220},
+    {0xA8D9D1535CE3B396ull, 694, 228},
+    {0xFB9B7CD9A4A7443Cull, 720, 236},
+    {0xBB764C4CA7A44410ull, 747, 244},
+    {0x8BAB8EEFB6409C1Aull, 774, 252},
+    {0xD01FEF10A657842Cull, 800, 260},
+    {0x9B10A4E5E9913129ull, 827, 268},
+    {0xE7109BFBA19C0C9Dull, 853, 276},
+    {0xAC2820D9623BF429ull, 880, 284},
+    {0x80444B5E7AA7CF85ull, 907, 292},
+    {0xBF21E44003ACDD2Dull, 933, 300},
+    {0x8E679C2F5E44FF8Full, 960, 308},
+    {0xD433179D9C8CB841ull, 986, 316},
+    {0x9E19DB92B4E31BA9ull, 1013, 324},
+    {0xEB96BF6EBADF77D9ull, 1039, 332},
+    {0xAF87023B9BF0EE6Bull, 1066, 340},
+};
+
+#define CACHED_POWERS_OFFSET 348
+#define CACHED_POWERS_STEP 8
+
+// Scaled values get a binary exponent in this range, so that the integral
+// part of a digit generation fits 32 bits
+#define MIN_TARGET_EXPONENT (-60)
+
+static diy_fp_t fp_multiply(diy_fp_t a, diy_fp_t b) {
+    uint64_t a_hi = a.f >> 32, a_lo = a.f & 0xFFFFFFFFu;
+    uint64_t b_hi = b.f >> 32, b_lo = b.f & 0xFFFFFFFFu;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    // Upper 64 bits of the product, rounded
+    uint64_t middle = ((a_lo * b_lo) >> 32) + (hi_lo & 0xFFFFFFFFu) + (lo_hi & 0xFFFFFFFFu) + (1u << 31);
+    return (diy_fp_t){a_hi * b_hi + (hi_lo >> 32) + (lo_hi >> 32) + (middle >> 32), a.e + b.e + 64};
+}
+
+static diy_fp_t fp_normalize(diy_fp_t x) {
+    int shift = __builtin_clzll(x.f);
+    return (diy_fp_t){x.f << shift, x.e - shift};
+}
+
+// Moves the last digit towards w while that stays inside the interval, then
+// checks that the result is the unique closest shortest representation
+static bool round_weed(char* buffer, int length, uint64_t distance_too_high_w, uint64_t unsafe_interval,
+                       uint64_t rest, uint64_t ten_kappa, uint64_t unit) {
+    uint64_t small_distance = distance_too_high_w - unit;
+    uint64_t big_distance = distance_too_high_w + unit;
+    while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance)) {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+    if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance)) {
+        return false;
+    }
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+// Generates digits of high until they fall inside (low, high), keeping a
+// unit of slack on both sides for the rounding of the scaled values
+static bool digit_gen(diy_fp_t low, diy_fp_t w, diy_fp_t high, char* buffer, int* length, int* kappa) {
+    uint64_t unit = 1;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe_interval = too_high - (low.f - unit);
+    int shift = -w.e;
+    uint64_t one = (uint64_t)1 << shift;
+    uint32_t integrals = (uint32_t)(too_high >> shift);
+    uint64_t fractionals = too_high & (one - 1);
+
+    uint32_t divisor = 1;
+    *kappa = 1;
+    while (divisor <= integrals / 10) {
+        divisor *= 10;
+        (*kappa)++;
+    }
+
+    *length = 0;
+    while (*kappa > 0) {
+        buffer[(*length)++] = (char)('0' + integrals / divisor);
+        integrals %= divisor;
+        (*kappa)--;
+        uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+        if (rest < unsafe_interval) {
+            return round_weed(buffer, *length, too_high - w.f, unsafe_interval, rest,
+                              (uint64_t)divisor << shift, unit);
+        }
+        divisor /= 10;
+    }
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        buffer[(*length)++] = (char)('0' + (fractionals >> shift));
+        fractionals &= one - 1;
+        (*kappa)--;
+        if (fractionals < unsafe_interval) {
+            return round_weed(buffer, *length, (too_high - w.f) * unit, unsafe_interval, fractionals, one, unit);
+        }
+    }
+}
+
+// Grisu3: shortest digits of a positive finite value, value = digits *
+// 10^exponent, or false in the rare cases it cannot prove the result
+static bool grisu3(double value, char* digits, int* length, int* exponent) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint64_t significand = bits & 0x000FFFFFFFFFFFFFull;
+    int biased_exponent = (int)((bits >> 52) & 0x7FF);
+
+    diy_fp_t v = biased_exponent == 0 ? (diy_fp_t){significand, 1 - 1075}
+                                      : (diy_fp_t){significand | 0x0010000000000000ull, biased_exponent - 1075};
+
+    // Midpoints to the neighbouring doubles; the lower one is closer at
+    // powers of two
+    diy_fp_t plus = fp_normalize((diy_fp_t){(v.f << 1) + 1, v.e - 1});
+    diy_fp_t minus = significand == 0 && biased_exponent > 1 ? (diy_fp_t){(v.f << 2) - 1, v.e - 2}
+                                                             : (diy_fp_t){(v.f << 1) - 1, v.e - 1};
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    diy_fp_t w = fp_normalize(v);
+
+    // Scale by the cached power of ten that brings w into the target range
+    int k = (int)ceil((MIN_TARGET_EXPONENT - (w.e + 64) + 63) * 0.30102999566398114);
+    const cached_power_t* power = &cached_powers[(CACHED_POWERS_OFFSET + k - 1) / CACHED_POWERS_STEP + 1];
+    diy_fp_t ten_mk = {power->f, power->e};
+
+    int kappa;
+    bool found = digit_gen(fp_multiply(minus, ten_mk), fp_multiply(w, ten_mk), fp_multiply(plus, ten_mk),
+                           digits, length, &kappa);
+    *exponent = kappa - power->decimal_exponent;
+    return found;
+}
+
+// Digits and decimal point of a "%.*e" rendering
+static int parse_exponential(const char* raw, char* digits, int* decpt) {
+    int length = 0;
+    const char* p = raw;
+    for (; *p != 'e'; p++) {
+        if (*p >= '0' && *p <= '9') {
+            digits[length++] = *p;
+        }
+    }
+    *decpt = atoi(p + 1) + 1;
+    return length;
+}
+
+// Shortest digits of a positive finite value and the position of the
+// decimal point: value = 0.digits * 10^decpt
+static int shortest_digits(double value, char* digits, int* decpt) {
+    int length, exponent;
+    if (grisu3(value, digits, &length, &exponent)) {
+        *decpt = length + exponent;
+        return length;
+    }
+
+    // Grisu3 gives up on about 0.5% of doubles; search with printf instead
+    char raw[40];
+    for (int precision = 1;; precision++) {
+        snprintf(raw, sizeof(raw), "%.*e", precision - 1, value);
+        if (precision == 17 || strtod(raw, NULL) == value) break;
+    }
+    return parse_exponential(raw, digits, decpt);
+}
+
+// Digits rounded to precision significant digits, like printf
+static int precision_digits(double value, int precision, char* digits, int* decpt) {
+    char raw[40];
+    if (precision > 15 || value < DBL_MIN) {
+        snprintf(raw, sizeof(raw), "%.*e", precision - 1, value);
+        return parse_exponential(raw, digits, decpt);
+    }
+
+    // The shortest digits of a normal double lie within half an ulp of it,
+    // a relative 2^-53. Up to 15 digits
+    // that is under half a unit of the last kept digit, so when they are no
+    // longer they are the rounded digits. Up to 14 it is under 0.012 units,
+    // so rounding them rounds value the same way unless they are that close
+    // to a midpoint.
+    int length = shortest_digits(value, digits, decpt);
+    if (length <= precision) {
+        return length;
+    }
+    int dropped = (digits[precision] - '0') * 100;
+    if (length > precision + 1) dropped += (digits[precision + 1] - '0') * 10;
+    if (length > precision + 2) dropped += digits[precision + 2] - '0';
+    if (precision <= 14 && (dropped < 480 || dropped > 520)) {
+        if (dropped > 500) {
+            int i = precision - 1;
+            while (i >= 0 && digits[i] == '9') {
+                digits[i--] = '0';
+            }
+            if (i < 0) {
+                digits[0] = '1';
+                (*decpt)++;
+            } else {
+                digits[i]++;
+            }
+        }
+        return precision;
+    }
+
+    snprintf(raw, sizeof(raw), "%.*e", precision - 1, value);
+    return parse_exponential(raw, digits, decpt);
+}
+
+// Layout of PHP's php_gcvt: exponential when the decimal point is more
+// than ndigit places right or four places left of the first digit
+size_t php_format_float(double value, int precision, char* buffer) {
+    if (isnan(value)) {
+        memcpy(buffer, "NAN", 4);
+        return 3;
+    }
+    if (isinf(value)) {
+        memcpy(buffer, value < 0 ? "-INF" : "INF", value < 0 ? 5 : 4);
+        return value < 0 ? 4 : 3;
+    }
+
+    char* out = buffer;
+    if (signbit(value)) {
+        *out++ = '-';
+        value = -value;
+    }
+    if (value == 0) {
+        *out++ = '0';
+        *out = '\0';
+        return (size_t)(out - buffer);
+    }
+
+    char digits[24];
+    int decpt;
+    if (precision > 17) {
+        precision = 17;
+    }
+    int length = precision > 0 ? precision_digits(value, precision, digits, &decpt)
+                               : shortest_digits(value, digits, &decpt);
+    while (length > 1 && digits[length - 1] == '0') {
+        length--;
+    }
+    int ndigit = precision > 0 ? precision : 17;
+
+    if (decpt < 0 ? decpt < -3 : decpt > ndigit) {
+        // 1.0E+25, 1.5E-7: always a fraction, exponent unpadded
+        *out++ = digits[0];
+        *out++ = '.';
+        if (length > 1) {
+            memcpy(out, digits + 1, (size_t)(length - 1));
+            out += length - 1;
+        } else {
+            *out++ = '0';
+        }
+        *out++ = 'E';
+        *out++ = decpt - 1 < 0 ? '-' : '+';
+        out += php_format_int(decpt - 1 < 0 ? 1 - decpt : decpt - 1, out);
+        return (size_t)(out - buffer);
+    }
+
+    if (decpt <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        memset(out, '0', (size_t)-decpt);
+        out += -decpt;
+        memcpy(out, digits, (size_t)length);
+        out += length;
+    } else if (decpt >= length) {
+        memcpy(out, digits, (size_t)length);
+        out += length;
+        memset(out, '0', (size_t)(decpt - length));
+        out += decpt - length;
+    } else {
+        memcpy(out, digits, (size_t)decpt);
+        out += decpt;
+        *out++ = '.';
+        memcpy(out, digits + decpt, (size_t)(length - decpt));
+        out += length - decpt;
+    }
+    *out = '\0';
+    return (size_t)(out - buffer);
+}
@@ -0,0 +1,35 @@
+/**
+ * PHP Number Formatting Header
+ * Integer and float to text conversion for output and string casts
+ */
+
+#ifndef PHP_FORMAT_H
+#define PHP_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Buffer sizes that fit any result, terminator included
+#define PHP_FORMAT_INT_SIZE 21          // "-9223372036854775808"
+#define PHP_FORMAT_FLOAT_SIZE 32        // "-1.2345678901234567E-308"
+
+// Default of PHP's precision directive, used by echo and string casts
+#define PHP_FORMAT_PRECISION 14
+
+// Both write a NUL-terminated result and return its length
+size_t php_format_int(int64_t value, char* buffer);
+
+// A float the way PHP prints it with precision significant digits; 0 gives
+// the shortest text that reads back as the same double, like var_dump and
+// json_encode with serialize_precision=-1
+size_t php_format_float(double value, int precision, char* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_FORMAT_H
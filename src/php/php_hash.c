@@ -0,0 +1,206 @@
+/**
+ * PHP Hash Table Implementation
+ * String-keyed open-addressing tables
+ */
+
+#include "php_hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define HASH_MIN_CAPACITY 8
+
+// Marks a deleted slot so probe chains stay intact
+static const char hash_tombstone[1] = {0};
+
+static inline char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// FNV-1a
+uint64_t php_hash_bytes(const char* str, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t php_hash_bytes_lower(const char* str, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)ascii_lower(str[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static inline uint64_t table_hash(const php_hash_t* table, const char* key, size_t key_len) {
+    return table->case_insensitive ? php_hash_bytes_lower(key, key_len) : php_hash_bytes(key, key_len);
+}
+
+static size_t round_capacity(size_t capacity) {
+    size_t result = HASH_MIN_CAPACITY;
+    while (result < capacity) {
+        result <<= 1;
+    }
+    return result;
+}
+
+bool php_hash_init(php_hash_t* table, size_t initial_capacity, bool case_insensitive) {
+    table->capacity = round_capacity(initial_capacity);
+    table->buckets = calloc(table->capacity, sizeof(php_hash_bucket_t));
+    table->count = 0;
+    table->used = 0;
+    table->case_insensitive = case_insensitive;
+    return table->buckets != NULL;
+}
+
+void php_hash_destroy(php_hash_t* table) {
+    free(table->buckets);
+    table->buckets = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    table->used = 0;
+}
+
+void php_hash_clear(php_hash_t* table) {
+    if (table->buckets) {
+        memset(table->buckets, 0, table->capacity * sizeof(php_hash_bucket_t));
+    }
+    table->count = 0;
+    table->used = 0;
+}
+
+static inline bool bucket_matches(const php_hash_t* table, const php_hash_bucket_t* bucket,
+                                  const char* key, size_t key_len, uint64_t hash) {
+    if (bucket->hash != hash || bucket->key_len != key_len || bucket->key == hash_tombstone) {
+        return false;
+    }
+    if (bucket->key == key) {
+        return true;
+    }
+    return table->case_insensitive ? strncasecmp(bucket->key, key, key_len) == 0
+                                   : memcmp(bucket->key, key, key_len) == 0;
+}
+
+// Slot holding the key, or the slot an insert should use
+static php_hash_bucket_t* find_slot(const php_hash_t* table, const char* key, size_t key_len,
+                                    uint64_t hash, bool* found) {
+    size_t mask = table->capacity - 1;
+    size_t index = (size_t)hash & mask;
+    php_hash_bucket_t* reuse = NULL;
+
+    for (;;) {
+        php_hash_bucket_t* bucket = &table->buckets[index];
+        if (!bucket->key) {
+            *found = false;
+            return reuse ? reuse : bucket;
+        }
+        if (bucket->key == hash_tombstone) {
+            if (!reuse) reuse = bucket;
+        } else if (bucket_matches(table, bucket, key, key_len, hash)) {
+            *found = true;
+            return bucket;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static bool resize(php_hash_t* table, size_t new_capacity) {
+    php_hash_bucket_t* old_buckets = table->buckets;
+    size_t old_capacity = table->capacity;
+
+    php_hash_bucket_t* buckets = calloc(new_capacity, sizeof(php_hash_bucket_t));
+    if (!buckets) return false;
+
+    table->buckets = buckets;
+    table->capacity = new_capacity;
+    table->used = table->count;
+
+    // Rehashing is cheap because every bucket keeps its full hash
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++) {
+        php_hash_bucket_t* bucket = &old_buckets[i];
+        if (!bucket->key || bucket->key == hash_tombstone) continue;
+
+        size_t index = (size_t)bucket->hash & mask;
+        while (buckets[index].key) {
+            index = (index + 1) & mask;
+        }
+        buckets[index] = *bucket;
+    }
+
+    free(old_buckets);
+    return true;
+}
+
+void* php_hash_find(const php_hash_t* table, const char* key, size_t key_len, uint64_t hash) {
+    if (!table->buckets || table->count == 0) return NULL;
+
+    bool found;
+    php_hash_bucket_t* bucket = find_slot(table, key, key_len, hash, &found);
+    return found ? bucket->value : NULL;
+}
+
+bool php_hash_insert(php_hash_t* table, const char* key, size_t key_len, uint64_t hash, void* value) {
+    if (!table->buckets && !php_hash_init(table, HASH_MIN_CAPACITY, table->case_insensitive)) {
+        return false;
+    }
+
+    // Keep the load factor, tombstones included, at or below 3/4
+    if ((table->used + 1) * 4 > table->capacity * 3) {
+        size_t new_capacity = (table->count + 1) * 2 > table->capacity ? table->capacity * 2 : table->capacity;
+        if (!resize(table, new_capacity)) return false;
+    }
+
+    bool found;
+    php_hash_bucket_t* bucket = find_slot(table, key, key_len, hash, &found);
+    if (!found) {
+        if (!bucket->key) {
+            table->used++;
+        }
+        table->count++;
+        bucket->key = key;
+        bucket->key_len = key_len;
+        bucket->hash = hash;
+    }
+    bucket->value = value;
+    return true;
+}
+
+bool php_hash_remove(php_hash_t* table, const char* key, size_t key_len, uint64_t hash) {
+    if (!table->buckets || table->count == 0) return false;
+
+    bool found;
+    php_hash_bucket_t* bucket = find_slot(table, key, key_len, hash, &found);
+    if (!found) return false;
+
+    bucket->key = hash_tombstone;
+    bucket->value = NULL;
+    table->count--;
+    return true;
+}
+
+void* php_hash_find_str(const php_hash_t* table, const char* key) {
+    size_t key_len = strlen(key);
+    return php_hash_find(table, key, key_len, table_hash(table, key, key_len));
+}
+
+bool php_hash_insert_str(php_hash_t* table, const char* key, void* value) {
+    size_t key_len = strlen(key);
+    return php_hash_insert(table, key, key_len, table_hash(table, key, key_len), value);
+}
+
+php_hash_bucket_t* php_hash_next(const php_hash_t* table, size_t* position) {
+    for (size_t i = *position; i < table->capacity; i++) {
+        php_hash_bucket_t* bucket = &table->buckets[i];
+        if (bucket->key && bucket->key != hash_tombstone) {
+            *position = i + 1;
+            return bucket;
+        }
+    }
+    *position = table->capacity;
+    return NULL;
+}
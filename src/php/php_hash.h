@@ -0,0 +1,60 @@
+/**
+ * PHP Hash Table Header
+ * String-keyed open-addressing tables
+ */
+
+#ifndef PHP_HASH_H
+#define PHP_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Slot of a hash table; key is NULL for empty slots. Keys are borrowed,
+// so callers pass interned or otherwise long-lived strings.
+typedef struct {
+    const char* key;
+    size_t key_len;
+    uint64_t hash;
+    void* value;
+} php_hash_bucket_t;
+
+// Open-addressing table with linear probing and tombstones
+typedef struct {
+    php_hash_bucket_t* buckets;
+    size_t capacity;            // Power of two
+    size_t count;               // Live entries
+    size_t used;                // Live entries plus tombstones
+    bool case_insensitive;      // ASCII case folding for function names
+} php_hash_t;
+
+// Hashing
+uint64_t php_hash_bytes(const char* str, size_t length);
+uint64_t php_hash_bytes_lower(const char* str, size_t length);
+
+// Table lifecycle
+bool php_hash_init(php_hash_t* table, size_t initial_capacity, bool case_insensitive);
+void php_hash_destroy(php_hash_t* table);
+void php_hash_clear(php_hash_t* table);
+
+// Lookup and update; hash must come from the matching php_hash_bytes variant
+void* php_hash_find(const php_hash_t* table, const char* key, size_t key_len, uint64_t hash);
+bool php_hash_insert(php_hash_t* table, const char* key, size_t key_len, uint64_t hash, void* value);
+bool php_hash_remove(php_hash_t* table, const char* key, size_t key_len, uint64_t hash);
+
+// Convenience wrappers that hash NUL-terminated keys
+void* php_hash_find_str(const php_hash_t* table, const char* key);
+bool php_hash_insert_str(php_hash_t* table, const char* key, void* value);
+
+// Iteration: returns the next live bucket at or after *position, or NULL
+php_hash_bucket_t* php_hash_next(const php_hash_t* table, size_t* position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_HASH_H
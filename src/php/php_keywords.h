@@ -0,0 +1,138 @@
+/**
+ * PHP Keywords
+ * Perfect hash from identifiers to keywords, case-insensitive.
+ * Generated by tools/gen_keywords.c, do not edit.
+ */
+
+#ifndef PHP_KEYWORDS_H
+#define PHP_KEYWORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    PHP_KEYWORD_NONE = -1,
+    PHP_KEYWORD_ABSTRACT,
+    PHP_KEYWORD_AND,
+    PHP_KEYWORD_ARRAY,
+    PHP_KEYWORD_BOOL,
+    PHP_KEYWORD_BREAK,
+    PHP_KEYWORD_CASE,
+    PHP_KEYWORD_CATCH,
+    PHP_KEYWORD_CLASS,
+    PHP_KEYWORD_CLONE,
+    PHP_KEYWORD_CONST,
+    PHP_KEYWORD_CONTINUE,
+    PHP_KEYWORD_DEFAULT,
+    PHP_KEYWORD_ECHO,
+    PHP_KEYWORD_ELSE,
+    PHP_KEYWORD_ELSEIF,
+    PHP_KEYWORD_EMPTY,
+    PHP_KEYWORD_FALSE,
+    PHP_KEYWORD_FINAL,
+    PHP_KEYWORD_FINALLY,
+    PHP_KEYWORD_FLOAT,
+    PHP_KEYWORD_FOR,
+    PHP_KEYWORD_FOREACH,
+    PHP_KEYWORD_FUNCTION,
+    PHP_KEYWORD_GLOBAL,
+    PHP_KEYWORD_IF,
+    PHP_KEYWORD_INCLUDE,
+    PHP_KEYWORD_INCLUDE_ONCE,
+    PHP_KEYWORD_INSTANCEOF,
+    PHP_KEYWORD_INT,
+    PHP_KEYWORD_INTERFACE,
+    PHP_KEYWORD_ISSET,
+    PHP_KEYWORD_MIXED,
+    PHP_KEYWORD_NAMESPACE,
+    PHP_KEYWORD_NEW,
+    PHP_KEYWORD_NOT,
+    PHP_KEYWORD_NULL,
+    PHP_KEYWORD_OBJECT,
+    PHP_KEYWORD_OR,
+    PHP_KEYWORD_PARENT,
+    PHP_KEYWORD_PRINT,
+    PHP_KEYWORD_PRIVATE,
+    PHP_KEYWORD_PROTECTED,
+    PHP_KEYWORD_PUBLIC,
+    PHP_KEYWORD_REQUIRE,
+    PHP_KEYWORD_REQUIRE_ONCE,
+    PHP_KEYWORD_RETURN,
+    PHP_KEYWORD_SELF,
+    PHP_KEYWORD_STATIC,
+    PHP_KEYWORD_STRING,
+    PHP_KEYWORD_SWITCH,
+    PHP_KEYWORD_THIS,
+    PHP_KEYWORD_THROW,
+    PHP_KEYWORD_TRAIT,
+    PHP_KEYWORD_TRUE,
+    PHP_KEYWORD_TRY,
+    PHP_KEYWORD_UNSET,
+    PHP_KEYWORD_USE,
+    PHP_KEYWORD_VAR,
+    PHP_KEYWORD_VOID,
+    PHP_KEYWORD_WHILE,
+    PHP_KEYWORD_XOR,
+    PHP_KEYWORD_COUNT
+} php_keyword_t;
+
+static const char* const php_keyword_names[PHP_KEYWORD_COUNT] = {
+    "abstract", "and", "array", "bool", "break", "case", "catch", "class",
+    "clone", "const", "continue", "default", "echo", "else", "elseif", "empty",
+    "false", "final", "finally", "float", "for", "foreach", "function", "global",
+    "if", "include", "include_once", "instanceof", "int", "interface", "isset", "mixed",
+    "namespace", "new", "not", "null", "object", "or", "parent", "print",
+    "private", "protected", "public", "require", "require_once", "return", "self", "static",
+    "string", "switch", "this", "throw", "trait", "true", "try", "unset",
+    "use", "var", "void", "while", "xor",
+};
+
+static const uint8_t php_keyword_displacements[32] = {
+    1, 0, 0, 0, 0, 0, 1, 0, 2, 0, 1, 0, 0, 0, 3, 0,
+    0, 1, 1, 1, 0, 0, 1, 0, 0, 0, 2, 1, 0, 0, 1, 0,
+};
+
+static const uint8_t php_keyword_slots[128] = {
+    23, 43, 0, 0, 0, 0, 0, 53, 0, 0, 0, 59, 0, 0, 55, 0,
+    32, 0, 0, 45, 0, 40, 0, 0, 0, 16, 31, 0, 48, 0, 49, 6,
+    0, 0, 0, 0, 5, 0, 30, 34, 0, 0, 60, 42, 52, 0, 0, 54,
+    0, 0, 17, 19, 0, 28, 0, 9, 13, 0, 0, 57, 46, 38, 0, 0,
+    47, 0, 3, 44, 0, 26, 0, 14, 0, 25, 2, 12, 0, 0, 61, 0,
+    58, 0, 27, 7, 0, 50, 0, 29, 0, 0, 24, 0, 0, 36, 18, 0,
+    0, 33, 0, 0, 0, 39, 0, 35, 0, 0, 22, 0, 1, 56, 20, 0,
+    0, 11, 51, 37, 15, 21, 0, 0, 0, 0, 4, 0, 8, 0, 41, 10,
+};
+
+static inline char php_keyword_fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Hashes the length and the first, second and last bytes
+static inline uint32_t php_keyword_hash(const char* str, size_t length) {
+    uint32_t h = (uint32_t)length * 0x9E3779B1u;
+    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[0]) * 0x85EBCA77u;
+    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[1]) * 0xC2B2AE3Du;
+    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[length - 1]) * 0x27D4EB2Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+// Keyword spelled by str in any case, or PHP_KEYWORD_NONE
+static inline php_keyword_t php_keyword_lookup(const char* str, size_t length) {
+    if (length < 2) return PHP_KEYWORD_NONE;
+    uint32_t h = php_keyword_hash(str, length);
+    uint32_t displacement = php_keyword_displacements[h & 31];
+    uint32_t slot = ((h >> 8) + displacement * ((h >> 20) | 1)) & 127;
+    int keyword = php_keyword_slots[slot] - 1;
+    if (keyword < 0) return PHP_KEYWORD_NONE;
+
+    const char* name = php_keyword_names[keyword];
+    for (size_t i = 0; i < length; i++) {
+        if (php_keyword_fold(str[i]) != name[i]) return PHP_KEYWORD_NONE;
+    }
+    return name[length] == '\0' ? (php_keyword_t)keyword : PHP_KEYWORD_NONE;
+}
+
+#endif // PHP_KEYWORDS_H
@@ -1,116 +1,245 @@
 /**
  * PHP Memory Management
- * Memory allocation and garbage collection for WebAssembly
+ * Size-class slab allocator backing the request heap
  */
 
-#include "php_engine.h"
+#include "php_memory.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Memory pool for efficient allocation
-typedef struct memory_block {
-    void* ptr;
-    size_t size;
-    bool in_use;
-    struct memory_block* next;
-} memory_block_t;
+// Small blocks are carved from slabs aligned to their size, so the slab a
+// block belongs to is found by masking its address. Huge blocks get an
+// aligned region of their own with the same header in front.
+#define SLAB_SIZE ((size_t)64 * 1024)
+#define SLAB_HUGE UINT32_MAX
+#define SMALL_MAX 3072
+#define CLASS_COUNT 30
+#define SPARE_SLABS_MAX 64          // Empty slabs kept for the next request
 
-static memory_block_t* memory_pool = NULL;
+// Eight classes 8 bytes apart up to 64, then four per power of two
+static const uint32_t class_sizes[CLASS_COUNT] = {
+    8, 16, 24, 32, 40, 48, 56, 64,
+    80, 96, 112, 128, 160, 192, 224, 256,
+    320, 384, 448, 512, 640, 768, 896, 1024,
+    1280, 1536, 1792, 2048, 2560, 3072
+};
+
+// Header at the start of every slab and huge region
+typedef struct memory_slab {
+    uint32_t size_class;        // Index into class_sizes, or SLAB_HUGE
+    size_t size;                // Bytes reserved for a huge block
+    struct memory_slab* prev;   // All slabs and huge regions, for cleanup
+    struct memory_slab* next;
+} memory_slab_t;
+
+// Blocks start past the header, keeping 16-byte alignment
+#define SLAB_HEADER ((sizeof(memory_slab_t) + 15) & ~(size_t)15)
+
+// Freed small blocks link through their first bytes
+typedef struct memory_free {
+    struct memory_free* next;
+} memory_free_t;
+
+typedef struct {
+    memory_free_t* free_list;
+    char* bump;                 // Unused tail of the newest slab of the class
+    char* bump_end;
+} memory_class_t;
+
+static memory_class_t classes[CLASS_COUNT];
+static memory_slab_t* slabs = NULL;
+static memory_slab_t* spare_slabs = NULL;   // Linked through next
+static size_t spare_count = 0;
 static size_t total_allocated = 0;
 static size_t peak_allocated = 0;
 
+static inline uint32_t size_class(size_t size) {
+    if (size <= 64) {
+        return size ? (uint32_t)((size - 1) >> 3) : 0;
+    }
+    // t = floor(log2(size - 1)); the four classes above 2^t are 2^(t-2) apart
+    uint32_t t = 63 - (uint32_t)__builtin_clzll((unsigned long long)(size - 1));
+    return 8 + 4 * (t - 6) + (uint32_t)((size - 1) >> (t - 2)) - 4;
+}
+
+static inline memory_slab_t* slab_of(const void* ptr) {
+    return (memory_slab_t*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+static void slab_link(memory_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = slabs;
+    if (slabs) slabs->prev = slab;
+    slabs = slab;
+}
+
+static void slab_unlink(memory_slab_t* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else slabs = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+}
+
+static inline void count_alloc(size_t size) {
+    total_allocated += size;
+    if (total_allocated > peak_allocated) {
+        peak_allocated = total_allocated;
+    }
+}
+
+static memory_slab_t* region_alloc(size_t size) {
+    void* region = NULL;
+    if (posix_memalign(&region, SLAB_SIZE, size) != 0) {
+        return NULL;
+    }
+    return region;
+}
+
+static void* huge_alloc(size_t size) {
+    if (size > SIZE_MAX - SLAB_HEADER) return NULL;
+    memory_slab_t* region = region_alloc(SLAB_HEADER + size);
+    if (!region) return NULL;
+
+    region->size_class = SLAB_HUGE;
+    region->size = size;
+    slab_link(region);
+    count_alloc(size);
+    return (char*)region + SLAB_HEADER;
+}
+
+static void* small_alloc(uint32_t index) {
+    memory_class_t* cls = &classes[index];
+    size_t size = class_sizes[index];
+
+    void* block = cls->free_list;
+    if (block) {
+        cls->free_list = cls->free_list->next;
+    } else {
+        if (!cls->bump || size > (size_t)(cls->bump_end - cls->bump)) {
+            memory_slab_t* slab = spare_slabs;
+            if (slab) {
+                spare_slabs = slab->next;
+                spare_count--;
+            } else {
+                slab = region_alloc(SLAB_SIZE);
+                if (!slab) return NULL;
+            }
+            slab->size_class = index;
+            slab->size = 0;
+            slab_link(slab);
+            cls->bump = (char*)slab + SLAB_HEADER;
+            cls->bump_end = (char*)slab + SLAB_SIZE;
+        }
+        block = cls->bump;
+        cls->bump += size;
+    }
+    count_alloc(size);
+    return block;
+}
+
+static void free_list(memory_slab_t* current) {
+    while (current) {
+        memory_slab_t* next = current->next;
+        free(current);
+        current = next;
+    }
+}
+
 // Initialize memory management
 bool php_memory_init(void) {
-    memory_pool = NULL;
+    memset(classes, 0, sizeof(classes));
+    slabs = NULL;
+    spare_slabs = NULL;
+    spare_count = 0;
     total_allocated = 0;
     peak_allocated = 0;
     return true;
 }
 
-// Cleanup memory management
+// Cleanup memory management; every block still allocated goes with it
 void php_memory_cleanup(void) {
-    memory_block_t* current = memory_pool;
+    free_list(slabs);
+    free_list(spare_slabs);
+    php_memory_init();
+}
+
+// Drop every block at once. Slabs are kept for reuse up to a limit; the
+// cost depends on the number of slabs, not on what was allocated in them.
+void php_memory_reset(void) {
+    memory_slab_t* current = slabs;
     while (current) {
-        memory_block_t* next = current->next;
-        if (current->ptr) {
-            free(current->ptr);
+        memory_slab_t* next = current->next;
+        if (current->size_class != SLAB_HUGE && spare_count < SPARE_SLABS_MAX) {
+            current->next = spare_slabs;
+            spare_slabs = current;
+            spare_count++;
+        } else {
+            free(current);
         }
-        free(current);
         current = next;
     }
-    memory_pool = NULL;
+    memset(classes, 0, sizeof(classes));
+    slabs = NULL;
+    total_allocated = 0;
+    peak_allocated = 0;
 }
 
 // Allocate memory
 void* php_memory_alloc(size_t size) {
-    memory_block_t* block = malloc(sizeof(memory_block_t));
-    if (!block) return NULL;
-    
-    block->ptr = malloc(size);
-    if (!block->ptr) {
-        free(block);
-        return NULL;
+    if (size > SMALL_MAX) {
+        return huge_alloc(size);
     }
-    
-    block->size = size;
-    block->in_use = true;
-    block->next = memory_pool;
-    memory_pool = block;
-    
-    total_allocated += size;
-    if (total_allocated > peak_allocated) {
-        peak_allocated = total_allocated;
+    return small_alloc(size_class(size));
+}
+
+// Free memory
+void php_memory_free(void* ptr) {
+    if (!ptr) return;
+
+    memory_slab_t* slab = slab_of(ptr);
+    if (slab->size_class == SLAB_HUGE) {
+        total_allocated -= slab->size;
+        slab_unlink(slab);
+        free(slab);
+        return;
     }
-    
-    return block->ptr;
+
+    memory_class_t* cls = &classes[slab->size_class];
+    memory_free_t* block = ptr;
+    block->next = cls->free_list;
+    cls->free_list = block;
+    total_allocated -= class_sizes[slab->size_class];
 }
 
-// Reallocate memory
+// Reallocate memory; blocks that still fit their size class stay put
 void* php_memory_realloc(void* ptr, size_t new_size) {
     if (!ptr) return php_memory_alloc(new_size);
-    
-    // Find the block
-    memory_block_t* current = memory_pool;
-    while (current) {
-        if (current->ptr == ptr) {
-            void* new_ptr = realloc(ptr, new_size);
-            if (new_ptr) {
-                current->ptr = new_ptr;
-                current->size = new_size;
-                return new_ptr;
-            }
-            return NULL;
-        }
-        current = current->next;
-    }
-    
-    return NULL;
-}
 
-// Free memory
-void php_memory_free(void* ptr) {
-    if (!ptr) return;
-    
-    memory_block_t* current = memory_pool;
-    memory_block_t* prev = NULL;
-    
-    while (current) {
-        if (current->ptr == ptr) {
-            free(ptr);
-            total_allocated -= current->size;
-            
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                memory_pool = current->next;
-            }
-            
-            free(current);
-            return;
+    memory_slab_t* slab = slab_of(ptr);
+    size_t old_size;
+    size_t alloc_size = new_size;
+    if (slab->size_class == SLAB_HUGE) {
+        old_size = slab->size;
+        // Shrinking by up to half stays put; growing reserves half as much
+        // again, so strings appended to over and over are copied rarely
+        if (new_size > SMALL_MAX && new_size <= old_size && new_size >= old_size / 2) {
+            return ptr;
+        }
+        if (new_size > old_size && new_size <= SIZE_MAX / 3 * 2) {
+            alloc_size = new_size + new_size / 2;
+        }
+    } else {
+        old_size = class_sizes[slab->size_class];
+        if (new_size <= SMALL_MAX && size_class(new_size) == slab->size_class) {
+            return ptr;
         }
-        prev = current;
-        current = current->next;
     }
+
+    void* new_ptr = php_memory_alloc(alloc_size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    php_memory_free(ptr);
+    return new_ptr;
 }
 
 // Get memory statistics
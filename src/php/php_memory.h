@@ -0,0 +1,36 @@
+/**
+ * PHP Memory Header
+ * Request heap: size-class slabs released in bulk when a request ends
+ */
+
+#ifndef PHP_MEMORY_H
+#define PHP_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lifecycle. reset frees every block still allocated in one step, at the
+// end of each request; cleanup also returns the cached slabs.
+bool php_memory_init(void);
+void php_memory_cleanup(void);
+void php_memory_reset(void);
+
+// Request-lifetime allocations: strings, arrays and variables. Anything
+// that outlives a request (interned strings, compiled scripts) uses malloc.
+void* php_memory_alloc(size_t size);
+void* php_memory_realloc(void* ptr, size_t new_size);
+void php_memory_free(void* ptr);
+
+// Bytes allocated in the current request
+size_t php_memory_get_usage(void);
+size_t php_memory_get_peak_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_MEMORY_H
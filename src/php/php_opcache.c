@@ -0,0 +1,1123 @@
+/**
+ * PHP Opcode Cache Implementation
+ * In-memory and on-disk caching of compiled scripts, and built-in images
+ */
+
+#include "php_opcache.h"
+#include "php_array.h"
+#include "wasi/wasi_shim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// Serialized script format, bumped whenever the op array layout changes
+#define OPCACHE_MAGIC "P2WC"
+#define OPCACHE_FORMAT_VERSION 10
+#define OPCACHE_NO_STRING UINT32_MAX
+
+// A cached script and what it was compiled from
+typedef struct {
+    char* path;
+    uint64_t path_hash;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t content_hash;
+    php_op_array_t* op_array;
+} opcache_entry_t;
+
+// What the validation needs to know about a script on disk
+typedef struct {
+    int64_t mtime;
+    uint64_t size;
+    uint64_t content_hash;
+    char* content;              // Only loaded when needed
+} opcache_source_t;
+
+// Growable buffer for serialization
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} opcache_writer_t;
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+    bool failed;
+} opcache_reader_t;
+
+// Cache state
+static opcache_entry_t* cache_entries = NULL;
+static size_t cache_count = 0;
+static size_t cache_capacity = 0;
+
+// Settings
+static bool cache_enabled = true;
+static bool validate_timestamps = true;
+static bool validate_hash = false;
+static char* file_cache_dir = NULL;
+
+bool php_opcache_init(void) {
+    cache_entries = NULL;
+    cache_count = 0;
+    cache_capacity = 0;
+    return true;
+}
+
+void php_opcache_reset(void) {
+    for (size_t i = 0; i < cache_count; i++) {
+        free(cache_entries[i].path);
+        php_op_array_destroy(cache_entries[i].op_array);
+    }
+    cache_count = 0;
+}
+
+void php_opcache_cleanup(void) {
+    php_opcache_reset();
+    free(cache_entries);
+    cache_entries = NULL;
+    cache_capacity = 0;
+
+    free(file_cache_dir);
+    file_cache_dir = NULL;
+}
+
+static bool ini_bool(const char* value) {
+    return strcmp(value, "1") == 0 || strcasecmp(value, "on") == 0 ||
+           strcasecmp(value, "yes") == 0 || strcasecmp(value, "true") == 0;
+}
+
+bool php_opcache_set_ini(const char* key, const char* value) {
+    if (!key || !value) return false;
+
+    if (strcmp(key, "opcache.enable") == 0) {
+        cache_enabled = ini_bool(value);
+        if (!cache_enabled) {
+            php_opcache_reset();
+        }
+    } else if (strcmp(key, "opcache.file_cache") == 0) {
+        free(file_cache_dir);
+        file_cache_dir = value[0] ? strdup(value) : NULL;
+    } else if (strcmp(key, "opcache.validate_timestamps") == 0) {
+        validate_timestamps = ini_bool(value);
+    } else if (strcmp(key, "opcache.validate_hash") == 0) {
+        validate_hash = ini_bool(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Source files
+// ---------------------------------------------------------------------------
+
+// FNV-1a, used for paths, script contents and the serialized payload
+static uint64_t hash_bytes(const void* data, size_t length) {
+    const uint8_t* bytes = data;
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static php_opcache_reader_t source_reader = NULL;
+
+void php_opcache_set_reader(php_opcache_reader_t reader) {
+    source_reader = reader;
+}
+
+static bool source_stat(const char* filename, opcache_source_t* source) {
+    size_t size = 0;
+    if (source_reader && source_reader(filename, &size)) {
+        // Never modified, so only its size tells it apart
+        source->mtime = 0;
+        source->size = size;
+        return true;
+    }
+
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return false;
+    }
+    source->mtime = (int64_t)st.st_mtime;
+    source->size = (uint64_t)st.st_size;
+    return true;
+}
+
+static bool source_load(const char* filename, opcache_source_t* source) {
+    size_t size = 0;
+    const uint8_t* data = source_reader ? source_reader(filename, &size) : NULL;
+    if (data) {
+        char* content = malloc(size + 1);
+        if (!content) {
+            return false;
+        }
+        memcpy(content, data, size);
+        content[size] = '\0';
+        source->content = content;
+        source->mtime = 0;
+        source->size = size;
+        source->content_hash = hash_bytes(content, size);
+        return true;
+    }
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (file_size < 0) {
+        fclose(file);
+        return false;
+    }
+
+    char* content = malloc((size_t)file_size + 1);
+    if (!content) {
+        fclose(file);
+        return false;
+    }
+
+    size_t read = fread(content, 1, (size_t)file_size, file);
+    content[read] = '\0';
+    fclose(file);
+
+    source->content = content;
+    source->size = read;
+    source->content_hash = hash_bytes(content, read);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// In-memory cache
+// ---------------------------------------------------------------------------
+
+static opcache_entry_t* cache_find(const char* path, uint64_t path_hash) {
+    for (size_t i = 0; i < cache_count; i++) {
+        if (cache_entries[i].path_hash == path_hash && strcmp(cache_entries[i].path, path) == 0) {
+            return &cache_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_remove(opcache_entry_t* entry) {
+    free(entry->path);
+    php_op_array_destroy(entry->op_array);
+    *entry = cache_entries[--cache_count];
+}
+
+static bool cache_store(const char* path, uint64_t path_hash, const opcache_source_t* source,
+                        php_op_array_t* op_array) {
+    if (cache_count >= cache_capacity) {
+        size_t new_capacity = cache_capacity ? cache_capacity * 2 : 16;
+        opcache_entry_t* entries = realloc(cache_entries, new_capacity * sizeof(opcache_entry_t));
+        if (!entries) return false;
+        cache_entries = entries;
+        cache_capacity = new_capacity;
+    }
+
+    opcache_entry_t* entry = &cache_entries[cache_count];
+    entry->path = strdup(path);
+    if (!entry->path) return false;
+    entry->path_hash = path_hash;
+    entry->mtime = source->mtime;
+    entry->size = source->size;
+    entry->content_hash = source->content_hash;
+    entry->op_array = op_array;
+    cache_count++;
+    return true;
+}
+
+static bool cache_is_owned(const php_op_array_t* op_array) {
+    for (size_t i = 0; i < cache_count; i++) {
+        if (cache_entries[i].op_array == op_array) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Serialization
+// ---------------------------------------------------------------------------
+
+static void write_bytes(opcache_writer_t* w, const void* data, size_t length) {
+    if (w->failed) return;
+
+    if (w->length + length > w->capacity) {
+        size_t new_capacity = w->capacity ? w->capacity : 1024;
+        while (new_capacity < w->length + length) {
+            new_capacity *= 2;
+        }
+        uint8_t* new_data = realloc(w->data, new_capacity);
+        if (!new_data) {
+            w->failed = true;
+            return;
+        }
+        w->data = new_data;
+        w->capacity = new_capacity;
+    }
+
+    memcpy(w->data + w->length, data, length);
+    w->length += length;
+}
+
+// Integers are stored little-endian so cache files are portable
+static void write_u64(opcache_writer_t* w, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (uint8_t)(value >> (i * 8));
+    }
+    write_bytes(w, bytes, sizeof(bytes));
+}
+
+static void write_u32(opcache_writer_t* w, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (uint8_t)(value >> (i * 8));
+    }
+    write_bytes(w, bytes, sizeof(bytes));
+}
+
+static void write_u8(opcache_writer_t* w, uint8_t value) {
+    write_bytes(w, &value, 1);
+}
+
+static void write_string(opcache_writer_t* w, const char* str, size_t length) {
+    if (!str) {
+        write_u32(w, OPCACHE_NO_STRING);
+        return;
+    }
+    write_u32(w, (uint32_t)length);
+    write_bytes(w, str, length);
+}
+
+static void write_literal(opcache_writer_t* w, const php_value_t* value) {
+    write_u8(w, (uint8_t)value->type);
+    switch (value->type) {
+        case PHP_TYPE_BOOL:
+            write_u8(w, value->value.bool_val ? 1 : 0);
+            break;
+        case PHP_TYPE_INT:
+            write_u64(w, (uint64_t)value->value.int_val);
+            break;
+        case PHP_TYPE_FLOAT: {
+            uint64_t bits;
+            memcpy(&bits, &value->value.float_val, sizeof(bits));
+            write_u64(w, bits);
+            break;
+        }
+        case PHP_TYPE_STRING:
+            write_string(w, value->value.str->val, value->value.str->len);
+            break;
+        case PHP_TYPE_NULL:
+            break;
+        case PHP_TYPE_ARRAY: {
+            // Constant array literals: count, then a key and a literal per element
+            const php_array_t* array = value->value.arr;
+            write_u32(w, php_array_count(array));
+            uint32_t position = 0;
+            php_array_key_t key;
+            php_value_t* element;
+            while ((element = php_array_next(array, &position, &key)) != NULL) {
+                if (key.str) {
+                    write_u8(w, 1);
+                    write_string(w, key.str->val, key.str->len);
+                } else {
+                    write_u8(w, 0);
+                    write_u64(w, (uint64_t)key.index);
+                }
+                write_literal(w, element);
+            }
+            break;
+        }
+        default:
+            // The compiler only produces scalar and array literals
+            w->failed = true;
+            break;
+    }
+}
+
+static void write_op_array(opcache_writer_t* w, const php_op_array_t* op_array) {
+    write_string(w, op_array->name, op_array->name ? strlen(op_array->name) : 0);
+
+    write_u32(w, op_array->op_count);
+    for (uint32_t i = 0; i < op_array->op_count; i++) {
+        const php_op_t* op = &op_array->ops[i];
+        write_u32(w, op->op1);
+        write_u32(w, op->op2);
+        write_u32(w, op->lineno);
+        write_u8(w, op->opcode);
+        write_u8(w, op->ext);
+    }
+
+    write_u32(w, op_array->literal_count);
+    for (uint32_t i = 0; i < op_array->literal_count; i++) {
+        write_literal(w, &op_array->literals[i]);
+    }
+
+    write_u32(w, op_array->num_cvs);
+    for (uint32_t i = 0; i < op_array->num_cvs; i++) {
+        write_u32(w, op_array->cv_names[i]);
+    }
+    write_u32(w, op_array->num_params);
+    write_u32(w, op_array->required_params);
+    write_u32(w, op_array->by_ref);
+    write_u8(w, op_array->variadic);
+    write_u8(w, op_array->conditional);
+
+    write_u32(w, op_array->function_count);
+    for (uint32_t i = 0; i < op_array->function_count; i++) {
+        write_op_array(w, op_array->functions[i]);
+    }
+}
+
+static const uint8_t* read_bytes(opcache_reader_t* r, size_t length) {
+    if (r->failed || r->length - r->pos < length) {
+        r->failed = true;
+        return NULL;
+    }
+    const uint8_t* bytes = r->data + r->pos;
+    r->pos += length;
+    return bytes;
+}
+
+static uint64_t read_u64(opcache_reader_t* r) {
+    const uint8_t* bytes = read_bytes(r, 8);
+    if (!bytes) return 0;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)bytes[i] << (i * 8);
+    }
+    return value;
+}
+
+static uint32_t read_u32(opcache_reader_t* r) {
+    const uint8_t* bytes = read_bytes(r, 4);
+    if (!bytes) return 0;
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)bytes[i] << (i * 8);
+    }
+    return value;
+}
+
+static uint8_t read_u8(opcache_reader_t* r) {
+    const uint8_t* bytes = read_bytes(r, 1);
+    return bytes ? bytes[0] : 0;
+}
+
+// Bytes of a string in place, or NULL for a missing one
+static const char* read_view(opcache_reader_t* r, size_t* length) {
+    uint32_t len = read_u32(r);
+    if (r->failed || len == OPCACHE_NO_STRING) {
+        return NULL;
+    }
+    *length = len;
+    return (const char*)read_bytes(r, len);
+}
+
+static char* read_string(opcache_reader_t* r, size_t* length) {
+    uint32_t len = read_u32(r);
+    if (r->failed || len == OPCACHE_NO_STRING) {
+        return NULL;
+    }
+    const uint8_t* bytes = read_bytes(r, len);
+    if (!bytes) return NULL;
+
+    char* str = malloc((size_t)len + 1);
+    if (!str) {
+        r->failed = true;
+        return NULL;
+    }
+    memcpy(str, bytes, len);
+    str[len] = '\0';
+    if (length) {
+        *length = len;
+    }
+    return str;
+}
+
+static php_value_t* read_literal(opcache_reader_t* r) {
+    switch (read_u8(r)) {
+        case PHP_TYPE_NULL:
+            return php_value_create_null();
+        case PHP_TYPE_BOOL:
+            return php_value_create_bool(read_u8(r) != 0);
+        case PHP_TYPE_INT:
+            return php_value_create_int((int64_t)read_u64(r));
+        case PHP_TYPE_FLOAT: {
+            uint64_t bits = read_u64(r);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return php_value_create_float(value);
+        }
+        case PHP_TYPE_STRING: {
+            size_t length = 0;
+            const char* str = read_view(r, &length);
+            if (!str) {
+                r->failed = true;
+                return NULL;
+            }
+            // Loaded literals are interned straight from the record, just
+            // like compiled ones
+            php_string_t* interned = php_string_intern(str, length);
+            return interned ? php_value_create_str(interned) : NULL;
+        }
+        case PHP_TYPE_ARRAY: {
+            // Every element takes at least two bytes
+            uint32_t count = read_u32(r);
+            if (r->failed || count > (r->length - r->pos) / 2) {
+                r->failed = true;
+                return NULL;
+            }
+            php_array_t* array = php_array_new_persistent(count);
+            if (!array) {
+                r->failed = true;
+                return NULL;
+            }
+            for (uint32_t i = 0; i < count && !r->failed; i++) {
+                php_array_key_t key = {NULL, 0};
+                if (read_u8(r)) {
+                    size_t length = 0;
+                    const char* str = read_view(r, &length);
+                    if (!str) {
+                        r->failed = true;
+                        break;
+                    }
+                    // Keys of literal arrays are interned, as the compiler does
+                    if (!php_array_numeric_key(str, length, &key.index)) {
+                        key.str = php_string_intern(str, length);
+                    }
+                } else {
+                    key.index = (int64_t)read_u64(r);
+                }
+                php_value_t* element = read_literal(r);
+                if (!element) {
+                    r->failed = true;
+                    break;
+                }
+                php_value_t value;
+                php_value_unbox(&value, element);
+                if (!php_array_update(array, &key, &value)) {
+                    r->failed = true;
+                }
+            }
+            if (r->failed) {
+                php_array_free(array);
+                return NULL;
+            }
+            return php_value_create_array(array);
+        }
+        default:
+            r->failed = true;
+            return NULL;
+    }
+}
+
+// The operator an element write applies, as the executor dispatches it
+static bool valid_dim_opcode(const php_op_t* op) {
+    uint8_t opcode = PHP_DIM_EXTRA(op->op2);
+    switch (op->opcode) {
+        case PHP_OP_ASSIGN_DIM:
+            return opcode == PHP_OP_NOP || (opcode >= PHP_OP_ADD && opcode <= PHP_OP_BW_XOR);
+        case PHP_OP_INC_DEC_DIM:
+            return opcode >= PHP_OP_PRE_INC_VAR && opcode <= PHP_OP_POST_DEC_VAR;
+        default:
+            return PHP_DIM_EXTRA(op->op2) == 0;
+    }
+}
+
+// Rebuilds an op array with the same ownership rules as the compiler's
+static php_op_array_t* read_op_array(opcache_reader_t* r, const char* filename) {
+    php_op_array_t* op_array = calloc(1, sizeof(php_op_array_t));
+    if (!op_array) return NULL;
+
+    op_array->name = read_string(r, NULL);
+    op_array->filename = strdup(filename);
+
+    // Every serialized op takes 14 bytes, which bounds the counts we trust
+    uint32_t op_count = read_u32(r);
+    if (!r->failed && (size_t)op_count * 14 <= r->length - r->pos) {
+        op_array->ops = malloc((op_count ? op_count : 1) * sizeof(php_op_t));
+        if (op_array->ops) {
+            op_array->op_capacity = op_count;
+            for (uint32_t i = 0; i < op_count && !r->failed; i++) {
+                php_op_t* op = &op_array->ops[i];
+                op->op1 = read_u32(r);
+                op->op2 = read_u32(r);
+                op->lineno = read_u32(r);
+                op->opcode = read_u8(r);
+                op->ext = read_u8(r);
+                if (op->opcode >= PHP_OP_COUNT) {
+                    r->failed = true;
+                }
+            }
+            op_array->op_count = op_count;
+        }
+    }
+
+    uint32_t literal_count = read_u32(r);
+    if (!r->failed && literal_count <= r->length - r->pos) {
+        op_array->literals = calloc(literal_count ? literal_count : 1, sizeof(php_value_t));
+        if (op_array->literals) {
+            op_array->literal_capacity = literal_count;
+            for (uint32_t i = 0; i < literal_count && !r->failed; i++) {
+                php_value_t* value = read_literal(r);
+                if (value) {
+                    php_value_t* literal = &op_array->literals[op_array->literal_count++];
+                    php_value_unbox(literal, value);
+                    if (literal->type == PHP_TYPE_ARRAY) {
+                        php_array_seal(literal->value.arr);
+                    }
+                }
+            }
+        }
+    }
+
+    op_array->num_cvs = read_u32(r);
+    if (!r->failed && (size_t)op_array->num_cvs * 4 <= r->length - r->pos) {
+        op_array->cv_names = calloc(op_array->num_cvs ? op_array->num_cvs : 1, sizeof(uint32_t));
+        for (uint32_t i = 0; op_array->cv_names && i < op_array->num_cvs; i++) {
+            op_array->cv_names[i] = read_u32(r);
+        }
+    } else {
+        op_array->num_cvs = 0;
+    }
+    op_array->num_params = read_u32(r);
+    op_array->required_params = read_u32(r);
+    op_array->by_ref = read_u32(r);
+    op_array->variadic = read_u8(r) != 0;
+    op_array->conditional = read_u8(r) != 0;
+
+    uint32_t function_count = read_u32(r);
+    if (!r->failed && function_count <= r->length - r->pos) {
+        op_array->functions = calloc(function_count ? function_count : 1, sizeof(php_op_array_t*));
+        if (op_array->functions) {
+            op_array->function_capacity = function_count;
+            for (uint32_t i = 0; i < function_count && !r->failed; i++) {
+                php_op_array_t* func = read_op_array(r, filename);
+                if (func) {
+                    op_array->functions[op_array->function_count++] = func;
+                }
+            }
+        }
+    }
+
+    if (r->failed || !op_array->filename || !op_array->ops || !op_array->literals ||
+        !op_array->cv_names || !op_array->functions) {
+        r->failed = true;
+        php_op_array_destroy(op_array);
+        return NULL;
+    }
+
+    // Operands must stay inside the arrays they index
+    if (op_array->num_params > op_array->num_cvs) {
+        r->failed = true;
+    }
+    for (uint32_t i = 0; i < op_array->num_cvs; i++) {
+        if (op_array->cv_names[i] >= op_array->literal_count ||
+            op_array->literals[op_array->cv_names[i]].type != PHP_TYPE_STRING) {
+            r->failed = true;
+        }
+    }
+    // Only the top level of a script has functions declared when it starts
+    for (uint32_t i = 0; i < op_array->function_count; i++) {
+        if (op_array->name && !op_array->functions[i]->conditional) r->failed = true;
+    }
+    for (uint32_t i = 0; i < op_array->op_count; i++) {
+        const php_op_t* op = &op_array->ops[i];
+        switch (op->opcode) {
+            case PHP_OP_JMP: case PHP_OP_JMPZ: case PHP_OP_JMPNZ: case PHP_OP_JMPZ_EX:
+            case PHP_OP_JMPNZ_EX: case PHP_OP_JMP_SET: case PHP_OP_JMP_NOT_NULL:
+            case PHP_OP_FE_RESET:
+                if (op->op1 > op_array->op_count) r->failed = true;
+                break;
+            case PHP_OP_FE_FETCH:
+                if (op->op1 > op_array->op_count || op->op2 >= op_array->num_cvs) r->failed = true;
+                break;
+            case PHP_OP_RECV:
+                if (op->op1 >= op_array->num_params) r->failed = true;
+                break;
+            case PHP_OP_RECV_INIT:
+                if (op->op1 >= op_array->num_params || op->op2 >= op_array->literal_count) r->failed = true;
+                break;
+            case PHP_OP_RECV_VARIADIC:
+                if (!op_array->variadic || op->op1 + 1 != op_array->num_params) r->failed = true;
+                break;
+            case PHP_OP_PUSH_CONST:
+                if (op->op1 >= op_array->literal_count) r->failed = true;
+                break;
+            case PHP_OP_CONCAT_N:
+                if (op->op1 < 3) r->failed = true;
+                break;
+            case PHP_OP_DECLARE_FUNCTION:
+                if (op->op1 >= op_array->function_count || !op_array->functions[op->op1]->conditional) {
+                    r->failed = true;
+                }
+                break;
+            case PHP_OP_INC_NUMBER: case PHP_OP_DEC_NUMBER:
+                if (op->op1 >= op_array->num_cvs) r->failed = true;
+                break;
+            case PHP_OP_FETCH_VAR: case PHP_OP_FETCH_VAR_QUIET: case PHP_OP_ASSIGN_VAR: case PHP_OP_ASSIGN_OP_VAR:
+            case PHP_OP_UNSET_VAR: case PHP_OP_ISSET_VAR: case PHP_OP_BIND_GLOBAL:
+            case PHP_OP_PRE_INC_VAR: case PHP_OP_PRE_DEC_VAR: case PHP_OP_POST_INC_VAR:
+            case PHP_OP_POST_DEC_VAR: case PHP_OP_FETCH_VAR_REF: case PHP_OP_FETCH_DIM_REF:
+            case PHP_OP_ASSIGN_DIM: case PHP_OP_INC_DEC_DIM: case PHP_OP_UNSET_DIM:
+                // Variables are slots unless their name comes from the stack
+                if (op->ext != PHP_VAR_DYNAMIC && op->op1 >= op_array->num_cvs) r->failed = true;
+                if (op->opcode == PHP_OP_ASSIGN_OP_VAR && (op->op2 < PHP_OP_ADD || op->op2 > PHP_OP_BW_XOR)) {
+                    r->failed = true;
+                }
+                if (op->opcode >= PHP_OP_ASSIGN_DIM && op->opcode <= PHP_OP_UNSET_DIM) {
+                    if (PHP_DIM_DEPTH(op->op2) == 0 || !valid_dim_opcode(op)) r->failed = true;
+                }
+                if (op->opcode == PHP_OP_FETCH_DIM_REF &&
+                    (PHP_DIM_DEPTH(op->op2) == 0 || op->ext == PHP_VAR_DYNAMIC)) {
+                    r->failed = true;
+                }
+                break;
+            case PHP_OP_FETCH_CONSTANT: case PHP_OP_CALL: case PHP_OP_ECHO_CONST:
+                // Names and static output must be string literals
+                if (op->op1 >= op_array->literal_count ||
+                    op_array->literals[op->op1].type != PHP_TYPE_STRING) {
+                    r->failed = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (op_array->op_count == 0 || op_array->ops[op_array->op_count - 1].opcode != PHP_OP_RETURN) {
+        r->failed = true;
+    }
+
+    if (r->failed) {
+        php_op_array_destroy(op_array);
+        return NULL;
+    }
+    return op_array;
+}
+
+static void open_failed(void) {
+    php_engine_error("Failed to open file");
+}
+
+static void open_failed_path(const char* filename) {
+    char message[512];
+    snprintf(message, sizeof(message), "Failed to open %s\n", filename);
+    php_engine_error(message);
+}
+
+// ---------------------------------------------------------------------------
+// Records
+// ---------------------------------------------------------------------------
+//
+// A compiled script as the file cache stores it and modules embed it.
+// Layout: magic, format version, opcode count, source mtime, size and
+// content hash, payload length and hash, then the payload holding the
+// script path and the serialized op array.
+
+#define OPCACHE_HEADER_SIZE (4 + 4 + 4 + 8 + 8 + 8 + 8 + 8)
+
+static void record_write(opcache_writer_t* w, const char* filename, const opcache_source_t* source,
+                         const php_op_array_t* op_array) {
+    opcache_writer_t payload = {0};
+    write_string(&payload, filename, strlen(filename));
+    write_op_array(&payload, op_array);
+
+    write_bytes(w, OPCACHE_MAGIC, 4);
+    write_u32(w, OPCACHE_FORMAT_VERSION);
+    write_u32(w, PHP_OP_COUNT);
+    write_u64(w, (uint64_t)source->mtime);
+    write_u64(w, source->size);
+    write_u64(w, source->content_hash);
+    write_u64(w, payload.length);
+    write_u64(w, hash_bytes(payload.data, payload.length));
+    write_bytes(w, payload.data, payload.length);
+    if (payload.failed) {
+        w->failed = true;
+    }
+    free(payload.data);
+}
+
+// The op array of a record of path built by this engine, named filename.
+// When source is given, the record must also match it as the settings
+// require, and source then takes the values recorded.
+static php_op_array_t* record_read(const uint8_t* data, size_t length, const char* path,
+                                   const char* filename, opcache_source_t* source) {
+    if (length < OPCACHE_HEADER_SIZE) return NULL;
+
+    opcache_reader_t r = {data, length, 0, false};
+    const uint8_t* magic = read_bytes(&r, 4);
+    uint32_t version = read_u32(&r);
+    uint32_t opcode_count = read_u32(&r);
+    int64_t mtime = (int64_t)read_u64(&r);
+    uint64_t size = read_u64(&r);
+    uint64_t content_hash = read_u64(&r);
+    uint64_t payload_length = read_u64(&r);
+    uint64_t payload_hash = read_u64(&r);
+
+    bool valid = !r.failed && memcmp(magic, OPCACHE_MAGIC, 4) == 0 &&
+                 version == OPCACHE_FORMAT_VERSION && opcode_count == PHP_OP_COUNT &&
+                 payload_length == r.length - r.pos &&
+                 hash_bytes(r.data + r.pos, r.length - r.pos) == payload_hash;
+
+    if (valid && source && validate_timestamps) {
+        if (validate_hash) {
+            valid = content_hash == source->content_hash;
+        } else {
+            valid = mtime == source->mtime && size == source->size;
+        }
+    }
+    if (!valid) return NULL;
+
+    // Guard against path hash collisions
+    size_t path_length = 0;
+    const char* stored_path = read_view(&r, &path_length);
+    if (!stored_path || path_length != strlen(path) || memcmp(stored_path, path, path_length) != 0) {
+        return NULL;
+    }
+    php_op_array_t* op_array = read_op_array(&r, filename);
+    if (op_array && (r.pos != r.length || !php_op_array_resolve_calls(op_array))) {
+        php_op_array_destroy(op_array);
+        return NULL;
+    }
+
+    if (op_array && source) {
+        source->mtime = mtime;
+        source->size = size;
+        source->content_hash = content_hash;
+    }
+    return op_array;
+}
+
+// ---------------------------------------------------------------------------
+// File cache
+// ---------------------------------------------------------------------------
+
+static char* file_cache_path(uint64_t path_hash) {
+    size_t length = strlen(file_cache_dir) + 32;
+    char* path = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%016llx.phpc", file_cache_dir, (unsigned long long)path_hash);
+    }
+    return path;
+}
+
+static php_op_array_t* file_cache_load(const char* filename, uint64_t path_hash, opcache_source_t* source) {
+    char* cache_path = file_cache_path(path_hash);
+    if (!cache_path) return NULL;
+
+    FILE* file = fopen(cache_path, "rb");
+    free(cache_path);
+    if (!file) return NULL;
+
+    uint8_t* data = NULL;
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        file_size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+    }
+    if (file_size >= OPCACHE_HEADER_SIZE) {
+        data = malloc((size_t)file_size);
+        if (data && fread(data, 1, (size_t)file_size, file) != (size_t)file_size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (!data) return NULL;
+
+    php_op_array_t* op_array = record_read(data, (size_t)file_size, filename, filename, source);
+    free(data);
+    return op_array;
+}
+
+static void file_cache_store(const char* filename, uint64_t path_hash, const opcache_source_t* source,
+                             const php_op_array_t* op_array) {
+    opcache_writer_t w = {0};
+    record_write(&w, filename, source, op_array);
+
+    // Each process writes under its own temporary name, so concurrent
+    // workers never interleave writes and a file left by one that died
+    // does not block the entry; the rename means readers only ever see
+    // complete files
+    static uint64_t temp_tag = 0;
+    static uint32_t temp_count = 0;
+    if (temp_tag == 0 && wasi_random_get((uint8_t*)&temp_tag, sizeof(temp_tag)) != WASI_ESUCCESS) {
+        temp_tag = (uint64_t)(uintptr_t)&w ^ (uint64_t)time(NULL);
+    }
+
+    char* cache_path = file_cache_path(path_hash);
+    char* temp_path = cache_path ? malloc(strlen(cache_path) + 40) : NULL;
+
+    if (!w.failed && temp_path) {
+        sprintf(temp_path, "%s.%016llx.%u.tmp", cache_path, (unsigned long long)temp_tag, ++temp_count);
+        FILE* file = fopen(temp_path, "wbx");
+        if (file) {
+            bool written = fwrite(w.data, 1, w.length, file) == w.length;
+            written = fclose(file) == 0 && written;
+            if (!written || rename(temp_path, cache_path) != 0) {
+                remove(temp_path);
+            }
+        }
+    }
+
+    free(temp_path);
+    free(cache_path);
+    free(w.data);
+}
+
+// ---------------------------------------------------------------------------
+// Embedded images
+// ---------------------------------------------------------------------------
+
+static const php_opcache_image_t** image_tables = NULL;
+static size_t image_table_count = 0;
+
+void php_opcache_add_images(const php_opcache_image_t* images) {
+    const php_opcache_image_t** grown = realloc(image_tables, (image_table_count + 1) * sizeof(*image_tables));
+    if (!grown) return;
+    image_tables = grown;
+    image_tables[image_table_count++] = images;
+}
+
+// Images are keyed by the path the way the VFS resolves it: "." and ".."
+// resolved and empty components and leading slashes dropped, so
+// "./index.php" and "/index.php" are both "index.php"
+static bool image_key(const char* path, char* out) {
+    size_t n = 0;
+    while (*path) {
+        while (*path == '/') path++;
+        const char* end = path;
+        while (*end && *end != '/') end++;
+        size_t part = (size_t)(end - path);
+
+        if (part == 2 && path[0] == '.' && path[1] == '.') {
+            while (n > 0 && out[--n] != '/') {}
+        } else if (part > 0 && !(part == 1 && path[0] == '.')) {
+            if (n + part + 2 > PATH_MAX) return false;
+            if (n > 0) out[n++] = '/';
+            memcpy(out + n, path, part);
+            n += part;
+        }
+        path = end;
+    }
+    out[n] = '\0';
+    return true;
+}
+
+static const php_opcache_image_t* image_find(const char* path, uint64_t path_hash) {
+    for (size_t t = 0; t < image_table_count; t++) {
+        for (const php_opcache_image_t* image = image_tables[t]; image->path; image++) {
+            if (image->path_hash == path_hash && strcmp(image->path, path) == 0) {
+                return image;
+            }
+        }
+    }
+    return NULL;
+}
+
+// C defining php_opcache_images over the images in the file at image_path,
+// which is included with .incbin rather than spelled out as arrays
+static bool write_image_stub(FILE* out, const char* image_path, const char* const* filenames,
+                             const size_t* offsets, const size_t* sizes, size_t count, size_t total) {
+    bool ok = fprintf(out, "// Generated by php2wasm from compiled PHP scripts; do not edit\n\n"
+                           "#include \"php_opcache.h\"\n\n"
+                           "#ifdef __wasm__\n"
+                           "#define IMAGE_SECTION \".section .rodata.php_opcache_image,\\\"\\\",@\\n\"\n"
+                           "#else\n"
+                           "#define IMAGE_SECTION \".section .rodata.php_opcache_image,\\\"a\\\",@progbits\\n\"\n"
+                           "#endif\n\n"
+                           "__asm__(IMAGE_SECTION\n"
+                           "        \".globl php_opcache_image\\n\"\n"
+                           "        \".type php_opcache_image,@object\\n\"\n"
+                           "        \".p2align 3\\n\"\n"
+                           "        \"php_opcache_image:\\n\"\n"
+                           "        \".incbin \\\"%s\\\"\\n\"\n"
+                           "        \".size php_opcache_image, %zu\\n\");\n\n"
+                           "extern const uint8_t php_opcache_image[];\n\n"
+                           "const php_opcache_image_t php_opcache_images[] = {\n",
+                      image_path, total) > 0;
+    char key[PATH_MAX];
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = image_key(filenames[i], key) && fprintf(out, "    {\"") > 0;
+        for (const unsigned char* p = (const unsigned char*)key; *p && ok; p++) {
+            bool plain = *p >= 0x20 && *p < 0x7f && *p != '"' && *p != '\\' && *p != '?';
+            ok = (plain ? fprintf(out, "%c", *p) : fprintf(out, "\\%03o", *p)) > 0;
+        }
+        ok = ok && fprintf(out, "\", 0x%016llxull, php_opcache_image + %zu, %zu},\n",
+                           (unsigned long long)hash_bytes(key, strlen(key)), offsets[i], sizes[i]) > 0;
+    }
+    return ok && fprintf(out, "    {NULL, 0, NULL, 0}\n};\n") > 0;
+}
+
+int php_opcache_emit_images(const char* const* filenames, size_t count, const char* output) {
+    size_t* offsets = calloc(count ? count * 2 : 2, sizeof(size_t));
+    FILE* image = offsets ? fopen(output, "wb") : NULL;
+    if (!image) {
+        free(offsets);
+        return -1;
+    }
+    size_t* sizes = offsets + count;
+
+    // Images are 8-byte aligned within the file, as the file is in memory
+    static const uint8_t padding[8] = {0};
+    bool ok = true;
+    size_t total = 0;
+    char key[PATH_MAX];
+    for (size_t i = 0; i < count && ok; i++) {
+        opcache_source_t source = {0, 0, 0, NULL};
+        if (!image_key(filenames[i], key)) {
+            ok = false;
+            break;
+        }
+        if (!source_load(filenames[i], &source)) {
+            open_failed_path(filenames[i]);
+            ok = false;
+            break;
+        }
+        php_op_array_t* op_array = php_compile_string(source.content, filenames[i]);
+        free(source.content);
+        if (!op_array) {
+            ok = false;
+            break;
+        }
+
+        opcache_writer_t w = {0};
+        record_write(&w, key, &source, op_array);
+        php_op_array_destroy(op_array);
+        size_t pad = (8 - total % 8) % 8;
+        ok = !w.failed && fwrite(padding, 1, pad, image) == pad && fwrite(w.data, 1, w.length, image) == w.length;
+        free(w.data);
+        offsets[i] = total + pad;
+        sizes[i] = w.length;
+        total = offsets[i] + sizes[i];
+    }
+    if (fclose(image) != 0) {
+        ok = false;
+    }
+
+    // The assembler is given the absolute path of the image
+    char image_path[PATH_MAX];
+    char* stub_path = malloc(strlen(output) + 3);
+    FILE* stub = NULL;
+    if (ok && stub_path && realpath(output, image_path) && !strpbrk(image_path, "\"\\\n")) {
+        sprintf(stub_path, "%s.c", output);
+        stub = fopen(stub_path, "w");
+    }
+    ok = stub && write_image_stub(stub, image_path, filenames, offsets, sizes, count, total);
+    if (stub && fclose(stub) != 0) {
+        ok = false;
+    }
+    free(stub_path);
+    free(offsets);
+    return ok ? (int)count : -1;
+}
+
+// ---------------------------------------------------------------------------
+// Lookup
+// ---------------------------------------------------------------------------
+
+php_op_array_t* php_opcache_compile_file(const char* filename) {
+    if (!filename) return NULL;
+
+    opcache_source_t source = {0, 0, 0, NULL};
+
+    // Scripts built into the module are immutable: no validation, and no
+    // file cache in front of them. One built by another engine version
+    // falls back to the script on disk.
+    char key[PATH_MAX];
+    if (image_table_count && image_key(filename, key)) {
+        const php_opcache_image_t* image = image_find(key, hash_bytes(key, strlen(key)));
+        uint64_t path_hash = hash_bytes(filename, strlen(filename));
+        opcache_entry_t* entry = image && cache_enabled ? cache_find(filename, path_hash) : NULL;
+        if (entry) {
+            return entry->op_array;
+        }
+        php_op_array_t* op_array = image ? record_read(image->data, image->size, key, filename, NULL) : NULL;
+        if (op_array) {
+            if (cache_enabled) {
+                cache_store(filename, path_hash, &source, op_array);
+            }
+            return op_array;
+        }
+    }
+
+    if (!cache_enabled && !file_cache_dir) {
+        if (!source_load(filename, &source)) {
+            open_failed();
+            return NULL;
+        }
+        php_op_array_t* op_array = php_compile_string(source.content, filename);
+        free(source.content);
+        return op_array;
+    }
+
+    uint64_t path_hash = hash_bytes(filename, strlen(filename));
+    opcache_entry_t* entry = cache_enabled ? cache_find(filename, path_hash) : NULL;
+
+    // Validate against the script on disk; the hash needs the contents
+    if (entry && !validate_timestamps) {
+        return entry->op_array;
+    }
+    bool have_source = validate_hash ? source_load(filename, &source) : source_stat(filename, &source);
+    if (!have_source) {
+        if (entry) {
+            cache_remove(entry);
+        }
+        open_failed();
+        return NULL;
+    }
+
+    if (entry) {
+        bool fresh = validate_hash ? entry->content_hash == source.content_hash
+                                   : entry->mtime == source.mtime && entry->size == source.size;
+        if (fresh) {
+            free(source.content);
+            return entry->op_array;
+        }
+        cache_remove(entry);
+    }
+
+    php_op_array_t* op_array = file_cache_dir ? file_cache_load(filename, path_hash, &source) : NULL;
+    if (!op_array) {
+        // The mtime was taken before reading, so a concurrent edit can only
+        // make the entry look stale and force another compile
+        if (!source.content && !source_load(filename, &source)) {
+            open_failed();
+            return NULL;
+        }
+
+        op_array = php_compile_string(source.content, filename);
+        if (op_array && file_cache_dir) {
+            file_cache_store(filename, path_hash, &source, op_array);
+        }
+    }
+    free(source.content);
+
+    // An op array that could not be stored is simply freed by release()
+    if (op_array && cache_enabled) {
+        cache_store(filename, path_hash, &source, op_array);
+    }
+    return op_array;
+}
+
+void php_opcache_release(php_op_array_t* op_array) {
+    if (op_array && !cache_is_owned(op_array)) {
+        php_op_array_destroy(op_array);
+    }
+}
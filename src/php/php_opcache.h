@@ -0,0 +1,68 @@
+/**
+ * PHP Opcode Cache Header
+ * Reuses compiled op arrays across executions of the same script, and
+ * loads the ones built into the module
+ */
+
+#ifndef PHP_OPCACHE_H
+#define PHP_OPCACHE_H
+
+#include "php_compiler.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cache lifecycle
+bool php_opcache_init(void);
+void php_opcache_cleanup(void);
+
+// Configuration, using the php.ini directive names:
+//   opcache.enable               In-memory cache (default 1)
+//   opcache.file_cache           Directory for serialized scripts (default off)
+//   opcache.validate_timestamps  Re-stat scripts before reuse (default 1)
+//   opcache.validate_hash        Compare a content hash instead of mtime/size (default 0)
+bool php_opcache_set_ini(const char* key, const char* value);
+
+// Compile a script or fetch it from the cache. Pair every successful call
+// with php_opcache_release(); cached op arrays stay owned by the cache.
+php_op_array_t* php_opcache_compile_file(const char* filename);
+void php_opcache_release(php_op_array_t* op_array);
+
+// Drop every cached script (the in-memory cache only)
+void php_opcache_reset(void);
+
+// Contents of the script at path from outside the disk, such as the file
+// system packed into the module, kept valid while it runs; NULL when
+// there is none
+typedef const uint8_t* (*php_opcache_reader_t)(const char* path, size_t* size);
+
+// Read scripts through reader before trying the disk
+void php_opcache_set_reader(php_opcache_reader_t reader);
+
+// A script compiled at build time, in the file cache format, under the
+// path it is compiled by with "." and ".." resolved and leading slashes
+// dropped, as the VFS resolves paths; tables of them end with a NULL path
+typedef struct {
+    const char* path;
+    uint64_t path_hash;
+    const uint8_t* data;
+    size_t size;
+} php_opcache_image_t;
+
+// Use built-in scripts instead of the files at their paths. An image is
+// decoded into a new op array when its script is compiled, without
+// revalidation; the table must outlive the runtime.
+void php_opcache_add_images(const php_opcache_image_t* images);
+
+// Write the scripts compiled to images in the file at output, and C
+// defining the php_opcache_images table over that file to output.c.
+// Returns the number of scripts written, or -1 on an error.
+int php_opcache_emit_images(const char* const* filenames, size_t count, const char* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_OPCACHE_H
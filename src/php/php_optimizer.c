@@ -0,0 +1,930 @@
+/**
+ * PHP Optimizer Implementation
+ * Compile-time folding over the AST; jump cleanup and type specialization
+ * over op arrays
+ */
+
+#include "php_optimizer.h"
+#include "php_executor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// ---------------------------------------------------------------------------
+// AST
+// ---------------------------------------------------------------------------
+//
+// Operators are folded by the executor itself, so a folded result is what
+// the op would have produced. Whatever would warn or fail at run time is
+// left alone to do so when the script runs.
+
+// Builtins that change nothing and whose result depends only on their
+// arguments, so a call with constant arguments can run at compile time
+static const char* const pure_functions[] = {
+    "strlen", "count", "sizeof", "strtolower", "strtoupper", "in_array", "array_key_exists",
+    "is_array", "is_string", "is_int", "is_float", "is_bool", "is_null", "is_numeric", "gettype", "trim",
+    "strpos", "substr", "implode", "array_sum", "max", "min", "abs", "sqrt", "pow", "round", "ceil", "floor", NULL
+};
+
+static bool is_pure_function(const char* name) {
+    for (int i = 0; pure_functions[i]; i++) {
+        if (strcasecmp(pure_functions[i], name) == 0) return true;
+    }
+    return false;
+}
+
+static bool is_literal(const php_ast_node_t* node) {
+    switch (node->kind) {
+        case PHP_AST_NULL_LITERAL:
+        case PHP_AST_BOOL_LITERAL:
+        case PHP_AST_INT_LITERAL:
+        case PHP_AST_FLOAT_LITERAL:
+        case PHP_AST_STRING_LITERAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool literal_is_true(const php_ast_node_t* node) {
+    php_value_t* value = php_evaluate_constant(node);
+    bool truth = value && php_value_is_true(value);
+    php_value_destroy(value);
+    return truth;
+}
+
+static void clear_children(php_ast_node_t* node) {
+    for (size_t i = 0; i < node->child_count; i++) {
+        php_ast_destroy(node->children[i]);
+    }
+    free(node->children);
+    node->children = NULL;
+    node->child_count = 0;
+    node->child_capacity = 0;
+}
+
+// Turn node into the literal of value; arrays have none and are left alone
+static bool set_literal(php_ast_node_t* node, const php_value_t* value) {
+    php_ast_kind_t kind;
+    const char* str = NULL;
+    size_t length = 0;
+    switch (value->type) {
+        case PHP_TYPE_NULL: kind = PHP_AST_NULL_LITERAL; break;
+        case PHP_TYPE_BOOL: kind = PHP_AST_BOOL_LITERAL; break;
+        case PHP_TYPE_INT: kind = PHP_AST_INT_LITERAL; break;
+        case PHP_TYPE_FLOAT: kind = PHP_AST_FLOAT_LITERAL; break;
+        case PHP_TYPE_STRING:
+            kind = PHP_AST_STRING_LITERAL;
+            length = value->value.str->len;
+            str = php_intern(value->value.str->val, length);
+            if (!str) return false;
+            break;
+        default:
+            return false;
+    }
+
+    clear_children(node);
+    node->kind = kind;
+    node->op = 0;
+    node->str = str;
+    node->str_len = length;
+    node->int_val = value->type == PHP_TYPE_INT ? value->value.int_val
+                  : value->type == PHP_TYPE_BOOL ? value->value.bool_val : 0;
+    node->float_val = value->type == PHP_TYPE_FLOAT ? value->value.float_val : 0.0;
+    return true;
+}
+
+// Put the child at index in the place of node
+static void replace_with_child(php_ast_node_t* node, size_t index) {
+    php_ast_node_t* child = node->children[index];
+    node->children[index] = NULL;
+    clear_children(node);
+    *node = *child;
+    free(child);
+}
+
+static void make_empty_statement(php_ast_node_t* node) {
+    clear_children(node);
+    node->kind = PHP_AST_STMT_LIST;
+    node->op = 0;
+    node->str = NULL;
+    node->str_len = 0;
+}
+
+// Fold an operator applied to constant operands; b is NULL for unary ones
+static void fold_op(php_ast_node_t* node, uint8_t opcode, uint8_t ext, const php_ast_node_t* a,
+                    const php_ast_node_t* b) {
+    php_value_t* left = php_evaluate_constant(a);
+    php_value_t* right = b ? php_evaluate_constant(b) : NULL;
+    php_value_t result;
+    if (left && (right || !b) && php_executor_fold_op(opcode, ext, left, right, &result)) {
+        set_literal(node, &result);
+        php_value_release(&result);
+    }
+    php_value_destroy(left);
+    php_value_destroy(right);
+}
+
+static void fold_cast(php_ast_node_t* node) {
+    fold_op(node, PHP_OP_CAST, (uint8_t)node->op, node->children[0], NULL);
+}
+
+static void fold_unary(php_ast_node_t* node) {
+    switch (node->op) {
+        case PHP_UNOP_NOT: fold_op(node, PHP_OP_BOOL_NOT, 0, node->children[0], NULL); break;
+        case PHP_UNOP_NEG: fold_op(node, PHP_OP_NEG, 0, node->children[0], NULL); break;
+        case PHP_UNOP_PLUS: fold_op(node, PHP_OP_PLUS, 0, node->children[0], NULL); break;
+        case PHP_UNOP_BW_NOT: fold_op(node, PHP_OP_BW_NOT, 0, node->children[0], NULL); break;
+        default:
+            // "@" has nothing to silence on a literal
+            if (is_literal(node->children[0])) {
+                replace_with_child(node, 0);
+            }
+            break;
+    }
+}
+
+static void fold_binary(php_ast_node_t* node) {
+    php_ast_node_t* left = node->children[0];
+    php_ast_node_t* right = node->children[1];
+
+    switch (node->op) {
+        case PHP_BINOP_BOOL_AND:
+        case PHP_BINOP_BOOL_OR: {
+            // A constant left side either decides the result or leaves (bool) right
+            if (!is_literal(left)) return;
+            bool truth = literal_is_true(left);
+            if (truth == (node->op == PHP_BINOP_BOOL_OR)) {
+                php_value_t result;
+                php_value_set_bool(&result, truth);
+                set_literal(node, &result);
+                return;
+            }
+            node->children[1] = NULL;
+            clear_children(node);
+            node->kind = PHP_AST_CAST;
+            node->op = PHP_TYPE_BOOL;
+            node->children = malloc(sizeof(php_ast_node_t*));
+            node->children[0] = right;
+            node->child_count = 1;
+            node->child_capacity = 1;
+            fold_cast(node);
+            return;
+        }
+        case PHP_BINOP_COALESCE:
+            if (is_literal(left)) {
+                replace_with_child(node, left->kind == PHP_AST_NULL_LITERAL ? 1 : 0);
+            }
+            return;
+        case PHP_BINOP_GREATER:
+            fold_op(node, PHP_OP_IS_SMALLER, 1, left, right);
+            return;
+        case PHP_BINOP_GREATER_OR_EQUAL:
+            fold_op(node, PHP_OP_IS_SMALLER_OR_EQUAL, 1, left, right);
+            return;
+        default: {
+            uint8_t opcode = php_binary_opcode(node->op);
+            if (opcode != PHP_OP_NOP) {
+                fold_op(node, opcode, 0, left, right);
+            }
+            return;
+        }
+    }
+}
+
+static void fold_ternary(php_ast_node_t* node) {
+    if (!is_literal(node->children[0])) return;
+    if (literal_is_true(node->children[0])) {
+        // "a ?: b" gives a itself
+        replace_with_child(node, node->children[1] ? 1 : 0);
+    } else {
+        replace_with_child(node, 2);
+    }
+}
+
+static void fold_call(php_ast_node_t* node) {
+    if (!is_pure_function(node->str)) return;
+    const php_function_t* func = php_engine_find_function(node->str);
+    if (!func) return;
+
+    size_t argc = node->child_count;
+    php_value_t** argv = calloc(argc ? argc : 1, sizeof(php_value_t*));
+    if (!argv) return;
+    bool constant = true;
+    for (size_t i = 0; i < argc && constant; i++) {
+        argv[i] = php_evaluate_constant(node->children[i]);
+        constant = argv[i] != NULL;
+    }
+
+    php_value_t result;
+    if (constant && php_executor_fold_call(func, (int)argc, argv, &result)) {
+        set_literal(node, &result);
+        php_value_release(&result);
+    }
+    for (size_t i = 0; i < argc; i++) {
+        php_value_destroy(argv[i]);
+    }
+    free(argv);
+}
+
+static void fold_constant(php_ast_node_t* node) {
+    php_value_t* value = php_evaluate_constant(node);
+    if (value) {
+        set_literal(node, value);
+        php_value_destroy(value);
+    }
+}
+
+// Drop branches whose condition is false; one that is true becomes the
+// else branch and ends the chain. Functions declared in a dropped branch
+// would never have been declared.
+static void prune_if(php_ast_node_t* node) {
+    size_t last = node->child_count - 1;
+    size_t count = 0;
+    for (size_t i = 0; i < last; i += 2) {
+        php_ast_node_t* cond = node->children[i];
+        php_ast_node_t* body = node->children[i + 1];
+        if (is_literal(cond) && !literal_is_true(cond)) {
+            php_ast_destroy(cond);
+            php_ast_destroy(body);
+            continue;
+        }
+        if (is_literal(cond)) {
+            for (size_t j = i + 2; j <= last; j++) {
+                php_ast_destroy(node->children[j]);
+            }
+            php_ast_destroy(cond);
+            node->children[last] = body;
+            break;
+        }
+        node->children[count++] = cond;
+        node->children[count++] = body;
+    }
+    node->children[count++] = node->children[last];
+    node->child_count = count;
+
+    if (count > 1) return;
+    if (node->children[0]) {
+        replace_with_child(node, 0);
+    } else {
+        make_empty_statement(node);
+    }
+}
+
+static bool ends_flow(const php_ast_node_t* node) {
+    switch (node->kind) {
+        case PHP_AST_RETURN:
+        case PHP_AST_BREAK:
+        case PHP_AST_CONTINUE:
+            return true;
+        case PHP_AST_EXPR_STMT:
+            return node->children[0]->kind == PHP_AST_EXIT;
+        default:
+            return false;
+    }
+}
+
+// Statements after a return, break, continue or exit never run. Function
+// declarations stay, as those at the top level of a script are declared
+// when it starts.
+static void drop_unreachable(php_ast_node_t* list) {
+    size_t count = 0;
+    bool reachable = true;
+    for (size_t i = 0; i < list->child_count; i++) {
+        php_ast_node_t* statement = list->children[i];
+        if (!reachable && (!statement || statement->kind != PHP_AST_FUNC_DECL)) {
+            php_ast_destroy(statement);
+            continue;
+        }
+        list->children[count++] = statement;
+        if (statement && ends_flow(statement)) {
+            reachable = false;
+        }
+    }
+    list->child_count = count;
+}
+
+static void optimize_node(php_ast_node_t* node) {
+    switch (node->kind) {
+        case PHP_AST_CONSTANT:
+            fold_constant(node);
+            break;
+        case PHP_AST_UNARY:
+            fold_unary(node);
+            break;
+        case PHP_AST_BINARY:
+            fold_binary(node);
+            break;
+        case PHP_AST_TERNARY:
+            fold_ternary(node);
+            break;
+        case PHP_AST_CAST:
+            fold_cast(node);
+            break;
+        case PHP_AST_CALL:
+            fold_call(node);
+            break;
+        case PHP_AST_IF:
+            prune_if(node);
+            break;
+        case PHP_AST_WHILE:
+            if (is_literal(node->children[0]) && !literal_is_true(node->children[0])) {
+                make_empty_statement(node);
+            }
+            break;
+        case PHP_AST_STMT_LIST:
+            drop_unreachable(node);
+            break;
+        default:
+            break;
+    }
+}
+
+void php_optimize_ast(php_ast_node_t* node) {
+    if (!node) return;
+
+    // The left spine of a binary chain is walked in a loop and folded from
+    // the innermost node out. Folding rewrites nodes in place, so the
+    // spine stays valid.
+    if (node->kind == PHP_AST_BINARY) {
+        size_t count = 0;
+        for (php_ast_node_t* left = node; left->kind == PHP_AST_BINARY; left = left->children[0]) {
+            count++;
+        }
+        php_ast_node_t** spine = malloc(count * sizeof(php_ast_node_t*));
+        if (spine) {
+            php_ast_node_t* operand = node;
+            for (size_t i = count; i > 0; i--) {
+                spine[i - 1] = operand;
+                operand = operand->children[0];
+            }
+            php_optimize_ast(operand);
+            for (size_t i = 0; i < count; i++) {
+                php_optimize_ast(spine[i]->children[1]);
+                optimize_node(spine[i]);
+            }
+            free(spine);
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < node->child_count; i++) {
+        php_optimize_ast(node->children[i]);
+    }
+    optimize_node(node);
+}
+
+// ---------------------------------------------------------------------------
+// Op arrays
+// ---------------------------------------------------------------------------
+
+static bool has_target(uint8_t opcode) {
+    return (opcode >= PHP_OP_JMP && opcode <= PHP_OP_JMP_NOT_NULL) || opcode == PHP_OP_FE_RESET ||
+           opcode == PHP_OP_FE_FETCH;
+}
+
+static bool falls_through(uint8_t opcode) {
+    return opcode != PHP_OP_JMP && opcode != PHP_OP_RETURN && opcode != PHP_OP_EXIT;
+}
+
+// Where a jump to target ends up after any unconditional jumps there; the
+// hop limit stops at cycles such as an empty for (;;)
+static uint32_t jump_destination(const php_op_array_t* op_array, uint32_t target) {
+    for (uint32_t hops = 0; hops < op_array->op_count && target < op_array->op_count &&
+                            op_array->ops[target].opcode == PHP_OP_JMP; hops++) {
+        target = op_array->ops[target].op1;
+    }
+    return target;
+}
+
+// The bool JMPZ_EX or JMPNZ_EX leaves when it jumps decides the jump at its
+// target, as in a && b && c or if (a && b): the same test keeps it and jumps
+// on, the plain one pops it and jumps, and the opposite ones pop it and go
+// on after themselves
+static void thread_logical_jump(const php_op_array_t* op_array, php_op_t* op) {
+    bool on_true = op->opcode == PHP_OP_JMPNZ_EX;
+    for (uint32_t hops = 0; hops < op_array->op_count && op->op1 < op_array->op_count; hops++) {
+        const php_op_t* target = &op_array->ops[op->op1];
+        if (target->opcode == op->opcode) {
+            op->op1 = jump_destination(op_array, target->op1);
+            continue;
+        }
+        switch (target->opcode) {
+            case PHP_OP_JMPZ:
+            case PHP_OP_JMPNZ:
+            case PHP_OP_JMPZ_EX:
+            case PHP_OP_JMPNZ_EX: {
+                bool target_on_true = target->opcode == PHP_OP_JMPNZ || target->opcode == PHP_OP_JMPNZ_EX;
+                bool jumps = target_on_true == on_true && (target->opcode == PHP_OP_JMPZ ||
+                                                           target->opcode == PHP_OP_JMPNZ);
+                op->opcode = on_true ? PHP_OP_JMPNZ : PHP_OP_JMPZ;
+                op->op1 = jump_destination(op_array, jumps ? target->op1 : op->op1 + 1);
+                return;
+            }
+            default:
+                return;
+        }
+    }
+}
+
+// One round over the ops, with scratch arrays of op_count + 1 entries.
+// Returns whether ops were removed, which can line up more jumps.
+static bool optimize_ops(php_op_array_t* op_array, uint8_t* flags, uint32_t* work, uint32_t* index) {
+    uint32_t count = op_array->op_count;
+    php_op_t* ops = op_array->ops;
+
+    // Tests right before JMPZ/JMPNZ, unless another jump lands between the
+    // two: a literal decides the jump, as in while (true), and the jump
+    // tests truth itself, so a BOOL there is not needed
+    memset(flags, 0, count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (has_target(ops[i].opcode) && ops[i].op1 < count) flags[ops[i].op1] = 1;
+    }
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        php_op_t* next = &ops[i + 1];
+        if (flags[i + 1] || (next->opcode != PHP_OP_JMPZ && next->opcode != PHP_OP_JMPNZ)) continue;
+        if (ops[i].opcode == PHP_OP_BOOL) {
+            ops[i].opcode = PHP_OP_NOP;
+        } else if (ops[i].opcode == PHP_OP_PUSH_CONST) {
+            bool truth = php_value_is_true(&op_array->literals[ops[i].op1]);
+            ops[i].opcode = PHP_OP_NOP;
+            next->opcode = truth == (next->opcode == PHP_OP_JMPNZ) ? PHP_OP_JMP : PHP_OP_NOP;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        php_op_t* op = &ops[i];
+        if (!has_target(op->opcode)) continue;
+        op->op1 = jump_destination(op_array, op->op1);
+        if (op->opcode == PHP_OP_JMPZ_EX || op->opcode == PHP_OP_JMPNZ_EX) {
+            thread_logical_jump(op_array, op);
+        }
+        if (op->op1 == i + 1) {
+            if (op->opcode == PHP_OP_JMP) {
+                op->opcode = PHP_OP_NOP;
+            } else if (op->opcode == PHP_OP_JMPZ || op->opcode == PHP_OP_JMPNZ) {
+                op->opcode = PHP_OP_POP;
+            }
+        }
+    }
+
+    // Keep what is reachable from the first op, apart from NOPs; the final
+    // RETURN stays, as every op array ends with one
+    memset(flags, 0, count);
+    uint32_t pending = 0;
+    work[pending++] = 0;
+    while (pending > 0) {
+        for (uint32_t i = work[--pending]; i < count && !flags[i]; i++) {
+            flags[i] = 1;
+            if (has_target(ops[i].opcode) && ops[i].op1 < count && !flags[ops[i].op1]) {
+                work[pending++] = ops[i].op1;
+            }
+            if (!falls_through(ops[i].opcode)) break;
+        }
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        index[i] = kept;
+        if ((flags[i] && ops[i].opcode != PHP_OP_NOP) || i == count - 1) {
+            flags[i] = 1;
+            kept++;
+        } else {
+            flags[i] = 0;
+        }
+    }
+    index[count] = kept;
+    if (kept == count) return false;
+
+    uint32_t to = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!flags[i]) continue;
+        php_op_t op = ops[i];
+        if (has_target(op.opcode) && op.op1 <= count) {
+            op.op1 = index[op.op1];
+        }
+        ops[to++] = op;
+    }
+    op_array->op_count = kept;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Types
+// ---------------------------------------------------------------------------
+//
+// The types each compiled variable and each pushed value may have, as sets
+// of 1 << php_type_t, followed forward through the ops until nothing
+// changes. Arithmetic and comparisons whose operands can only be numbers
+// become the _NUMBER opcodes, and counters the INC/DEC_NUMBER ones. Those
+// still check the types they get, so a wrong guess here costs speed only.
+
+#define TYPE_ANY 0xffff
+#define TYPE_OF(type) ((uint16_t)(1u << (type)))
+#define TYPE_NUMBER (TYPE_OF(PHP_TYPE_INT) | TYPE_OF(PHP_TYPE_FLOAT))
+#define NO_OP UINT32_MAX
+
+typedef struct {
+    const php_op_array_t* op_array;
+    uint32_t num_cvs;
+    uint16_t* states;                   // Variable types on entry to each op, num_cvs apiece
+    uint16_t* types;                    // Type of the value each op pushes
+    uint32_t* starts;                   // First op of the expression each op ends, or NO_OP
+    uint32_t* targets;                  // Jumps landing before each op, for ranges without any
+    bool* escaped;                      // Variables a called function may change through "global" or a reference
+} type_state_t;
+
+// Builtins whose result type is known from their name alone
+static const struct {
+    const char* name;
+    php_type_t type;
+} builtin_types[] = {
+    {"strlen", PHP_TYPE_INT}, {"count", PHP_TYPE_INT}, {"sizeof", PHP_TYPE_INT},
+    {"ob_get_level", PHP_TYPE_INT}, {NULL, PHP_TYPE_UNDEF}
+};
+
+static bool is_number(uint16_t type) {
+    return type != 0 && !(type & ~TYPE_NUMBER);
+}
+
+// Reading a variable turns undefined into null
+static uint16_t read_type(uint16_t type) {
+    if (type & TYPE_OF(PHP_TYPE_UNDEF)) {
+        type = (uint16_t)((type & ~TYPE_OF(PHP_TYPE_UNDEF)) | TYPE_OF(PHP_TYPE_NULL));
+    }
+    return type;
+}
+
+// Integer results overflow into floats
+static uint16_t arithmetic_type(uint8_t opcode, uint16_t a, uint16_t b) {
+    if (!is_number(a) || !is_number(b)) return TYPE_ANY;
+    switch (opcode) {
+        case PHP_OP_ADD:
+        case PHP_OP_SUB:
+        case PHP_OP_MUL:
+        case PHP_OP_DIV:
+        case PHP_OP_POW: {
+            uint16_t type = 0;
+            if ((a & TYPE_OF(PHP_TYPE_INT)) && (b & TYPE_OF(PHP_TYPE_INT))) type = TYPE_NUMBER;
+            if ((a | b) & TYPE_OF(PHP_TYPE_FLOAT)) type |= TYPE_OF(PHP_TYPE_FLOAT);
+            return type;
+        }
+        case PHP_OP_MOD:
+        case PHP_OP_SL:
+        case PHP_OP_SR:
+        case PHP_OP_BW_AND:
+        case PHP_OP_BW_OR:
+        case PHP_OP_BW_XOR:
+            return TYPE_OF(PHP_TYPE_INT);
+        default:
+            return TYPE_ANY;
+    }
+}
+
+static uint16_t increment_type(uint16_t type) {
+    if (!is_number(type)) return TYPE_ANY;
+    return (type & TYPE_OF(PHP_TYPE_INT)) ? TYPE_NUMBER : type;
+}
+
+static uint16_t call_type(const php_op_array_t* op_array, const php_op_t* op) {
+    const char* name = op_array->literals[op->op1].value.str->val;
+    for (int i = 0; builtin_types[i].name; i++) {
+        if (strcasecmp(builtin_types[i].name, name) == 0) return TYPE_OF(builtin_types[i].type);
+    }
+    return TYPE_ANY;
+}
+
+// Ops whose op1 names a variable, or whose ext marks the name as on the stack
+static bool is_variable_op(uint8_t opcode) {
+    return (opcode >= PHP_OP_FETCH_VAR && opcode <= PHP_OP_POST_DEC_VAR) ||
+           (opcode >= PHP_OP_ASSIGN_DIM && opcode <= PHP_OP_FETCH_DIM_REF);
+}
+
+// Values popped and pushed by the ops expressions are made of; -1 for the
+// rest, whose operands are not followed
+static int stack_pops(const php_op_t* op) {
+    switch (op->opcode) {
+        case PHP_OP_PUSH_CONST:
+        case PHP_OP_FETCH_VAR:
+        case PHP_OP_FETCH_VAR_QUIET:
+        case PHP_OP_ISSET_VAR:
+        case PHP_OP_PRE_INC_VAR:
+        case PHP_OP_PRE_DEC_VAR:
+        case PHP_OP_POST_INC_VAR:
+        case PHP_OP_POST_DEC_VAR:
+            return 0;
+        case PHP_OP_ASSIGN_VAR:
+        case PHP_OP_ASSIGN_OP_VAR:
+        case PHP_OP_BOOL_NOT:
+        case PHP_OP_BOOL:
+        case PHP_OP_NEG:
+        case PHP_OP_PLUS:
+        case PHP_OP_BW_NOT:
+        case PHP_OP_CAST:
+            return 1;
+        case PHP_OP_CALL:
+            return (int)op->op2;
+        case PHP_OP_CONCAT_N:
+            return (int)op->op1;
+        default:
+            if ((op->opcode >= PHP_OP_ADD && op->opcode <= PHP_OP_BOOL_XOR) ||
+                (op->opcode >= PHP_OP_ADD_NUMBER && op->opcode <= PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER)) {
+                return 2;
+            }
+            return -1;
+    }
+}
+
+// Finds the ops that pushed the count operands of op i, the last ones into
+// found, and the first op of the whole expression. Fails when a jump lands
+// in between, where a value may come from elsewhere; only the expression's
+// first op may be a jump target.
+static bool find_operands(const type_state_t* s, uint32_t i, int count, uint32_t found[2], uint32_t* start) {
+    uint32_t end = i;
+    for (int k = 0; k < count; k++) {
+        if (end == 0) return false;
+        uint32_t producer = end - 1;
+        uint32_t first = s->starts[producer];
+        if (first == NO_OP) return false;
+        uint32_t from = k == count - 1 ? first + 1 : first;
+        if (s->targets[i + 1] != s->targets[from]) return false;
+        if (k < 2) found[k] = producer;
+        end = first;
+    }
+    *start = end;
+    return true;
+}
+
+static void find_expressions(type_state_t* s) {
+    for (uint32_t i = 0; i < s->op_array->op_count; i++) {
+        int pops = stack_pops(&s->op_array->ops[i]);
+        uint32_t found[2];
+        uint32_t start;
+        s->starts[i] = pops >= 0 && find_operands(s, i, pops, found, &start) ? start : NO_OP;
+    }
+}
+
+// Applies op i to the variable types in vars and returns the type it pushes
+static uint16_t transfer(const type_state_t* s, uint32_t i, uint16_t* vars) {
+    const php_op_array_t* op_array = s->op_array;
+    const php_op_t* op = &op_array->ops[i];
+    uint32_t found[2];
+    uint32_t start;
+    int pops = stack_pops(op);
+    uint16_t a = TYPE_ANY;
+    uint16_t b = TYPE_ANY;
+    if (pops > 0 && find_operands(s, i, pops, found, &start)) {
+        // a is the first operand of a binary op, b the last of any op
+        b = s->types[found[0]];
+        if (pops == 2) a = s->types[found[1]];
+    }
+
+    switch (op->opcode) {
+        case PHP_OP_PUSH_CONST:
+            return TYPE_OF(op_array->literals[op->op1].type);
+        case PHP_OP_FETCH_VAR:
+        case PHP_OP_FETCH_VAR_QUIET:
+            return read_type(vars[op->op1]);
+        case PHP_OP_ASSIGN_VAR:
+            vars[op->op1] = b;
+            return b;
+        case PHP_OP_ASSIGN_OP_VAR:
+            vars[op->op1] = arithmetic_type((uint8_t)op->op2, read_type(vars[op->op1]), b);
+            return vars[op->op1];
+        case PHP_OP_PRE_INC_VAR:
+        case PHP_OP_PRE_DEC_VAR:
+        case PHP_OP_POST_INC_VAR:
+        case PHP_OP_POST_DEC_VAR: {
+            uint16_t old = read_type(vars[op->op1]);
+            vars[op->op1] = increment_type(old);
+            return op->opcode == PHP_OP_POST_INC_VAR || op->opcode == PHP_OP_POST_DEC_VAR ? old : vars[op->op1];
+        }
+        case PHP_OP_INC_NUMBER:
+        case PHP_OP_DEC_NUMBER:
+            vars[op->op1] = increment_type(read_type(vars[op->op1]));
+            return TYPE_ANY;
+        case PHP_OP_ISSET_VAR:
+        case PHP_OP_BOOL_NOT:
+        case PHP_OP_BOOL:
+        case PHP_OP_IS_EQUAL:
+        case PHP_OP_IS_NOT_EQUAL:
+        case PHP_OP_IS_IDENTICAL:
+        case PHP_OP_IS_NOT_IDENTICAL:
+        case PHP_OP_IS_SMALLER:
+        case PHP_OP_IS_SMALLER_OR_EQUAL:
+        case PHP_OP_IS_SMALLER_NUMBER:
+        case PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER:
+        case PHP_OP_BOOL_XOR:
+            return TYPE_OF(PHP_TYPE_BOOL);
+        case PHP_OP_SPACESHIP:
+            return TYPE_OF(PHP_TYPE_INT);
+        case PHP_OP_CONCAT:
+        case PHP_OP_CONCAT_N:
+            return TYPE_OF(PHP_TYPE_STRING);
+        case PHP_OP_ADD_NUMBER:
+        case PHP_OP_SUB_NUMBER:
+        case PHP_OP_MUL_NUMBER:
+            return arithmetic_type((uint8_t)(op->opcode - PHP_OP_ADD_NUMBER + PHP_OP_ADD), a, b);
+        case PHP_OP_NEG:
+            return is_number(b) ? increment_type(b) : TYPE_ANY;
+        case PHP_OP_PLUS:
+            return is_number(b) ? b : TYPE_ANY;
+        case PHP_OP_CAST:
+            return TYPE_OF(op->ext);
+        case PHP_OP_CALL: {
+            // A user function may change globals, and with them the
+            // variables of the main script or those bound by "global"
+            uint16_t type = call_type(op_array, op);
+            if (type == TYPE_ANY) {
+                for (uint32_t cv = 0; cv < s->num_cvs; cv++) {
+                    if (s->escaped[cv]) vars[cv] = TYPE_ANY;
+                }
+            }
+            return type;
+        }
+        case PHP_OP_FE_FETCH:
+            vars[op->op2] = TYPE_ANY;
+            return TYPE_ANY;
+        default:
+            if (op->opcode >= PHP_OP_ADD && op->opcode <= PHP_OP_BW_XOR) {
+                return arithmetic_type(op->opcode, a, b);
+            }
+            // Anything else that names a variable may change it
+            if (is_variable_op(op->opcode) || op->opcode == PHP_OP_RECV || op->opcode == PHP_OP_RECV_INIT ||
+                op->opcode == PHP_OP_RECV_VARIADIC) {
+                vars[op->op1] = TYPE_ANY;
+            }
+            return TYPE_ANY;
+    }
+}
+
+// Follows the types from the first op until they stop changing
+static bool infer(type_state_t* s) {
+    const php_op_array_t* op_array = s->op_array;
+    uint32_t count = op_array->op_count;
+    uint32_t num_cvs = s->num_cvs;
+    uint32_t* work = malloc(count * sizeof(uint32_t));
+    bool* queued = calloc(count, sizeof(bool));
+    bool* visited = calloc(count, sizeof(bool));
+    uint16_t* vars = malloc((num_cvs ? num_cvs : 1) * sizeof(uint16_t));
+    bool ok = work && queued && visited && vars;
+
+    if (ok) {
+        // Parameters and the main script's variables may hold anything;
+        // other variables start out undefined
+        for (uint32_t cv = 0; cv < num_cvs; cv++) {
+            s->states[cv] = !op_array->name || cv < op_array->num_params ? TYPE_ANY : TYPE_OF(PHP_TYPE_UNDEF);
+        }
+        uint32_t pending = 0;
+        work[pending++] = 0;
+        queued[0] = visited[0] = true;
+        while (pending > 0) {
+            uint32_t i = work[--pending];
+            queued[i] = false;
+            memcpy(vars, &s->states[(size_t)i * num_cvs], num_cvs * sizeof(uint16_t));
+            uint16_t type = transfer(s, i, vars);
+            bool type_changed = (s->types[i] | type) != s->types[i];
+            s->types[i] |= type;
+
+            const php_op_t* op = &op_array->ops[i];
+            uint32_t next[2];
+            int successors = 0;
+            if (falls_through(op->opcode) && i + 1 < count) next[successors++] = i + 1;
+            if (has_target(op->opcode) && op->op1 < count) next[successors++] = op->op1;
+            for (int k = 0; k < successors; k++) {
+                uint32_t to = next[k];
+                uint16_t* state = &s->states[(size_t)to * num_cvs];
+                bool changed = !visited[to] || (type_changed && to == i + 1);
+                for (uint32_t cv = 0; cv < num_cvs; cv++) {
+                    uint16_t merged = state[cv] | vars[cv];
+                    if (merged != state[cv]) {
+                        state[cv] = merged;
+                        changed = true;
+                    }
+                }
+                visited[to] = true;
+                if (changed && !queued[to]) {
+                    queued[to] = true;
+                    work[pending++] = to;
+                }
+            }
+        }
+    }
+
+    free(work);
+    free(queued);
+    free(visited);
+    free(vars);
+    return ok;
+}
+
+// Rewrites ops whose operands were found to be numbers; returns whether
+// NOPs were left behind
+static bool specialize(const type_state_t* s, php_op_array_t* op_array) {
+    bool left_nops = false;
+    for (uint32_t i = 0; i < op_array->op_count; i++) {
+        php_op_t* op = &op_array->ops[i];
+        uint32_t found[2];
+        uint32_t start;
+        switch (op->opcode) {
+            case PHP_OP_ADD:
+            case PHP_OP_SUB:
+            case PHP_OP_MUL:
+            case PHP_OP_IS_SMALLER:
+            case PHP_OP_IS_SMALLER_OR_EQUAL:
+                if (!find_operands(s, i, 2, found, &start) || !is_number(s->types[found[0]]) ||
+                    !is_number(s->types[found[1]])) {
+                    break;
+                }
+                if (op->opcode == PHP_OP_ADD) op->opcode = PHP_OP_ADD_NUMBER;
+                else if (op->opcode == PHP_OP_SUB) op->opcode = PHP_OP_SUB_NUMBER;
+                else if (op->opcode == PHP_OP_MUL) op->opcode = PHP_OP_MUL_NUMBER;
+                else if (op->opcode == PHP_OP_IS_SMALLER) op->opcode = PHP_OP_IS_SMALLER_NUMBER;
+                else op->opcode = PHP_OP_IS_SMALLER_OR_EQUAL_NUMBER;
+                break;
+            case PHP_OP_PRE_INC_VAR:
+            case PHP_OP_PRE_DEC_VAR:
+            case PHP_OP_POST_INC_VAR:
+            case PHP_OP_POST_DEC_VAR: {
+                // $i++ as a statement changes the counter where it is
+                php_op_t* next = op + 1;
+                if (i + 1 >= op_array->op_count || next->opcode != PHP_OP_POP ||
+                    s->targets[i + 2] != s->targets[i + 1] ||
+                    !is_number(s->states[(size_t)i * s->num_cvs + op->op1])) {
+                    break;
+                }
+                bool increment = op->opcode == PHP_OP_PRE_INC_VAR || op->opcode == PHP_OP_POST_INC_VAR;
+                op->opcode = increment ? PHP_OP_INC_NUMBER : PHP_OP_DEC_NUMBER;
+                next->opcode = PHP_OP_NOP;
+                left_nops = true;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return left_nops;
+}
+
+static bool specialize_types(php_op_array_t* op_array) {
+    uint32_t count = op_array->op_count;
+    uint32_t num_cvs = op_array->num_cvs;
+    // Variables named at run time could be any of them
+    for (uint32_t i = 0; i < count; i++) {
+        if (is_variable_op(op_array->ops[i].opcode) && (op_array->ops[i].ext & PHP_VAR_DYNAMIC)) return false;
+    }
+    if ((size_t)count * num_cvs > (1u << 22)) return false;
+
+    type_state_t s = {op_array, num_cvs, NULL, NULL, NULL, NULL, NULL};
+    s.states = calloc((size_t)count * num_cvs + 1, sizeof(uint16_t));
+    s.types = calloc(count, sizeof(uint16_t));
+    s.starts = malloc(count * sizeof(uint32_t));
+    s.targets = calloc(count + 1, sizeof(uint32_t));
+    s.escaped = calloc(num_cvs + 1, sizeof(bool));
+    bool left_nops = false;
+    if (s.states && s.types && s.starts && s.targets && s.escaped) {
+        // targets[i] counts the jumps landing before op i
+        for (uint32_t i = 0; i < count; i++) {
+            const php_op_t* op = &op_array->ops[i];
+            if (has_target(op->opcode) && op->op1 < count) s.targets[op->op1 + 1]++;
+            if (op->opcode == PHP_OP_BIND_GLOBAL) s.escaped[op->op1] = true;
+        }
+        for (uint32_t cv = 0; cv < op_array->num_params && cv < 32; cv++) {
+            if (op_array->by_ref & (1u << cv)) s.escaped[cv] = true;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            s.targets[i + 1] += s.targets[i];
+        }
+        for (uint32_t cv = 0; cv < num_cvs && !op_array->name; cv++) {
+            s.escaped[cv] = true;
+        }
+        find_expressions(&s);
+        if (infer(&s)) left_nops = specialize(&s, op_array);
+    }
+    free(s.states);
+    free(s.types);
+    free(s.starts);
+    free(s.targets);
+    free(s.escaped);
+    return left_nops;
+}
+
+void php_optimize_op_array(php_op_array_t* op_array) {
+    uint32_t count = op_array->op_count;
+    if (count < 2) return;
+
+    uint8_t* flags = malloc(count + 1);
+    uint32_t* work = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t* index = malloc((count + 1) * sizeof(uint32_t));
+    if (flags && work && index) {
+        while (optimize_ops(op_array, flags, work, index)) {
+        }
+        if (specialize_types(op_array)) {
+            while (optimize_ops(op_array, flags, work, index)) {
+            }
+        }
+    }
+    free(flags);
+    free(work);
+    free(index);
+}
@@ -0,0 +1,31 @@
+/**
+ * PHP Optimizer Header
+ * Compile-time folding over the AST; jump cleanup and type specialization
+ * over op arrays
+ */
+
+#ifndef PHP_OPTIMIZER_H
+#define PHP_OPTIMIZER_H
+
+#include "php_compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rewrite the AST in place before it is compiled: fold constant operators,
+// known constants and pure builtins called with constants, and drop
+// branches and statements that can never run
+void php_optimize_ast(php_ast_node_t* node);
+
+// Thread jumps through jumps, resolve jumps on constant conditions, remove
+// the ops nothing reaches, and switch arithmetic, comparisons and counters
+// whose operands are inferred to be numbers to their _NUMBER opcodes; run
+// on each compiled op array
+void php_optimize_op_array(php_op_array_t* op_array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_OPTIMIZER_H
@@ -0,0 +1,372 @@
+/**
+ * PHP Output Implementation
+ * Output buffers (ob_*) over a write-gathering layer in front of stdout
+ */
+
+#include "php_output.h"
+#include "php_executor.h"
+#include "php_memory.h"
+#include "wasi/wasi_shim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define OUTPUT_DEFAULT_BUFFERING 4096
+#define OUTPUT_SEGMENT_MAX 64           // Segments gathered into one fd_write
+#define OUTPUT_REFERENCE_MIN 128        // Static writes from this length are sent in place
+
+// ---------------------------------------------------------------------------
+// Host layer
+// ---------------------------------------------------------------------------
+
+// Bytes waiting for the host, as the segments of one gathered fd_write.
+// Short writes are copied into the chunk; long static writes are referenced
+// where they are, and long transient ones are sent before returning.
+static size_t buffering = OUTPUT_DEFAULT_BUFFERING;
+static char* chunk = NULL;              // buffering bytes, allocated on first use
+static size_t chunk_used = 0;
+static wasi_ciovec_t segments[OUTPUT_SEGMENT_MAX];
+static size_t segment_count = 0;
+static size_t pending = 0;              // Bytes in all segments
+
+void php_output_flush(void) {
+    wasi_ciovec_t* segment = segments;
+    size_t count = segment_count;
+    while (count > 0) {
+        size_t written = 0;
+        if (wasi_fd_write(WASI_STDOUT_FD, segment, count, &written) != WASI_ESUCCESS || written == 0) {
+            break;
+        }
+        // Resume after a short write
+        while (count > 0 && written >= segment->len) {
+            written -= segment->len;
+            segment++;
+            count--;
+        }
+        if (count > 0) {
+            segment->buf += written;
+            segment->len -= written;
+        }
+    }
+    segment_count = 0;
+    chunk_used = 0;
+    pending = 0;
+}
+
+// Space at the end of the chunk, flushing first when it is too short
+static char* host_reserve(size_t length) {
+    if (length > buffering) return NULL;
+    if (!chunk) {
+        chunk = malloc(buffering);
+        if (!chunk) return NULL;
+    }
+    if (segment_count == OUTPUT_SEGMENT_MAX || chunk_used + length > buffering) {
+        php_output_flush();
+    }
+    return chunk + chunk_used;
+}
+
+static void host_commit(size_t length) {
+    if (length == 0) return;
+    uint8_t* dest = (uint8_t*)chunk + chunk_used;
+    chunk_used += length;
+    wasi_ciovec_t* last = segment_count ? &segments[segment_count - 1] : NULL;
+    if (last && last->buf + last->len == dest) {
+        last->len += length;
+    } else {
+        segments[segment_count++] = (wasi_ciovec_t){dest, length};
+    }
+    pending += length;
+    if (pending >= buffering) {
+        php_output_flush();
+    }
+}
+
+static void host_write(const char* str, size_t length, bool stable) {
+    if (length == 0) return;
+
+    if (length < buffering && !(stable && length >= OUTPUT_REFERENCE_MIN)) {
+        char* dest = host_reserve(length);
+        if (dest) {
+            memcpy(dest, str, length);
+            host_commit(length);
+            return;
+        }
+    }
+
+    if (segment_count == OUTPUT_SEGMENT_MAX) {
+        php_output_flush();
+    }
+    segments[segment_count++] = (wasi_ciovec_t){(uint8_t*)str, length};
+    pending += length;
+    // Borrowed transient bytes must be sent before the caller frees them
+    if (pending >= buffering || !stable) {
+        php_output_flush();
+    }
+}
+
+bool php_output_set_ini(const char* key, const char* value) {
+    if (!key || !value) return false;
+    if (strcmp(key, "output_buffering") != 0) return false;
+
+    size_t size;
+    if (strcasecmp(value, "on") == 0 || strcasecmp(value, "yes") == 0 || strcasecmp(value, "true") == 0) {
+        size = OUTPUT_DEFAULT_BUFFERING;
+    } else if (value[0] == '\0' || strcasecmp(value, "off") == 0 || strcasecmp(value, "no") == 0 ||
+               strcasecmp(value, "false") == 0) {
+        size = 0;
+    } else {
+        char* end;
+        size = (size_t)strtoull(value, &end, 10);
+        if (*end != '\0' || value[0] == '-') return false;
+    }
+
+    php_output_flush();
+    free(chunk);
+    chunk = NULL;
+    buffering = size;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Output buffers
+// ---------------------------------------------------------------------------
+
+// One ob_start() level; the contents live in the request heap
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} output_buffer_t;
+
+static output_buffer_t* buffers = NULL;
+static size_t buffer_level = 0;
+static size_t buffer_capacity = 0;
+
+static bool buffer_grow(output_buffer_t* buffer, size_t length) {
+    if (buffer->length + length <= buffer->capacity) return true;
+    size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+    while (capacity < buffer->length + length) {
+        capacity *= 2;
+    }
+    char* data = php_memory_realloc(buffer->data, capacity);
+    if (!data) return false;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static void buffer_append(output_buffer_t* buffer, const char* str, size_t length) {
+    if (!buffer_grow(buffer, length)) return;
+    memcpy(buffer->data + buffer->length, str, length);
+    buffer->length += length;
+}
+
+// Write to the level below the innermost buffer
+static void write_below(const char* str, size_t length) {
+    if (length == 0) return;
+    if (buffer_level > 1) {
+        buffer_append(&buffers[buffer_level - 2], str, length);
+    } else {
+        host_write(str, length, false);
+    }
+}
+
+void php_output_write(const char* str, size_t length) {
+    if (!str || length == 0) return;
+    if (buffer_level > 0) {
+        buffer_append(&buffers[buffer_level - 1], str, length);
+    } else {
+        host_write(str, length, false);
+    }
+}
+
+void php_output_write_static(const char* str, size_t length) {
+    if (!str || length == 0) return;
+    if (buffer_level > 0) {
+        buffer_append(&buffers[buffer_level - 1], str, length);
+    } else {
+        host_write(str, length, true);
+    }
+}
+
+char* php_output_reserve(size_t length) {
+    if (buffer_level == 0) {
+        return host_reserve(length);
+    }
+    output_buffer_t* buffer = &buffers[buffer_level - 1];
+    if (!buffer_grow(buffer, length)) return NULL;
+    return buffer->data + buffer->length;
+}
+
+void php_output_commit(size_t length) {
+    if (buffer_level == 0) {
+        host_commit(length);
+    } else {
+        buffers[buffer_level - 1].length += length;
+    }
+}
+
+bool php_output_start(void) {
+    if (buffer_level >= buffer_capacity) {
+        size_t capacity = buffer_capacity ? buffer_capacity * 2 : 4;
+        output_buffer_t* grown = realloc(buffers, capacity * sizeof(output_buffer_t));
+        if (!grown) return false;
+        buffers = grown;
+        buffer_capacity = capacity;
+    }
+    buffers[buffer_level++] = (output_buffer_t){NULL, 0, 0};
+    return true;
+}
+
+size_t php_output_get_level(void) {
+    return buffer_level;
+}
+
+php_string_t* php_output_get_contents(void) {
+    if (buffer_level == 0) return NULL;
+    const output_buffer_t* buffer = &buffers[buffer_level - 1];
+    return php_string_init(buffer->data, buffer->length);
+}
+
+bool php_output_clean(void) {
+    if (buffer_level == 0) return false;
+    buffers[buffer_level - 1].length = 0;
+    return true;
+}
+
+bool php_output_flush_buffer(void) {
+    if (buffer_level == 0) return false;
+    output_buffer_t* buffer = &buffers[buffer_level - 1];
+    write_below(buffer->data, buffer->length);
+    buffer->length = 0;
+    return true;
+}
+
+bool php_output_end(bool flush) {
+    if (buffer_level == 0) return false;
+    output_buffer_t* buffer = &buffers[buffer_level - 1];
+    if (flush) {
+        write_below(buffer->data, buffer->length);
+    }
+    php_memory_free(buffer->data);
+    buffer_level--;
+    return true;
+}
+
+void php_output_end_all(void) {
+    while (php_output_end(true)) {
+    }
+    php_output_flush();
+}
+
+void php_output_cleanup(void) {
+    php_output_end_all();
+    free(buffers);
+    buffers = NULL;
+    buffer_capacity = 0;
+    free(chunk);
+    chunk = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Built-in functions
+// ---------------------------------------------------------------------------
+
+php_value_t* php_function_ob_start(int argc, php_value_t** argv) {
+    // Output callbacks would need calls back into the executor
+    if (argc > 0 && argv[0]->type != PHP_TYPE_NULL) {
+        php_executor_warning("ob_start(): Output callbacks are not supported");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(php_output_start());
+}
+
+php_value_t* php_function_ob_get_contents(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    php_string_t* contents = php_output_get_contents();
+    return contents ? php_value_create_str(contents) : php_value_create_bool(false);
+}
+
+php_value_t* php_function_ob_get_clean(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    php_string_t* contents = php_output_get_contents();
+    if (!contents) return php_value_create_bool(false);
+    php_output_end(false);
+    return php_value_create_str(contents);
+}
+
+php_value_t* php_function_ob_get_flush(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    php_string_t* contents = php_output_get_contents();
+    if (!contents) {
+        php_executor_notice("ob_get_flush(): Failed to delete and flush buffer. No buffer to delete or flush");
+        return php_value_create_bool(false);
+    }
+    php_output_end(true);
+    return php_value_create_str(contents);
+}
+
+php_value_t* php_function_ob_get_length(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    if (buffer_level == 0) return php_value_create_bool(false);
+    return php_value_create_int((int64_t)buffers[buffer_level - 1].length);
+}
+
+php_value_t* php_function_ob_get_level(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    return php_value_create_int((int64_t)buffer_level);
+}
+
+php_value_t* php_function_ob_clean(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    if (!php_output_clean()) {
+        php_executor_notice("ob_clean(): Failed to delete buffer. No buffer to delete");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(true);
+}
+
+php_value_t* php_function_ob_flush(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    if (!php_output_flush_buffer()) {
+        php_executor_notice("ob_flush(): Failed to flush buffer. No buffer to flush");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(true);
+}
+
+php_value_t* php_function_ob_end_clean(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    if (!php_output_end(false)) {
+        php_executor_notice("ob_end_clean(): Failed to delete buffer. No buffer to delete");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(true);
+}
+
+php_value_t* php_function_ob_end_flush(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    if (!php_output_end(true)) {
+        php_executor_notice("ob_end_flush(): Failed to delete and flush buffer. No buffer to delete or flush");
+        return php_value_create_bool(false);
+    }
+    return php_value_create_bool(true);
+}
+
+// flush() sends the host layer on; output buffers keep their contents
+php_value_t* php_function_flush(int argc, php_value_t** argv) {
+    (void)argc;
+    (void)argv;
+    php_output_flush();
+    return php_value_create_null();
+}
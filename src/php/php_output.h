@@ -0,0 +1,64 @@
+/**
+ * PHP Output Header
+ * Output buffers (ob_*) over a write-gathering layer in front of stdout
+ */
+
+#ifndef PHP_OUTPUT_H
+#define PHP_OUTPUT_H
+
+#include "php_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configuration, using the php.ini directive name:
+//   output_buffering   Bytes gathered before they are sent to the host
+//                      (default 4096, "On" = 4096, 0 or "Off" writes through)
+bool php_output_set_ini(const char* key, const char* value);
+void php_output_cleanup(void);
+
+// Script output goes to the innermost output buffer, or to the host layer
+// when there is none. write_static is for bytes that stay valid until the
+// request ends, such as literals; the host layer sends them in place.
+void php_output_write(const char* str, size_t length);
+void php_output_write_static(const char* str, size_t length);
+
+// Room to format up to length bytes in place at the end of the output, or
+// NULL when there is none; commit then adds the bytes actually written
+char* php_output_reserve(size_t length);
+void php_output_commit(size_t length);
+
+// Send what the host layer holds in one gathered fd_write
+void php_output_flush(void);
+
+// Output buffers, innermost last. get_contents returns NULL without a
+// buffer; end passes the contents to the level below when flush is set.
+bool php_output_start(void);
+size_t php_output_get_level(void);
+php_string_t* php_output_get_contents(void);
+bool php_output_clean(void);
+bool php_output_flush_buffer(void);
+bool php_output_end(bool flush);
+
+// End of a request: flush every buffer, then the host layer
+void php_output_end_all(void);
+
+// Built-in functions
+php_value_t* php_function_ob_start(int argc, php_value_t** argv);
+php_value_t* php_function_ob_get_contents(int argc, php_value_t** argv);
+php_value_t* php_function_ob_get_clean(int argc, php_value_t** argv);
+php_value_t* php_function_ob_get_flush(int argc, php_value_t** argv);
+php_value_t* php_function_ob_get_length(int argc, php_value_t** argv);
+php_value_t* php_function_ob_get_level(int argc, php_value_t** argv);
+php_value_t* php_function_ob_clean(int argc, php_value_t** argv);
+php_value_t* php_function_ob_flush(int argc, php_value_t** argv);
+php_value_t* php_function_ob_end_clean(int argc, php_value_t** argv);
+php_value_t* php_function_ob_end_flush(int argc, php_value_t** argv);
+php_value_t* php_function_flush(int argc, php_value_t** argv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_OUTPUT_H
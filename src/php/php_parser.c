@@ -4,274 +4,2000 @@
  */
 
 #include "php_engine.h"
+#include "php_parser.h"
+#include "php_keywords.h"
+#include "php_scan.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 
-// Token types
-typedef enum {
-    TOKEN_EOF,
-    TOKEN_IDENTIFIER,
-    TOKEN_STRING,
-    TOKEN_NUMBER,
-    TOKEN_OPERATOR,
-    TOKEN_KEYWORD,
-    TOKEN_SYMBOL
-} token_type_t;
-
-// Token structure
-typedef struct {
-    token_type_t type;
-    char* value;
-    size_t length;
-    int line;
-    int column;
-} token_t;
-
-// Parser state
-typedef struct {
-    const char* source;
-    size_t position;
-    int line;
-    int column;
-    token_t current_token;
-} parser_state_t;
-
 // Forward declarations
 static token_t next_token(parser_state_t* parser);
 static void skip_whitespace(parser_state_t* parser);
-static bool is_keyword(const char* word);
-static void free_token(token_t* token);
 
-// Initialize parser
-parser_state_t* parser_init(const char* source) {
-    parser_state_t* parser = malloc(sizeof(parser_state_t));
+// Character classes, indexed by byte. Bytes from 0x80 up may start names,
+// as PHP allows any non-ASCII byte there.
+#define CC_SPACE        (1u << 0)
+#define CC_DIGIT        (1u << 1)
+#define CC_XDIGIT       (1u << 2)
+#define CC_LABEL_START  (1u << 3)   // First byte of a name
+#define CC_LABEL        (1u << 4)   // Later bytes of a name
+#define CC_OPERATOR     (1u << 5)   // First byte of a multi-character operator
+
+#define S_ CC_SPACE
+#define D_ (CC_DIGIT | CC_XDIGIT | CC_LABEL)
+#define X_ (CC_XDIGIT | CC_LABEL_START | CC_LABEL)
+#define L_ (CC_LABEL_START | CC_LABEL)
+#define O_ CC_OPERATOR
+
+static const uint8_t char_classes[256] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  S_, S_, S_, S_, S_, 0,  0,     // 0x00
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,     // 0x10
+    S_, O_, 0,  0,  0,  O_, O_, 0,  0,  0,  O_, O_, 0,  O_, O_, O_,    //  !"#$%&'()*+,-./
+    D_, D_, D_, D_, D_, D_, D_, D_, D_, D_, O_, 0,  O_, O_, O_, O_,    // 0123456789:;<=>?
+    0,  X_, X_, X_, X_, X_, X_, L_, L_, L_, L_, L_, L_, L_, L_, L_,    // @ABCDEFGHIJKLMNO
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, 0,  0,  0,  O_, L_,    // PQRSTUVWXYZ[\]^_
+    0,  X_, X_, X_, X_, X_, X_, L_, L_, L_, L_, L_, L_, L_, L_, L_,    // `abcdefghijklmno
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, 0,  O_, 0,  0,  0,     // pqrstuvwxyz{|}~
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,    // 0x80
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+    L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_, L_,
+};
+
+#undef S_
+#undef D_
+#undef X_
+#undef L_
+#undef O_
+
+static inline bool char_is(char c, unsigned classes) {
+    return (char_classes[(unsigned char)c] & classes) != 0;
+}
+
+// Multi-character operators, longest first so the scanner can take the first match
+static const char* const multi_char_operators[] = {
+    "===", "!==", "<=>", "**=", "...", "<<=", ">>=", "?\?=", "?->",
+    "==", "!=", "<>", "<=", ">=", "&&", "||", "++", "--", "+=", "-=",
+    "*=", "/=", ".=", "%=", "&=", "|=", "^=", "->", "=>", "::", "<<",
+    ">>", "??", "**",
+    NULL
+};
+
+// Cast type names recognised inside "( type )"
+static const struct {
+    const char* name;
+    php_type_t type;
+} cast_types[] = {
+    {"int", PHP_TYPE_INT}, {"integer", PHP_TYPE_INT}, {"float", PHP_TYPE_FLOAT},
+    {"double", PHP_TYPE_FLOAT}, {"string", PHP_TYPE_STRING}, {"bool", PHP_TYPE_BOOL},
+    {"boolean", PHP_TYPE_BOOL}, {"array", PHP_TYPE_ARRAY}, {"object", PHP_TYPE_OBJECT},
+    {"unset", PHP_TYPE_NULL},
+};
+
+static bool push_token(parser_state_t* parser, const token_t* token) {
+    if (parser->token_count >= parser->token_capacity) {
+        size_t capacity = parser->token_capacity ? parser->token_capacity * 2 : 64;
+        token_t* tokens = realloc(parser->tokens, capacity * sizeof(token_t));
+        if (!tokens) return false;
+        parser->tokens = tokens;
+        parser->token_capacity = capacity;
+    }
+    parser->tokens[parser->token_count++] = *token;
+    return true;
+}
+
+// Tokenize the whole source, which must be NUL-terminated: scans stop at
+// that sentinel instead of checking the length on every byte
+static parser_state_t* parser_create(const char* source, size_t length, bool in_php, int line) {
+    if (length >= UINT32_MAX) return NULL;
+    parser_state_t* parser = calloc(1, sizeof(parser_state_t));
     if (!parser) return NULL;
-    
+
     parser->source = source;
-    parser->position = 0;
-    parser->line = 1;
-    parser->column = 1;
-    parser->current_token = next_token(parser);
-    
+    parser->length = length;
+    parser->line = line;
+    parser->in_php = in_php;
+
+    token_t token;
+    do {
+        token = next_token(parser);
+        if (!push_token(parser, &token)) {
+            parser_cleanup(parser);
+            return NULL;
+        }
+    } while (token.type != TOKEN_EOF);
+
     return parser;
 }
 
+// Initialize parser
+parser_state_t* parser_init(const char* source) {
+    return parser_init_ex(source, false);
+}
+
+// Initialize parser, optionally starting inside a PHP block
+parser_state_t* parser_init_ex(const char* source, bool in_php) {
+    return parser_create(source, strlen(source), in_php, 1);
+}
+
 // Cleanup parser
 void parser_cleanup(parser_state_t* parser) {
     if (parser) {
-        free_token(&parser->current_token);
+        free(parser->tokens);
         free(parser);
     }
 }
 
+static inline const char* token_text(const parser_state_t* parser, const token_t* token) {
+    return parser->source + token->offset;
+}
+
+// Start a token at the current position
+static inline token_t token_at(const parser_state_t* parser, token_type_t type) {
+    token_t token = {type, (uint32_t)parser->position, 0, 0, parser->line};
+    return token;
+}
+
+// Advance over source bytes, keeping the line in sync
+static void advance_chars(parser_state_t* parser, size_t count) {
+    size_t end = parser->position + count < parser->length ? parser->position + count : parser->length;
+    parser->line += (int)php_scan_count(parser->source + parser->position, parser->source + end, '\n');
+    parser->position = end;
+}
+
+// Scan text outside of PHP tags up to the next open tag
+static token_t next_inline_html(parser_state_t* parser) {
+    token_t token = token_at(parser, TOKEN_INLINE_HTML);
+    const char* start = parser->source + parser->position;
+    const char* end = parser->source + parser->length;
+    const char* pos = start;
+
+    while ((pos = php_scan_find(pos, end, '<')) < end) {
+        if (pos[1] == '?' && (pos[2] == '=' || (strncasecmp(pos + 2, "php", 3) == 0 &&
+                                                (pos[5] == '\0' || char_is(pos[5], CC_SPACE))))) {
+            break;
+        }
+        pos++;
+    }
+
+    if (pos > start) {
+        token.length = (uint32_t)(pos - start);
+        advance_chars(parser, pos - start);
+        return token;
+    }
+
+    if (pos == end) {
+        token.type = TOKEN_EOF;
+        return token;
+    }
+
+    parser->in_php = true;
+    if (pos[2] == '=') {
+        token.type = TOKEN_OPEN_TAG_ECHO;
+        token.length = 3;
+        advance_chars(parser, 3);
+        return token;
+    }
+
+    // "<?php" swallows exactly one following whitespace character
+    advance_chars(parser, pos[5] ? 6 : 5);
+    return next_token(parser);
+}
+
+// Heredoc and nowdoc: "<<<" label, a line break, the body, then the label
+// alone at the start of a line, possibly indented. The token is the body;
+// extra is the indentation of the closing label, which the parser removes
+// from every body line. Returns false, consuming nothing, when the source
+// at the current position is not a complete heredoc.
+static bool scan_heredoc(parser_state_t* parser, token_t* token) {
+    const char* src = parser->source;
+    size_t pos = parser->position + 3;
+    while (src[pos] == ' ' || src[pos] == '\t') pos++;
+
+    char quote = (src[pos] == '"' || src[pos] == '\'') ? src[pos] : 0;
+    if (quote) pos++;
+    if (!char_is(src[pos], CC_LABEL_START)) return false;
+    size_t label = pos;
+    while (char_is(src[pos], CC_LABEL)) pos++;
+    size_t label_len = pos - label;
+    if (quote && src[pos++] != quote) return false;
+    if (src[pos] == '\r') pos++;
+    if (src[pos] != '\n') return false;
+    size_t body = ++pos;
+
+    // Find the closing line
+    size_t indent = 0;
+    size_t close = 0;
+    bool found = false;
+    while (pos < parser->length) {
+        size_t line_start = pos;
+        while (src[pos] == ' ' || src[pos] == '\t') pos++;
+        if (strncmp(src + pos, src + label, label_len) == 0 && !char_is(src[pos + label_len], CC_LABEL)) {
+            indent = pos - line_start;
+            close = line_start;
+            found = true;
+            break;
+        }
+        const char* newline = php_scan_find(src + pos, src + parser->length, '\n');
+        if (newline == src + parser->length) break;
+        pos = (size_t)(newline - src) + 1;
+    }
+    if (!found) return false;
+
+    // The line break before the closing label is not part of the body
+    size_t body_end = close > body ? close - 1 : body;
+    if (body_end > body && src[body_end - 1] == '\r') body_end--;
+
+    token->type = quote == '\'' ? TOKEN_NOWDOC : TOKEN_HEREDOC;
+    token->offset = (uint32_t)body;
+    token->length = (uint32_t)(body_end - body);
+    token->extra = (uint32_t)indent;
+    advance_chars(parser, close + indent + label_len - parser->position);
+    return true;
+}
+
 // Get next token
 static token_t next_token(parser_state_t* parser) {
-    token_t token = {0};
-    
+    if (!parser->in_php) {
+        return next_inline_html(parser);
+    }
+
     skip_whitespace(parser);
-    
-    if (parser->position >= strlen(parser->source)) {
+
+    token_t token = token_at(parser, TOKEN_OPERATOR);
+    if (parser->position >= parser->length) {
         token.type = TOKEN_EOF;
         return token;
     }
-    
-    char current = parser->source[parser->position];
-    token.line = parser->line;
-    token.column = parser->column;
-    
-    // String literals
+
+    const char* src = parser->source;
+    const char* start = src + parser->position;
+    char current = *start;
+
+    // Close tag, eats a single directly following newline
+    if (current == '?' && start[1] == '>') {
+        token.type = TOKEN_CLOSE_TAG;
+        token.length = 2;
+        advance_chars(parser, start[2] == '\n' ? 3 : (start[2] == '\r' && start[3] == '\n') ? 4 : 2);
+        parser->in_php = false;
+        return token;
+    }
+
+    // String literals: the token is the body between the quotes
     if (current == '"' || current == '\'') {
-        char quote = current;
-        parser->position++;
-        parser->column++;
-        
-        const char* start = parser->source + parser->position;
-        size_t length = 0;
-        
-        while (parser->position < strlen(parser->source) && 
-               parser->source[parser->position] != quote) {
-            if (parser->source[parser->position] == '\n') {
-                parser->line++;
-                parser->column = 1;
-            } else {
-                parser->column++;
-            }
-            parser->position++;
-            length++;
+        const char* end = src + parser->length;
+        const char* pos = php_scan_find2(start + 1, end, current, '\\');
+        while (pos < end && *pos == '\\') {
+            pos = php_scan_find2(pos + 2 < end ? pos + 2 : end, end, current, '\\');
         }
-        
-        if (parser->position < strlen(parser->source)) {
-            parser->position++;
-            parser->column++;
-        }
-        
-        token.type = TOKEN_STRING;
-        token.value = malloc(length + 1);
-        memcpy(token.value, start, length);
-        token.value[length] = '\0';
-        token.length = length;
-        
+        size_t length = pos - start;
+
+        token.type = current == '"' ? TOKEN_TEMPLATE : TOKEN_STRING;
+        token.offset++;
+        token.length = (uint32_t)(length - 1);
+        advance_chars(parser, length + 1);
         return token;
     }
-    
+
     // Numbers
-    if (isdigit(current)) {
-        const char* start = parser->source + parser->position;
+    if (char_is(current, CC_DIGIT) || (current == '.' && char_is(start[1], CC_DIGIT))) {
         size_t length = 0;
-        
-        while (parser->position < strlen(parser->source) && 
-               (isdigit(parser->source[parser->position]) || 
-                parser->source[parser->position] == '.')) {
-            parser->position++;
-            parser->column++;
-            length++;
+
+        if (current == '0' && (start[1] == 'x' || start[1] == 'X' || start[1] == 'b' || start[1] == 'B')) {
+            length = 2;
+            while (char_is(start[length], CC_XDIGIT) || start[length] == '_') {
+                length++;
+            }
+        } else {
+            while (char_is(start[length], CC_DIGIT) || start[length] == '.' || start[length] == '_') {
+                length++;
+            }
+            if ((start[length] == 'e' || start[length] == 'E') &&
+                (char_is(start[length + 1], CC_DIGIT) ||
+                 ((start[length + 1] == '+' || start[length + 1] == '-') && char_is(start[length + 2], CC_DIGIT)))) {
+                length += 2;
+                while (char_is(start[length], CC_DIGIT)) {
+                    length++;
+                }
+            }
         }
-        
+
         token.type = TOKEN_NUMBER;
-        token.value = malloc(length + 1);
-        memcpy(token.value, start, length);
-        token.value[length] = '\0';
-        token.length = length;
-        
+        token.length = (uint32_t)length;
+        parser->position += length;
         return token;
     }
-    
+
+    // Variables
+    if (current == '$' && char_is(start[1], CC_LABEL_START)) {
+        size_t length = 1;
+        while (char_is(start[length + 1], CC_LABEL)) {
+            length++;
+        }
+
+        token.type = TOKEN_VARIABLE;
+        token.offset++;
+        token.length = (uint32_t)length;
+        parser->position += length + 1;
+        return token;
+    }
+
     // Identifiers and keywords
-    if (isalpha(current) || current == '_') {
-        const char* start = parser->source + parser->position;
-        size_t length = 0;
-        
-        while (parser->position < strlen(parser->source) && 
-               (isalnum(parser->source[parser->position]) || 
-                parser->source[parser->position] == '_')) {
-            parser->position++;
-            parser->column++;
+    if (char_is(current, CC_LABEL_START)) {
+        size_t length = 1;
+        while (char_is(start[length], CC_LABEL)) {
             length++;
         }
-        
-        token.type = TOKEN_IDENTIFIER;
-        token.value = malloc(length + 1);
-        memcpy(token.value, start, length);
-        token.value[length] = '\0';
-        token.length = length;
-        
-        // Check if it's a keyword
-        if (is_keyword(token.value)) {
+
+        php_keyword_t keyword = php_keyword_lookup(start, length);
+        if (keyword != PHP_KEYWORD_NONE) {
             token.type = TOKEN_KEYWORD;
+            token.extra = (uint32_t)keyword;
+        } else {
+            token.type = TOKEN_IDENTIFIER;
+        }
+        token.length = (uint32_t)length;
+        parser->position += length;
+        return token;
+    }
+
+    // Casts: "(" whitespace* type whitespace* ")"
+    if (current == '(') {
+        const char* pos = start + 1;
+        while (*pos == ' ' || *pos == '\t') pos++;
+        const char* word = pos;
+        while (char_is(*pos, CC_LABEL_START)) pos++;
+        size_t word_len = pos - word;
+        while (*pos == ' ' || *pos == '\t') pos++;
+        if (word_len > 0 && *pos == ')') {
+            for (size_t i = 0; i < sizeof(cast_types) / sizeof(cast_types[0]); i++) {
+                if (strlen(cast_types[i].name) == word_len && strncasecmp(word, cast_types[i].name, word_len) == 0) {
+                    token.type = TOKEN_CAST;
+                    token.length = (uint32_t)(pos + 1 - start);
+                    token.extra = cast_types[i].type;
+                    parser->position += token.length;
+                    return token;
+                }
+            }
         }
-        
+    }
+
+    if (current == '<' && start[1] == '<' && start[2] == '<' && scan_heredoc(parser, &token)) {
         return token;
     }
-    
+
+    // Multi-character operators
+    if (char_is(current, CC_OPERATOR)) {
+        for (int i = 0; multi_char_operators[i]; i++) {
+            if (multi_char_operators[i][0] != current) continue;
+            size_t op_len = strlen(multi_char_operators[i]);
+            if (strncmp(start, multi_char_operators[i], op_len) == 0) {
+                token.length = (uint32_t)op_len;
+                parser->position += op_len;
+                return token;
+            }
+        }
+    }
+
     // Operators and symbols
-    token.type = TOKEN_OPERATOR;
-    token.value = malloc(2);
-    token.value[0] = current;
-    token.value[1] = '\0';
     token.length = 1;
-    
     parser->position++;
-    parser->column++;
-    
     return token;
 }
 
 // Skip whitespace and comments
 static void skip_whitespace(parser_state_t* parser) {
-    while (parser->position < strlen(parser->source)) {
-        char current = parser->source[parser->position];
-        
-        if (isspace(current)) {
-            if (current == '\n') {
-                parser->line++;
-                parser->column = 1;
-            } else {
-                parser->column++;
-            }
+    const char* src = parser->source;
+    for (;;) {
+        char current = src[parser->position];
+
+        if (char_is(current, CC_SPACE)) {
+            parser->line += current == '\n';
             parser->position++;
-        } else if (current == '/' && parser->position + 1 < strlen(parser->source) && 
-                   parser->source[parser->position + 1] == '/') {
-            // Single-line comment
-            while (parser->position < strlen(parser->source) && 
-                   parser->source[parser->position] != '\n') {
-                parser->position++;
-            }
-        } else if (current == '/' && parser->position + 1 < strlen(parser->source) && 
-                   parser->source[parser->position + 1] == '*') {
+        } else if ((current == '/' && src[parser->position + 1] == '/') ||
+                   (current == '#' && src[parser->position + 1] != '[')) {
+            // Single-line comment, ends at newline or before a close tag
+            const char* end = src + parser->length;
+            const char* pos = php_scan_find2(src + parser->position + 1, end, '\n', '?');
+            while (pos < end && *pos == '?' && pos[1] != '>') {
+                pos = php_scan_find2(pos + 1, end, '\n', '?');
+            }
+            parser->position = pos - src;
+            if (*pos == '?') {
+                return;
+            }
+        } else if (current == '/' && src[parser->position + 1] == '*') {
             // Multi-line comment
-            parser->position += 2;
-            parser->column += 2;
-            
-            while (parser->position + 1 < strlen(parser->source)) {
-                if (parser->source[parser->position] == '*' && 
-                    parser->source[parser->position + 1] == '/') {
-                    parser->position += 2;
-                    parser->column += 2;
-                    break;
-                }
-                
-                if (parser->source[parser->position] == '\n') {
-                    parser->line++;
-                    parser->column = 1;
-                } else {
-                    parser->column++;
-                }
-                parser->position++;
+            const char* end = src + parser->length;
+            const char* pos = php_scan_find(src + parser->position + 2, end, '*');
+            while (pos < end && pos[1] != '/') {
+                pos = php_scan_find(pos + 1, end, '*');
             }
+            advance_chars(parser, pos < end ? (size_t)(pos + 2 - (src + parser->position)) : parser->length);
         } else {
             break;
         }
     }
 }
 
-// Check if word is a keyword
-static bool is_keyword(const char* word) {
-    const char* keywords[] = {
-        "echo", "print", "if", "else", "elseif", "while", "for", "foreach",
-        "function", "class", "interface", "trait", "namespace", "use",
-        "return", "break", "continue", "switch", "case", "default",
-        "try", "catch", "finally", "throw", "new", "clone", "instanceof",
-        "public", "private", "protected", "static", "abstract", "final",
-        "const", "var", "global", "static", "unset", "isset", "empty",
-        "include", "require", "include_once", "require_once",
-        "and", "or", "xor", "not", "true", "false", "null",
-        "array", "object", "string", "int", "float", "bool", "mixed",
-        "void", "self", "parent", "this"
-    };
-    
-    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-        if (strcmp(word, keywords[i]) == 0) {
-            return true;
+// ---------------------------------------------------------------------------
+// AST construction
+// ---------------------------------------------------------------------------
+
+static php_ast_node_t* ast_create(php_ast_kind_t kind, int line) {
+    php_ast_node_t* node = calloc(1, sizeof(php_ast_node_t));
+    if (!node) return NULL;
+    node->kind = kind;
+    node->line = line;
+    return node;
+}
+
+static void ast_add_child(php_ast_node_t* node, php_ast_node_t* child) {
+    if (node->child_count >= node->child_capacity) {
+        node->child_capacity = node->child_capacity ? node->child_capacity * 2 : 4;
+        node->children = realloc(node->children, node->child_capacity * sizeof(php_ast_node_t*));
+    }
+    node->children[node->child_count++] = child;
+}
+
+// Names and literals are copied out of the source into the intern pool,
+// where the compiler looks them up anyway
+static void ast_set_str(php_ast_node_t* node, const char* str, size_t length) {
+    node->str = php_intern(str, length);
+    node->str_len = length;
+}
+
+// The first child is followed in a loop, so a left-nested chain such as
+// a + b + c does not recurse once per operator
+void php_ast_destroy(php_ast_node_t* node) {
+    while (node) {
+        php_ast_node_t* first = node->child_count ? node->children[0] : NULL;
+        for (size_t i = 1; i < node->child_count; i++) {
+            php_ast_destroy(node->children[i]);
         }
+        free(node->children);
+        free(node);
+        node = first;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Token stream helpers
+// ---------------------------------------------------------------------------
+
+static inline token_t* parser_current(parser_state_t* parser) {
+    return &parser->tokens[parser->current];
+}
+
+static void parser_advance(parser_state_t* parser) {
+    if (parser->current + 1 < parser->token_count) {
+        parser->current++;
+    }
+}
+
+static token_t* parser_peek(parser_state_t* parser) {
+    size_t next = parser->current + 1 < parser->token_count ? parser->current + 1 : parser->current;
+    return &parser->tokens[next];
+}
+
+static bool token_is_op(const parser_state_t* parser, const token_t* token, const char* op) {
+    size_t length = strlen(op);
+    return token->type == TOKEN_OPERATOR && token->length == length &&
+           memcmp(token_text(parser, token), op, length) == 0;
+}
+
+static bool token_is_word(const parser_state_t* parser, const token_t* token, const char* word) {
+    size_t length = strlen(word);
+    return (token->type == TOKEN_IDENTIFIER || token->type == TOKEN_KEYWORD) && token->length == length &&
+           strncasecmp(token_text(parser, token), word, length) == 0;
+}
+
+static bool check_op(parser_state_t* parser, const char* op) {
+    return token_is_op(parser, parser_current(parser), op);
+}
+
+static bool check_word(parser_state_t* parser, const char* word) {
+    return token_is_word(parser, parser_current(parser), word);
+}
+
+static bool accept_op(parser_state_t* parser, const char* op) {
+    if (check_op(parser, op)) {
+        parser_advance(parser);
+        return true;
     }
-    
     return false;
 }
 
-// Free token memory
-static void free_token(token_t* token) {
-    if (token && token->value) {
-        free(token->value);
-        token->value = NULL;
+static bool accept_word(parser_state_t* parser, const char* word) {
+    if (check_word(parser, word)) {
+        parser_advance(parser);
+        return true;
     }
+    return false;
 }
 
-// Parse PHP code
-bool parse_php_code(const char* code) {
-    parser_state_t* parser = parser_init(code);
-    if (!parser) {
-        return false;
+static void syntax_error(parser_state_t* parser, const char* expected) {
+    if (parser->has_error) return;
+    parser->has_error = true;
+
+    char message[256];
+    const token_t* token = parser_current(parser);
+    if (token->type == TOKEN_EOF) {
+        snprintf(message, sizeof(message),
+                 "PHP Parse error: syntax error, unexpected end of file%s%s on line %d\n",
+                 expected ? ", expecting " : "", expected ? expected : "", token->line);
+    } else {
+        snprintf(message, sizeof(message),
+                 "PHP Parse error: syntax error, unexpected '%.*s'%s%s on line %d\n",
+                 (int)(token->length < 32 ? token->length : 32), token_text(parser, token),
+                 expected ? ", expecting " : "", expected ? expected : "", token->line);
+    }
+    php_engine_error(message);
+}
+
+static bool enter_nesting(parser_state_t* parser) {
+    if (parser->depth < PHP_PARSE_MAX_DEPTH) {
+        parser->depth++;
+        return true;
     }
-    
-    // Simple parsing - just tokenize for now
-    while (parser->current_token.type != TOKEN_EOF) {
-        // Process token here
-        free_token(&parser->current_token);
-        parser->current_token = next_token(parser);
+    if (!parser->has_error) {
+        parser->has_error = true;
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "PHP Parse error: nesting deeper than %d levels on line %d\n",
+                 PHP_PARSE_MAX_DEPTH, parser_current(parser)->line);
+        php_engine_error(message);
     }
-    
-    parser_cleanup(parser);
+    return false;
+}
+
+static bool expect_op(parser_state_t* parser, const char* op) {
+    if (accept_op(parser, op)) {
+        return true;
+    }
+    char expected[16];
+    snprintf(expected, sizeof(expected), "\"%s\"", op);
+    syntax_error(parser, expected);
+    return false;
+}
+
+// Statements end with ';' or an implicit terminator in the form of "?>"
+static bool expect_terminator(parser_state_t* parser) {
+    if (accept_op(parser, ";")) {
+        return true;
+    }
+    if (parser_current(parser)->type == TOKEN_CLOSE_TAG) {
+        parser_advance(parser);
+        return true;
+    }
+    if (parser_current(parser)->type == TOKEN_EOF) {
+        return true;
+    }
+    syntax_error(parser, "\";\"");
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+static php_ast_node_t* parse_expression(parser_state_t* parser, int min_prec);
+static php_ast_node_t* parse_statement(parser_state_t* parser);
+
+// Binding power for binary operators, 0 if the token is not one
+static int binary_precedence(const parser_state_t* parser, const token_t* token, int* op, bool* right_assoc) {
+    static const struct {
+        const char* text;
+        int prec;
+        int op;
+        bool right_assoc;
+    } table[] = {
+        {"or", 1, PHP_BINOP_BOOL_OR, false},
+        {"xor", 2, PHP_BINOP_BOOL_XOR, false},
+        {"and", 3, PHP_BINOP_BOOL_AND, false},
+        {"??", 7, PHP_BINOP_COALESCE, true},
+        {"||", 8, PHP_BINOP_BOOL_OR, false},
+        {"&&", 9, PHP_BINOP_BOOL_AND, false},
+        {"|", 10, PHP_BINOP_BW_OR, false},
+        {"^", 11, PHP_BINOP_BW_XOR, false},
+        {"&", 12, PHP_BINOP_BW_AND, false},
+        {"==", 13, PHP_BINOP_EQUAL, false},
+        {"!=", 13, PHP_BINOP_NOT_EQUAL, false},
+        {"<>", 13, PHP_BINOP_NOT_EQUAL, false},
+        {"===", 13, PHP_BINOP_IDENTICAL, false},
+        {"!==", 13, PHP_BINOP_NOT_IDENTICAL, false},
+        {"<=>", 13, PHP_BINOP_SPACESHIP, false},
+        {"<", 14, PHP_BINOP_SMALLER, false},
+        {"<=", 14, PHP_BINOP_SMALLER_OR_EQUAL, false},
+        {">", 14, PHP_BINOP_GREATER, false},
+        {">=", 14, PHP_BINOP_GREATER_OR_EQUAL, false},
+        {".", 15, PHP_BINOP_CONCAT, false},
+        {"<<", 16, PHP_BINOP_SL, false},
+        {">>", 16, PHP_BINOP_SR, false},
+        {"+", 17, PHP_BINOP_ADD, false},
+        {"-", 17, PHP_BINOP_SUB, false},
+        {"*", 18, PHP_BINOP_MUL, false},
+        {"/", 18, PHP_BINOP_DIV, false},
+        {"%", 18, PHP_BINOP_MOD, false},
+        {"**", 22, PHP_BINOP_POW, true},
+    };
+
+    if (token->type != TOKEN_OPERATOR && token->type != TOKEN_KEYWORD &&
+        token->type != TOKEN_IDENTIFIER) {
+        return 0;
+    }
+
+    const char* text = token_text(parser, token);
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        bool match = strlen(table[i].text) == token->length &&
+                     (token->type == TOKEN_OPERATOR
+                          ? memcmp(text, table[i].text, token->length) == 0
+                          : (char_is(table[i].text[0], CC_LABEL_START) &&
+                             strncasecmp(text, table[i].text, token->length) == 0));
+        if (match) {
+            *op = table[i].op;
+            *right_assoc = table[i].right_assoc;
+            return table[i].prec;
+        }
+    }
+    return 0;
+}
+
+// Maps "op=" assignment tokens to their binary operator
+static int assign_op(const parser_state_t* parser, const token_t* token) {
+    static const struct {
+        const char* text;
+        int op;
+    } table[] = {
+        {"+=", PHP_BINOP_ADD}, {"-=", PHP_BINOP_SUB}, {"*=", PHP_BINOP_MUL},
+        {"/=", PHP_BINOP_DIV}, {"%=", PHP_BINOP_MOD}, {"**=", PHP_BINOP_POW},
+        {".=", PHP_BINOP_CONCAT}, {"&=", PHP_BINOP_BW_AND}, {"|=", PHP_BINOP_BW_OR},
+        {"^=", PHP_BINOP_BW_XOR}, {"<<=", PHP_BINOP_SL}, {">>=", PHP_BINOP_SR},
+        {"?\?=", PHP_BINOP_COALESCE},
+    };
+
+    if (token->type != TOKEN_OPERATOR) return -1;
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
+        if (token_is_op(parser, token, table[i].text)) {
+            return table[i].op;
+        }
+    }
+    return -1;
+}
+
+static bool is_lvalue(const php_ast_node_t* node) {
+    while (node && node->kind == PHP_AST_DIM) {
+        node = node->children[0];
+    }
+    return node && node->kind == PHP_AST_VAR;
+}
+
+// Decode a double-quoted escape sequence, returns bytes consumed after the backslash
+static size_t decode_escape(const char* src, size_t remaining, char* out, size_t* out_len) {
+    *out_len = 1;
+    switch (src[0]) {
+        case 'n': out[0] = '\n'; return 1;
+        case 't': out[0] = '\t'; return 1;
+        case 'r': out[0] = '\r'; return 1;
+        case 'v': out[0] = '\v'; return 1;
+        case 'e': out[0] = 27; return 1;
+        case 'f': out[0] = '\f'; return 1;
+        case '\\': out[0] = '\\'; return 1;
+        case '$': out[0] = '$'; return 1;
+        case '"': out[0] = '"'; return 1;
+        case 'x':
+            if (remaining > 1 && isxdigit((unsigned char)src[1])) {
+                size_t n = 1;
+                unsigned value = 0;
+                while (n < 3 && n < remaining && isxdigit((unsigned char)src[n])) {
+                    value = value * 16 + (isdigit((unsigned char)src[n]) ? src[n] - '0'
+                                          : (tolower((unsigned char)src[n]) - 'a' + 10));
+                    n++;
+                }
+                out[0] = (char)value;
+                return n;
+            }
+            break;
+        case 'u':
+            if (remaining > 2 && src[1] == '{') {
+                size_t n = 2;
+                uint32_t cp = 0;
+                while (n < remaining && isxdigit((unsigned char)src[n])) {
+                    cp = cp * 16 + (isdigit((unsigned char)src[n]) ? src[n] - '0'
+                                    : (tolower((unsigned char)src[n]) - 'a' + 10));
+                    n++;
+                }
+                if (n < remaining && src[n] == '}') {
+                    // Encode as UTF-8
+                    if (cp < 0x80) {
+                        out[0] = (char)cp;
+                    } else if (cp < 0x800) {
+                        out[0] = (char)(0xC0 | (cp >> 6));
+                        out[1] = (char)(0x80 | (cp & 0x3F));
+                        *out_len = 2;
+                    } else if (cp < 0x10000) {
+                        out[0] = (char)(0xE0 | (cp >> 12));
+                        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                        out[2] = (char)(0x80 | (cp & 0x3F));
+                        *out_len = 3;
+                    } else {
+                        out[0] = (char)(0xF0 | (cp >> 18));
+                        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                        out[3] = (char)(0x80 | (cp & 0x3F));
+                        *out_len = 4;
+                    }
+                    return n + 1;
+                }
+            }
+            break;
+        default:
+            if (src[0] >= '0' && src[0] <= '7') {
+                size_t n = 0;
+                unsigned value = 0;
+                while (n < 3 && n < remaining && src[n] >= '0' && src[n] <= '7') {
+                    value = value * 8 + (src[n] - '0');
+                    n++;
+                }
+                out[0] = (char)value;
+                return n;
+            }
+            break;
+    }
+
+    // Unknown escape: keep the backslash
+    out[0] = '\\';
+    return 0;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} text_buffer_t;
+
+static void text_append(text_buffer_t* buf, const char* data, size_t length) {
+    if (buf->length + length + 1 > buf->capacity) {
+        buf->capacity = (buf->length + length + 1) * 2;
+        buf->data = realloc(buf->data, buf->capacity);
+    }
+    memcpy(buf->data + buf->length, data, length);
+    buf->length += length;
+    buf->data[buf->length] = '\0';
+}
+
+static php_ast_node_t* make_string_literal(const char* data, size_t length, int line) {
+    php_ast_node_t* node = ast_create(PHP_AST_STRING_LITERAL, line);
+    ast_set_str(node, data ? data : "", data ? length : 0);
+    return node;
+}
+
+// Single-quoted bodies only know \' and \\ escapes; without any, the
+// literal comes straight from the source
+static php_ast_node_t* make_single_quoted(const char* raw, size_t length, int line) {
+    if (!memchr(raw, '\\', length)) {
+        return make_string_literal(raw, length, line);
+    }
+
+    char* text = malloc(length);
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (raw[i] == '\\' && i + 1 < length && (raw[i + 1] == '\'' || raw[i + 1] == '\\')) {
+            i++;
+        }
+        text[out++] = raw[i];
+    }
+    php_ast_node_t* node = make_string_literal(text, out, line);
+    free(text);
+    return node;
+}
+
+// Copy of a heredoc or nowdoc body with up to indent blanks removed from
+// the start of every line, or NULL when there is no indentation
+static char* strip_indent(const char* raw, size_t* length, size_t indent) {
+    if (indent == 0) return NULL;
+
+    char* text = malloc(*length + 1);
+    size_t out = 0;
+    for (size_t i = 0; i < *length;) {
+        for (size_t skipped = 0; skipped < indent && i < *length && (raw[i] == ' ' || raw[i] == '\t'); skipped++) {
+            i++;
+        }
+        while (i < *length && raw[i] != '\n') {
+            text[out++] = raw[i++];
+        }
+        if (i < *length) {
+            text[out++] = raw[i++];
+        }
+    }
+    *length = out;
+    return text;
+}
+
+// Flush pending literal text into an interpolation node
+static void flush_literal(php_ast_node_t* interp, text_buffer_t* buf, int line) {
+    if (buf->length > 0) {
+        ast_add_child(interp, make_string_literal(buf->data, buf->length, line));
+        buf->length = 0;
+    }
+}
+
+// Parse the expression inside "{$...}" with a nested parser
+static php_ast_node_t* parse_embedded_expression(parser_state_t* outer, const char* src, size_t length, int line) {
+    char* code = malloc(length + 1);
+    memcpy(code, src, length);
+    code[length] = '\0';
+
+    parser_state_t* sub = parser_create(code, length, true, line);
+    if (!sub) {
+        free(code);
+        outer->has_error = true;
+        return NULL;
+    }
+    sub->depth = outer->depth;
+    php_ast_node_t* expr = parse_expression(sub, 0);
+    if (expr && parser_current(sub)->type != TOKEN_EOF) {
+        syntax_error(sub, "\"}\"");
+    }
+    if (sub->has_error) {
+        php_ast_destroy(expr);
+        expr = NULL;
+        outer->has_error = true;
+    }
+    parser_cleanup(sub);
+    free(code);
+    return expr;
+}
+
+// Simple "$name[key]" syntax: key is an integer, a bare word taken as a
+// string, or a variable. *pos is at the '['.
+static php_ast_node_t* parse_template_dim(parser_state_t* parser, php_ast_node_t* var, const char* raw,
+                                          size_t length, size_t* pos, int line) {
+    size_t start = *pos + 1;
+    size_t end = start;
+    while (end < length && raw[end] != ']') end++;
+    if (end >= length || end == start) {
+        php_ast_destroy(var);
+        syntax_error(parser, "\"]\"");
+        return NULL;
+    }
+
+    php_ast_node_t* key;
+    bool negative = raw[start] == '-' && end - start > 1;
+    bool numeric = true;
+    for (size_t i = start + negative; i < end; i++) {
+        numeric = numeric && isdigit((unsigned char)raw[i]);
+    }
+    if (numeric && (raw[start + negative] != '0' || end - start - negative == 1)) {
+        key = ast_create(PHP_AST_INT_LITERAL, line);
+        key->int_val = strtoll(raw + start, NULL, 10);
+    } else if (raw[start] == '$' && end - start > 1) {
+        key = ast_create(PHP_AST_VAR, line);
+        ast_set_str(key, raw + start + 1, end - start - 1);
+    } else {
+        key = make_string_literal(raw + start, end - start, line);
+    }
+
+    php_ast_node_t* dim = ast_create(PHP_AST_DIM, line);
+    ast_add_child(dim, var);
+    ast_add_child(dim, key);
+    *pos = end + 1;
+    return dim;
+}
+
+// Turn a double-quoted or heredoc body into a literal or an interpolation
+// node. Heredocs need no escaped quotes, so \" keeps its backslash there.
+static php_ast_node_t* parse_template(parser_state_t* parser, const char* raw, size_t length, int line, bool heredoc) {
+    php_ast_node_t* interp = ast_create(PHP_AST_INTERP, line);
+    text_buffer_t buf = {0};
+    size_t i = 0;
+
+    while (i < length && !parser->has_error) {
+        char c = raw[i];
+
+        if (c == '\\' && i + 1 < length && !(heredoc && raw[i + 1] == '"')) {
+            char decoded[4];
+            size_t decoded_len;
+            size_t consumed = decode_escape(raw + i + 1, length - i - 1, decoded, &decoded_len);
+            text_append(&buf, decoded, decoded_len);
+            i += 1 + consumed;
+            continue;
+        }
+
+        if (c == '$' && i + 1 < length &&
+            (isalpha((unsigned char)raw[i + 1]) || raw[i + 1] == '_' || (unsigned char)raw[i + 1] >= 0x80)) {
+            size_t start = ++i;
+            while (i < length && (isalnum((unsigned char)raw[i]) || raw[i] == '_' || (unsigned char)raw[i] >= 0x80)) {
+                i++;
+            }
+            flush_literal(interp, &buf, line);
+            php_ast_node_t* var = ast_create(PHP_AST_VAR, line);
+            ast_set_str(var, raw + start, i - start);
+            if (i < length && raw[i] == '[') {
+                var = parse_template_dim(parser, var, raw, length, &i, line);
+                if (!var) break;
+            }
+            ast_add_child(interp, var);
+            continue;
+        }
+
+        if (c == '$' && i + 1 < length && raw[i + 1] == '{') {
+            size_t start = i + 2;
+            size_t end = start;
+            while (end < length && raw[end] != '}') end++;
+            if (end >= length) {
+                syntax_error(parser, "\"}\"");
+                break;
+            }
+            flush_literal(interp, &buf, line);
+            php_ast_node_t* var = ast_create(PHP_AST_VAR, line);
+            ast_set_str(var, raw + start, end - start);
+            ast_add_child(interp, var);
+            i = end + 1;
+            continue;
+        }
+
+        if (c == '{' && i + 1 < length && raw[i + 1] == '$') {
+            size_t start = i + 1;
+            size_t end = start;
+            int depth = 1;
+            while (end < length) {
+                if (raw[end] == '{') depth++;
+                else if (raw[end] == '}' && --depth == 0) break;
+                end++;
+            }
+            if (end >= length) {
+                syntax_error(parser, "\"}\"");
+                break;
+            }
+            flush_literal(interp, &buf, line);
+            php_ast_node_t* expr = parse_embedded_expression(parser, raw + start, end - start, line);
+            if (!expr) break;
+            ast_add_child(interp, expr);
+            i = end + 1;
+            continue;
+        }
+
+        // Plain text runs up to the next byte that may start an escape or
+        // an interpolation
+        size_t run = (size_t)(php_scan_find3(raw + i + 1, raw + length, '\\', '$', '{') - raw);
+        text_append(&buf, raw + i, run - i);
+        i = run;
+    }
+
+    if (parser->has_error) {
+        free(buf.data);
+        php_ast_destroy(interp);
+        return NULL;
+    }
+
+    // No interpolation at all: a plain literal
+    if (interp->child_count == 0) {
+        php_ast_node_t* literal = make_string_literal(buf.data, buf.length, line);
+        free(buf.data);
+        php_ast_destroy(interp);
+        return literal;
+    }
+
+    flush_literal(interp, &buf, line);
+    free(buf.data);
+    return interp;
+}
+
+static php_ast_node_t* parse_number(parser_state_t* parser) {
+    const token_t* token = parser_current(parser);
+    const char* text = token_text(parser, token);
+    char digits[128];
+    size_t n = 0;
+    bool is_float = false;
+
+    // Strip numeric separators
+    for (size_t i = 0; i < token->length && n < sizeof(digits) - 1; i++) {
+        if (text[i] != '_') {
+            digits[n++] = text[i];
+        }
+    }
+    digits[n] = '\0';
+
+    php_ast_node_t* node;
+    if (n > 1 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        node = ast_create(PHP_AST_INT_LITERAL, token->line);
+        node->int_val = (int64_t)strtoull(digits + 2, NULL, 16);
+    } else if (n > 1 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B')) {
+        node = ast_create(PHP_AST_INT_LITERAL, token->line);
+        node->int_val = (int64_t)strtoull(digits + 2, NULL, 2);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            if (digits[i] == '.' || digits[i] == 'e' || digits[i] == 'E') {
+                is_float = true;
+            }
+        }
+        if (!is_float) {
+            char* end;
+            bool octal = n > 1 && digits[0] == '0';
+            unsigned long long value = strtoull(digits, &end, octal ? 8 : 10);
+            // Integer literals that overflow become floats, as in PHP
+            if (value > (unsigned long long)INT64_MAX) {
+                is_float = true;
+            } else {
+                node = ast_create(PHP_AST_INT_LITERAL, token->line);
+                node->int_val = (int64_t)value;
+            }
+        }
+        if (is_float) {
+            node = ast_create(PHP_AST_FLOAT_LITERAL, token->line);
+            node->float_val = strtod(digits, NULL);
+        }
+    }
+
+    parser_advance(parser);
+    return node;
+}
+
+// Parse "( expr, expr, ... )" into node's children
+static bool parse_argument_list(parser_state_t* parser, php_ast_node_t* node) {
+    if (!expect_op(parser, "(")) return false;
+    if (accept_op(parser, ")")) return true;
+
+    do {
+        if (check_op(parser, ")")) break;  // Trailing comma
+        php_ast_node_t* arg = parse_expression(parser, 0);
+        if (!arg) return false;
+        ast_add_child(node, arg);
+    } while (accept_op(parser, ","));
+
+    return expect_op(parser, ")");
+}
+
+// Parse array literal elements up to the closing token, which has already
+// been opened: "[ ... ]" or "array( ... )"
+static php_ast_node_t* parse_array_literal(parser_state_t* parser, const char* closing, int line) {
+    php_ast_node_t* node = ast_create(PHP_AST_ARRAY, line);
+
+    while (!check_op(parser, closing)) {
+        int elem_line = parser_current(parser)->line;
+        php_ast_node_t* value = parse_expression(parser, 0);
+        if (!value) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+
+        php_ast_node_t* elem = ast_create(PHP_AST_ARRAY_ELEM, elem_line);
+        if (accept_op(parser, "=>")) {
+            php_ast_node_t* key = value;
+            value = parse_expression(parser, 0);
+            if (!value) {
+                php_ast_destroy(key);
+                php_ast_destroy(elem);
+                php_ast_destroy(node);
+                return NULL;
+            }
+            ast_add_child(elem, key);
+        } else {
+            ast_add_child(elem, NULL);
+        }
+        ast_add_child(elem, value);
+        ast_add_child(node, elem);
+
+        if (!accept_op(parser, ",")) break;
+    }
+
+    if (!expect_op(parser, closing)) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
+static php_ast_node_t* parse_primary(parser_state_t* parser) {
+    token_t* token = parser_current(parser);
+    int line = token->line;
+
+    switch (token->type) {
+        case TOKEN_NUMBER:
+            return parse_number(parser);
+
+        case TOKEN_STRING: {
+            php_ast_node_t* node = make_single_quoted(token_text(parser, token), token->length, line);
+            parser_advance(parser);
+            return node;
+        }
+
+        case TOKEN_TEMPLATE:
+        case TOKEN_HEREDOC:
+        case TOKEN_NOWDOC: {
+            size_t length = token->length;
+            char* body = strip_indent(token_text(parser, token), &length, token->extra);
+            const char* raw = body ? body : token_text(parser, token);
+            php_ast_node_t* node = token->type == TOKEN_NOWDOC
+                ? make_string_literal(raw, length, line)
+                : parse_template(parser, raw, length, line, token->type == TOKEN_HEREDOC);
+            free(body);
+            parser_advance(parser);
+            return node;
+        }
+
+        case TOKEN_VARIABLE: {
+            php_ast_node_t* node = ast_create(PHP_AST_VAR, line);
+            ast_set_str(node, token_text(parser, token), token->length);
+            parser_advance(parser);
+            return node;
+        }
+
+        case TOKEN_OPERATOR:
+            if (check_op(parser, "(")) {
+                parser_advance(parser);
+                php_ast_node_t* inner = parse_expression(parser, 0);
+                if (!inner) return NULL;
+                if (!expect_op(parser, ")")) {
+                    php_ast_destroy(inner);
+                    return NULL;
+                }
+                return inner;
+            }
+            if (accept_op(parser, "[")) {
+                return parse_array_literal(parser, "]", line);
+            }
+            if (check_op(parser, "$")) {
+                // Variable variables: $$name, $$$name and ${expr}
+                parser_advance(parser);
+                php_ast_node_t* name;
+                if (accept_op(parser, "{")) {
+                    name = parse_expression(parser, 0);
+                    if (name && !expect_op(parser, "}")) {
+                        php_ast_destroy(name);
+                        return NULL;
+                    }
+                } else if (parser_current(parser)->type == TOKEN_VARIABLE || check_op(parser, "$")) {
+                    name = parse_primary(parser);
+                } else {
+                    syntax_error(parser, "variable");
+                    return NULL;
+                }
+                if (!name) return NULL;
+
+                php_ast_node_t* node = ast_create(PHP_AST_VAR, line);
+                ast_add_child(node, name);
+                return node;
+            }
+            break;
+
+        case TOKEN_IDENTIFIER:
+        case TOKEN_KEYWORD: {
+            if (check_word(parser, "true") || check_word(parser, "false")) {
+                php_ast_node_t* node = ast_create(PHP_AST_BOOL_LITERAL, line);
+                node->int_val = check_word(parser, "true");
+                parser_advance(parser);
+                return node;
+            }
+            if (check_word(parser, "null")) {
+                parser_advance(parser);
+                return ast_create(PHP_AST_NULL_LITERAL, line);
+            }
+            if (check_word(parser, "isset")) {
+                parser_advance(parser);
+                php_ast_node_t* node = ast_create(PHP_AST_ISSET, line);
+                if (!parse_argument_list(parser, node)) {
+                    php_ast_destroy(node);
+                    return NULL;
+                }
+                return node;
+            }
+            if (check_word(parser, "empty")) {
+                parser_advance(parser);
+                php_ast_node_t* node = ast_create(PHP_AST_EMPTY, line);
+                if (!parse_argument_list(parser, node) || node->child_count != 1) {
+                    syntax_error(parser, NULL);
+                    php_ast_destroy(node);
+                    return NULL;
+                }
+                return node;
+            }
+            if (check_word(parser, "exit") || check_word(parser, "die")) {
+                parser_advance(parser);
+                php_ast_node_t* node = ast_create(PHP_AST_EXIT, line);
+                if (check_op(parser, "(") && !parse_argument_list(parser, node)) {
+                    php_ast_destroy(node);
+                    return NULL;
+                }
+                return node;
+            }
+            if (check_word(parser, "array") && token_is_op(parser, parser_peek(parser), "(")) {
+                parser_advance(parser);
+                parser_advance(parser);
+                return parse_array_literal(parser, ")", line);
+            }
+            if (check_word(parser, "print")) {
+                parser_advance(parser);
+                php_ast_node_t* operand = parse_expression(parser, 5);
+                if (!operand) return NULL;
+                php_ast_node_t* node = ast_create(PHP_AST_PRINT, line);
+                ast_add_child(node, operand);
+                return node;
+            }
+
+            // Function call or constant
+            php_ast_node_t* node;
+            if (token_is_op(parser, parser_peek(parser), "(")) {
+                node = ast_create(PHP_AST_CALL, line);
+                ast_set_str(node, token_text(parser, token), token->length);
+                parser_advance(parser);
+                if (!parse_argument_list(parser, node)) {
+                    php_ast_destroy(node);
+                    return NULL;
+                }
+            } else {
+                node = ast_create(PHP_AST_CONSTANT, line);
+                ast_set_str(node, token_text(parser, token), token->length);
+                parser_advance(parser);
+            }
+            return node;
+        }
+
+        default:
+            break;
+    }
+
+    syntax_error(parser, NULL);
+    return NULL;
+}
+
+static php_ast_node_t* parse_postfix(parser_state_t* parser, php_ast_node_t* node) {
+    while (node && !parser->has_error) {
+        int line = parser_current(parser)->line;
+        if (accept_op(parser, "[")) {
+            php_ast_node_t* dim = ast_create(PHP_AST_DIM, line);
+            ast_add_child(dim, node);
+            node = dim;
+            if (accept_op(parser, "]")) {
+                ast_add_child(dim, NULL);
+                continue;
+            }
+            php_ast_node_t* key = parse_expression(parser, 0);
+            if (!key || !expect_op(parser, "]")) {
+                php_ast_destroy(key);
+                php_ast_destroy(dim);
+                return NULL;
+            }
+            ast_add_child(dim, key);
+            continue;
+        }
+        if (is_lvalue(node) && (check_op(parser, "++") || check_op(parser, "--"))) {
+            php_ast_node_t* inc = ast_create(check_op(parser, "++") ? PHP_AST_POST_INC : PHP_AST_POST_DEC, line);
+            ast_add_child(inc, node);
+            parser_advance(parser);
+            node = inc;
+            continue;
+        }
+        break;
+    }
+    return node;
+}
+
+static php_ast_node_t* parse_unary(parser_state_t* parser) {
+    token_t* token = parser_current(parser);
+    int line = token->line;
+
+    if (token->type == TOKEN_OPERATOR) {
+        int unop = -1;
+        int operand_prec = 21;
+
+        if (check_op(parser, "!")) {
+            unop = PHP_UNOP_NOT;
+            operand_prec = 19;
+        } else if (check_op(parser, "-")) {
+            unop = PHP_UNOP_NEG;
+        } else if (check_op(parser, "+")) {
+            unop = PHP_UNOP_PLUS;
+        } else if (check_op(parser, "~")) {
+            unop = PHP_UNOP_BW_NOT;
+        } else if (check_op(parser, "@")) {
+            unop = PHP_UNOP_SILENCE;
+        }
+
+        if (unop >= 0) {
+            parser_advance(parser);
+            php_ast_node_t* operand = parse_expression(parser, operand_prec);
+            if (!operand) return NULL;
+            php_ast_node_t* node = ast_create(PHP_AST_UNARY, line);
+            node->op = unop;
+            ast_add_child(node, operand);
+            return node;
+        }
+
+        if (check_op(parser, "++") || check_op(parser, "--")) {
+            php_ast_kind_t kind = check_op(parser, "++") ? PHP_AST_PRE_INC : PHP_AST_PRE_DEC;
+            parser_advance(parser);
+            php_ast_node_t* operand = parse_postfix(parser, parse_primary(parser));
+            if (!operand) return NULL;
+            if (!is_lvalue(operand)) {
+                syntax_error(parser, "variable");
+                php_ast_destroy(operand);
+                return NULL;
+            }
+            php_ast_node_t* node = ast_create(kind, line);
+            ast_add_child(node, operand);
+            return node;
+        }
+    }
+
+    if (token->type == TOKEN_CAST) {
+        php_ast_node_t* node = ast_create(PHP_AST_CAST, line);
+        node->op = (int)token->extra;
+        parser_advance(parser);
+        php_ast_node_t* operand = parse_expression(parser, 21);
+        if (!operand) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, operand);
+        return node;
+    }
+
+    return parse_postfix(parser, parse_primary(parser));
+}
+
+static php_ast_node_t* parse_operators(parser_state_t* parser, int min_prec) {
+    php_ast_node_t* left = parse_unary(parser);
+
+    while (left && !parser->has_error) {
+        token_t* token = parser_current(parser);
+        int line = token->line;
+
+        // Assignment binds to the nearest variable regardless of precedence
+        if (is_lvalue(left) && (token_is_op(parser, token, "=") || assign_op(parser, token) >= 0)) {
+            int op = assign_op(parser, token);
+            parser_advance(parser);
+            php_ast_node_t* right = parse_expression(parser, 5);
+            if (!right) {
+                php_ast_destroy(left);
+                return NULL;
+            }
+            php_ast_node_t* node = ast_create(op >= 0 ? PHP_AST_ASSIGN_OP : PHP_AST_ASSIGN, line);
+            node->op = op;
+            ast_add_child(node, left);
+            ast_add_child(node, right);
+            left = node;
+            continue;
+        }
+
+        // Ternary
+        if (token_is_op(parser, token, "?") && min_prec <= 6) {
+            parser_advance(parser);
+            php_ast_node_t* node = ast_create(PHP_AST_TERNARY, line);
+            ast_add_child(node, left);
+            if (accept_op(parser, ":")) {
+                ast_add_child(node, NULL);
+            } else {
+                php_ast_node_t* then_expr = parse_expression(parser, 5);
+                if (!then_expr || !expect_op(parser, ":")) {
+                    php_ast_destroy(then_expr);
+                    php_ast_destroy(node);
+                    return NULL;
+                }
+                ast_add_child(node, then_expr);
+            }
+            php_ast_node_t* else_expr = parse_expression(parser, 7);
+            if (!else_expr) {
+                php_ast_destroy(node);
+                return NULL;
+            }
+            ast_add_child(node, else_expr);
+            left = node;
+            continue;
+        }
+
+        int op;
+        bool right_assoc;
+        int prec = binary_precedence(parser, token, &op, &right_assoc);
+        if (prec == 0 || prec < min_prec) {
+            break;
+        }
+
+        // A left-associative operand binds tighter than its operator, so
+        // that recursion is bounded by the number of precedence levels and
+        // is not counted as nesting.
+        parser_advance(parser);
+        php_ast_node_t* right = right_assoc ? parse_expression(parser, prec)
+                                            : parse_operators(parser, prec + 1);
+        if (!right) {
+            php_ast_destroy(left);
+            return NULL;
+        }
+
+        php_ast_node_t* node = ast_create(PHP_AST_BINARY, line);
+        node->op = op;
+        ast_add_child(node, left);
+        ast_add_child(node, right);
+        left = node;
+    }
+
+    if (parser->has_error) {
+        php_ast_destroy(left);
+        return NULL;
+    }
+    return left;
+}
+
+static php_ast_node_t* parse_expression(parser_state_t* parser, int min_prec) {
+    if (!enter_nesting(parser)) return NULL;
+    php_ast_node_t* node = parse_operators(parser, min_prec);
+    parser->depth--;
+    return node;
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
+// Parse statements until one of the given terminator words (or "}" / EOF)
+static php_ast_node_t* parse_statement_list(parser_state_t* parser, const char* const* terminators) {
+    php_ast_node_t* list = ast_create(PHP_AST_STMT_LIST, parser_current(parser)->line);
+
+    while (!parser->has_error && parser_current(parser)->type != TOKEN_EOF) {
+        if (check_op(parser, "}")) break;
+
+        bool done = false;
+        for (int i = 0; terminators && terminators[i]; i++) {
+            if (check_word(parser, terminators[i])) {
+                done = true;
+                break;
+            }
+        }
+        if (done) break;
+
+        php_ast_node_t* stmt = parse_statement(parser);
+        if (stmt) {
+            ast_add_child(list, stmt);
+        }
+    }
+
+    if (parser->has_error) {
+        php_ast_destroy(list);
+        return NULL;
+    }
+    return list;
+}
+
+// Parse "{ ... }" or a single statement
+static php_ast_node_t* parse_block(parser_state_t* parser) {
+    if (accept_op(parser, "{")) {
+        php_ast_node_t* list = parse_statement_list(parser, NULL);
+        if (!list || !expect_op(parser, "}")) {
+            php_ast_destroy(list);
+            return NULL;
+        }
+        return list;
+    }
+    return parse_statement(parser);
+}
+
+// Parse the body of a control structure in either brace or "':' ... endxxx;" syntax
+static php_ast_node_t* parse_control_body(parser_state_t* parser, const char* const* alt_terminators, bool* alt_syntax) {
+    *alt_syntax = false;
+    if (accept_op(parser, ":")) {
+        *alt_syntax = true;
+        return parse_statement_list(parser, alt_terminators);
+    }
+    return parse_block(parser);
+}
+
+static php_ast_node_t* parse_paren_expression(parser_state_t* parser) {
+    if (!expect_op(parser, "(")) return NULL;
+    php_ast_node_t* expr = parse_expression(parser, 0);
+    if (!expr) return NULL;
+    if (!expect_op(parser, ")")) {
+        php_ast_destroy(expr);
+        return NULL;
+    }
+    return expr;
+}
+
+// "elseif" and "else if" branches are parsed in a loop into the one IF
+// node rather than nested, so a long chain takes no stack
+static php_ast_node_t* parse_if(parser_state_t* parser) {
+    static const char* const alt_terminators[] = {"elseif", "else", "endif", NULL};
+    php_ast_node_t* node = ast_create(PHP_AST_IF, parser_current(parser)->line);
+    bool alt_syntax = false;
+    bool is_elseif = false;
+
+    for (;;) {
+        parser_advance(parser);
+        php_ast_node_t* cond = parse_paren_expression(parser);
+        if (!cond) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, cond);
+
+        // An elseif keeps the syntax of the branches before it
+        if (is_elseif && alt_syntax != check_op(parser, ":")) {
+            if (alt_syntax) {
+                expect_op(parser, ":");
+            } else {
+                syntax_error(parser, NULL);
+            }
+            php_ast_destroy(node);
+            return NULL;
+        }
+
+        php_ast_node_t* body = parse_control_body(parser, alt_terminators, &alt_syntax);
+        if (!body) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, body);
+
+        is_elseif = check_word(parser, "elseif");
+        if (is_elseif) continue;
+        if (!accept_word(parser, "else")) {
+            ast_add_child(node, NULL);
+            break;
+        }
+        if (!alt_syntax && check_word(parser, "if")) continue;
+
+        php_ast_node_t* else_branch;
+        if (alt_syntax) {
+            static const char* const endif_only[] = {"endif", NULL};
+            if (!expect_op(parser, ":")) {
+                php_ast_destroy(node);
+                return NULL;
+            }
+            else_branch = parse_statement_list(parser, endif_only);
+        } else {
+            else_branch = parse_block(parser);
+        }
+        if (!else_branch) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, else_branch);
+        break;
+    }
+
+    if (alt_syntax) {
+        if (!accept_word(parser, "endif") || !expect_terminator(parser)) {
+            syntax_error(parser, "\"endif\"");
+            php_ast_destroy(node);
+            return NULL;
+        }
+    }
+    return node;
+}
+
+static php_ast_node_t* parse_while(parser_state_t* parser) {
+    static const char* const alt_terminators[] = {"endwhile", NULL};
+    int line = parser_current(parser)->line;
+    parser_advance(parser);
+
+    php_ast_node_t* node = ast_create(PHP_AST_WHILE, line);
+    php_ast_node_t* cond = parse_paren_expression(parser);
+    if (!cond) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, cond);
+
+    bool alt_syntax;
+    php_ast_node_t* body = parse_control_body(parser, alt_terminators, &alt_syntax);
+    if (!body || (alt_syntax && (!accept_word(parser, "endwhile") || !expect_terminator(parser)))) {
+        php_ast_destroy(body);
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, body);
+    return node;
+}
+
+// foreach target: a variable or element, optionally by reference
+static php_ast_node_t* parse_foreach_target(parser_state_t* parser, bool* by_ref) {
+    *by_ref = accept_op(parser, "&");
+    php_ast_node_t* target = parse_postfix(parser, parse_primary(parser));
+    if (target && !is_lvalue(target)) {
+        syntax_error(parser, "variable");
+        php_ast_destroy(target);
+        return NULL;
+    }
+    return target;
+}
+
+static php_ast_node_t* parse_foreach(parser_state_t* parser) {
+    static const char* const alt_terminators[] = {"endforeach", NULL};
+    int line = parser_current(parser)->line;
+    parser_advance(parser);
+
+    php_ast_node_t* node = ast_create(PHP_AST_FOREACH, line);
+    if (!expect_op(parser, "(")) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    php_ast_node_t* expr = parse_expression(parser, 0);
+    if (!expr) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, expr);
+    if (!accept_word(parser, "as")) {
+        syntax_error(parser, "\"as\"");
+        php_ast_destroy(node);
+        return NULL;
+    }
+
+    bool by_ref;
+    php_ast_node_t* target = parse_foreach_target(parser, &by_ref);
+    if (!target) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    if (!by_ref && accept_op(parser, "=>")) {
+        ast_add_child(node, target);
+        target = parse_foreach_target(parser, &by_ref);
+        if (!target) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+    } else {
+        ast_add_child(node, NULL);
+    }
+    ast_add_child(node, target);
+    node->op = by_ref;
+
+    bool alt_syntax;
+    php_ast_node_t* body = NULL;
+    if (expect_op(parser, ")")) {
+        body = parse_control_body(parser, alt_terminators, &alt_syntax);
+    }
+    if (!body || (alt_syntax && (!accept_word(parser, "endforeach") || !expect_terminator(parser)))) {
+        php_ast_destroy(body);
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, body);
+    return node;
+}
+
+static php_ast_node_t* parse_do_while(parser_state_t* parser) {
+    int line = parser_current(parser)->line;
+    parser_advance(parser);
+
+    php_ast_node_t* node = ast_create(PHP_AST_DO_WHILE, line);
+    php_ast_node_t* body = parse_block(parser);
+    if (!body) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, body);
+
+    if (!accept_word(parser, "while")) {
+        syntax_error(parser, "\"while\"");
+        php_ast_destroy(node);
+        return NULL;
+    }
+    php_ast_node_t* cond = parse_paren_expression(parser);
+    if (!cond || !expect_terminator(parser)) {
+        php_ast_destroy(cond);
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, cond);
+    return node;
+}
+
+// Comma separated expressions up to (not including) the closing token
+static php_ast_node_t* parse_expression_list(parser_state_t* parser, const char* closing) {
+    php_ast_node_t* list = ast_create(PHP_AST_STMT_LIST, parser_current(parser)->line);
+    if (check_op(parser, closing)) {
+        return list;
+    }
+    do {
+        php_ast_node_t* expr = parse_expression(parser, 0);
+        if (!expr) {
+            php_ast_destroy(list);
+            return NULL;
+        }
+        ast_add_child(list, expr);
+    } while (accept_op(parser, ","));
+    return list;
+}
+
+static php_ast_node_t* parse_for(parser_state_t* parser) {
+    static const char* const alt_terminators[] = {"endfor", NULL};
+    int line = parser_current(parser)->line;
+    parser_advance(parser);
+
+    php_ast_node_t* node = ast_create(PHP_AST_FOR, line);
+    if (!expect_op(parser, "(")) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+
+    static const char* const separators[] = {";", ";", ")"};
+    for (int i = 0; i < 3; i++) {
+        php_ast_node_t* list = parse_expression_list(parser, separators[i]);
+        if (!list || !expect_op(parser, separators[i])) {
+            php_ast_destroy(list);
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, list);
+    }
+
+    bool alt_syntax;
+    php_ast_node_t* body = parse_control_body(parser, alt_terminators, &alt_syntax);
+    if (!body || (alt_syntax && (!accept_word(parser, "endfor") || !expect_terminator(parser)))) {
+        php_ast_destroy(body);
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, body);
+    return node;
+}
+
+// Skip a (possibly nullable or union) type declaration
+static void skip_type(parser_state_t* parser) {
+    accept_op(parser, "?");
+    while (parser_current(parser)->type == TOKEN_IDENTIFIER || parser_current(parser)->type == TOKEN_KEYWORD ||
+           check_op(parser, "\\")) {
+        parser_advance(parser);
+        if (!accept_op(parser, "|") && !check_op(parser, "\\") &&
+            parser_current(parser)->type != TOKEN_IDENTIFIER && parser_current(parser)->type != TOKEN_KEYWORD) {
+            break;
+        }
+    }
+}
+
+static php_ast_node_t* parse_function(parser_state_t* parser) {
+    int line = parser_current(parser)->line;
+    parser_advance(parser);
+
+    accept_op(parser, "&");
+    if (parser_current(parser)->type != TOKEN_IDENTIFIER && parser_current(parser)->type != TOKEN_KEYWORD) {
+        syntax_error(parser, "identifier");
+        return NULL;
+    }
+
+    php_ast_node_t* node = ast_create(PHP_AST_FUNC_DECL, line);
+    ast_set_str(node, token_text(parser, parser_current(parser)), parser_current(parser)->length);
+    parser_advance(parser);
+
+    php_ast_node_t* params = ast_create(PHP_AST_STMT_LIST, line);
+    ast_add_child(node, params);
+
+    if (!expect_op(parser, "(")) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    while (!check_op(parser, ")") && !parser->has_error) {
+        skip_type(parser);
+        php_ast_node_t* param = ast_create(PHP_AST_PARAM, parser_current(parser)->line);
+        if (accept_op(parser, "&")) param->op |= PHP_PARAM_BY_REF;
+        if (accept_op(parser, "...")) param->op |= PHP_PARAM_VARIADIC;
+        if (parser_current(parser)->type != TOKEN_VARIABLE) {
+            syntax_error(parser, "variable");
+            php_ast_destroy(param);
+            break;
+        }
+        ast_set_str(param, token_text(parser, parser_current(parser)), parser_current(parser)->length);
+        parser_advance(parser);
+        if (accept_op(parser, "=")) {
+            php_ast_node_t* def = parse_expression(parser, 0);
+            if (!def) {
+                php_ast_destroy(param);
+                break;
+            }
+            ast_add_child(param, def);
+        } else {
+            ast_add_child(param, NULL);
+        }
+        ast_add_child(params, param);
+        if (!accept_op(parser, ",")) break;
+    }
+    if (parser->has_error || !expect_op(parser, ")")) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+
+    if (accept_op(parser, ":")) {
+        skip_type(parser);
+    }
+
+    if (!expect_op(parser, "{")) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    php_ast_node_t* body = parse_statement_list(parser, NULL);
+    if (!body || !expect_op(parser, "}")) {
+        php_ast_destroy(body);
+        php_ast_destroy(node);
+        return NULL;
+    }
+    ast_add_child(node, body);
+    return node;
+}
+
+// "echo a, b;" and "<?= a, b ?>"
+static php_ast_node_t* parse_echo(parser_state_t* parser) {
+    php_ast_node_t* node = ast_create(PHP_AST_ECHO, parser_current(parser)->line);
+    parser_advance(parser);
+
+    do {
+        php_ast_node_t* expr = parse_expression(parser, 0);
+        if (!expr) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        ast_add_child(node, expr);
+    } while (accept_op(parser, ","));
+
+    if (!expect_terminator(parser)) {
+        php_ast_destroy(node);
+        return NULL;
+    }
+    return node;
+}
+
+static php_ast_node_t* parse_statement_node(parser_state_t* parser) {
+    token_t* token = parser_current(parser);
+    int line = token->line;
+
+    switch (token->type) {
+        case TOKEN_INLINE_HTML: {
+            php_ast_node_t* node = ast_create(PHP_AST_INLINE_HTML, line);
+            ast_set_str(node, token_text(parser, token), token->length);
+            parser_advance(parser);
+            return node;
+        }
+        case TOKEN_OPEN_TAG_ECHO:
+            return parse_echo(parser);
+        case TOKEN_CLOSE_TAG:
+            parser_advance(parser);
+            return NULL;
+        default:
+            break;
+    }
+
+    if (accept_op(parser, ";")) {
+        return NULL;
+    }
+    if (check_op(parser, "{")) {
+        return parse_block(parser);
+    }
+
+    if (check_word(parser, "echo")) return parse_echo(parser);
+    if (check_word(parser, "if")) return parse_if(parser);
+    if (check_word(parser, "while")) return parse_while(parser);
+    if (check_word(parser, "do")) return parse_do_while(parser);
+    if (check_word(parser, "for")) return parse_for(parser);
+    if (check_word(parser, "foreach")) return parse_foreach(parser);
+    if (check_word(parser, "function") && parser_peek(parser)->type != TOKEN_OPERATOR) {
+        return parse_function(parser);
+    }
+
+    if (check_word(parser, "return")) {
+        parser_advance(parser);
+        php_ast_node_t* node = ast_create(PHP_AST_RETURN, line);
+        if (!check_op(parser, ";") && parser_current(parser)->type != TOKEN_CLOSE_TAG &&
+            parser_current(parser)->type != TOKEN_EOF) {
+            php_ast_node_t* expr = parse_expression(parser, 0);
+            if (!expr) {
+                php_ast_destroy(node);
+                return NULL;
+            }
+            ast_add_child(node, expr);
+        }
+        if (!expect_terminator(parser)) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    if (check_word(parser, "break") || check_word(parser, "continue")) {
+        php_ast_node_t* node = ast_create(check_word(parser, "break") ? PHP_AST_BREAK : PHP_AST_CONTINUE, line);
+        parser_advance(parser);
+        node->int_val = 1;
+        if (parser_current(parser)->type == TOKEN_NUMBER) {
+            node->int_val = strtoll(token_text(parser, parser_current(parser)), NULL, 10);
+            parser_advance(parser);
+        }
+        if (node->int_val < 1 || !expect_terminator(parser)) {
+            syntax_error(parser, NULL);
+            php_ast_destroy(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    if (check_word(parser, "global")) {
+        parser_advance(parser);
+        php_ast_node_t* node = ast_create(PHP_AST_GLOBAL, line);
+        do {
+            if (parser_current(parser)->type != TOKEN_VARIABLE) {
+                syntax_error(parser, "variable");
+                php_ast_destroy(node);
+                return NULL;
+            }
+            php_ast_node_t* var = ast_create(PHP_AST_VAR, parser_current(parser)->line);
+            ast_set_str(var, token_text(parser, parser_current(parser)), parser_current(parser)->length);
+            ast_add_child(node, var);
+            parser_advance(parser);
+        } while (accept_op(parser, ","));
+        if (!expect_terminator(parser)) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    if (check_word(parser, "unset")) {
+        parser_advance(parser);
+        php_ast_node_t* node = ast_create(PHP_AST_UNSET, line);
+        if (!parse_argument_list(parser, node) || !expect_terminator(parser)) {
+            php_ast_destroy(node);
+            return NULL;
+        }
+        for (size_t i = 0; i < node->child_count; i++) {
+            if (!is_lvalue(node->children[i])) {
+                syntax_error(parser, "variable");
+                php_ast_destroy(node);
+                return NULL;
+            }
+        }
+        return node;
+    }
+
+    // Expression statement
+    php_ast_node_t* expr = parse_expression(parser, 0);
+    if (!expr) {
+        return NULL;
+    }
+    if (!expect_terminator(parser)) {
+        php_ast_destroy(expr);
+        return NULL;
+    }
+    php_ast_node_t* node = ast_create(PHP_AST_EXPR_STMT, line);
+    ast_add_child(node, expr);
+    return node;
+}
+
+static php_ast_node_t* parse_statement(parser_state_t* parser) {
+    if (!enter_nesting(parser)) return NULL;
+    php_ast_node_t* node = parse_statement_node(parser);
+    parser->depth--;
+    return node;
+}
+
+// Parse a complete script into a statement list
+php_ast_node_t* php_parse(const char* source) {
+    parser_state_t* parser = parser_init(source);
+    if (!parser) {
+        return NULL;
+    }
+
+    php_ast_node_t* root = parse_statement_list(parser, NULL);
+    if (root && parser_current(parser)->type != TOKEN_EOF) {
+        syntax_error(parser, NULL);
+        php_ast_destroy(root);
+        root = NULL;
+    }
+
+    parser_cleanup(parser);
+    return root;
+}
+
+// Parse PHP code
+bool parse_php_code(const char* code) {
+    php_ast_node_t* root = php_parse(code);
+    if (!root) {
+        return false;
+    }
+    php_ast_destroy(root);
     return true;
 }
@@ -0,0 +1,186 @@
+/**
+ * PHP Parser Header
+ * Tokenizer and AST construction for the PHP compiler
+ */
+
+#ifndef PHP_PARSER_H
+#define PHP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Token types
+typedef enum {
+    TOKEN_EOF,
+    TOKEN_IDENTIFIER,
+    TOKEN_STRING,          // Single-quoted literal body, \' and \\ escapes pending
+    TOKEN_NUMBER,
+    TOKEN_OPERATOR,
+    TOKEN_KEYWORD,
+    TOKEN_SYMBOL,
+    TOKEN_VARIABLE,        // $name, the slice holds the name without '$'
+    TOKEN_TEMPLATE,        // Double-quoted literal, raw body (escapes and interpolation pending)
+    TOKEN_HEREDOC,         // Heredoc body, indentation, escapes and interpolation pending
+    TOKEN_NOWDOC,          // Nowdoc body, indentation pending
+    TOKEN_CAST,            // "(type)", extra holds the PHP_TYPE_* cast to
+    TOKEN_INLINE_HTML,     // Text outside of <?php ... ?>
+    TOKEN_OPEN_TAG_ECHO,   // <?=
+    TOKEN_CLOSE_TAG        // ?>, acts as a statement terminator
+} token_type_t;
+
+// Token: a slice of the source. Text is only copied out of the source
+// when it becomes part of the AST, through the intern pool.
+typedef struct {
+    token_type_t type;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t extra;        // Keyword: its php_keyword_t. Heredoc/nowdoc: indentation of the closing label
+    int line;
+} token_t;
+
+// Statements and expressions nested deeper than this are a parse error:
+// the parser and every later pass over the tree recurse once per level,
+// which must fit in the module's stack (see the stack-size link option).
+// Left-associative chains such as a + b * c - d do not count.
+#define PHP_PARSE_MAX_DEPTH 256
+
+// Parser state. The whole source is tokenized up front into one array,
+// ending with TOKEN_EOF, which the parser walks by index.
+typedef struct {
+    const char* source;    // NUL-terminated
+    size_t length;
+    size_t position;       // Lexer position
+    int line;              // Lexer line
+    bool in_php;
+    bool has_error;
+    token_t* tokens;
+    size_t token_count;
+    size_t token_capacity;
+    size_t current;        // Index of the current token
+    int depth;             // Statements and expressions being parsed
+} parser_state_t;
+
+// AST node kinds
+typedef enum {
+    // Statements
+    PHP_AST_STMT_LIST,
+    PHP_AST_INLINE_HTML,
+    PHP_AST_ECHO,
+    PHP_AST_EXPR_STMT,
+    PHP_AST_IF,                 // cond, body pairs for if and each elseif, then else body or NULL
+    PHP_AST_WHILE,
+    PHP_AST_DO_WHILE,
+    PHP_AST_FOR,
+    PHP_AST_FOREACH,            // expr, key target or NULL, value target, body; op = 1 for &$value
+    PHP_AST_FUNC_DECL,
+    PHP_AST_PARAM,              // str = name, children[0] = default or NULL; op = PHP_PARAM_* flags
+    PHP_AST_RETURN,
+    PHP_AST_BREAK,
+    PHP_AST_CONTINUE,
+    PHP_AST_GLOBAL,
+    PHP_AST_UNSET,
+
+    // Expressions
+    PHP_AST_NULL_LITERAL,
+    PHP_AST_BOOL_LITERAL,
+    PHP_AST_INT_LITERAL,
+    PHP_AST_FLOAT_LITERAL,
+    PHP_AST_STRING_LITERAL,
+    PHP_AST_CONSTANT,
+    PHP_AST_VAR,                // str = name, or children[0] = name expression ($$name)
+    PHP_AST_ARRAY,              // children are ARRAY_ELEMs
+    PHP_AST_ARRAY_ELEM,         // children[0] = key or NULL, children[1] = value
+    PHP_AST_DIM,                // children[0] = container, children[1] = key or NULL for []
+    PHP_AST_BINARY,
+    PHP_AST_UNARY,
+    PHP_AST_ASSIGN,
+    PHP_AST_ASSIGN_OP,
+    PHP_AST_PRE_INC,
+    PHP_AST_PRE_DEC,
+    PHP_AST_POST_INC,
+    PHP_AST_POST_DEC,
+    PHP_AST_CALL,
+    PHP_AST_TERNARY,
+    PHP_AST_INTERP,
+    PHP_AST_CAST,
+    PHP_AST_ISSET,
+    PHP_AST_EMPTY,
+    PHP_AST_PRINT,
+    PHP_AST_EXIT
+} php_ast_kind_t;
+
+// Flags of PHP_AST_PARAM in php_ast_node_t.op
+#define PHP_PARAM_BY_REF 1      // &$name
+#define PHP_PARAM_VARIADIC 2    // ...$name
+
+// Binary and unary operators carried in php_ast_node_t.op
+typedef enum {
+    PHP_BINOP_ADD,
+    PHP_BINOP_SUB,
+    PHP_BINOP_MUL,
+    PHP_BINOP_DIV,
+    PHP_BINOP_MOD,
+    PHP_BINOP_POW,
+    PHP_BINOP_CONCAT,
+    PHP_BINOP_SL,
+    PHP_BINOP_SR,
+    PHP_BINOP_BW_AND,
+    PHP_BINOP_BW_OR,
+    PHP_BINOP_BW_XOR,
+    PHP_BINOP_EQUAL,
+    PHP_BINOP_NOT_EQUAL,
+    PHP_BINOP_IDENTICAL,
+    PHP_BINOP_NOT_IDENTICAL,
+    PHP_BINOP_SMALLER,
+    PHP_BINOP_SMALLER_OR_EQUAL,
+    PHP_BINOP_GREATER,
+    PHP_BINOP_GREATER_OR_EQUAL,
+    PHP_BINOP_SPACESHIP,
+    PHP_BINOP_BOOL_AND,
+    PHP_BINOP_BOOL_OR,
+    PHP_BINOP_BOOL_XOR,
+    PHP_BINOP_COALESCE
+} php_binary_op_t;
+
+typedef enum {
+    PHP_UNOP_NOT,
+    PHP_UNOP_NEG,
+    PHP_UNOP_PLUS,
+    PHP_UNOP_BW_NOT,
+    PHP_UNOP_SILENCE
+} php_unary_op_t;
+
+// AST node
+typedef struct php_ast_node {
+    php_ast_kind_t kind;
+    int op;                         // Operator, cast type or flags
+    int line;
+    const char* str;                // Name or literal bytes, interned
+    size_t str_len;
+    int64_t int_val;
+    double float_val;
+    struct php_ast_node** children; // NULL entries mark absent optional parts
+    size_t child_count;
+    size_t child_capacity;
+} php_ast_node_t;
+
+// Tokenizer
+parser_state_t* parser_init(const char* source);
+parser_state_t* parser_init_ex(const char* source, bool in_php);
+void parser_cleanup(parser_state_t* parser);
+
+// Parsing
+php_ast_node_t* php_parse(const char* source);
+void php_ast_destroy(php_ast_node_t* node);
+bool parse_php_code(const char* code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_PARSER_H
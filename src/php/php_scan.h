@@ -0,0 +1,123 @@
+/**
+ * PHP Scanning Kernels
+ * Vectorized byte search for the lexer, with a scalar fallback
+ */
+
+#ifndef PHP_SCAN_H
+#define PHP_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One block of input is compared at a time. Each kernel turns the matches
+// of a block into a bit mask with PHP_SCAN_BITS bits per byte; NEON has no
+// movemask, so its masks use four. Loads never reach past the end given.
+#if defined(__AVX2__)
+#define PHP_SCAN_BLOCK 32
+#define PHP_SCAN_BITS 1
+
+static inline uint64_t php_scan_block(const char* p, char a, char b, char c) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(a)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(b)),
+                                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+#elif defined(__SSE2__)
+#define PHP_SCAN_BLOCK 16
+#define PHP_SCAN_BITS 1
+
+static inline uint64_t php_scan_block(const char* p, char a, char b, char c) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(b)),
+                                          _mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+    return (uint32_t)_mm_movemask_epi8(m);
+}
+
+#elif defined(__wasm_simd128__)
+#define PHP_SCAN_BLOCK 16
+#define PHP_SCAN_BITS 1
+
+static inline uint64_t php_scan_block(const char* p, char a, char b, char c) {
+    v128_t v = wasm_v128_load(p);
+    v128_t m = wasm_v128_or(wasm_i8x16_eq(v, wasm_i8x16_splat(a)),
+                            wasm_v128_or(wasm_i8x16_eq(v, wasm_i8x16_splat(b)),
+                                         wasm_i8x16_eq(v, wasm_i8x16_splat(c))));
+    return wasm_i8x16_bitmask(m);
+}
+
+#elif defined(__ARM_NEON)
+#define PHP_SCAN_BLOCK 16
+#define PHP_SCAN_BITS 4
+
+static inline uint64_t php_scan_block(const char* p, char a, char b, char c) {
+    uint8x16_t v = vld1q_u8((const uint8_t*)p);
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, vdupq_n_u8((uint8_t)a)),
+                            vorrq_u8(vceqq_u8(v, vdupq_n_u8((uint8_t)b)),
+                                     vceqq_u8(v, vdupq_n_u8((uint8_t)c))));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#endif
+
+// First byte in [p, end) equal to a, b or c, or end
+static inline const char* php_scan_find3(const char* p, const char* end, char a, char b, char c) {
+#ifdef PHP_SCAN_BLOCK
+    while (end - p >= PHP_SCAN_BLOCK) {
+        uint64_t mask = php_scan_block(p, a, b, c);
+        if (mask) {
+            return p + __builtin_ctzll(mask) / PHP_SCAN_BITS;
+        }
+        p += PHP_SCAN_BLOCK;
+    }
+#endif
+    while (p < end && *p != a && *p != b && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* php_scan_find2(const char* p, const char* end, char a, char b) {
+    return php_scan_find3(p, end, a, b, b);
+}
+
+static inline const char* php_scan_find(const char* p, const char* end, char c) {
+    return php_scan_find3(p, end, c, c, c);
+}
+
+// Occurrences of c in [p, end), used to keep line numbers in step
+static inline size_t php_scan_count(const char* p, const char* end, char c) {
+    size_t count = 0;
+#ifdef PHP_SCAN_BLOCK
+    while (end - p >= PHP_SCAN_BLOCK) {
+        count += (size_t)__builtin_popcountll(php_scan_block(p, c, c, c)) / PHP_SCAN_BITS;
+        p += PHP_SCAN_BLOCK;
+    }
+#endif
+    for (; p < end; p++) {
+        count += *p == c;
+    }
+    return count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_SCAN_H
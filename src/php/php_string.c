@@ -0,0 +1,172 @@
+/**
+ * PHP String Implementation
+ * Length-prefixed, reference counted strings and the interned string pool
+ */
+
+#include "php_string.h"
+#include "php_hash.h"
+#include "php_memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a of the empty string, so "" never needs hashing
+static php_string_t empty_string = {
+    {1, PHP_GC_IMMORTAL | PHP_STRING_INTERNED}, 14695981039346656037ULL, 0, ""
+};
+
+// Interned string pool, keyed by the bytes of each string
+static php_hash_t intern_pool = {0};
+
+static inline void string_header_init(php_string_t* str, size_t length) {
+    str->gc.refcount = 1;
+    str->gc.flags = 0;
+    str->hash = 0;
+    str->len = length;
+    str->val[length] = '\0';
+}
+
+php_string_t* php_string_alloc(size_t length) {
+    php_string_t* str = php_memory_alloc(offsetof(php_string_t, val) + length + 1);
+    if (str) {
+        string_header_init(str, length);
+    }
+    return str;
+}
+
+php_string_t* php_string_init(const char* str, size_t length) {
+    if (length == 0) {
+        return &empty_string;
+    }
+
+    php_string_t* result = php_string_alloc(length);
+    if (result) {
+        memcpy(result->val, str, length);
+    }
+    return result;
+}
+
+php_string_t* php_string_concat(const php_string_t* a, const php_string_t* b) {
+    // Joining with "" shares the other side instead of copying it
+    if (b->len == 0) return php_string_addref((php_string_t*)a);
+    if (a->len == 0) return php_string_addref((php_string_t*)b);
+
+    php_string_t* result = php_string_alloc(a->len + b->len);
+    if (result) {
+        memcpy(result->val, a->val, a->len);
+        memcpy(result->val + a->len, b->val, b->len);
+    }
+    return result;
+}
+
+php_string_t* php_string_extend(php_string_t* str, size_t length) {
+    if (php_string_is_unique(str)) {
+        php_string_t* resized = php_memory_realloc(str, offsetof(php_string_t, val) + length + 1);
+        if (!resized) return NULL;
+        resized->hash = 0;
+        resized->len = length;
+        resized->val[length] = '\0';
+        return resized;
+    }
+
+    php_string_t* copy = php_string_alloc(length);
+    if (!copy) return NULL;
+    memcpy(copy->val, str->val, str->len < length ? str->len : length);
+    php_string_release(str);
+    return copy;
+}
+
+php_string_t* php_string_empty(void) {
+    return &empty_string;
+}
+
+void php_string_free(php_string_t* str) {
+    php_memory_free(str);
+}
+
+uint64_t php_string_hash(php_string_t* str) {
+    if (str->hash == 0) {
+        str->hash = php_hash_bytes(str->val, str->len);
+    }
+    return str->hash;
+}
+
+bool php_string_equals(const php_string_t* a, const php_string_t* b) {
+    if (a == b) return true;
+    if (a->len != b->len) return false;
+    if (a->hash && b->hash && a->hash != b->hash) return false;
+    return memcmp(a->val, b->val, a->len) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Interned strings
+// ---------------------------------------------------------------------------
+
+static php_string_t* intern_hashed(const char* str, size_t length, uint64_t hash) {
+    if (length == 0) {
+        return &empty_string;
+    }
+
+    php_string_t* existing = php_hash_find(&intern_pool, str, length, hash);
+    if (existing) {
+        return existing;
+    }
+
+    // The pool outlives requests, so it stays out of the request heap
+    php_string_t* interned = malloc(offsetof(php_string_t, val) + length + 1);
+    if (!interned) return NULL;
+    string_header_init(interned, length);
+    memcpy(interned->val, str, length);
+    interned->gc.flags = PHP_GC_IMMORTAL | PHP_STRING_INTERNED;
+    interned->hash = hash;
+
+    if (!php_hash_insert(&intern_pool, interned->val, length, hash, interned)) {
+        free(interned);
+        return NULL;
+    }
+    return interned;
+}
+
+php_string_t* php_string_intern(const char* str, size_t length) {
+    return intern_hashed(str, length, php_hash_bytes(str, length));
+}
+
+const char* php_intern(const char* str, size_t length) {
+    php_string_t* interned = php_string_intern(str, length);
+    return interned ? interned->val : NULL;
+}
+
+const char* php_intern_lower(const char* str, size_t length) {
+    // The pool is case-sensitive, so look up the folded spelling; the hash
+    // of the folded bytes equals the case-insensitive hash of the original
+    uint64_t hash = php_hash_bytes_lower(str, length);
+    bool has_upper = false;
+    for (size_t i = 0; i < length && !has_upper; i++) {
+        has_upper = str[i] >= 'A' && str[i] <= 'Z';
+    }
+    if (!has_upper) {
+        php_string_t* interned = intern_hashed(str, length, hash);
+        return interned ? interned->val : NULL;
+    }
+
+    char buffer[128];
+    char* folded = length < sizeof(buffer) ? buffer : malloc(length + 1);
+    if (!folded) return NULL;
+    for (size_t i = 0; i < length; i++) {
+        char c = str[i];
+        folded[i] = (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+    }
+    php_string_t* interned = intern_hashed(folded, length, hash);
+    if (folded != buffer) {
+        free(folded);
+    }
+    return interned ? interned->val : NULL;
+}
+
+void php_intern_cleanup(void) {
+    size_t position = 0;
+    php_hash_bucket_t* bucket;
+    while ((bucket = php_hash_next(&intern_pool, &position)) != NULL) {
+        free(bucket->value);
+    }
+    php_hash_destroy(&intern_pool);
+}
@@ -0,0 +1,80 @@
+/**
+ * PHP String Header
+ * Length-prefixed, reference counted strings and the interned string pool
+ */
+
+#ifndef PHP_STRING_H
+#define PHP_STRING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Header in front of every heap payload. Values are copied by value and
+// only the payload they point to is shared and counted.
+typedef struct {
+    uint32_t refcount;
+    uint32_t flags;
+} php_refcounted_t;
+
+#define PHP_GC_IMMORTAL (1u << 0)       // Static payload, never counted or freed
+#define PHP_STRING_INTERNED (1u << 1)   // Owned by the intern pool, equal strings share it
+
+// Binary-safe string. val is always NUL-terminated so it can be handed to
+// C APIs, but len is authoritative and the bytes may contain NULs.
+typedef struct php_string {
+    php_refcounted_t gc;
+    uint64_t hash;                      // php_hash_bytes of val, 0 until computed
+    size_t len;
+    char val[1];
+} php_string_t;
+
+// Creation, in the request heap; alloc leaves the bytes for the caller to fill
+php_string_t* php_string_alloc(size_t length);
+php_string_t* php_string_init(const char* str, size_t length);
+php_string_t* php_string_concat(const php_string_t* a, const php_string_t* b);
+php_string_t* php_string_empty(void);
+void php_string_free(php_string_t* str);
+
+// Resize to length bytes, keeping the bytes that fit. Takes over the
+// caller's reference: a string nobody else holds is resized in place, a
+// shared one is copied. Returns NULL, leaving str alone, when out of memory.
+php_string_t* php_string_extend(php_string_t* str, size_t length);
+
+// The bytes of a string only the caller holds may be changed in place
+static inline bool php_string_is_unique(const php_string_t* str) {
+    return str->gc.refcount == 1 && !(str->gc.flags & PHP_GC_IMMORTAL);
+}
+
+static inline php_string_t* php_string_addref(php_string_t* str) {
+    if (!(str->gc.flags & PHP_GC_IMMORTAL)) str->gc.refcount++;
+    return str;
+}
+
+static inline void php_string_release(php_string_t* str) {
+    if (!(str->gc.flags & PHP_GC_IMMORTAL) && --str->gc.refcount == 0) {
+        php_string_free(str);
+    }
+}
+
+// Hash, computed on first use and cached in the string
+uint64_t php_string_hash(php_string_t* str);
+bool php_string_equals(const php_string_t* a, const php_string_t* b);
+
+// Interned strings live until php_intern_cleanup(); equal strings share
+// one immortal php_string_t, so they can be compared by address. The
+// char* variants return its bytes, for use as borrowed hash keys.
+php_string_t* php_string_intern(const char* str, size_t length);
+const char* php_intern(const char* str, size_t length);
+const char* php_intern_lower(const char* str, size_t length);
+void php_intern_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_STRING_H
@@ -3,155 +3,157 @@
  * Variable management and scope handling
  */
 
-#include "php_engine.h"
+#include "php_variables.h"
+#include "php_executor.h"
+#include "php_memory.h"
 #include <stdlib.h>
 #include <string.h>
 
-// Variable scope
-typedef enum {
-    SCOPE_GLOBAL,
-    SCOPE_LOCAL,
-    SCOPE_FUNCTION
-} variable_scope_t;
-
-// Variable entry
-typedef struct variable_entry {
-    char* name;
-    php_value_t* value;
-    variable_scope_t scope;
-    struct variable_entry* next;
-} variable_entry_t;
-
-// Variable table
-typedef struct {
-    variable_entry_t* entries;
-    size_t count;
-    size_t capacity;
-} variable_table_t;
-
-static variable_table_t global_variables = {0};
-static variable_table_t* current_scope = &global_variables;
+static php_symbol_table_t global_variables = {0};
 
 // Initialize variable system
 bool php_variables_init(void) {
-    global_variables.capacity = 64;
-    global_variables.entries = calloc(global_variables.capacity, sizeof(variable_entry_t));
-    if (!global_variables.entries) {
-        return false;
-    }
-    return true;
+    return php_symbol_table_init(&global_variables, 64);
 }
 
 // Cleanup variable system
 void php_variables_cleanup(void) {
-    for (size_t i = 0; i < global_variables.count; i++) {
-        if (global_variables.entries[i].name) {
-            free(global_variables.entries[i].name);
-        }
-        if (global_variables.entries[i].value) {
-            php_value_destroy(global_variables.entries[i].value);
+    php_symbol_table_destroy(&global_variables);
+}
+
+// Forget the globals of the finished request. Their variables and values
+// live in the request heap, which is reset right after, so nothing is
+// released one by one.
+void php_variables_reset(void) {
+    php_hash_destroy(&global_variables.table);
+    php_symbol_table_init(&global_variables, 64);
+}
+
+php_symbol_table_t* php_variables_globals(void) {
+    return &global_variables;
+}
+
+// Symbol tables
+bool php_symbol_table_init(php_symbol_table_t* symbols, size_t capacity) {
+    return php_hash_init(&symbols->table, capacity, false);
+}
+
+void php_symbol_table_destroy(php_symbol_table_t* symbols) {
+    size_t position = 0;
+    php_hash_bucket_t* bucket;
+    while ((bucket = php_hash_next(&symbols->table, &position)) != NULL) {
+        // Bound frame slots are released by their frame
+        php_variable_t* var = bucket->value;
+        if (var->is_dynamic) {
+            php_value_release(&var->value);
+            php_memory_free(var);
         }
     }
-    free(global_variables.entries);
-    global_variables.entries = NULL;
-    global_variables.count = 0;
-    global_variables.capacity = 0;
+    php_hash_destroy(&symbols->table);
+}
+
+php_variable_t* php_symbol_table_find(const php_symbol_table_t* symbols, const char* name, size_t length) {
+    return php_hash_find(&symbols->table, name, length, php_hash_bytes(name, length));
+}
+
+php_variable_t* php_symbol_table_add(php_symbol_table_t* symbols, const char* name, size_t length) {
+    uint64_t hash = php_hash_bytes(name, length);
+    php_variable_t* var = php_hash_find(&symbols->table, name, length, hash);
+    if (var) {
+        return var;
+    }
+
+    // Keys are borrowed by the table, so they come from the intern pool
+    const char* key = php_intern(name, length);
+    var = php_memory_alloc(sizeof(php_variable_t));
+    if (!key || !var) {
+        php_memory_free(var);
+        return NULL;
+    }
+    memset(var, 0, sizeof(php_variable_t));
+    var->is_dynamic = true;
+
+    if (!php_hash_insert(&symbols->table, key, length, hash, var)) {
+        php_memory_free(var);
+        return NULL;
+    }
+    return var;
+}
+
+bool php_symbol_table_bind(php_symbol_table_t* symbols, const char* name, size_t length, php_variable_t* slot) {
+    const char* key = php_intern(name, length);
+    return key && php_hash_insert(&symbols->table, key, length, php_hash_bytes(key, length), slot);
+}
+
+// Slot updates
+void php_variable_assign(php_variable_t* var, const php_value_t* value) {
+    var = php_variable_deref(var);
+    php_value_t old = var->value;
+    php_value_copy(&var->value, value);
+    php_value_release(&old);
+}
+
+void php_variable_unset_slot(php_variable_t* var) {
+    if (var->alias) {
+        var->alias = NULL;
+        return;
+    }
+    php_value_release(&var->value);
+    var->value.type = PHP_TYPE_UNDEF;
+}
+
+// Variables of the running scope
+static php_variable_t* active_lookup(const char* name, bool create) {
+    php_symbol_table_t* symbols = php_executor_active_symbols();
+    if (!symbols || !name) return NULL;
+
+    size_t length = strlen(name);
+    php_variable_t* var = create ? php_symbol_table_add(symbols, name, length)
+                                 : php_symbol_table_find(symbols, name, length);
+    return var ? php_variable_deref(var) : NULL;
 }
 
 // Set variable
 bool php_variable_set(const char* name, php_value_t* value) {
     if (!name || !value) return false;
-    
-    // Check if variable already exists
-    for (size_t i = 0; i < current_scope->count; i++) {
-        if (current_scope->entries[i].name && 
-            strcmp(current_scope->entries[i].name, name) == 0) {
-            // Update existing variable
-            php_value_destroy(current_scope->entries[i].value);
-            current_scope->entries[i].value = value;
-            return true;
-        }
-    }
-    
-    // Add new variable
-    if (current_scope->count >= current_scope->capacity) {
-        current_scope->capacity *= 2;
-        current_scope->entries = realloc(current_scope->entries, 
-                                        current_scope->capacity * sizeof(variable_entry_t));
-        if (!current_scope->entries) {
-            return false;
-        }
+
+    php_variable_t* var = active_lookup(name, true);
+    if (!var) {
+        php_value_destroy(value);
+        return false;
     }
-    
-    current_scope->entries[current_scope->count].name = strdup(name);
-    current_scope->entries[current_scope->count].value = value;
-    current_scope->entries[current_scope->count].scope = SCOPE_GLOBAL;
-    current_scope->count++;
-    
+
+    php_value_release(&var->value);
+    php_value_unbox(&var->value, value);
     return true;
 }
 
 // Get variable
 php_value_t* php_variable_get(const char* name) {
-    if (!name) return NULL;
-    
-    // Search current scope first
-    for (size_t i = 0; i < current_scope->count; i++) {
-        if (current_scope->entries[i].name && 
-            strcmp(current_scope->entries[i].name, name) == 0) {
-            return current_scope->entries[i].value;
-        }
-    }
-    
-    return NULL;
+    php_variable_t* var = active_lookup(name, false);
+    return var && var->value.type != PHP_TYPE_UNDEF ? &var->value : NULL;
 }
 
 // Unset variable
 bool php_variable_unset(const char* name) {
-    if (!name) return false;
-    
-    for (size_t i = 0; i < current_scope->count; i++) {
-        if (current_scope->entries[i].name && 
-            strcmp(current_scope->entries[i].name, name) == 0) {
-            free(current_scope->entries[i].name);
-            php_value_destroy(current_scope->entries[i].value);
-            
-            // Move last entry to this position
-            if (i < current_scope->count - 1) {
-                current_scope->entries[i] = current_scope->entries[current_scope->count - 1];
-            }
-            current_scope->count--;
-            return true;
-        }
+    php_symbol_table_t* symbols = php_executor_active_symbols();
+    if (!symbols || !name) return false;
+
+    php_variable_t* var = php_symbol_table_find(symbols, name, strlen(name));
+    if (!var || (!var->alias && var->value.type == PHP_TYPE_UNDEF)) {
+        return false;
     }
-    
-    return false;
+    php_variable_unset_slot(var);
+    return true;
 }
 
 // Check if variable is set
 bool php_variable_isset(const char* name) {
-    return php_variable_get(name) != NULL;
+    php_value_t* value = php_variable_get(name);
+    return value && value->type != PHP_TYPE_NULL;
 }
 
 // Check if variable is empty
 bool php_variable_empty(const char* name) {
-    php_value_t* value = php_variable_get(name);
-    if (!value) return true;
-    
-    switch (value->type) {
-        case PHP_TYPE_NULL:
-            return true;
-        case PHP_TYPE_BOOL:
-            return !value->value.bool_val;
-        case PHP_TYPE_INT:
-            return value->value.int_val == 0;
-        case PHP_TYPE_FLOAT:
-            return value->value.float_val == 0.0;
-        case PHP_TYPE_STRING:
-            return strlen(value->value.string_val) == 0;
-        case PHP_TYPE_ARRAY:
-            return true; // Simplified - would check array length
-        default:
-            return false;
-    }
+    return !php_value_is_true(php_variable_get(name));
 }
@@ -0,0 +1,66 @@
+/**
+ * PHP Variables Header
+ * Variable slots, symbol tables and scope handling
+ */
+
+#ifndef PHP_VARIABLES_H
+#define PHP_VARIABLES_H
+
+#include "php_engine.h"
+#include "php_hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A variable. Compiled variables are slots in their call frame; variables
+// only reached by name ($$name, extract()) are owned by a symbol table.
+// "global $x" turns a local slot into an alias of the global one.
+typedef struct php_variable {
+    php_value_t value;                  // PHP_TYPE_UNDEF while undefined
+    struct php_variable* alias;
+    bool is_dynamic;                    // Allocated and owned by a symbol table
+} php_variable_t;
+
+// Name -> variable map of one scope, keyed by interned names
+typedef struct {
+    php_hash_t table;
+} php_symbol_table_t;
+
+static inline php_variable_t* php_variable_deref(php_variable_t* var) {
+    return var->alias ? var->alias : var;
+}
+
+// Variable system lifecycle; owns the global scope, which reset empties
+// at the end of a request without releasing anything
+bool php_variables_init(void);
+void php_variables_cleanup(void);
+void php_variables_reset(void);
+php_symbol_table_t* php_variables_globals(void);
+
+// Symbol tables
+bool php_symbol_table_init(php_symbol_table_t* symbols, size_t capacity);
+void php_symbol_table_destroy(php_symbol_table_t* symbols);
+php_variable_t* php_symbol_table_find(const php_symbol_table_t* symbols, const char* name, size_t length);
+php_variable_t* php_symbol_table_add(php_symbol_table_t* symbols, const char* name, size_t length);
+bool php_symbol_table_bind(php_symbol_table_t* symbols, const char* name, size_t length, php_variable_t* slot);
+
+// Slot updates. assign copies value and shares its payload; unset drops a
+// "global" alias without touching the global itself.
+void php_variable_assign(php_variable_t* var, const php_value_t* value);
+void php_variable_unset_slot(php_variable_t* var);
+
+// Variables of the running scope (the innermost function call, or the
+// global scope outside functions). set takes ownership of the boxed value;
+// get returns the variable's own value, or NULL when it is undefined.
+bool php_variable_set(const char* name, php_value_t* value);
+php_value_t* php_variable_get(const char* name);
+bool php_variable_unset(const char* name);
+bool php_variable_isset(const char* name);
+bool php_variable_empty(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PHP_VARIABLES_H
@@ -4,6 +4,7 @@
  */
 
 #include "wasi_shim.h"
+#include "wasi_vfs.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -80,6 +81,11 @@ wasi_errno_t wasi_fs_stat(const char* path, wasi_filestat_t* stat) {
         return WASI_EINVAL;
     }
     
+    // Files packed into the module come first
+    if (wasi_vfs_stat(path, stat) == WASI_ESUCCESS) {
+        return WASI_ESUCCESS;
+    }
+
     struct stat st;
     if (stat(path, &st) < 0) {
         switch (errno) {
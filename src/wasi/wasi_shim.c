@@ -4,12 +4,14 @@
  */
 
 #include "wasi_shim.h"
+#include "wasi_vfs.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <errno.h>
 
 // Standard file descriptors
@@ -23,6 +25,46 @@ static char** wasi_argv = NULL;
 static char** wasi_envp = NULL;
 static int wasi_argc = 0;
 
+// Files packed into the module open as descriptors from WASI_VFS_FD_BASE
+// up, which host descriptors do not reach, and are read through the VFS
+#define WASI_VFS_FD_BASE 0x40000000u
+#define WASI_VFS_FD_MAX  64
+
+typedef struct {
+    char* path;                 // NULL for a free slot
+    uint64_t offset;
+    wasi_filestat_t stat;
+} vfs_fd_t;
+
+static vfs_fd_t vfs_fds[WASI_VFS_FD_MAX];
+
+static vfs_fd_t* vfs_fd(wasi_fd_t fd) {
+    if (fd < WASI_VFS_FD_BASE || fd - WASI_VFS_FD_BASE >= WASI_VFS_FD_MAX) {
+        return NULL;
+    }
+    vfs_fd_t* file = &vfs_fds[fd - WASI_VFS_FD_BASE];
+    return file->path ? file : NULL;
+}
+
+// Takes ownership of path
+static wasi_errno_t vfs_open(char* path, const wasi_filestat_t* stat, wasi_rights_t rights, wasi_fd_t* fd) {
+    if (rights & WASI_RIGHT_FD_WRITE) {
+        free(path);
+        return WASI_EROFS;
+    }
+    for (uint32_t i = 0; i < WASI_VFS_FD_MAX; i++) {
+        if (!vfs_fds[i].path) {
+            vfs_fds[i].path = path;
+            vfs_fds[i].offset = 0;
+            vfs_fds[i].stat = *stat;
+            *fd = WASI_VFS_FD_BASE + i;
+            return WASI_ESUCCESS;
+        }
+    }
+    free(path);
+    return WASI_EMFILE;
+}
+
 bool wasi_init(void) {
     if (wasi_initialized) {
         return true;
@@ -41,6 +83,12 @@ void wasi_cleanup(void) {
     }
 
     // Cleanup resources
+    for (uint32_t i = 0; i < WASI_VFS_FD_MAX; i++) {
+        free(vfs_fds[i].path);
+        vfs_fds[i].path = NULL;
+    }
+    wasi_vfs_unmount();
+
     if (wasi_argv) {
         free(wasi_argv);
         wasi_argv = NULL;
@@ -61,6 +109,23 @@ wasi_errno_t wasi_fd_read(wasi_fd_t fd, const wasi_iovec_t* iovs, size_t iovs_le
     }
 
     *nread = 0;
+
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        for (size_t i = 0; i < iovs_len; i++) {
+            size_t count = 0;
+            wasi_errno_t error = wasi_vfs_pread(file->path, file->offset, (void*)iovs[i].buf, iovs[i].len, &count);
+            if (error != WASI_ESUCCESS) {
+                return error;
+            }
+            file->offset += count;
+            *nread += count;
+            if (count < iovs[i].len) {
+                break;
+            }
+        }
+        return WASI_ESUCCESS;
+    }
     
     for (size_t i = 0; i < iovs_len; i++) {
         ssize_t result = read(fd, (void*)iovs[i].buf, iovs[i].len);
@@ -87,23 +152,25 @@ wasi_errno_t wasi_fd_write(wasi_fd_t fd, const wasi_ciovec_t* iovs, size_t iovs_
     }
 
     *nwritten = 0;
-    
-    for (size_t i = 0; i < iovs_len; i++) {
-        ssize_t result = write(fd, iovs[i].buf, iovs[i].len);
-        if (result < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                return WASI_EAGAIN;
-            }
-            return WASI_EIO;
-        }
-        *nwritten += result;
-        
-        // If we wrote less than requested, we're done
-        if ((size_t)result < iovs[i].len) {
-            break;
+
+    // Gather lists go out in one writev, as fd_write does on a WASI host;
+    // callers resume after a short write
+    struct iovec vec[64];
+    size_t count = iovs_len < 64 ? iovs_len : 64;
+    for (size_t i = 0; i < count; i++) {
+        vec[i].iov_base = iovs[i].buf;
+        vec[i].iov_len = iovs[i].len;
+    }
+
+    ssize_t result = writev(fd, vec, (int)count);
+    if (result < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return WASI_EAGAIN;
         }
+        return WASI_EIO;
     }
-    
+    *nwritten = (size_t)result;
+
     return WASI_ESUCCESS;
 }
 
@@ -120,6 +187,17 @@ wasi_errno_t wasi_fd_seek(wasi_fd_t fd, int64_t offset, uint8_t whence, uint64_t
         default: return WASI_EINVAL;
     }
 
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        uint64_t base = whence == 0 ? 0 : whence == 1 ? file->offset : file->stat.size;
+        if (offset < 0 && (uint64_t)-(offset + 1) >= base) {
+            return WASI_EINVAL;
+        }
+        file->offset = base + (uint64_t)offset;
+        *newoffset = file->offset;
+        return WASI_ESUCCESS;
+    }
+
     off_t result = lseek(fd, offset, posix_whence);
     if (result < 0) {
         return WASI_EIO;
@@ -134,6 +212,12 @@ wasi_errno_t wasi_fd_tell(wasi_fd_t fd, uint64_t* newoffset) {
         return WASI_EINVAL;
     }
 
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        *newoffset = file->offset;
+        return WASI_ESUCCESS;
+    }
+
     off_t result = lseek(fd, 0, SEEK_CUR);
     if (result < 0) {
         return WASI_EIO;
@@ -144,6 +228,13 @@ wasi_errno_t wasi_fd_tell(wasi_fd_t fd, uint64_t* newoffset) {
 }
 
 wasi_errno_t wasi_fd_close(wasi_fd_t fd) {
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        free(file->path);
+        file->path = NULL;
+        return WASI_ESUCCESS;
+    }
+
     if (close(fd) < 0) {
         return WASI_EIO;
     }
@@ -164,6 +255,15 @@ wasi_errno_t wasi_fd_fdstat_get(wasi_fd_t fd, wasi_fdstat_t* stat) {
         return WASI_ESUCCESS;
     }
 
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        stat->filetype = file->stat.filetype;
+        stat->flags = 0;
+        stat->rights_base = WASI_RIGHT_FD_READ;
+        stat->rights_inheriting = 0;
+        return WASI_ESUCCESS;
+    }
+
     // For other file descriptors, we'd need to query the actual file
     // This is a simplified implementation
     stat->filetype = WASI_FILETYPE_REGULAR_FILE;
@@ -179,6 +279,12 @@ wasi_errno_t wasi_fd_filestat_get(wasi_fd_t fd, wasi_filestat_t* stat) {
         return WASI_EINVAL;
     }
 
+    vfs_fd_t* file = vfs_fd(fd);
+    if (file) {
+        *stat = file->stat;
+        return WASI_ESUCCESS;
+    }
+
     struct stat st;
     if (fstat(fd, &st) < 0) {
         return WASI_EIO;
@@ -200,11 +306,43 @@ wasi_errno_t wasi_fd_filestat_get(wasi_fd_t fd, wasi_filestat_t* stat) {
     return WASI_ESUCCESS;
 }
 
+// Copy what fits of data into buf after the *used bytes already there
+static void readdir_copy(uint8_t* buf, size_t buf_len, size_t* used, const void* data, size_t length) {
+    size_t count = buf_len - *used < length ? buf_len - *used : length;
+    memcpy(buf + *used, data, count);
+    *used += count;
+}
+
 wasi_errno_t wasi_fd_readdir(wasi_fd_t fd, uint8_t* buf, size_t buf_len, uint64_t cookie, size_t* nread) {
-    // This is a simplified implementation
-    // In a real WASI implementation, this would read directory entries
+    if (!buf || !nread) {
+        return WASI_EINVAL;
+    }
     *nread = 0;
-    return WASI_ENOSYS; // Not implemented in this simplified version
+
+    // Only directories packed into the module can be listed
+    vfs_fd_t* file = vfs_fd(fd);
+    if (!file) {
+        return WASI_ENOSYS;
+    }
+    if (file->stat.filetype != WASI_FILETYPE_DIRECTORY) {
+        return WASI_ENOTDIR;
+    }
+
+    // Each entry is a wasi_dirent_t followed by the name. The last one is
+    // cut off where the buffer ends, and a full buffer tells the caller to
+    // read again from the cookie of the last whole entry.
+    const char* name = NULL;
+    wasi_filetype_t type = WASI_FILETYPE_UNKNOWN;
+    for (; *nread < buf_len && wasi_vfs_readdir(file->path, cookie, &name, &type) == WASI_ESUCCESS; cookie++) {
+        wasi_dirent_t dirent;
+        memset(&dirent, 0, sizeof(dirent));
+        dirent.d_next = cookie + 1;
+        dirent.d_namlen = strlen(name);
+        dirent.d_type = type;
+        readdir_copy(buf, buf_len, nread, &dirent, sizeof(dirent));
+        readdir_copy(buf, buf_len, nread, name, (size_t)dirent.d_namlen);
+    }
+    return WASI_ESUCCESS;
 }
 
 wasi_errno_t wasi_path_open(wasi_fd_t dirfd, uint32_t dirflags, const char* path, size_t path_len, 
@@ -222,6 +360,12 @@ wasi_errno_t wasi_path_open(wasi_fd_t dirfd, uint32_t dirflags, const char* path
     memcpy(null_terminated_path, path, path_len);
     null_terminated_path[path_len] = '\0';
 
+    // Files packed into the module come first, as in wasi_fs_stat
+    wasi_filestat_t vfs_stat;
+    if (wasi_vfs_stat(null_terminated_path, &vfs_stat) == WASI_ESUCCESS) {
+        return vfs_open(null_terminated_path, &vfs_stat, rights_base, fd);
+    }
+
     int flags = 0;
     if (rights_base & WASI_RIGHT_FD_READ) {
         flags |= O_RDONLY;
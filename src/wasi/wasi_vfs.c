@@ -0,0 +1,358 @@
+/**
+ * WASI Virtual File System Implementation
+ * Mounts images written by tools/php2wasm_pack.c and reads files from them
+ */
+
+#include "wasi_vfs.h"
+#include "wasi_vfs_format.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Decompressed contents, filled a block at a time
+typedef struct {
+    uint8_t* data;
+    uint8_t* ready;     // Per block
+    bool in_place;      // Stored raw and contiguous, so read from the image
+} vfs_cache_t;
+
+// The mounted image
+static const vfs_header_t* vfs_header = NULL;
+static const uint32_t* vfs_buckets = NULL;
+static const uint32_t* vfs_slots = NULL;
+static const vfs_node_t* vfs_nodes = NULL;
+static const vfs_content_t* vfs_contents = NULL;
+static const vfs_block_t* vfs_blocks = NULL;
+static const char* vfs_strings = NULL;
+static const uint8_t* vfs_data = NULL;
+static vfs_cache_t* vfs_cache = NULL;
+
+// ---------------------------------------------------------------------------
+// Paths
+// ---------------------------------------------------------------------------
+
+// Resolve "." and ".." and drop empty components and leading slashes, so
+// "/src/./lib//a.php" is "src/lib/a.php" and the root is ""
+static bool vfs_normalize(const char* path, char* out, size_t* length) {
+    size_t n = 0;
+    while (*path) {
+        while (*path == '/') path++;
+        const char* end = path;
+        while (*end && *end != '/') end++;
+        size_t part = (size_t)(end - path);
+
+        if (part == 2 && path[0] == '.' && path[1] == '.') {
+            while (n > 0 && out[--n] != '/') {}
+        } else if (part > 0 && !(part == 1 && path[0] == '.')) {
+            if (n + part + 2 > VFS_PATH_MAX) return false;
+            if (n > 0) out[n++] = '/';
+            memcpy(out + n, path, part);
+            n += part;
+        }
+        path = end;
+    }
+    out[n] = '\0';
+    *length = n;
+    return true;
+}
+
+static uint32_t vfs_find(const char* path) {
+    char normal[VFS_PATH_MAX];
+    size_t length = 0;
+    if (!vfs_header || !path || !vfs_normalize(path, normal, &length) || !vfs_header->node_count) {
+        return VFS_NO_NODE;
+    }
+
+    uint32_t bucket = vfs_hash(normal, length, 0) % vfs_header->bucket_count;
+    uint32_t slot = vfs_hash(normal, length, vfs_buckets[bucket]) % vfs_header->slot_count;
+    uint32_t node = vfs_slots[slot];
+    if (node == VFS_NO_NODE || strcmp(vfs_strings + vfs_nodes[node].path, normal) != 0) {
+        return VFS_NO_NODE;
+    }
+    return node;
+}
+
+// ---------------------------------------------------------------------------
+// LZ4 block format, see wasi_vfs_format.h
+// ---------------------------------------------------------------------------
+
+static bool lz4_length(const uint8_t** in, const uint8_t* end, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*in >= end) return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static bool lz4_decompress(const uint8_t* in, size_t in_length, uint8_t* out, size_t out_length) {
+    const uint8_t* in_end = in + in_length;
+    uint8_t* op = out;
+    uint8_t* out_end = out + out_length;
+
+    while (in < in_end) {
+        uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !lz4_length(&in, in_end, &literals)) return false;
+        if ((size_t)(in_end - in) < literals || (size_t)(out_end - op) < literals) return false;
+        memcpy(op, in, literals);
+        op += literals;
+        in += literals;
+        if (in == in_end) break;
+
+        if (in_end - in < 2) return false;
+        size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t match = token & 15;
+        if (match == 15 && !lz4_length(&in, in_end, &match)) return false;
+        match += 4;
+        if (offset == 0 || offset > (size_t)(op - out) || (size_t)(out_end - op) < match) return false;
+
+        // Byte by byte, as a match may overlap what it produces
+        const uint8_t* from = op - offset;
+        while (match--) *op++ = *from++;
+    }
+    return op == out_end;
+}
+
+// ---------------------------------------------------------------------------
+// Mounting
+// ---------------------------------------------------------------------------
+
+static bool vfs_validate(const vfs_header_t* header) {
+    if (header->strings_size == 0 || vfs_strings[header->strings_size - 1] != '\0') return false;
+    if (header->node_count == 0) return true;
+    if (header->bucket_count == 0 || header->slot_count < header->node_count) return false;
+    if (vfs_nodes[0].type != WASI_FILETYPE_DIRECTORY) return false;
+
+    for (uint32_t i = 0; i < header->slot_count; i++) {
+        if (vfs_slots[i] != VFS_NO_NODE && vfs_slots[i] >= header->node_count) return false;
+    }
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const vfs_node_t* node = &vfs_nodes[i];
+        if (node->path >= header->strings_size || node->name >= header->strings_size) return false;
+        if (node->type == WASI_FILETYPE_DIRECTORY) {
+            if (node->first > header->node_count || node->count > header->node_count - node->first) return false;
+        } else if (node->type != WASI_FILETYPE_REGULAR_FILE || node->first >= header->content_count) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->content_count; i++) {
+        const vfs_content_t* content = &vfs_contents[i];
+        if (content->first_block > header->block_count ||
+            content->block_count > header->block_count - content->first_block ||
+            content->block_count != (content->size + VFS_BLOCK_SIZE - 1) / VFS_BLOCK_SIZE) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        uint32_t length = vfs_blocks[i].length & ~VFS_RAW_BLOCK;
+        if (vfs_blocks[i].offset > header->data_size || length > header->data_size - vfs_blocks[i].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool wasi_vfs_mount(const uint8_t* image, size_t size) {
+    wasi_vfs_unmount();
+    if (!image || size < sizeof(vfs_header_t) || ((uintptr_t)image & 7) != 0) return false;
+
+    const vfs_header_t* header = (const vfs_header_t*)image;
+    if (memcmp(header->magic, VFS_MAGIC, 4) != 0 || header->version != VFS_FORMAT_VERSION) return false;
+
+    uint64_t offset = vfs_align(sizeof(vfs_header_t));
+    uint64_t buckets = offset;
+    offset = vfs_align(offset + (uint64_t)header->bucket_count * sizeof(uint32_t));
+    uint64_t slots = offset;
+    offset = vfs_align(offset + (uint64_t)header->slot_count * sizeof(uint32_t));
+    uint64_t nodes = offset;
+    offset = vfs_align(offset + (uint64_t)header->node_count * sizeof(vfs_node_t));
+    uint64_t contents = offset;
+    offset = vfs_align(offset + (uint64_t)header->content_count * sizeof(vfs_content_t));
+    uint64_t blocks = offset;
+    offset = vfs_align(offset + (uint64_t)header->block_count * sizeof(vfs_block_t));
+    uint64_t strings = offset;
+    offset = vfs_align(offset + header->strings_size);
+    uint64_t data = offset;
+    if (offset + header->data_size != size) return false;
+
+    vfs_buckets = (const uint32_t*)(image + buckets);
+    vfs_slots = (const uint32_t*)(image + slots);
+    vfs_nodes = (const vfs_node_t*)(image + nodes);
+    vfs_contents = (const vfs_content_t*)(image + contents);
+    vfs_blocks = (const vfs_block_t*)(image + blocks);
+    vfs_strings = (const char*)(image + strings);
+    vfs_data = image + data;
+    if (!vfs_validate(header)) return false;
+
+    vfs_cache = calloc(header->content_count ? header->content_count : 1, sizeof(vfs_cache_t));
+    if (!vfs_cache) return false;
+    for (uint32_t i = 0; i < header->content_count; i++) {
+        const vfs_content_t* content = &vfs_contents[i];
+        bool in_place = true;
+        for (uint32_t b = 0; b < content->block_count && in_place; b++) {
+            const vfs_block_t* block = &vfs_blocks[content->first_block + b];
+            in_place = (block->length & VFS_RAW_BLOCK) &&
+                       block->offset == vfs_blocks[content->first_block].offset + (uint64_t)b * VFS_BLOCK_SIZE;
+        }
+        vfs_cache[i].in_place = in_place;
+    }
+
+    vfs_header = header;
+    return true;
+}
+
+void wasi_vfs_unmount(void) {
+    if (vfs_cache && vfs_header) {
+        for (uint32_t i = 0; i < vfs_header->content_count; i++) {
+            free(vfs_cache[i].data);
+            free(vfs_cache[i].ready);
+        }
+    }
+    free(vfs_cache);
+    vfs_cache = NULL;
+    vfs_header = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Access
+// ---------------------------------------------------------------------------
+
+static wasi_errno_t vfs_file(const char* path, uint32_t* content) {
+    uint32_t node = vfs_find(path);
+    if (node == VFS_NO_NODE) return WASI_ENOENT;
+    if (vfs_nodes[node].type == WASI_FILETYPE_DIRECTORY) return WASI_EISDIR;
+    *content = vfs_nodes[node].first;
+    return WASI_ESUCCESS;
+}
+
+static bool vfs_load_block(uint32_t index, uint32_t block_index) {
+    const vfs_content_t* content = &vfs_contents[index];
+    vfs_cache_t* cache = &vfs_cache[index];
+    if (!cache->data) {
+        cache->data = malloc(content->size);
+        cache->ready = calloc(content->block_count, 1);
+        if (!cache->data || !cache->ready) {
+            free(cache->data);
+            free(cache->ready);
+            cache->data = NULL;
+            cache->ready = NULL;
+            return false;
+        }
+    }
+    if (cache->ready[block_index]) return true;
+
+    const vfs_block_t* block = &vfs_blocks[content->first_block + block_index];
+    size_t offset = (size_t)block_index * VFS_BLOCK_SIZE;
+    size_t length = content->size - offset < VFS_BLOCK_SIZE ? (size_t)(content->size - offset) : VFS_BLOCK_SIZE;
+    size_t stored = block->length & ~VFS_RAW_BLOCK;
+
+    if (block->length & VFS_RAW_BLOCK) {
+        if (stored != length) return false;
+        memcpy(cache->data + offset, vfs_data + block->offset, length);
+    } else if (!lz4_decompress(vfs_data + block->offset, stored, cache->data + offset, length)) {
+        return false;
+    }
+    cache->ready[block_index] = 1;
+    return true;
+}
+
+wasi_errno_t wasi_vfs_stat(const char* path, wasi_filestat_t* stat) {
+    if (!path || !stat) {
+        return WASI_EINVAL;
+    }
+
+    uint32_t node = vfs_find(path);
+    if (node == VFS_NO_NODE) {
+        return WASI_ENOENT;
+    }
+
+    memset(stat, 0, sizeof(*stat));
+    stat->filetype = (uint8_t)vfs_nodes[node].type;
+    stat->nlink = 1;
+    if (vfs_nodes[node].type == WASI_FILETYPE_REGULAR_FILE) {
+        stat->size = vfs_contents[vfs_nodes[node].first].size;
+    }
+    return WASI_ESUCCESS;
+}
+
+wasi_errno_t wasi_vfs_map(const char* path, const uint8_t** data, size_t* size) {
+    if (!path || !data || !size) {
+        return WASI_EINVAL;
+    }
+
+    uint32_t index = 0;
+    wasi_errno_t error = vfs_file(path, &index);
+    if (error != WASI_ESUCCESS) {
+        return error;
+    }
+
+    const vfs_content_t* content = &vfs_contents[index];
+    if (vfs_cache[index].in_place) {
+        *data = content->block_count ? vfs_data + vfs_blocks[content->first_block].offset : vfs_data;
+    } else {
+        for (uint32_t b = 0; b < content->block_count; b++) {
+            if (!vfs_load_block(index, b)) return WASI_EIO;
+        }
+        *data = vfs_cache[index].data;
+    }
+    *size = (size_t)content->size;
+    return WASI_ESUCCESS;
+}
+
+wasi_errno_t wasi_vfs_pread(const char* path, uint64_t offset, void* buf, size_t count, size_t* nread) {
+    if (!path || !buf || !nread) {
+        return WASI_EINVAL;
+    }
+
+    uint32_t index = 0;
+    wasi_errno_t error = vfs_file(path, &index);
+    if (error != WASI_ESUCCESS) {
+        return error;
+    }
+
+    const vfs_content_t* content = &vfs_contents[index];
+    *nread = 0;
+    if (offset >= content->size || count == 0) {
+        return WASI_ESUCCESS;
+    }
+    if (count > content->size - offset) {
+        count = (size_t)(content->size - offset);
+    }
+
+    if (vfs_cache[index].in_place) {
+        memcpy(buf, vfs_data + vfs_blocks[content->first_block].offset + offset, count);
+    } else {
+        uint32_t first = (uint32_t)(offset / VFS_BLOCK_SIZE);
+        uint32_t last = (uint32_t)((offset + count - 1) / VFS_BLOCK_SIZE);
+        for (uint32_t b = first; b <= last; b++) {
+            if (!vfs_load_block(index, b)) return WASI_EIO;
+        }
+        memcpy(buf, vfs_cache[index].data + offset, count);
+    }
+    *nread = count;
+    return WASI_ESUCCESS;
+}
+
+wasi_errno_t wasi_vfs_readdir(const char* path, uint64_t cookie, const char** name, wasi_filetype_t* type) {
+    if (!path || !name || !type) {
+        return WASI_EINVAL;
+    }
+
+    uint32_t node = vfs_find(path);
+    if (node == VFS_NO_NODE) {
+        return WASI_ENOENT;
+    }
+    if (vfs_nodes[node].type != WASI_FILETYPE_DIRECTORY) {
+        return WASI_ENOTDIR;
+    }
+    if (cookie >= vfs_nodes[node].count) {
+        return WASI_ENOENT;
+    }
+
+    const vfs_node_t* child = &vfs_nodes[vfs_nodes[node].first + cookie];
+    *name = vfs_strings + child->name;
+    *type = (wasi_filetype_t)child->type;
+    return WASI_ESUCCESS;
+}
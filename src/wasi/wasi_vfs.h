@@ -0,0 +1,37 @@
+/**
+ * WASI Virtual File System Header
+ * Read-only files packed into the module, found through a perfect hash
+ */
+
+#ifndef WASI_VFS_H
+#define WASI_VFS_H
+
+#include "wasi_shim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Make an image written by php2wasm-pack the file system of the module.
+// Paths are relative to its root, with or without a leading "/"; the
+// image must outlive the mount.
+bool wasi_vfs_mount(const uint8_t* image, size_t size);
+void wasi_vfs_unmount(void);
+
+wasi_errno_t wasi_vfs_stat(const char* path, wasi_filestat_t* stat);
+
+// The whole contents of a file. Compressed files are decompressed on first
+// access and kept while mounted; the others are read in place.
+wasi_errno_t wasi_vfs_map(const char* path, const uint8_t** data, size_t* size);
+
+// Read up to count bytes at offset, decompressing only the blocks spanned
+wasi_errno_t wasi_vfs_pread(const char* path, uint64_t offset, void* buf, size_t count, size_t* nread);
+
+// The entry at cookie (from 0) of a directory; WASI_ENOENT past the last
+wasi_errno_t wasi_vfs_readdir(const char* path, uint64_t cookie, const char** name, wasi_filetype_t* type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WASI_VFS_H
@@ -0,0 +1,87 @@
+/**
+ * WASI Virtual File System Image Format
+ * Shared by the runtime (wasi_vfs.c) and the packer (tools/php2wasm_pack.c)
+ */
+
+#ifndef WASI_VFS_FORMAT_H
+#define WASI_VFS_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Image layout, every section aligned to 8 bytes:
+//   header
+//   bucket seeds   u32[bucket_count]    First level of the path hash
+//   slots          u32[slot_count]      Node of each second level hash
+//   nodes          vfs_node_t[]         Breadth first from the root, so the
+//                                       children of a directory are adjacent
+//   contents       vfs_content_t[]      Distinct file contents
+//   blocks         vfs_block_t[]        VFS_BLOCK_SIZE pieces of contents,
+//                                       LZ4 block format or stored raw
+//   strings        Paths relative to the root, without leading "/" or
+//                  "." and ".." components, NUL-terminated
+//   data           Stored blocks
+#define VFS_MAGIC "P2WV"
+#define VFS_FORMAT_VERSION 1
+#define VFS_BLOCK_SIZE 65536
+#define VFS_RAW_BLOCK 0x80000000u
+#define VFS_NO_NODE UINT32_MAX
+#define VFS_PATH_MAX 4096
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t node_count;
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t content_count;
+    uint32_t block_count;
+    uint32_t strings_size;
+    uint32_t data_size;
+    uint32_t reserved;
+} vfs_header_t;
+
+typedef struct {
+    uint32_t path;      // Offset of the path in the strings
+    uint32_t name;      // Offset of its last component
+    uint32_t type;      // WASI_FILETYPE_DIRECTORY or WASI_FILETYPE_REGULAR_FILE
+    uint32_t first;     // First child of a directory, content of a file
+    uint32_t count;     // Children of a directory
+    uint32_t reserved;
+} vfs_node_t;
+
+typedef struct {
+    uint64_t size;
+    uint32_t first_block;
+    uint32_t block_count;
+} vfs_content_t;
+
+typedef struct {
+    uint32_t offset;    // In the data section
+    uint32_t length;    // Stored length, with VFS_RAW_BLOCK when not compressed
+} vfs_block_t;
+
+// LZ4 block format: sequences of a token (literal length << 4 | match
+// length - 4), extra length bytes when a nibble is 15, the literals, a
+// 16-bit offset and extra match length bytes. The last sequence has
+// literals only, the last 5 bytes are literals and no match starts in the
+// last 12.
+
+// Hash of a normalized path: bucket seeds are 0, slots the bucket's seed
+static inline uint32_t vfs_hash(const char* path, size_t length, uint32_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)path[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return (uint32_t)hash;
+}
+
+static inline uint64_t vfs_align(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+#endif // WASI_VFS_FORMAT_H
@@ -0,0 +1,14 @@
+<?php
+/**
+ * Entry script of the application packed by run_tests.sh
+ */
+
+function render($title, $items) {
+    $html = "<h1>" . $title . "</h1>\n";
+    foreach ($items as $item) {
+        $html .= "<li>" . $item . "</li>\n";
+    }
+    return $html;
+}
+
+echo render("Packed", ["read from the module", "not from the disk"]);
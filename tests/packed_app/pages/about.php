@@ -0,0 +1,50 @@
+<?php
+/**
+ * A larger script, stored compressed in the packed image
+ */
+
+$rows = [];
+$rows[] = "row 1: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 2: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 3: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 4: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 5: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 6: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 7: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 8: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 9: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 10: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 11: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 12: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 13: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 14: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 15: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 16: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 17: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 18: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 19: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 20: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 21: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 22: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 23: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 24: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 25: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 26: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 27: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 28: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 29: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 30: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 31: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 32: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 33: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 34: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 35: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 36: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 37: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 38: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 39: the quick brown fox jumps over the lazy dog";
+$rows[] = "row 40: the quick brown fox jumps over the lazy dog";
+
+echo "about: ", count($rows), " rows\n";
+echo $rows[0], "\n";
+echo $rows[39], "\n";
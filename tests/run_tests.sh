@@ -118,6 +118,141 @@ run_all_tests() {
     done
 }
 
+# Run the opcache test against a file cache, then again after damaging
+# the cached entries; the corrupt entries must be recompiled, not run
+run_opcache_corruption_test() {
+    local test_file="$TEST_DIR/test_opcache.php"
+    local expected_file="$EXPECTED_DIR/test_opcache.txt"
+    local cache_dir="$OUTPUT_DIR/opcache"
+    local output_file="$OUTPUT_DIR/test_opcache_corrupt.out"
+
+    TOTAL_TESTS=$((TOTAL_TESTS + 1))
+
+    print_info "Running test: test_opcache (corrupted file cache)"
+
+    rm -rf "$cache_dir"
+    mkdir -p "$cache_dir"
+    if ! wasmtime run --dir=. "$WASM_BINARY" -- -dopcache.file_cache="$cache_dir" "$test_file" > "$output_file" 2>&1 ||
+       ! ls "$cache_dir"/*.phpc > /dev/null 2>&1; then
+        print_error "test_opcache - File cache was not written"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+        return
+    fi
+
+    for entry in "$cache_dir"/*.phpc; do
+        printf 'corrupt' | dd of="$entry" bs=1 seek=40 conv=notrunc 2> /dev/null
+    done
+
+    if wasmtime run --dir=. "$WASM_BINARY" -- -dopcache.file_cache="$cache_dir" "$test_file" > "$output_file" 2>&1 &&
+       diff -q "$output_file" "$expected_file" > /dev/null; then
+        print_success "test_opcache - Corrupted cache entries were recompiled"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        print_error "test_opcache - Output from a corrupted cache does not match expected"
+        print_info "Actual:"
+        cat "$output_file"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# Remove the cached entries and leave temporary files in their place, as
+# a worker that died while writing would; they must be written again
+run_opcache_stale_temp_test() {
+    local test_file="$TEST_DIR/test_opcache.php"
+    local cache_dir="$OUTPUT_DIR/opcache"
+    local output_file="$OUTPUT_DIR/test_opcache_stale.out"
+    local entries=("$cache_dir"/*.phpc)
+
+    TOTAL_TESTS=$((TOTAL_TESTS + 1))
+
+    print_info "Running test: test_opcache (stale temporary files)"
+
+    if [[ ! -f "${entries[0]}" ]]; then
+        print_error "test_opcache - No file cache entries to replace"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+        return
+    fi
+    for entry in "${entries[@]}"; do
+        rm -f "$entry"
+        touch "$entry.tmp"
+    done
+
+    if wasmtime run --dir=. "$WASM_BINARY" -- -dopcache.file_cache="$cache_dir" "$test_file" > "$output_file" 2>&1 &&
+       ls "${entries[@]}" > /dev/null 2>&1; then
+        print_success "test_opcache - Entries were written past stale temporary files"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        print_error "test_opcache - Stale temporary files blocked the file cache"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
+# Pack packed_app into a module and run its scripts from an empty
+# directory, so that they can only come from what was packed. The paths
+# are spelled differently to check that they resolve alike. With
+# PHP2WASM_HOST set, the scripts are also packed compiled to bytecode, and
+# with their functions compiled ahead of time. With wizer available, the
+# module is also snapshotted with the entry script preloaded.
+run_packed_module_test() {
+    local app_dir="$TEST_DIR/packed_app"
+    local expected_file="$EXPECTED_DIR/packed_app.txt"
+    local run_dir="$OUTPUT_DIR/packed_run"
+    local scripts=(index.php ./pages/about.php /pages/copy.php)
+    local modes=(source)
+
+    if ! command -v clang > /dev/null ||
+       { [[ -z "$PHP2WASM_PACKER" ]] && ! command -v php2wasm-pack > /dev/null; }; then
+        print_warning "packed_app - Skipped, packing needs clang and php2wasm-pack"
+        return
+    fi
+    if [[ -n "$PHP2WASM_HOST" ]]; then
+        modes+=(bytecode aot)
+    fi
+    if command -v wizer > /dev/null; then
+        modes+=(snapshot)
+    fi
+
+    for mode in "${modes[@]}"; do
+        local module="$OUTPUT_DIR/packed_app_${mode}.wasm"
+        local output_file="$OUTPUT_DIR/packed_app_${mode}.out"
+        local pack_args=()
+        if [[ "$mode" == snapshot ]]; then
+            pack_args+=(--preload index.php)
+        elif [[ "$mode" != source ]]; then
+            pack_args+=(--"$mode")
+        fi
+
+        TOTAL_TESTS=$((TOTAL_TESTS + 1))
+
+        print_info "Running test: packed_app ($mode)"
+
+        if ! "$TEST_DIR/../tools/php2wasm" "${pack_args[@]}" "$app_dir" -o "$module" > "$output_file" 2>&1; then
+            print_error "packed_app ($mode) - Packing failed"
+            cat "$output_file"
+            TESTS_FAILED=$((TESTS_FAILED + 1))
+            continue
+        fi
+
+        module="$(cd "$(dirname "$module")" && pwd)/$(basename "$module")"
+        rm -rf "$run_dir"
+        mkdir -p "$run_dir"
+        if (cd "$run_dir" && for script in "${scripts[@]}"; do
+                wasmtime run --dir=. "$module" -- "$script" || exit 1
+            done) > "$output_file" 2>&1 &&
+           diff -q "$output_file" "$expected_file" > /dev/null; then
+            print_success "packed_app ($mode) - Packed scripts ran from the module"
+            TESTS_PASSED=$((TESTS_PASSED + 1))
+        else
+            print_error "packed_app ($mode) - Output does not match expected"
+            print_info "Expected:"
+            cat "$expected_file"
+            print_info "Actual:"
+            cat "$output_file"
+            TESTS_FAILED=$((TESTS_FAILED + 1))
+        fi
+    done
+}
+
 # Generate test report
 generate_report() {
     echo "=========================================="
@@ -142,6 +277,9 @@ generate_report() {
 main() {
     check_wasm_binary
     run_all_tests
+    run_opcache_corruption_test
+    run_opcache_stale_temp_test
+    run_packed_module_test
     generate_report
 }
 
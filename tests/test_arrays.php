@@ -0,0 +1,60 @@
+<?php
+/**
+ * Array Tests
+ * Arrays are values: copies share storage until one side is written
+ */
+
+$a = [1, 2, 3];
+$b = $a;
+$b[] = 4;
+echo "a: ", count($a), " b: ", count($b), "\n";
+
+// Nested arrays separate at every level written through
+$config = ["db" => ["host" => "localhost", "port" => 3306]];
+$copy = $config;
+$copy["db"]["port"] = 5432;
+echo $config["db"]["port"], " ", $copy["db"]["port"], "\n";
+
+// Arguments are copies too
+function append($list, $item) {
+    $list[] = $item;
+    return $list;
+}
+$base = ["x"];
+$more = append($base, "y");
+echo count($base), " ", count($more), "\n";
+
+// Iterating a copy while writing the original
+$items = [1, 2, 3];
+foreach ($items as $item) {
+    $items[] = $item * 10;
+}
+echo "items: ", count($items), "\n";
+
+// Unset on one copy only
+$first = ["k" => 1, "l" => 2];
+$second = $first;
+unset($second["k"]);
+var_dump(array_key_exists("k", $first), array_key_exists("k", $second));
+
+// Copies kept in another array
+$rows = [];
+$row = [0];
+for ($i = 1; $i <= 3; $i++) {
+    $row[0] = $i;
+    $rows[] = $row;
+}
+foreach ($rows as $r) {
+    echo $r[0];
+}
+echo "\n";
+
+var_dump(array_values(array_merge($a, $b)));
+
+// Appending after negative keys continues from the largest one (PHP 8.3)
+$negative = [-5 => 'a'];
+$negative[] = 'b';
+$mixed = [3 => 'a'];
+$mixed[-1] = 'b';
+$mixed[] = 'c';
+var_dump($negative, $mixed);
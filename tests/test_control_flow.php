@@ -0,0 +1,119 @@
+<?php
+/**
+ * Control Flow Tests
+ * Branches, loops and user functions in the VM
+ */
+
+// if / elseif / else, both syntaxes
+function classify($n) {
+    if ($n < 0) {
+        return "negative";
+    } elseif ($n == 0) {
+        return "zero";
+    } else if ($n < 10) {
+        return "small";
+    } else {
+        return "large";
+    }
+}
+
+foreach ([-5, 0, 7, 42] as $n) {
+    echo $n, " is ", classify($n), "\n";
+}
+
+$x = 3;
+if ($x == 1):
+    echo "one\n";
+elseif ($x == 3):
+    echo "three\n";
+else:
+    echo "other\n";
+endif;
+
+// Loops, break and continue
+$sum = 0;
+for ($i = 0; $i < 10; $i++) {
+    if ($i % 2) continue;
+    if ($i > 6) break;
+    $sum += $i;
+}
+echo "for sum: ", $sum, "\n";
+
+$n = 5;
+$fact = 1;
+while ($n > 1) {
+    $fact *= $n;
+    $n--;
+}
+echo "while factorial: ", $fact, "\n";
+
+$i = 0;
+do {
+    $i++;
+} while ($i < 3);
+echo "do-while count: ", $i, "\n";
+
+foreach (["a" => 1, "b" => 2] as $key => $value) {
+    echo $key, "=", $value, "\n";
+}
+
+// Ternary and null coalescing
+$name = null;
+echo $name ?? "anonymous", "\n";
+echo $x > 2 ? "big" : "small", "\n";
+
+// Recursion and defaults
+function fib($n) {
+    return $n < 2 ? $n : fib($n - 1) + fib($n - 2);
+}
+echo "fib(15) = ", fib(15), "\n";
+
+function greet($who, $greeting = "Hello") {
+    return $greeting . ", " . $who . "!";
+}
+echo greet("World"), "\n";
+echo greet("PHP", "Hi"), "\n";
+
+// Calls ahead of the declaration
+echo later(2), "\n";
+function later($n) {
+    return $n * 21;
+}
+
+// Functions declared when their declaration runs
+if ($x == 3) {
+    function chosen() { return "first"; }
+} else {
+    function chosen() { return "second"; }
+}
+echo chosen(), "\n";
+
+// By-reference and variadic parameters
+function increment(&$value) {
+    $value++;
+}
+$counter = 1;
+increment($counter);
+increment($counter);
+echo "counter: ", $counter, "\n";
+
+function total(...$numbers) {
+    $sum = 0;
+    foreach ($numbers as $number) {
+        $sum += $number;
+    }
+    return $sum;
+}
+echo "total: ", total(1, 2, 3, 4), "\n";
+echo "empty total: ", total(), "\n";
+
+// Globals
+$hits = 0;
+function hit() {
+    global $hits, $created;
+    $hits++;
+    var_dump($created);
+}
+hit();
+hit();
+echo "hits: ", $hits, "\n";
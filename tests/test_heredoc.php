@@ -0,0 +1,39 @@
+<?php
+/**
+ * Heredoc and Nowdoc Tests
+ */
+
+$name = "World";
+$items = ["apple" => 3];
+$count = 2;
+
+echo <<<EOT
+Hello, $name!
+You have {$items['apple']} apples and $count pears.
+Escapes: \t tab, \\ backslash, \$name literal
+EOT;
+echo "\n";
+
+echo <<<'EOT'
+Nowdoc keeps $name and \t as written
+EOT;
+echo "\n";
+
+// Closing marker indentation is removed from every line
+function indented($who) {
+    return <<<TEXT
+        Dear $who,
+          indented line
+        Regards
+        TEXT;
+}
+echo indented("reader"), "\n";
+
+$empty = <<<EOT
+EOT;
+var_dump($empty);
+
+$quoted = <<<"EOT"
+Quoted label for $name
+EOT;
+echo $quoted, "\n";
@@ -0,0 +1,28 @@
+<?php
+/**
+ * Number Formatting Tests
+ * How ints and floats are printed by echo and var_dump
+ */
+
+echo 42, " ", -7, " ", 0, "\n";
+echo 9223372036854775807, "\n";
+echo 1.5, " ", -0.25, " ", 2.0, "\n";
+echo 0.1 + 0.2, "\n";
+echo 1 / 3, "\n";
+echo 1e20, " ", 1.5e-7, " ", 1e15, "\n";
+echo 10 / 4, " ", 10 / 5, "\n";
+echo 7 % 3, " ", 2 ** 10, " ", 2 ** -1, "\n";
+echo 9223372036854775807 + 1, "\n";
+
+var_dump(42);
+var_dump(-0.0);
+var_dump(0.1 + 0.2);
+var_dump(1 / 3);
+var_dump(2.0);
+var_dump(1e100);
+var_dump(10 / 5);
+var_dump("12" + 3);
+var_dump("1.5" + 1);
+
+echo "Value: " . 3.0 . "\n";
+echo "Concat: " . 1e6 . " " . 123456789012345678 . "\n";
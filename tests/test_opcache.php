@@ -0,0 +1,25 @@
+<?php
+/**
+ * Opcache Tests
+ * Run twice against one file cache by run_tests.sh, the second time
+ * after the cached entry has been corrupted; both runs must print this.
+ */
+
+function square($n) {
+    return $n * $n;
+}
+
+$values = [];
+for ($i = 1; $i <= 5; $i++) {
+    $values[] = square($i);
+}
+foreach ($values as $value) {
+    echo $value, " ";
+}
+echo "\n";
+
+$text = <<<EOT
+cached {$values[4]}
+EOT;
+echo $text, "\n";
+var_dump(1.5 * 2, "done");
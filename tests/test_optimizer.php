@@ -0,0 +1,55 @@
+<?php
+/**
+ * Optimizer Tests
+ * Constant folding and dead code removal must not change results
+ */
+
+echo 2 + 3 * 4, "\n";
+echo (2 + 3) * 4, "\n";
+echo "a" . "b" . 1 . 2.5, "\n";
+echo 10 - 2 - 3, "\n";
+echo 2 ** 3 ** 2, "\n";
+echo 7 / 2, " ", intdiv_free(7, 2), "\n";
+echo -(3 - 5), " ", !0, " ", ~5, "\n";
+echo 1 << 4, " ", 255 >> 2, " ", 6 & 3, " ", 6 | 3, " ", 6 ^ 3, "\n";
+var_dump(1 == 1.0, "1" === 1, null ?? "default", true && false, 0 || "x");
+var_dump("10" + 5, "abc" == 0, 1 <=> 2);
+
+function intdiv_free($a, $b) {
+    return ($a - $a % $b) / $b;
+}
+
+// Branches decided at compile time
+if (false) {
+    echo "never\n";
+} elseif (true) {
+    echo "folded branch\n";
+}
+while (false) {
+    echo "never\n";
+}
+if (0) {
+    function never_declared() {}
+}
+
+// Loop-invariant values and copies
+$total = 0;
+$step = 3;
+for ($i = 0; $i < 5; $i++) {
+    $limit = $step * 2;
+    $total += $limit + $i;
+}
+echo "total: ", $total, "\n";
+
+$s = "";
+for ($i = 0; $i < 3; $i++) {
+    $s .= $i;
+    $s .= "-";
+}
+echo $s, "\n";
+
+// A value overwritten before it is read
+$v = 1;
+$v = $v + 1;
+$v = $v * 10;
+echo $v, "\n";
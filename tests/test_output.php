@@ -0,0 +1,53 @@
+<?php
+/**
+ * Output Buffering Tests
+ */
+
+echo "level: ", ob_get_level(), "\n";
+
+ob_start();
+echo "inner";
+$captured = ob_get_clean();
+echo "captured: ", $captured, "\n";
+
+// Nested buffers
+ob_start();
+echo "outer ";
+ob_start();
+echo "inner";
+echo " (level ", ob_get_level(), ")";
+$inner = ob_get_contents();
+ob_end_clean();
+echo "saw [", $inner, "]";
+$outer = ob_get_clean();
+echo $outer, "\n";
+
+// Flushing passes a buffer's contents to the one below
+ob_start();
+ob_start();
+echo "flushed ";
+ob_flush();
+echo "discarded";
+ob_end_clean();
+echo "length ", ob_get_length();
+ob_end_flush();
+echo "\n";
+
+ob_start();
+echo "kept";
+$kept = ob_get_flush();
+echo " / ", $kept, "\n";
+
+ob_start();
+echo "gone";
+ob_clean();
+echo "after clean";
+ob_end_flush();
+echo "\n";
+
+var_dump(ob_get_level());
+
+// Buffers left open are flushed at the end of the script
+ob_start();
+ob_start();
+echo "still open\n";
@@ -0,0 +1,181 @@
+/**
+ * Keyword Table Generator
+ * Writes src/php/php_keywords.h: a perfect hash from identifiers to keywords
+ *
+ *   cc -o gen_keywords tools/gen_keywords.c && ./gen_keywords src/php/php_keywords.h
+ *
+ * The native CMake build runs it and fails when the checked-in header
+ * differs from its output.
+ */
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Lowercase, in any order; the enum follows this order
+static const char* const keywords[] = {
+    "abstract", "and", "array", "bool", "break", "case", "catch", "class", "clone", "const",
+    "continue", "default", "echo", "else", "elseif", "empty", "false", "final", "finally",
+    "float", "for", "foreach", "function", "global", "if", "include", "include_once", "instanceof",
+    "int", "interface", "isset", "mixed", "namespace", "new", "not", "null", "object", "or",
+    "parent", "print", "private", "protected", "public", "require", "require_once", "return",
+    "self", "static", "string", "switch", "this", "throw", "trait", "true", "try", "unset",
+    "use", "var", "void", "while", "xor"
+};
+
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+#define SLOT_COUNT 128      // Power of two, about twice KEYWORD_COUNT
+#define BUCKET_COUNT 32     // Power of two
+#define MAX_DISPLACEMENT 256
+
+// Must match php_keyword_hash in the generated header
+static uint32_t keyword_hash(const char* str, size_t length) {
+    uint32_t h = (uint32_t)length * 0x9E3779B1u;
+    h ^= (uint32_t)(unsigned char)tolower((unsigned char)str[0]) * 0x85EBCA77u;
+    h ^= (uint32_t)(unsigned char)tolower((unsigned char)str[1]) * 0xC2B2AE3Du;
+    h ^= (uint32_t)(unsigned char)tolower((unsigned char)str[length - 1]) * 0x27D4EB2Fu;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+static uint32_t slot_of(uint32_t h, uint32_t displacement) {
+    return ((h >> 8) + displacement * ((h >> 20) | 1)) & (SLOT_COUNT - 1);
+}
+
+int main(int argc, char** argv) {
+    uint32_t hashes[KEYWORD_COUNT];
+    size_t bucket_sizes[BUCKET_COUNT] = {0};
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        if (strlen(keywords[i]) < 2) {
+            fprintf(stderr, "keyword '%s' is shorter than two bytes\n", keywords[i]);
+            return 1;
+        }
+        hashes[i] = keyword_hash(keywords[i], strlen(keywords[i]));
+        bucket_sizes[hashes[i] & (BUCKET_COUNT - 1)]++;
+    }
+
+    // Place the fullest buckets first, each with the first displacement
+    // that sends all of its keywords to free slots
+    int slots[SLOT_COUNT];
+    memset(slots, -1, sizeof(slots));
+    unsigned displacements[BUCKET_COUNT] = {0};
+    bool placed[BUCKET_COUNT] = {false};
+    for (size_t round = 0; round < BUCKET_COUNT; round++) {
+        size_t bucket = BUCKET_COUNT;
+        for (size_t b = 0; b < BUCKET_COUNT; b++) {
+            if (!placed[b] && (bucket == BUCKET_COUNT || bucket_sizes[b] > bucket_sizes[bucket])) {
+                bucket = b;
+            }
+        }
+        placed[bucket] = true;
+
+        unsigned d = 0;
+        for (; d < MAX_DISPLACEMENT; d++) {
+            int trial[SLOT_COUNT];
+            memcpy(trial, slots, sizeof(slots));
+            bool fits = true;
+            for (size_t i = 0; i < KEYWORD_COUNT && fits; i++) {
+                if ((hashes[i] & (BUCKET_COUNT - 1)) != bucket) continue;
+                uint32_t slot = slot_of(hashes[i], d);
+                if (trial[slot] >= 0) {
+                    fits = false;
+                } else {
+                    trial[slot] = (int)i;
+                }
+            }
+            if (fits) {
+                memcpy(slots, trial, sizeof(slots));
+                break;
+            }
+        }
+        if (d == MAX_DISPLACEMENT) {
+            fprintf(stderr, "no displacement for bucket %zu; change the hash constants\n", bucket);
+            return 1;
+        }
+        displacements[bucket] = d;
+    }
+
+    // To the file named, or to stdout
+    if (argc > 1 && !freopen(argv[1], "w", stdout)) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    printf("/**\n"
+           " * PHP Keywords\n"
+           " * Perfect hash from identifiers to keywords, case-insensitive.\n"
+           " * Generated by tools/gen_keywords.c, do not edit.\n"
+           " */\n\n"
+           "#ifndef PHP_KEYWORDS_H\n"
+           "#define PHP_KEYWORDS_H\n\n"
+           "#include <stddef.h>\n"
+           "#include <stdint.h>\n\n"
+           "typedef enum {\n"
+           "    PHP_KEYWORD_NONE = -1,\n");
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        printf("    PHP_KEYWORD_");
+        for (const char* c = keywords[i]; *c; c++) {
+            putchar(toupper((unsigned char)*c));
+        }
+        printf(",\n");
+    }
+    printf("    PHP_KEYWORD_COUNT\n"
+           "} php_keyword_t;\n\n");
+
+    printf("static const char* const php_keyword_names[PHP_KEYWORD_COUNT] = {\n");
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        printf("%s\"%s\",%s", i % 8 == 0 ? "    " : "", keywords[i],
+               i % 8 == 7 || i + 1 == KEYWORD_COUNT ? "\n" : " ");
+    }
+    printf("};\n\n");
+
+    printf("static const uint8_t php_keyword_displacements[%d] = {\n", BUCKET_COUNT);
+    for (size_t b = 0; b < BUCKET_COUNT; b++) {
+        printf("%s%u,%s", b % 16 == 0 ? "    " : "", displacements[b], b % 16 == 15 ? "\n" : " ");
+    }
+    printf("};\n\n");
+
+    // Keyword number plus one, 0 for empty slots
+    printf("static const uint8_t php_keyword_slots[%d] = {\n", SLOT_COUNT);
+    for (size_t s = 0; s < SLOT_COUNT; s++) {
+        printf("%s%d,%s", s % 16 == 0 ? "    " : "", slots[s] + 1, s % 16 == 15 ? "\n" : " ");
+    }
+    printf("};\n\n");
+
+    printf("static inline char php_keyword_fold(char c) {\n"
+           "    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;\n"
+           "}\n\n"
+           "// Hashes the length and the first, second and last bytes\n"
+           "static inline uint32_t php_keyword_hash(const char* str, size_t length) {\n"
+           "    uint32_t h = (uint32_t)length * 0x9E3779B1u;\n"
+           "    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[0]) * 0x85EBCA77u;\n"
+           "    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[1]) * 0xC2B2AE3Du;\n"
+           "    h ^= (uint32_t)(unsigned char)php_keyword_fold(str[length - 1]) * 0x27D4EB2Fu;\n"
+           "    h ^= h >> 15;\n"
+           "    h *= 0x2C1B3C6Du;\n"
+           "    h ^= h >> 12;\n"
+           "    return h;\n"
+           "}\n\n"
+           "// Keyword spelled by str in any case, or PHP_KEYWORD_NONE\n"
+           "static inline php_keyword_t php_keyword_lookup(const char* str, size_t length) {\n"
+           "    if (length < 2) return PHP_KEYWORD_NONE;\n"
+           "    uint32_t h = php_keyword_hash(str, length);\n"
+           "    uint32_t displacement = php_keyword_displacements[h & %d];\n"
+           "    uint32_t slot = ((h >> 8) + displacement * ((h >> 20) | 1)) & %d;\n"
+           "    int keyword = php_keyword_slots[slot] - 1;\n"
+           "    if (keyword < 0) return PHP_KEYWORD_NONE;\n\n"
+           "    const char* name = php_keyword_names[keyword];\n"
+           "    for (size_t i = 0; i < length; i++) {\n"
+           "        if (php_keyword_fold(str[i]) != name[i]) return PHP_KEYWORD_NONE;\n"
+           "    }\n"
+           "    return name[length] == '\\0' ? (php_keyword_t)keyword : PHP_KEYWORD_NONE;\n"
+           "}\n\n"
+           "#endif // PHP_KEYWORDS_H\n",
+           BUCKET_COUNT - 1, SLOT_COUNT - 1);
+    return fclose(stdout) == 0 ? 0 : 1;
+}
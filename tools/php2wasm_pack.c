@@ -0,0 +1,941 @@
+/**
+ * php2wasm Packer
+ * Packs an application directory into a file system image for wasi_vfs.c.
+ * Files are read, hashed and compressed on a thread pool, identical ones
+ * are stored once, and those unchanged since the previous pack are reused
+ * as stored.
+ *
+ *   php2wasm-pack [-j threads] [-i pattern]... [-x pattern]... [-v] -o app.vfs ./app
+ *
+ * Writes the image to app.vfs, app.vfs.c to link it into the module as the
+ * wasi_vfs_image symbols, and app.vfs.manifest for the next pack.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "wasi_shim.h"
+#include "wasi_vfs_format.h"
+#include <dirent.h>
+#include <fnmatch.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PACK_MANIFEST_VERSION 1
+#define PACK_NONE UINT32_MAX
+#define PACK_MAX_THREADS 256
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} pack_buffer_t;
+
+typedef struct {
+    char* path;             // Relative to the root
+    size_t name;            // Offset of the last component in path
+    uint32_t type;          // WASI_FILETYPE_DIRECTORY or WASI_FILETYPE_REGULAR_FILE
+    uint32_t first;         // First child of a directory, file of a file
+    uint32_t count;         // Children of a directory
+} pack_node_t;
+
+typedef struct {
+    const char* path;       // Of its node
+    uint64_t size;
+    int64_t mtime;          // Nanoseconds
+    uint64_t hash[2];
+    uint8_t* bytes;         // Read from disk, until compressed
+    uint32_t previous;      // Content of the previous image it is unchanged from
+    uint32_t content;
+    bool failed;
+} pack_file_t;
+
+typedef struct {
+    uint32_t file;          // First file with these contents
+    uint32_t previous;      // Content of the previous image stored as is
+    pack_buffer_t blocks;   // vfs_block_t, with offsets in stored
+    pack_buffer_t stored;
+} pack_content_t;
+
+// A file of the previous pack, from its manifest
+typedef struct {
+    char* path;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash[2];
+    uint32_t content;
+} pack_entry_t;
+
+static const char* root = NULL;
+static const char** includes = NULL;
+static size_t include_count = 0;
+static const char** excludes = NULL;
+static size_t exclude_count = 0;
+static int thread_count = 1;
+static bool verbose = false;
+
+static pack_node_t* nodes = NULL;
+static size_t node_count = 0;
+static size_t node_capacity = 0;
+static pack_file_t* files = NULL;
+static size_t file_count = 0;
+static size_t file_capacity = 0;
+static pack_content_t* contents = NULL;
+static size_t content_count = 0;
+
+static uint8_t* previous_image = NULL;
+static const vfs_content_t* previous_contents = NULL;
+static const vfs_block_t* previous_blocks = NULL;
+static const uint8_t* previous_data = NULL;
+static uint32_t previous_content_count = 0;
+static pack_entry_t* entries = NULL;
+static size_t entry_count = 0;
+static size_t entry_capacity = 0;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Room for one more element in an array, doubling it when full
+static bool grow(void** array, size_t* capacity, size_t count, size_t size) {
+    if (count < *capacity) return true;
+    size_t grown_capacity = *capacity ? *capacity * 2 : 64;
+    void* grown = realloc(*array, grown_capacity * size);
+    if (!grown) return false;
+    *array = grown;
+    *capacity = grown_capacity;
+    return true;
+}
+
+static void buffer_write(pack_buffer_t* buffer, const void* data, size_t length) {
+    if (buffer->failed) return;
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->length + length) capacity *= 2;
+        uint8_t* grown = realloc(buffer->data, capacity);
+        if (!grown) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    if (length) memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void buffer_align(pack_buffer_t* buffer) {
+    static const uint8_t padding[8] = {0};
+    buffer_write(buffer, padding, (size_t)(vfs_align(buffer->length) - buffer->length));
+}
+
+static char* join_path(const char* a, const char* b) {
+    size_t length = strlen(a) + strlen(b) + 2;
+    char* path = malloc(length);
+    if (path) snprintf(path, length, "%s%s%s", a, *a && *b ? "/" : "", b);
+    return path;
+}
+
+static bool read_file(const char* path, uint8_t** bytes, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+    }
+    *bytes = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    bool ok = *bytes && fread(*bytes, 1, (size_t)length, file) == (size_t)length;
+    fclose(file);
+    if (!ok) {
+        free(*bytes);
+        *bytes = NULL;
+        return false;
+    }
+    *size = (size_t)length;
+    return true;
+}
+
+// Two independent 64-bit hashes, which identical contents are told by
+static void hash_contents(const uint8_t* bytes, size_t size, uint64_t hash[2]) {
+    uint64_t a = 14695981039346656037ULL;
+    uint64_t b = 0x6A09E667F3BCC909ULL ^ size;
+    for (size_t i = 0; i < size; i++) {
+        a = (a ^ bytes[i]) * 1099511628211ULL;
+        b = (b + bytes[i] + 1) * 0x9E3779B97F4A7C15ULL;
+        b ^= b >> 31;
+    }
+    hash[0] = a;
+    hash[1] = b;
+}
+
+static uint64_t hash_image(const uint8_t* bytes, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------------------
+// Thread pool
+// ---------------------------------------------------------------------------
+
+typedef void (*pack_job_t)(size_t index);
+
+static pack_job_t job_function = NULL;
+static size_t job_count = 0;
+static atomic_size_t job_next;
+
+static void* job_worker(void* arg) {
+    (void)arg;
+    for (size_t i; (i = atomic_fetch_add(&job_next, 1)) < job_count;) {
+        job_function(i);
+    }
+    return NULL;
+}
+
+// Run job for indexes 0 to count - 1, on every thread
+static void run_parallel(pack_job_t job, size_t count) {
+    job_function = job;
+    job_count = count;
+    atomic_store(&job_next, 0);
+
+    pthread_t workers[PACK_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; i < thread_count && (size_t)i < count; i++) {
+        if (pthread_create(&workers[started], NULL, job_worker, NULL) == 0) {
+            started++;
+        }
+    }
+    job_worker(NULL);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// LZ4 block format, see wasi_vfs_format.h
+// ---------------------------------------------------------------------------
+
+static bool lz4_put(uint8_t* out, size_t capacity, size_t* pos, uint8_t byte) {
+    if (*pos >= capacity) return false;
+    out[(*pos)++] = byte;
+    return true;
+}
+
+static bool lz4_put_length(uint8_t* out, size_t capacity, size_t* pos, size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (!lz4_put(out, capacity, pos, 255)) return false;
+    }
+    return lz4_put(out, capacity, pos, (uint8_t)length);
+}
+
+// A sequence of literals followed by a match, or by nothing when match is 0
+static bool lz4_sequence(uint8_t* out, size_t capacity, size_t* pos, const uint8_t* literals,
+                         size_t literal_length, size_t offset, size_t match) {
+    size_t match_code = match ? match - 4 : 0;
+    uint8_t token = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4 | (match_code < 15 ? match_code : 15));
+    if (!lz4_put(out, capacity, pos, token)) return false;
+    if (literal_length >= 15 && !lz4_put_length(out, capacity, pos, literal_length - 15)) return false;
+    if (capacity - *pos < literal_length) return false;
+    memcpy(out + *pos, literals, literal_length);
+    *pos += literal_length;
+    if (!match) return true;
+
+    if (!lz4_put(out, capacity, pos, (uint8_t)offset) || !lz4_put(out, capacity, pos, (uint8_t)(offset >> 8))) {
+        return false;
+    }
+    return match_code < 15 || lz4_put_length(out, capacity, pos, match_code - 15);
+}
+
+// Greedy matching over a hash of 4-byte sequences. Returns the compressed
+// length, or 0 when it does not fit in capacity.
+static size_t lz4_compress(const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+    enum { HASH_BITS = 12 };
+    uint32_t table[1 << HASH_BITS];     // Position + 1 of the last sequence seen
+    memset(table, 0, sizeof(table));
+
+    size_t pos = 0;
+    size_t anchor = 0;
+    size_t written = 0;
+    size_t match_start_limit = length > 12 ? length - 12 : 0;
+    size_t match_end_limit = length > 5 ? length - 5 : 0;
+
+    while (pos < match_start_limit) {
+        uint32_t sequence;
+        memcpy(&sequence, in + pos, 4);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)(pos + 1);
+
+        if (candidate && pos - (candidate - 1) <= 65535 && memcmp(in + candidate - 1, in + pos, 4) == 0) {
+            size_t ref = candidate - 1;
+            size_t match = 4;
+            while (pos + match < match_end_limit && in[ref + match] == in[pos + match]) {
+                match++;
+            }
+            if (!lz4_sequence(out, capacity, &written, in + anchor, pos - anchor, pos - ref, match)) {
+                return 0;
+            }
+            pos += match;
+            anchor = pos;
+        } else {
+            pos++;
+        }
+    }
+
+    if (!lz4_sequence(out, capacity, &written, in + anchor, length - anchor, 0, 0)) {
+        return 0;
+    }
+    return written;
+}
+
+// ---------------------------------------------------------------------------
+// Previous pack
+// ---------------------------------------------------------------------------
+
+static int compare_entries(const void* a, const void* b) {
+    return strcmp(((const pack_entry_t*)a)->path, ((const pack_entry_t*)b)->path);
+}
+
+// The image written last time and its manifest, when they match; packing
+// starts from scratch otherwise
+static void load_previous(const char* output) {
+    size_t size = 0;
+    if (!read_file(output, &previous_image, &size)) return;
+
+    char* manifest_path = malloc(strlen(output) + 10);
+    FILE* manifest = NULL;
+    if (manifest_path) {
+        sprintf(manifest_path, "%s.manifest", output);
+        manifest = fopen(manifest_path, "r");
+        free(manifest_path);
+    }
+
+    unsigned manifest_version = 0;
+    unsigned format_version = 0;
+    unsigned long long image_size = 0;
+    uint64_t image_hash = 0;
+    const vfs_header_t* header = (const vfs_header_t*)previous_image;
+    bool valid = manifest &&
+                 fscanf(manifest, "php2wasm-pack %u %u %llu %" SCNx64 "\n", &manifest_version, &format_version,
+                        &image_size, &image_hash) == 4 &&
+                 manifest_version == PACK_MANIFEST_VERSION && format_version == VFS_FORMAT_VERSION &&
+                 image_size == size && size >= sizeof(vfs_header_t) && hash_image(previous_image, size) == image_hash &&
+                 memcmp(header->magic, VFS_MAGIC, 4) == 0 && header->version == VFS_FORMAT_VERSION;
+
+    if (valid) {
+        uint64_t offset = vfs_align(sizeof(vfs_header_t));
+        offset = vfs_align(offset + (uint64_t)header->bucket_count * sizeof(uint32_t));
+        offset = vfs_align(offset + (uint64_t)header->slot_count * sizeof(uint32_t));
+        offset = vfs_align(offset + (uint64_t)header->node_count * sizeof(vfs_node_t));
+        uint64_t contents_offset = offset;
+        offset = vfs_align(offset + (uint64_t)header->content_count * sizeof(vfs_content_t));
+        uint64_t blocks_offset = offset;
+        offset = vfs_align(offset + (uint64_t)header->block_count * sizeof(vfs_block_t));
+        offset = vfs_align(offset + header->strings_size);
+        valid = offset + header->data_size == size;
+
+        previous_contents = (const vfs_content_t*)(previous_image + contents_offset);
+        previous_blocks = (const vfs_block_t*)(previous_image + blocks_offset);
+        previous_data = previous_image + offset;
+        previous_content_count = header->content_count;
+    }
+
+    // The image was checked when written and is unchanged since, going by
+    // its hash; entries are checked against it as they are used
+    char line[VFS_PATH_MAX + 128];
+    while (valid && fgets(line, sizeof(line), manifest)) {
+        pack_entry_t entry = {0};
+        int path_start = 0;
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "%" SCNd64 " %" SCNu64 " %" SCNx64 " %" SCNx64 " %" SCNu32 " %n", &entry.mtime, &entry.size,
+                   &entry.hash[0], &entry.hash[1], &entry.content, &path_start) < 5 ||
+            !path_start || entry.content >= previous_content_count) {
+            continue;
+        }
+        entry.path = strdup(line + path_start);
+        if (!entry.path || !grow((void**)&entries, &entry_capacity, entry_count, sizeof(pack_entry_t))) {
+            free(entry.path);
+            valid = false;
+            break;
+        }
+        entries[entry_count++] = entry;
+    }
+    if (manifest) fclose(manifest);
+
+    if (!valid) {
+        for (size_t i = 0; i < entry_count; i++) free(entries[i].path);
+        free(entries);
+        free(previous_image);
+        entries = NULL;
+        entry_count = 0;
+        previous_image = NULL;
+        previous_content_count = 0;
+        return;
+    }
+    qsort(entries, entry_count, sizeof(pack_entry_t), compare_entries);
+}
+
+// The content of the previous image a file is unchanged from
+static uint32_t find_previous(pack_file_t* file) {
+    pack_entry_t key = {(char*)file->path, 0, 0, {0, 0}, 0};
+    const pack_entry_t* entry =
+        entry_count ? bsearch(&key, entries, entry_count, sizeof(pack_entry_t), compare_entries) : NULL;
+    if (!entry || entry->size != file->size || entry->mtime != file->mtime ||
+        previous_contents[entry->content].size != file->size) {
+        return PACK_NONE;
+    }
+    file->hash[0] = entry->hash[0];
+    file->hash[1] = entry->hash[1];
+    return entry->content;
+}
+
+// ---------------------------------------------------------------------------
+// Walking
+// ---------------------------------------------------------------------------
+
+// By the name or the relative path, where "*" spans directories
+static bool matches(const char** patterns, size_t count, const char* name, const char* path) {
+    for (size_t i = 0; i < count; i++) {
+        if (fnmatch(patterns[i], name, 0) == 0 || fnmatch(patterns[i], path, 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static bool add_node(char* path, size_t name, uint32_t type) {
+    if (!grow((void**)&nodes, &node_capacity, node_count, sizeof(pack_node_t))) return false;
+    nodes[node_count++] = (pack_node_t){path, name, type, 0, 0};
+    return true;
+}
+
+static bool add_file(size_t node, const struct stat* st) {
+    if (!grow((void**)&files, &file_capacity, file_count, sizeof(pack_file_t))) return false;
+#ifdef __APPLE__
+    int64_t mtime = (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    int64_t mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+    files[file_count] = (pack_file_t){nodes[node].path, (uint64_t)st->st_size, mtime, {0, 0}, NULL, PACK_NONE, 0, false};
+    nodes[node].first = (uint32_t)file_count++;
+    return true;
+}
+
+// Append the entries of a directory node, sorted by name
+static bool add_children(size_t index) {
+    char* dir_path = join_path(root, nodes[index].path);
+    DIR* dir = dir_path ? opendir(dir_path) : NULL;
+    if (!dir) {
+        fprintf(stderr, "php2wasm-pack: cannot open directory %s\n", dir_path ? dir_path : root);
+        free(dir_path);
+        return false;
+    }
+
+    char** names = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool ok = true;
+    for (struct dirent* entry; ok && (entry = readdir(dir));) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        ok = grow((void**)&names, &capacity, count, sizeof(char*)) && (names[count] = strdup(entry->d_name));
+        if (ok) count++;
+    }
+    closedir(dir);
+    if (names) qsort(names, count, sizeof(char*), compare_names);
+
+    nodes[index].first = (uint32_t)node_count;
+    for (size_t i = 0; i < count && ok; i++) {
+        char* path = join_path(nodes[index].path, names[i]);
+        char* full_path = path ? join_path(root, path) : NULL;
+        struct stat st;
+        ok = full_path != NULL;
+        if (ok && !matches(excludes, exclude_count, names[i], path)) {
+            ok = strlen(path) < VFS_PATH_MAX && !strchr(path, '\n') && stat(full_path, &st) == 0;
+            if (!ok) {
+                fprintf(stderr, "php2wasm-pack: cannot pack %s\n", full_path);
+            } else if (S_ISDIR(st.st_mode) ||
+                       (S_ISREG(st.st_mode) && (!include_count || matches(includes, include_count, names[i], path)))) {
+                uint32_t type = S_ISDIR(st.st_mode) ? WASI_FILETYPE_DIRECTORY : WASI_FILETYPE_REGULAR_FILE;
+                ok = add_node(path, strlen(path) - strlen(names[i]), type) &&
+                     (type == WASI_FILETYPE_DIRECTORY || add_file(node_count - 1, &st));
+                path = NULL;
+                nodes[index].count += ok;
+            }
+        }
+        free(path);
+        free(full_path);
+    }
+
+    for (size_t i = 0; i < count; i++) free(names[i]);
+    free(names);
+    free(dir_path);
+    return ok;
+}
+
+// Breadth first, so the children of each directory are adjacent
+static bool walk(void) {
+    char* root_path = strdup("");
+    if (!root_path || !add_node(root_path, 0, WASI_FILETYPE_DIRECTORY)) {
+        free(root_path);
+        return false;
+    }
+    for (size_t i = 0; i < node_count; i++) {
+        if (nodes[i].type == WASI_FILETYPE_DIRECTORY && !add_children(i)) {
+            return false;
+        }
+    }
+    return node_count < VFS_NO_NODE;
+}
+
+// ---------------------------------------------------------------------------
+// Contents
+// ---------------------------------------------------------------------------
+
+static void read_job(size_t index) {
+    pack_file_t* file = &files[index];
+    if (file->previous != PACK_NONE) return;
+
+    char* path = join_path(root, file->path);
+    size_t size = 0;
+    file->failed = !path || !read_file(path, &file->bytes, &size);
+    if (!file->failed) {
+        file->size = size;
+        hash_contents(file->bytes, size, file->hash);
+    }
+    free(path);
+}
+
+// Files reused from the previous image are no longer read, and go by their
+// hashes alone
+static bool same_contents(const pack_file_t* a, const pack_file_t* b) {
+    if (a->size != b->size || a->hash[0] != b->hash[0] || a->hash[1] != b->hash[1]) return false;
+    return !a->bytes || !b->bytes || memcmp(a->bytes, b->bytes, a->size) == 0;
+}
+
+// One content per distinct file, in the order first seen
+static bool deduplicate(void) {
+    size_t capacity = 16;
+    while (capacity < file_count * 2) capacity *= 2;
+    uint32_t* table = malloc(capacity * sizeof(uint32_t));
+    contents = calloc(file_count ? file_count : 1, sizeof(pack_content_t));
+    if (!table || !contents) {
+        free(table);
+        return false;
+    }
+    memset(table, 0xFF, capacity * sizeof(uint32_t));
+
+    for (size_t i = 0; i < file_count; i++) {
+        pack_file_t* file = &files[i];
+        size_t slot = (size_t)(file->hash[0] ^ file->size) & (capacity - 1);
+        for (; table[slot] != PACK_NONE; slot = (slot + 1) & (capacity - 1)) {
+            if (same_contents(&files[contents[table[slot]].file], file)) break;
+        }
+
+        if (table[slot] != PACK_NONE) {
+            file->content = table[slot];
+            free(file->bytes);
+            file->bytes = NULL;
+        } else {
+            table[slot] = (uint32_t)content_count;
+            file->content = (uint32_t)content_count;
+            contents[content_count++] = (pack_content_t){(uint32_t)i, file->previous, {0}, {0}};
+        }
+    }
+    free(table);
+    return true;
+}
+
+static void compress_job(size_t index) {
+    pack_content_t* content = &contents[index];
+    pack_file_t* file = &files[content->file];
+    if (content->previous != PACK_NONE) return;
+
+    uint8_t* compressed = malloc(VFS_BLOCK_SIZE);
+    if (!compressed) {
+        file->failed = true;
+        return;
+    }
+    for (size_t offset = 0; offset < file->size; offset += VFS_BLOCK_SIZE) {
+        size_t length = file->size - offset < VFS_BLOCK_SIZE ? (size_t)(file->size - offset) : VFS_BLOCK_SIZE;
+        size_t stored = lz4_compress(file->bytes + offset, length, compressed, length - 1);
+        vfs_block_t block = {(uint32_t)content->stored.length,
+                             stored ? (uint32_t)stored : (uint32_t)length | VFS_RAW_BLOCK};
+        buffer_write(&content->stored, stored ? compressed : file->bytes + offset, stored ? stored : length);
+        buffer_write(&content->blocks, &block, sizeof(block));
+    }
+    file->failed = content->stored.failed || content->blocks.failed;
+    free(compressed);
+    free(file->bytes);
+    file->bytes = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Index
+// ---------------------------------------------------------------------------
+
+// Hash and displace: place the largest buckets first, each with the first
+// seed sending all its paths to free slots
+static bool build_index(uint32_t* bucket_count, uint32_t** buckets, uint32_t* slot_count, uint32_t** slots) {
+    size_t n = node_count;
+    *bucket_count = (uint32_t)(n / 4 + 1);
+    *slot_count = (uint32_t)(n + n / 8 + 1);
+
+    uint32_t* bucket_of = malloc(n * sizeof(uint32_t));
+    uint32_t* bucket_size = calloc(*bucket_count, sizeof(uint32_t));
+    uint32_t* start = calloc(*bucket_count + 1, sizeof(uint32_t));
+    uint32_t* members = malloc(n * sizeof(uint32_t));
+    uint32_t* order = malloc(*bucket_count * sizeof(uint32_t));
+    uint32_t* placed = malloc(n * sizeof(uint32_t));
+    *buckets = calloc(*bucket_count, sizeof(uint32_t));
+    *slots = NULL;
+    bool ok = bucket_of && bucket_size && start && members && order && placed && *buckets;
+
+    uint32_t largest = 0;
+    for (size_t i = 0; ok && i < n; i++) {
+        bucket_of[i] = vfs_hash(nodes[i].path, strlen(nodes[i].path), 0) % *bucket_count;
+        if (++bucket_size[bucket_of[i]] > largest) largest = bucket_size[bucket_of[i]];
+    }
+    for (uint32_t b = 0; ok && b < *bucket_count; b++) {
+        start[b + 1] = start[b] + bucket_size[b];
+    }
+    for (size_t i = 0; ok && i < n; i++) {
+        members[start[bucket_of[i]]++] = (uint32_t)i;
+    }
+    for (uint32_t b = *bucket_count; ok && b > 0; b--) {
+        start[b] = start[b - 1];
+    }
+    if (ok) start[0] = 0;
+
+    // Largest first, by a pass per size
+    uint32_t ordered = 0;
+    for (uint32_t size = largest; ok && size > 0; size--) {
+        for (uint32_t b = 0; b < *bucket_count; b++) {
+            if (bucket_size[b] == size) order[ordered++] = b;
+        }
+    }
+
+    while (ok) {
+        free(*slots);
+        *slots = malloc(*slot_count * sizeof(uint32_t));
+        if (!*slots) {
+            ok = false;
+            break;
+        }
+        memset(*slots, 0xFF, *slot_count * sizeof(uint32_t));
+
+        bool complete = true;
+        for (uint32_t i = 0; i < ordered && complete; i++) {
+            uint32_t b = order[i];
+            uint32_t size = bucket_size[b];
+            complete = false;
+            for (uint32_t seed = 1; seed < (1u << 16) && !complete; seed++) {
+                complete = true;
+                for (uint32_t k = 0; k < size && complete; k++) {
+                    const char* path = nodes[members[start[b] + k]].path;
+                    placed[k] = vfs_hash(path, strlen(path), seed) % *slot_count;
+                    complete = (*slots)[placed[k]] == VFS_NO_NODE;
+                    for (uint32_t m = 0; m < k && complete; m++) complete = placed[m] != placed[k];
+                }
+                if (complete) {
+                    (*buckets)[b] = seed;
+                    for (uint32_t k = 0; k < size; k++) (*slots)[placed[k]] = members[start[b] + k];
+                }
+            }
+        }
+        if (complete) break;
+
+        // Rare: retry with more room
+        *slot_count += *slot_count / 4 + 1;
+    }
+
+    free(bucket_of);
+    free(bucket_size);
+    free(start);
+    free(members);
+    free(order);
+    free(placed);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+static bool build_image(pack_buffer_t* image) {
+    pack_buffer_t blocks = {0};
+    pack_buffer_t data = {0};
+    vfs_content_t* image_contents = calloc(content_count ? content_count : 1, sizeof(vfs_content_t));
+    for (size_t i = 0; image_contents && i < content_count; i++) {
+        pack_content_t* content = &contents[i];
+        image_contents[i].size = files[content->file].size;
+        image_contents[i].first_block = (uint32_t)(blocks.length / sizeof(vfs_block_t));
+
+        // Blocks of the previous image are copied as stored
+        const vfs_block_t* source = content->previous != PACK_NONE
+                                        ? &previous_blocks[previous_contents[content->previous].first_block]
+                                        : (const vfs_block_t*)content->blocks.data;
+        const uint8_t* stored = content->previous != PACK_NONE ? previous_data : content->stored.data;
+        uint32_t count = content->previous != PACK_NONE ? previous_contents[content->previous].block_count
+                                                        : (uint32_t)(content->blocks.length / sizeof(vfs_block_t));
+        for (uint32_t b = 0; b < count; b++) {
+            vfs_block_t block = {(uint32_t)data.length, source[b].length};
+            buffer_write(&data, stored + source[b].offset, source[b].length & ~VFS_RAW_BLOCK);
+            buffer_write(&blocks, &block, sizeof(block));
+        }
+        image_contents[i].block_count = count;
+    }
+
+    uint32_t bucket_count = 0;
+    uint32_t slot_count = 0;
+    uint32_t* buckets = NULL;
+    uint32_t* slots = NULL;
+    bool ok = image_contents && build_index(&bucket_count, &buckets, &slot_count, &slots);
+
+    pack_buffer_t strings = {0};
+    vfs_node_t* image_nodes = calloc(node_count, sizeof(vfs_node_t));
+    for (size_t i = 0; ok && image_nodes && i < node_count; i++) {
+        const pack_node_t* node = &nodes[i];
+        uint32_t first = node->type == WASI_FILETYPE_DIRECTORY ? node->first : files[node->first].content;
+        image_nodes[i] = (vfs_node_t){(uint32_t)strings.length, (uint32_t)(strings.length + node->name), node->type,
+                                      first, node->count, 0};
+        buffer_write(&strings, node->path, strlen(node->path) + 1);
+    }
+
+    ok = ok && image_nodes && !blocks.failed && !data.failed && !strings.failed && data.length <= UINT32_MAX &&
+         strings.length <= UINT32_MAX;
+    if (ok) {
+        vfs_header_t header = {
+            {0},
+            VFS_FORMAT_VERSION,
+            (uint32_t)node_count,
+            bucket_count,
+            slot_count,
+            (uint32_t)content_count,
+            (uint32_t)(blocks.length / sizeof(vfs_block_t)),
+            (uint32_t)strings.length,
+            (uint32_t)data.length,
+            0,
+        };
+        memcpy(header.magic, VFS_MAGIC, 4);
+        buffer_write(image, &header, sizeof(header));
+        buffer_align(image);
+        buffer_write(image, buckets, bucket_count * sizeof(uint32_t));
+        buffer_align(image);
+        buffer_write(image, slots, slot_count * sizeof(uint32_t));
+        buffer_align(image);
+        buffer_write(image, image_nodes, node_count * sizeof(vfs_node_t));
+        buffer_align(image);
+        buffer_write(image, image_contents, content_count * sizeof(vfs_content_t));
+        buffer_align(image);
+        buffer_write(image, blocks.data, blocks.length);
+        buffer_align(image);
+        buffer_write(image, strings.data, strings.length);
+        buffer_align(image);
+        buffer_write(image, data.data, data.length);
+        ok = !image->failed;
+    }
+
+    free(image_contents);
+    free(image_nodes);
+    free(buckets);
+    free(slots);
+    free(blocks.data);
+    free(data.data);
+    free(strings.data);
+    return ok;
+}
+
+static bool write_file(const char* path, const void* data, size_t length) {
+    char* temp_path = malloc(strlen(path) + 5);
+    if (!temp_path) return false;
+    sprintf(temp_path, "%s.tmp", path);
+
+    FILE* file = fopen(temp_path, "wb");
+    bool ok = file && fwrite(data, 1, length, file) == length;
+    ok = file && fclose(file) == 0 && ok;
+    ok = ok && rename(temp_path, path) == 0;
+    if (!ok) remove(temp_path);
+    free(temp_path);
+    return ok;
+}
+
+// C linking the image as is, with no array literal for the compiler to parse
+static bool write_stub(const char* output, size_t size) {
+    char image_path[PATH_MAX];
+    if (!realpath(output, image_path) || strpbrk(image_path, "\"\\\n")) {
+        fprintf(stderr, "php2wasm-pack: cannot link %s from C\n", output);
+        return false;
+    }
+
+    pack_buffer_t stub = {0};
+    char text[PATH_MAX + 1024];
+    int length = snprintf(text, sizeof(text),
+                          "// Generated by php2wasm-pack from %s; do not edit\n\n"
+                          "#include <stddef.h>\n#include <stdint.h>\n\n"
+                          "const size_t wasi_vfs_image_size = %zu;\n\n"
+                          "#ifdef __wasm__\n"
+                          "#define VFS_SECTION \".section .rodata.wasi_vfs_image,\\\"\\\",@\\n\"\n"
+                          "#else\n"
+                          "#define VFS_SECTION \".section .rodata.wasi_vfs_image,\\\"a\\\",@progbits\\n\"\n"
+                          "#endif\n\n"
+                          "__asm__(VFS_SECTION\n"
+                          "        \".globl wasi_vfs_image\\n\"\n"
+                          "        \".type wasi_vfs_image,@object\\n\"\n"
+                          "        \".p2align 3\\n\"\n"
+                          "        \"wasi_vfs_image:\\n\"\n"
+                          "        \".incbin \\\"%s\\\"\\n\"\n"
+                          "        \".size wasi_vfs_image, %zu\\n\");\n",
+                          root, size, image_path, size);
+    if (length < 0 || (size_t)length >= sizeof(text)) return false;
+    buffer_write(&stub, text, (size_t)length);
+
+    char* stub_path = malloc(strlen(output) + 3);
+    bool ok = stub_path && !stub.failed;
+    if (ok) {
+        sprintf(stub_path, "%s.c", output);
+        ok = write_file(stub_path, stub.data, stub.length);
+    }
+    free(stub_path);
+    free(stub.data);
+    return ok;
+}
+
+static bool write_manifest(const char* output, const uint8_t* image, size_t size) {
+    pack_buffer_t manifest = {0};
+    char line[VFS_PATH_MAX + 128];
+    int length = snprintf(line, sizeof(line), "php2wasm-pack %d %d %zu %016" PRIx64 "\n", PACK_MANIFEST_VERSION,
+                          VFS_FORMAT_VERSION, size, hash_image(image, size));
+    buffer_write(&manifest, line, (size_t)length);
+    for (size_t i = 0; i < file_count; i++) {
+        const pack_file_t* file = &files[i];
+        length = snprintf(line, sizeof(line), "%" PRId64 " %" PRIu64 " %016" PRIx64 " %016" PRIx64 " %" PRIu32 " %s\n",
+                          file->mtime, file->size, file->hash[0], file->hash[1], file->content, file->path);
+        buffer_write(&manifest, line, (size_t)length);
+    }
+
+    char* manifest_path = malloc(strlen(output) + 10);
+    bool ok = manifest_path && !manifest.failed;
+    if (ok) {
+        sprintf(manifest_path, "%s.manifest", output);
+        ok = write_file(manifest_path, manifest.data, manifest.length);
+    }
+    free(manifest_path);
+    free(manifest.data);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Main
+// ---------------------------------------------------------------------------
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] -o <image> <dir>\n"
+            "\n"
+            "Options:\n"
+            "  -o FILE      Image to write, with FILE.c linking it and FILE.manifest\n"
+            "  -j N         Threads (default: one per CPU)\n"
+            "  -i PATTERN   Pack only files matching by name or path\n"
+            "  -x PATTERN   Leave out files and directories matching by name or path\n"
+            "  -v           Report what was packed\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    const char* output = NULL;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = cpus > 0 ? (int)cpus : 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:j:i:x:vh")) != -1) {
+        switch (opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'j':
+                thread_count = atoi(optarg);
+                break;
+            case 'i':
+                includes = realloc(includes, (include_count + 1) * sizeof(char*));
+                if (!includes) return 1;
+                includes[include_count++] = optarg;
+                break;
+            case 'x':
+                excludes = realloc(excludes, (exclude_count + 1) * sizeof(char*));
+                if (!excludes) return 1;
+                excludes[exclude_count++] = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!output || optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    root = argv[optind];
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > PACK_MAX_THREADS) thread_count = PACK_MAX_THREADS;
+
+    load_previous(output);
+    if (!walk()) return 1;
+
+    size_t reused = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        files[i].previous = previous_image ? find_previous(&files[i]) : PACK_NONE;
+        reused += files[i].previous != PACK_NONE;
+    }
+
+    run_parallel(read_job, file_count);
+    for (size_t i = 0; i < file_count; i++) {
+        if (files[i].failed) {
+            fprintf(stderr, "php2wasm-pack: cannot read %s/%s\n", root, files[i].path);
+            return 1;
+        }
+    }
+
+    if (!deduplicate()) return 1;
+    run_parallel(compress_job, content_count);
+    for (size_t i = 0; i < content_count; i++) {
+        if (files[contents[i].file].failed) {
+            fprintf(stderr, "php2wasm-pack: out of memory\n");
+            return 1;
+        }
+    }
+
+    pack_buffer_t image = {0};
+    if (!build_image(&image) || !write_file(output, image.data, image.length) ||
+        !write_stub(output, image.length) || !write_manifest(output, image.data, image.length)) {
+        fprintf(stderr, "php2wasm-pack: cannot write %s\n", output);
+        return 1;
+    }
+
+    if (verbose) {
+        uint64_t total = 0;
+        for (size_t i = 0; i < file_count; i++) total += files[i].size;
+        printf("%zu files, %zu distinct, %zu unchanged; %" PRIu64 " bytes packed into %zu on %d threads\n",
+               file_count, content_count, reused, total, image.length, thread_count);
+    }
+
+    free(image.data);
+    return 0;
+}